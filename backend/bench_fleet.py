@@ -0,0 +1,307 @@
+#!/usr/bin/env python3
+"""
+End-to-end ingest benchmark
+
+Runs a backend against a fleet from fleetgen.py on a pty, into a local
+PostgreSQL database of its own, one step per fleet size (-n 100,500,...),
+and reports for each:
+
+  - offered: packets/s the nodes want to send (DATA and heartbeats), sent:
+    what got onto the link
+  - stored: readings/s committed while it ran, what the backend sustains
+  - lost: DATA packets sent intact but not stored by SETTLE_MAX after the
+    end (corrupted ones are expected to go and don't count)
+  - latency from a DATA packet being due at the node to its reading being
+    committed: the link's queue included, to within POLL
+  - lag: the longest a packet waited for the link (the reader is behind)
+  - /api/machines latency with CLIENTS clients requesting it back to back
+    meanwhile
+
+A reading is matched to its packet by order: one reader stores a node's
+packets in the order they come.
+
+The backend is server.py reading the pty itself, or with --ingest a command
+line for another ingest ({port} and {conninfo} filled in), server.py then
+only serving the API (INGEST=external):
+
+  --ingest "ingest/build/wasche_ingest -d {port} -D '{conninfo}'"
+
+The database (--db) is created if wasche_user may create it, and loaded
+with database/schema.sql on every run. The backend's output goes to
+bench_fleet.log.
+
+Usage: python bench_fleet.py [-n nodes,nodes,...] [-t seconds] [-k clients]
+                             [--ingest command] [--db name] [fleetgen options]
+"""
+
+import argparse
+import collections
+import multiprocessing
+import os
+import shlex
+import subprocess
+import sys
+import threading
+import time
+
+import psycopg2
+import requests
+
+import fleetgen
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCHEMA = os.path.normpath(os.path.join(HERE, '..', 'database', 'schema.sql'))
+
+# server.py's DB_CONFIG, another database
+DB_HOST = 'localhost'
+DB_USER = 'wasche_user'
+DB_PASSWORD = 'wasche_pass'
+
+POLL = 0.01            # s between looks for new readings
+STARTUP = 30.0         # s for the backend to come up
+SETTLE = 3.0           # s without a new reading once the fleet stopped: the rest is lost
+SETTLE_MAX = 60.0
+API_TIMEOUT = 5.0
+
+
+def percentiles(values):
+    """(p50, p99, max), None for none"""
+    if not values:
+        return None
+    values = sorted(values)
+    return values[len(values) // 2], values[len(values) * 99 // 100], values[-1]
+
+
+def ms(p):
+    return '-' if p is None else '/'.join(f'{v * 1000:.0f}' for v in p)
+
+
+class CommitWatcher(threading.Thread):
+    """Follows machine_readings and matches each new row to the oldest
+    unmatched DATA packet of its node"""
+
+    def __init__(self, db):
+        super().__init__(daemon=True)
+        self.db = db
+        self.lock = threading.Lock()
+        self.running = True
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.pending = collections.defaultdict(collections.deque)  # node -> due times
+            self.commits = []      # (seen, latency)
+            self.unmatched = 0     # readings of no packet sent (late from a step before)
+
+    def sent(self, node, due):
+        with self.lock:
+            self.pending[node].append(due)
+
+    def outstanding(self):
+        with self.lock:
+            return sum(len(dues) for dues in self.pending.values())
+
+    def run(self):
+        conn = psycopg2.connect(host=DB_HOST, database=self.db, user=DB_USER, password=DB_PASSWORD)
+        conn.autocommit = True
+        cur = conn.cursor()
+        cur.execute("SELECT COALESCE(MAX(id), 0) FROM machine_readings")
+        last_id = cur.fetchone()[0]
+
+        while self.running:
+            # Anything the query sees was committed before it started
+            seen = time.monotonic()
+            cur.execute("SELECT id, node_id FROM machine_readings WHERE id > %s ORDER BY id", (last_id,))
+            rows = cur.fetchall()
+            with self.lock:
+                for row_id, node in rows:
+                    dues = self.pending.get(node)
+                    if dues:
+                        self.commits.append((seen, seen - dues.popleft()))
+                    else:
+                        self.unmatched += 1
+                    last_id = row_id
+            time.sleep(POLL)
+        conn.close()
+
+
+def api_clients(url, clients, stop, results):
+    """Runs in a process of its own: `clients` threads requesting url back
+    to back until stop is set, then (requests, errors, elapsed,
+    percentiles) into results"""
+    latencies = []
+    errors = [0]
+
+    def client():
+        session = requests.Session()
+        while not stop.is_set():
+            start = time.perf_counter()
+            try:
+                ok = session.get(url, timeout=API_TIMEOUT).status_code == 200
+            except requests.RequestException:
+                ok = False
+            if ok:
+                latencies.append(time.perf_counter() - start)
+            else:
+                errors[0] += 1
+
+    start = time.perf_counter()
+    threads = [threading.Thread(target=client) for _ in range(clients)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    results.put((len(latencies), errors[0], time.perf_counter() - start, percentiles(latencies)))
+
+
+def prepare_database(db, nodes):
+    """Creates db if it isn't there, loads the schema, nodes 1..nodes"""
+    try:
+        conn = psycopg2.connect(host=DB_HOST, database='postgres', user=DB_USER, password=DB_PASSWORD)
+        conn.autocommit = True
+        cur = conn.cursor()
+        cur.execute("SELECT 1 FROM pg_database WHERE datname = %s", (db,))
+        if cur.fetchone() is None:
+            cur.execute(f'CREATE DATABASE "{db}"')
+        conn.close()
+    except psycopg2.Error as e:
+        sys.exit(f"Can't create database {db} ({str(e).strip()}), create it for {DB_USER} first")
+
+    env = dict(os.environ, PGPASSWORD=DB_PASSWORD, PGOPTIONS='-c client_min_messages=warning')
+    try:
+        subprocess.run(['psql', '-q', '-v', 'ON_ERROR_STOP=1', '-h', DB_HOST, '-U', DB_USER, '-d', db,
+                        '-f', SCHEMA], env=env, check=True, stdout=subprocess.DEVNULL)
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit(f"Loading {SCHEMA} with psql failed: {e}")
+
+    conn = psycopg2.connect(host=DB_HOST, database=db, user=DB_USER, password=DB_PASSWORD)
+    cur = conn.cursor()
+    cur.execute("INSERT INTO nodes (node_id) SELECT generate_series(1, %s) ON CONFLICT DO NOTHING",
+                (nodes,))
+    conn.commit()
+    conn.close()
+
+
+def start_backend(args, port, log):
+    """server.py, and the --ingest command if there is one"""
+    env = dict(os.environ, SERIAL_PORT=port, DB_HOST=DB_HOST, DB_NAME=args.db,
+               API_PORT=str(args.api_port))
+    processes = []
+    if args.ingest:
+        conninfo = f"host={DB_HOST} dbname={args.db} user={DB_USER} password={DB_PASSWORD}"
+        command = shlex.split(args.ingest.format(port=port, conninfo=conninfo))
+        processes.append(subprocess.Popen(command, cwd=HERE, stdout=log, stderr=subprocess.STDOUT))
+        env['INGEST'] = 'external'
+    processes.append(subprocess.Popen([sys.executable, 'server.py'], cwd=HERE, env=env,
+                                      stdout=log, stderr=subprocess.STDOUT))
+
+    url = f'http://localhost:{args.api_port}/api/machines'
+    deadline = time.monotonic() + STARTUP
+    while time.monotonic() < deadline:
+        if any(process.poll() is not None for process in processes):
+            break
+        try:
+            if requests.get(url, timeout=1).status_code == 200:
+                return processes
+        except requests.RequestException:
+            pass
+        time.sleep(0.2)
+    stop_backend(processes)
+    sys.exit("Backend didn't come up, see bench_fleet.log")
+
+
+def stop_backend(processes):
+    for process in processes:
+        process.terminate()
+    for process in processes:
+        try:
+            process.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            process.kill()
+
+
+def run_step(args, link, watcher, nodes):
+    watcher.reset()
+    fleet = fleetgen.fleet_from_arguments(args, nodes)
+
+    ctx = multiprocessing.get_context('spawn')
+    stop = ctx.Event()
+    results = ctx.Queue()
+    api = None
+    if args.clients > 0:
+        api = ctx.Process(target=api_clients, args=(f'http://localhost:{args.api_port}/api/machines',
+                                                    args.clients, stop, results))
+        api.start()
+
+    start = time.monotonic()
+    stats = fleet.run(link, args.seconds, on_data=watcher.sent)
+    end = start + args.seconds
+    stop.set()
+    api_result = results.get() if api is not None else None
+    if api is not None:
+        api.join()
+
+    # What's still on its way in
+    last = (0, time.monotonic())
+    while watcher.outstanding() and time.monotonic() - last[1] < SETTLE and \
+            time.monotonic() - end < SETTLE_MAX:
+        time.sleep(0.1)
+        if watcher.outstanding() != last[0]:
+            last = (watcher.outstanding(), time.monotonic())
+
+    with watcher.lock:
+        commits = list(watcher.commits)
+        unmatched = watcher.unmatched
+    lost = watcher.outstanding()
+    intact = stats.data - stats.corrupted
+    in_time = sum(1 for seen, _ in commits if seen <= end)
+
+    offered = nodes * (1 / args.interval + (1 / args.heartbeat if args.heartbeat > 0 else 0))
+    line = (f"{nodes:6d} {offered:9.1f} {(stats.data + stats.heartbeats) / args.seconds:9.1f} "
+            f"{in_time / args.seconds:9.1f} {lost:6d} {100 * lost / max(intact, 1):5.1f}% "
+            f"{ms(percentiles([latency for _, latency in commits])):>17} {stats.max_lag:6.2f}")
+    if api_result is not None:
+        count, errors, elapsed, p = api_result
+        line += f" {count / elapsed:8.1f} {ms(p):>12} {errors:4d}"
+    print(line, flush=True)
+    if unmatched or stats.unsent:
+        print(f"       {unmatched} readings of no packet, {stats.unsent} bytes never left the fleet")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end ingest benchmark")
+    parser.add_argument('-n', '--nodes', default='100,500,1000', help="fleet sizes, a step each")
+    fleetgen.add_fleet_arguments(parser)
+    parser.add_argument('-t', '--seconds', type=float, default=30.0, help="per step")
+    parser.add_argument('-k', '--clients', type=int, default=4, help="/api/machines clients")
+    parser.add_argument('--ingest', help="ingest command line, {port} and {conninfo} filled in")
+    parser.add_argument('--db', default='wasche_bench')
+    parser.add_argument('--api-port', type=int, default=5050)
+    args = parser.parse_args()
+    steps = [int(n) for n in args.nodes.split(',')]
+    if args.db == 'wasche_db':
+        sys.exit("The benchmark reloads its database, give it one of its own")
+
+    prepare_database(args.db, max(steps))
+    link = fleetgen.Link(args.baud)
+    with open(os.path.join(HERE, 'bench_fleet.log'), 'w') as log:
+        processes = start_backend(args, link.name, log)
+        watcher = CommitWatcher(args.db)
+        watcher.start()
+        try:
+            print(f"{'server.py' if not args.ingest else args.ingest} on {link.name}, "
+                  f"{f'{args.baud} baud' if args.baud else 'unpaced'}, a DATA packet every {args.interval} s per node, "
+                  f"{args.seconds:.0f} s per step")
+            print(f"{'nodes':>6} {'offered/s':>9} {'sent/s':>9} {'stored/s':>9} {'lost':>6} {'':>6} "
+                  f"{'latency ms p50/99/max':>17} {'lag s':>6}"
+                  + (f" {'api req/s':>8} {'p50/99/max ms':>12} {'errs':>4}" if args.clients else ''))
+            for nodes in steps:
+                run_step(args, link, watcher, nodes)
+        finally:
+            watcher.running = False
+            stop_backend(processes)
+            link.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Serial frame decoding throughput, as the backend does it
+
+Frames a stream of random telemetry-sized packets (11..82 bytes) and times
+the native decoder (firmware/build-host/libframe_codec.so, build it with
+`cd firmware && make codec-lib`) and the pure Python fallback on it, clean
+and with one flipped bit every CORRUPT bytes. Compared against what the
+coordinator can send at 115200 baud 8N1.
+
+Usage: python bench_framing.py [packets] [corrupt_every]
+"""
+
+import random
+import sys
+import time
+
+from framing import NativeFrameDecoder, PyFrameDecoder, encode_frame, native_available
+
+LINE_RATE = 115200 / 10  # bytes/s
+CHUNK = 4096             # roughly what one serial read returns when busy
+
+
+def run(name, decoder, stream):
+    start = time.perf_counter()
+    packets = 0
+    for pos in range(0, len(stream), CHUNK):
+        packets += len(decoder.feed(stream[pos:pos + CHUNK]))
+    elapsed = time.perf_counter() - start
+
+    rate = len(stream) / elapsed
+    stats = decoder.stats
+    print(f"{name:<16} {rate / 1e6:7.2f} MB/s  {packets / elapsed:9.0f} packets/s  "
+          f"{rate / LINE_RATE:7.0f}x line rate  "
+          f"({stats.frames} good, {stats.crc_errors} crc, {stats.length_errors} length)")
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 50000
+    corrupt = int(sys.argv[2]) if len(sys.argv) > 2 else 1000
+
+    rng = random.Random(1)
+    stream = bytearray()
+    for _ in range(count):
+        packet = bytes(rng.randrange(16) if rng.randrange(4) else rng.randrange(256)
+                       for _ in range(rng.randrange(11, 83)))
+        stream += encode_frame(packet)
+    stream = bytes(stream)
+
+    damaged = bytearray(stream)
+    if corrupt > 0:
+        for pos in range(rng.randrange(corrupt), len(damaged), corrupt):
+            damaged[pos] ^= 1 << rng.randrange(8)
+    damaged = bytes(damaged)
+
+    print(f"{count} packets, {len(stream)} bytes on the wire")
+    decoders = [('python', PyFrameDecoder)]
+    if native_available():
+        decoders.insert(0, ('native', NativeFrameDecoder))
+    else:
+        print("libframe_codec.so not found, Python decoder only")
+
+    for name, cls in decoders:
+        run(f"{name} clean", cls(), stream)
+        if corrupt > 0:
+            run(f"{name} 1/{corrupt}", cls(), damaged)
+
+
+if __name__ == '__main__':
+    main()
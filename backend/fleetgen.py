@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+"""
+Fleet load generator
+
+A fleet of nodes on a pty whose slave side stands in for the coordinator's
+serial port (/dev/ttyUSB0). Every node sends zigbee_packet_t DATA packets
+every INTERVAL s and HEARTBEATs every HEARTBEAT s (the firmware's
+TRANSMIT_INTERVAL_MS and HEARTBEAT_INTERVAL_MS), each one up to JITTER of
+its interval early or late, framed the way the coordinator frames them
+(framing.py). Its machine goes round a wash cycle (CYCLE, state:seconds,...)
+from a random point in it, with rms and frequency to match the state.
+
+Every CORRUPT-th frame gets one bit flipped on the wire, which costs exactly
+that frame. The link runs at BAUD (0: as fast as the reader takes it). A
+packet that can't go out when it's due (the link or the reader is behind)
+waits its turn and keeps its due time, so lag says how far behind it got.
+
+bench_fleet.py runs a backend against it and measures. On its own:
+
+Usage: python fleetgen.py [-n nodes] [-i interval] [-H heartbeat] [-j jitter]
+                          [-c cycle] [-x corrupt_every] [-b baud] [-t seconds]
+  then point a backend at the pty it prints: SERIAL_PORT=/dev/pts/N python
+  server.py, or ingest/build/wasche_ingest -d /dev/pts/N
+"""
+
+import argparse
+import bisect
+import heapq
+import itertools
+import os
+import random
+import select
+import struct
+import time
+import tty
+
+from framing import crc16_ccitt, encode_frame
+
+# firmware zigbee_handler.h
+PKT_TYPE_DATA = 0x01
+PKT_TYPE_HEARTBEAT = 0x02
+LEGACY_BODY = struct.Struct('<BHBffI')  # zigbee_packet_t without its checksum
+
+STATES = {'IDLE': 0, 'WASHING': 1, 'SPINNING': 2, 'DONE': 3, 'UNKNOWN': 4}
+
+# (rms in g, dominant frequency in Hz) of a machine in each state, give or
+# take 20 %
+SIGNATURES = {0: (0.01, 0.0), 1: (0.25, 0.8), 2: (0.9, 13.0), 3: (0.02, 0.0), 4: (0.05, 0.0)}
+
+DEFAULT_CYCLE = 'IDLE:1200,WASHING:2400,SPINNING:600,DONE:600'
+
+# Bytes waiting for the link before due packets are held back (and start
+# to lag): about what the coordinator's queue holds
+OUT_HIGH = 16384
+LINE_AHEAD = 0.005   # s of line time written ahead of the clock
+WRITE_MAX = 65536
+READ_SIZE = 4096
+DRAIN = 10.0         # s to get what's waiting out once the fleet stops
+
+
+def parse_cycle(spec):
+    """'IDLE:1200,WASHING:2400,...' -> [(state number, seconds)]"""
+    cycle = []
+    for step in spec.split(','):
+        name, _, seconds = step.partition(':')
+        name = name.strip().upper()
+        if name not in STATES or not seconds or float(seconds) <= 0:
+            raise ValueError(f"Bad cycle step: {step}")
+        cycle.append((STATES[name], float(seconds)))
+    return cycle
+
+
+class FleetStats:
+    def __init__(self):
+        self.data = 0          # DATA packets sent, corrupted included
+        self.heartbeats = 0
+        self.corrupted = 0
+        self.bytes = 0         # written to the link
+        self.unsent = 0        # bytes still waiting when it gave up draining
+        self.held = 0          # packets due before the end that never went out
+        self.max_lag = 0.0     # s, longest a packet waited past its due time
+        self.elapsed = 0.0     # s, first packet to the link drained
+
+
+class Link:
+    """The pty: written on the master side at `baud` (0: unpaced), the
+    slave left open so the reader can come and go"""
+
+    def __init__(self, baud=115200):
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.slave)
+        os.set_blocking(self.master, False)
+        self.name = os.ttyname(self.slave)
+        self.baud = baud
+        self.line_free = 0.0   # monotonic time the line is done with what it got
+        self.received = 0      # bytes the reader sent back (ACKs)
+
+    def room(self, now):
+        """Bytes the line takes now"""
+        if not self.baud:
+            return WRITE_MAX
+        self.line_free = max(self.line_free, now)
+        return min(WRITE_MAX, int((now + LINE_AHEAD - self.line_free) * self.baud / 10))
+
+    def wait(self, now):
+        """s until the line takes another byte"""
+        if not self.baud:
+            return 0.0
+        return max(0.0, self.line_free - LINE_AHEAD - now) + 10 / self.baud
+
+    def write(self, out, now):
+        """Writes what it can of `out` (a bytearray), drops that from it"""
+        room = self.room(now)
+        if room <= 0 or not out:
+            return 0
+        try:
+            n = os.write(self.master, bytes(out[:room]))
+        except BlockingIOError:
+            return 0
+        del out[:n]
+        if self.baud:
+            self.line_free += n * 10 / self.baud
+        return n
+
+    def read(self):
+        """Whatever came back; nothing reads it"""
+        while True:
+            try:
+                data = os.read(self.master, READ_SIZE)
+            except (BlockingIOError, OSError):
+                return
+            if not data:
+                return
+            self.received += len(data)
+
+    def close(self):
+        os.close(self.master)
+        os.close(self.slave)
+
+
+class Fleet:
+    """Nodes 1..nodes. Not thread safe: run() it from one thread."""
+
+    def __init__(self, nodes, interval=5.0, heartbeat=30.0, jitter=0.1,
+                 cycle=DEFAULT_CYCLE, corrupt_every=0, seed=1):
+        if not 0 < nodes <= 0xFFFF:
+            raise ValueError("1 to 65535 nodes")
+        self.nodes = nodes
+        self.interval = interval
+        self.heartbeat = heartbeat
+        self.jitter = jitter
+        self.cycle = parse_cycle(cycle) if isinstance(cycle, str) else cycle
+        self.cycle_ends = list(itertools.accumulate(seconds for _, seconds in self.cycle))
+        self.corrupt_every = corrupt_every
+        self.rng = random.Random(seed)
+        self.phase = [self.rng.uniform(0, self.cycle_ends[-1]) for _ in range(nodes)]
+        self.boot_ms = [self.rng.randrange(1 << 31) for _ in range(nodes)]
+        self.stats = FleetStats()
+
+    def state(self, node, t):
+        """Where node's machine is in its cycle t s into the run"""
+        offset = (self.phase[node - 1] + t) % self.cycle_ends[-1]
+        return self.cycle[bisect.bisect_right(self.cycle_ends, offset)][0]
+
+    def packet(self, kind, node, t):
+        """zigbee_packet_t as the firmware sends it, timestamp its ms since boot"""
+        ms = (self.boot_ms[node - 1] + int(t * 1000)) & 0xFFFFFFFF
+        if kind == PKT_TYPE_HEARTBEAT:
+            body = LEGACY_BODY.pack(PKT_TYPE_HEARTBEAT, node, 0, 0.0, 0.0, ms)
+        else:
+            state = self.state(node, t)
+            rms, freq = SIGNATURES[state]
+            noise = self.rng.uniform(0.8, 1.2)
+            body = LEGACY_BODY.pack(PKT_TYPE_DATA, node, state, rms * noise, freq * noise, ms)
+        return body + struct.pack('<H', crc16_ccitt(body))
+
+    def damage(self, frame):
+        """One bit flipped anywhere but the delimiter, never into one, so
+        the frames either side are left alone"""
+        frame = bytearray(frame)
+        pos = self.rng.randrange(len(frame) - 1)
+        for bit in self.rng.sample(range(8), 8):
+            if frame[pos] ^ (1 << bit):
+                frame[pos] ^= 1 << bit
+                break
+        return bytes(frame)
+
+    def next_due(self, due, kind):
+        interval = self.interval if kind == PKT_TYPE_DATA else self.heartbeat
+        return due + interval * (1 + self.rng.uniform(-self.jitter, self.jitter))
+
+    def run(self, link, duration=None, stop=None, on_data=None):
+        """Sends for `duration` s, or until `stop` (a threading.Event) is
+        set, then drains what's waiting for up to DRAIN s.
+        on_data(node, due) is called for every DATA packet that goes out
+        intact, before it's written, with its due time in time.monotonic().
+        Returns the stats."""
+        stats = self.stats = FleetStats()
+        queue = []
+        for node in range(1, self.nodes + 1):
+            queue.append((self.rng.uniform(0, self.interval), node, PKT_TYPE_DATA))
+            if self.heartbeat > 0:
+                queue.append((self.rng.uniform(0, self.heartbeat), node, PKT_TYPE_HEARTBEAT))
+        heapq.heapify(queue)
+
+        out = bytearray()
+        frames = 0
+        start = time.monotonic()
+        end = start + duration if duration is not None else float('inf')
+        drain_until = None
+
+        while True:
+            now = time.monotonic()
+            if drain_until is None and (now >= end or (stop is not None and stop.is_set())):
+                stop_t = now - start
+                stats.held = sum(1 for due, _, _ in queue if due <= stop_t)
+                drain_until = now + DRAIN
+
+            if drain_until is None:
+                while queue and start + queue[0][0] <= now and len(out) < OUT_HIGH:
+                    due, node, kind = queue[0]
+                    frame = encode_frame(self.packet(kind, node, due))
+                    frames += 1
+                    if self.corrupt_every and frames % self.corrupt_every == 0:
+                        frame = self.damage(frame)
+                        stats.corrupted += 1
+                    elif kind == PKT_TYPE_DATA and on_data is not None:
+                        on_data(node, start + due)
+                    if kind == PKT_TYPE_DATA:
+                        stats.data += 1
+                    else:
+                        stats.heartbeats += 1
+                    stats.max_lag = max(stats.max_lag, now - start - due)
+                    out += frame
+                    heapq.heapreplace(queue, (self.next_due(due, kind), node, kind))
+            elif not out or now >= drain_until:
+                break
+
+            stats.bytes += link.write(out, now)
+            link.read()
+
+            timeout = 0.1
+            if drain_until is None:
+                timeout = min(timeout, end - now)
+                if queue and len(out) < OUT_HIGH:
+                    timeout = min(timeout, start + queue[0][0] - now)
+            writing = out and link.room(now) > 0
+            if out and not writing:
+                timeout = min(timeout, link.wait(now))
+            select.select([link.master], [link.master] if writing else [], [], max(timeout, 0))
+
+        stats.unsent = len(out)
+        stats.elapsed = time.monotonic() - start
+        return stats
+
+
+def add_fleet_arguments(parser):
+    """The fleet's options, shared with bench_fleet.py"""
+    parser.add_argument('-i', '--interval', type=float, default=5.0, help="s between DATA packets")
+    parser.add_argument('-H', '--heartbeat', type=float, default=30.0,
+                        help="s between heartbeats, 0 for none")
+    parser.add_argument('-j', '--jitter', type=float, default=0.1, help="fraction of the interval")
+    parser.add_argument('-c', '--cycle', default=DEFAULT_CYCLE, help="state:seconds,...")
+    parser.add_argument('-x', '--corrupt-every', type=int, default=0,
+                        help="flip a bit in every n-th frame, 0 for never")
+    parser.add_argument('-b', '--baud', type=int, default=115200, help="0: as fast as it's read")
+    parser.add_argument('--seed', type=int, default=1)
+
+
+def fleet_from_arguments(args, nodes):
+    return Fleet(nodes, args.interval, args.heartbeat, args.jitter, parse_cycle(args.cycle),
+                 args.corrupt_every, args.seed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fleet of nodes on a pty")
+    parser.add_argument('-n', '--nodes', type=int, default=100)
+    add_fleet_arguments(parser)
+    parser.add_argument('-t', '--seconds', type=float, help="how long (default: until Ctrl-C)")
+    args = parser.parse_args()
+
+    link = Link(args.baud)
+    fleet = fleet_from_arguments(args, args.nodes)
+    print(f"{args.nodes} nodes on {link.name}, {args.baud or 'unpaced'} baud", flush=True)
+    try:
+        stats = fleet.run(link, args.seconds)
+    except KeyboardInterrupt:
+        stats = fleet.stats
+    print(f"{stats.data} data, {stats.heartbeats} heartbeats ({stats.corrupted} corrupted) "
+          f"in {stats.elapsed:.1f} s, {stats.bytes} bytes, {link.received} back, "
+          f"max lag {stats.max_lag:.2f} s, {stats.held} held, {stats.unsent} bytes unsent")
+    link.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,200 @@
+"""
+Serial framing (matches firmware/frame_codec.h)
+
+On the wire every packet is COBS(length | packet | crc16 big-endian) + 0x00,
+CRC-16/CCITT-FALSE over length and packet. 0x00 only ever appears as the
+delimiter, so after a dropped or garbled byte the decoder loses that frame
+and picks up again at the next one.
+
+Decoding uses the firmware's own frame_codec.c built as a shared library
+(cd firmware && make codec-lib) when it's there, WASCHE_CODEC_LIB overrides
+the path. Otherwise falls back to the pure Python version below, which is
+slower but plenty for one serial port.
+"""
+
+import ctypes
+import os
+
+
+FRAME_PAYLOAD_MAX = 255
+FRAME_OVERHEAD = 3  # length + CRC
+
+DEFAULT_LIB = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           '..', 'firmware', 'build-host', 'libframe_codec.so')
+
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        table.append(crc & 0xFFFF)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, same as frame_crc16() in the firmware"""
+    for byte in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC16_TABLE[(crc >> 8) ^ byte]
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_at = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_at] = code
+            code_at = len(out)
+            out.append(0)
+            code = 1
+            continue
+        out.append(byte)
+        code += 1
+        if code == 0xFF:
+            out[code_at] = code
+            code_at = len(out)
+            out.append(0)
+            code = 1
+    out[code_at] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """Returns the decoded bytes, None if the block structure is broken"""
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        end = pos + code
+        if code == 0 or end > len(data):
+            return None
+        out += data[pos + 1:end]
+        pos = end
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(packet):
+    """Frame one packet for the wire, delimiter included"""
+    if len(packet) > FRAME_PAYLOAD_MAX:
+        raise ValueError("Packet too long to frame")
+    raw = bytes([len(packet)]) + bytes(packet)
+    crc = crc16_ccitt(raw)
+    return cobs_encode(raw + bytes([crc >> 8, crc & 0xFF])) + b'\x00'
+
+
+class FrameStats(ctypes.Structure):
+    # frame_stats_t, the first member of frame_decoder_t
+    _fields_ = [
+        ('frames', ctypes.c_uint32),
+        ('crc_errors', ctypes.c_uint32),
+        ('length_errors', ctypes.c_uint32),
+        ('overruns', ctypes.c_uint32),
+    ]
+
+
+def _load_native():
+    path = os.environ.get('WASCHE_CODEC_LIB', DEFAULT_LIB)
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+
+    lib.frame_decoder_size.restype = ctypes.c_size_t
+    lib.frame_decoder_init.argtypes = [ctypes.c_void_p]
+    lib.frame_decoder_init.restype = None
+    lib.frame_decoder_feed.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_size_t)]
+    lib.frame_decoder_feed.restype = ctypes.c_size_t
+    return lib
+
+
+_native = _load_native()
+
+
+class NativeFrameDecoder:
+    """Streaming decoder backed by frame_codec.c"""
+
+    def __init__(self, lib=None):
+        self.lib = lib or _native
+        self.state = ctypes.create_string_buffer(self.lib.frame_decoder_size())
+        self.lib.frame_decoder_init(self.state)
+        self.stats = FrameStats.from_buffer(self.state)
+        self._packet = ctypes.c_void_p()
+        self._length = ctypes.c_size_t()
+
+    def feed(self, data):
+        """Returns the packets completed by `data`, oldest first"""
+        packets = []
+        size = len(data)
+        if size == 0:
+            return packets
+
+        buf = (ctypes.c_char * size).from_buffer_copy(data)
+        base = ctypes.addressof(buf)
+        pos = 0
+        while pos < size:
+            pos += self.lib.frame_decoder_feed(self.state, base + pos, size - pos,
+                                               ctypes.byref(self._packet), ctypes.byref(self._length))
+            if self._length.value:
+                packets.append(ctypes.string_at(self._packet.value, self._length.value))
+        return packets
+
+
+class PyFrameDecoder:
+    """
+    Same as frame_codec.c in Python, for when the library isn't built. Only
+    splits on delimiters: a frame that lost its delimiter takes the next one
+    with it, where the C decoder saves both.
+    """
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.stats = FrameStats()
+
+    def _check(self, encoded):
+        raw = cobs_decode(encoded)
+        if raw is None or len(raw) < FRAME_OVERHEAD or raw[0] != len(raw) - FRAME_OVERHEAD:
+            self.stats.length_errors += 1
+            return None
+        if crc16_ccitt(raw) != 0:
+            self.stats.crc_errors += 1
+            return None
+        self.stats.frames += 1
+        return raw[1:-2] or None
+
+    def feed(self, data):
+        self.pending += data
+        *frames, rest = self.pending.split(b'\x00')
+        self.pending = bytearray(rest)
+        if len(self.pending) > FRAME_PAYLOAD_MAX * 2:
+            # no delimiter for longer than any frame, wait for the next one
+            self.stats.overruns += 1
+            self.pending.clear()
+
+        packets = []
+        for encoded in frames:
+            if encoded:
+                packet = self._check(bytes(encoded))
+                if packet:
+                    packets.append(packet)
+        return packets
+
+
+def FrameDecoder():
+    """Native decoder if libframe_codec.so loaded, Python otherwise"""
+    if _native is not None:
+        return NativeFrameDecoder()
+    return PyFrameDecoder()
+
+
+def native_available():
+    return _native is not None
@@ -0,0 +1,253 @@
+#include "decode.h"
+#include "frame_codec.h"
+#include "zigbee_handler.h"
+#include <string.h>
+
+#define TELEMETRY_HEADER 11
+#define COORDINATOR_HEADER 6
+#define PROFILE_HEADER 17
+#define LEGACY_SIZE 18
+#define TASKS_HEADER 13
+#define TASKS_ENTRY 5
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// LEB128, at most 5 bytes
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint32_t *value) {
+    uint32_t v = 0;
+
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (*p >= end) {
+            return false;
+        }
+        uint8_t byte = *(*p)++;
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+bool decode_checksum(const uint8_t *packet, size_t length) {
+    return length >= 3 && frame_crc16(packet, length - 2) == get16(&packet[length - 2]);
+}
+
+uint16_t decode_node_id(const uint8_t *packet, size_t length) {
+    return length >= 3 ? get16(&packet[1]) : 0;
+}
+
+bool decode_batch(const uint8_t *packet, size_t length, decode_batch_t *out) {
+    if (length < TELEMETRY_HEADER + 2 || (packet[0] != PKT_TYPE_BATCH && packet[0] != PKT_TYPE_FEATURES) ||
+        !decode_checksum(packet, length)) {
+        return false;
+    }
+
+    const uint8_t *p = packet + TELEMETRY_HEADER, *end = packet + length - 2;
+    out->features = packet[0] == PKT_TYPE_FEATURES;
+    out->node_id = get16(&packet[1]);
+    out->flags = packet[3];
+    out->count = packet[4];
+    out->sent_ms = get32(&packet[5]);
+    out->seq = get16(&packet[9]);
+    if (out->count == 0) {
+        return p == end;
+    }
+
+    size_t bitmap_size = (out->count + 6) / 8;
+    size_t first_size = 3 + (out->features ? DECODE_FEATURES_SIZE : 2);
+    if (p + first_size + bitmap_size > end) {
+        return false;
+    }
+
+    uint8_t state = p[0];
+    int32_t rms = get16(&p[1]);
+    int32_t freq = 0;
+    uint8_t vector[DECODE_FEATURES_SIZE];
+    if (out->features) {
+        memcpy(vector, &p[3], DECODE_FEATURES_SIZE);
+    } else {
+        freq = get16(&p[3]);
+    }
+    const uint8_t *bitmap = p + first_size;
+    p += first_size + bitmap_size;
+
+    for (uint8_t i = 0; i < out->count; i++) {
+        if (i > 0 && (bitmap[(i - 1) / 8] & (1 << ((i - 1) % 8)))) {
+            if (p >= end) {
+                return false;
+            }
+            state = *p++;
+        }
+        out->readings[i].state = state;
+    }
+
+    uint32_t age, v;
+    if (!get_varint(&p, end, &age)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < out->count; i++) {
+        decode_reading_t *r = &out->readings[i];
+
+        if (i > 0) {
+            if (!get_varint(&p, end, &v)) {
+                return false;
+            }
+            age -= v;
+            if (!get_varint(&p, end, &v)) {
+                return false;
+            }
+            rms += unzigzag(v);
+            if (out->features) {
+                if (p >= end) {
+                    return false;
+                }
+                uint8_t mask = *p++;
+                for (int j = 0; j < DECODE_FEATURES_SIZE; j++) {
+                    if (mask & (1 << j)) {
+                        if (p >= end) {
+                            return false;
+                        }
+                        vector[j] = *p++;
+                    }
+                }
+            } else {
+                if (!get_varint(&p, end, &v)) {
+                    return false;
+                }
+                freq += unzigzag(v);
+            }
+        }
+
+        r->rms = rms / 1000.0;
+        r->age_ms = (int32_t)age > 0 ? age : 0;
+        if (out->features) {
+            memcpy(r->features, vector, DECODE_FEATURES_SIZE);
+            r->freq_hz = 0;
+        } else {
+            r->freq_hz = freq / 10.0;
+        }
+    }
+    return p == end;
+}
+
+bool decode_legacy(const uint8_t *packet, size_t length, uint16_t *node_id, uint8_t *state,
+                   float *rms, float *freq_hz) {
+    if (length != LEGACY_SIZE || (packet[0] != PKT_TYPE_DATA && packet[0] != PKT_TYPE_HEARTBEAT) ||
+        !decode_checksum(packet, length)) {
+        return false;
+    }
+    *node_id = get16(&packet[1]);
+    *state = packet[3];
+    memcpy(rms, &packet[4], 4);
+    memcpy(freq_hz, &packet[8], 4);
+    return true;
+}
+
+bool decode_profile(const uint8_t *packet, size_t length, decode_profile_t *out) {
+    if (length < PROFILE_HEADER + 2 || packet[0] != PKT_TYPE_PROFILE || !decode_checksum(packet, length)) {
+        return false;
+    }
+
+    uint32_t cycle_hz = get32(&packet[7]);
+    if (cycle_hz == 0) {
+        return false;
+    }
+    float us_per_cycle = 1e6f / cycle_hz;
+    out->node_id = get16(&packet[1]);
+    out->period_ms = get32(&packet[11]);
+    out->bucket_shift = packet[15];
+    out->count = 0;
+
+    const uint8_t *p = packet + PROFILE_HEADER, *end = packet + length - 2;
+    for (uint8_t i = 0; i < packet[16]; i++) {
+        uint32_t low, high, mean;
+        decode_stage_t *s = &out->stages[out->count];
+
+        if (out->count == DECODE_STAGES_MAX || p >= end) {
+            return false;
+        }
+        s->stage = *p++;
+        if (!get_varint(&p, end, &s->count) || !get_varint(&p, end, &low) ||
+            !get_varint(&p, end, &high) || !get_varint(&p, end, &mean) || p + 2 > end) {
+            return false;
+        }
+        s->first_bucket = p[0];
+        s->buckets = p[1];
+        p += 2;
+        if (s->buckets > DECODE_HISTOGRAM_MAX || p + s->buckets > end) {
+            return false;
+        }
+        memcpy(s->histogram, p, s->buckets);
+        p += s->buckets;
+        s->min_us = low * us_per_cycle;
+        s->max_us = high * us_per_cycle;
+        s->mean_us = mean * us_per_cycle;
+        out->count++;
+    }
+    return p == end;
+}
+
+bool decode_tasks(const uint8_t *packet, size_t length, uint16_t *node_id) {
+    if (length < TASKS_HEADER + 2 || packet[0] != PKT_TYPE_TASKS ||
+        length != TASKS_HEADER + (size_t)packet[12] * TASKS_ENTRY + 2 || !decode_checksum(packet, length)) {
+        return false;
+    }
+    *node_id = get16(&packet[1]);
+    return true;
+}
+
+static bool iter_begin(const uint8_t *packet, size_t length, uint8_t type, decode_iter_t *it) {
+    if (length < COORDINATOR_HEADER + 2 || packet[0] != type || !decode_checksum(packet, length)) {
+        return false;
+    }
+    it->p = packet + COORDINATOR_HEADER;
+    it->end = packet + length - 2;
+    it->left = packet[5];
+    return true;
+}
+
+bool decode_aggregate_begin(const uint8_t *packet, size_t length, decode_iter_t *it) {
+    return iter_begin(packet, length, PKT_TYPE_AGGREGATE, it);
+}
+
+bool decode_aggregate_next(decode_iter_t *it, uint32_t *age_ms, const uint8_t **packet, size_t *length) {
+    if (it->left == 0 || !get_varint(&it->p, it->end, age_ms) || it->p >= it->end ||
+        it->p + 1 + it->p[0] > it->end) {
+        return false;
+    }
+    *length = it->p[0];
+    *packet = it->p + 1;
+    it->p += 1 + *length;
+    it->left--;
+    return true;
+}
+
+bool decode_nodes_begin(const uint8_t *packet, size_t length, decode_iter_t *it) {
+    return iter_begin(packet, length, PKT_TYPE_NODES, it);
+}
+
+bool decode_nodes_next(decode_iter_t *it, uint16_t *node_id, uint8_t *lqi, uint32_t *age_ms) {
+    if (it->left == 0 || it->p + 3 > it->end) {
+        return false;
+    }
+    *node_id = get16(it->p);
+    *lqi = it->p[2];
+    it->p += 3;
+    if (!get_varint(&it->p, it->end, age_ms)) {
+        return false;
+    }
+    it->left--;
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// The packets server.py understands, decoded in C (layouts in the firmware:
+// telemetry.h, coordinator.h, profile.h, zigbee_handler.h). Everything
+// works on the packet where it lies: aggregates hand back pointers into the
+// frame, nothing is allocated. All return false on a bad packet (length,
+// checksum, truncation), like server.py's ValueError.
+
+#define DECODE_READINGS_MAX 255
+#define DECODE_FEATURES_SIZE 5
+#define DECODE_STAGES_MAX 16
+#define DECODE_HISTOGRAM_MAX 32
+
+typedef struct {
+    uint8_t state;
+    double rms;               // g
+    double freq_hz;           // PKT_TYPE_BATCH only
+    uint32_t age_ms;          // before the frame was sent
+    uint8_t features[DECODE_FEATURES_SIZE];  // PKT_TYPE_FEATURES only
+} decode_reading_t;
+
+typedef struct {
+    uint16_t node_id;
+    uint8_t flags;
+    uint16_t seq;
+    uint32_t sent_ms;
+    bool features;            // PKT_TYPE_FEATURES: features set, freq_hz not
+    uint8_t count;
+    decode_reading_t readings[DECODE_READINGS_MAX];
+} decode_batch_t;
+
+typedef struct {
+    uint8_t stage;
+    uint32_t count;
+    float min_us, max_us, mean_us;
+    uint8_t first_bucket;
+    uint8_t buckets;
+    uint8_t histogram[DECODE_HISTOGRAM_MAX];
+} decode_stage_t;
+
+typedef struct {
+    uint16_t node_id;
+    uint32_t period_ms;
+    uint8_t bucket_shift;
+    uint8_t count;
+    decode_stage_t stages[DECODE_STAGES_MAX];
+} decode_profile_t;
+
+// PKT_TYPE_AGGREGATE / PKT_TYPE_NODES entries, one at a time
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint8_t left;
+} decode_iter_t;
+
+bool decode_checksum(const uint8_t *packet, size_t length);
+uint16_t decode_node_id(const uint8_t *packet, size_t length);
+
+bool decode_batch(const uint8_t *packet, size_t length, decode_batch_t *out);
+bool decode_legacy(const uint8_t *packet, size_t length, uint16_t *node_id, uint8_t *state,
+                   float *rms, float *freq_hz);
+bool decode_profile(const uint8_t *packet, size_t length, decode_profile_t *out);
+// PKT_TYPE_TASKS: only checked, the numbers go to server.py's log, not here
+bool decode_tasks(const uint8_t *packet, size_t length, uint16_t *node_id);
+
+bool decode_aggregate_begin(const uint8_t *packet, size_t length, decode_iter_t *it);
+// Next packet: *packet points into the aggregate. False at the end or on a
+// bad entry (it->left says which).
+bool decode_aggregate_next(decode_iter_t *it, uint32_t *age_ms, const uint8_t **packet, size_t *length);
+
+bool decode_nodes_begin(const uint8_t *packet, size_t length, decode_iter_t *it);
+bool decode_nodes_next(decode_iter_t *it, uint16_t *node_id, uint8_t *lqi, uint32_t *age_ms);
+
+#endif // DECODE_H
@@ -0,0 +1,379 @@
+/*
+ * Wasche ingest daemon
+ *
+ * Takes the coordinator's serial link off backend/server.py: reads the
+ * port, decodes the frames and stores what they carry in the same tables,
+ * ACKing telemetry frames once they are committed. server.py then only
+ * serves the API (run it with INGEST=external, see README.md).
+ *
+ * Two threads. This one (the reader) waits on the port with epoll, reads
+ * whatever is there and decodes the frames (firmware/frame_codec.c) into a
+ * bounded lock-free queue; the writer (writer.c) empties it into the
+ * database a group per transaction.
+ *
+ *   wasche_ingest [-d /dev/ttyUSB0] [-b 115200] [-D conninfo | -s file.db]
+ *                 [-g group_ms] [-G group_packets] [-q queue_depth]
+ *
+ * Self test: a simulated fleet on a pty, into SQLite (in memory unless -s)
+ *
+ *   wasche_ingest -T [-n nodes] [-c frames] [-r frames/s] [-R dup_every] [-U]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "frame_codec.h"
+#include "loadgen.h"
+#include "queue.h"
+#include "sink.h"
+#include "writer.h"
+#include "zigbee_handler.h"
+
+// server.py's DB_CONFIG
+#define DEFAULT_CONNINFO "host=localhost dbname=wasche_db user=wasche_user password=wasche_pass"
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+#define READ_SIZE 65536
+
+typedef struct {
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t stalls;          // queue full, the reader waited for the writer
+} reader_stats_t;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static speed_t baud_constant(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    default: return 0;
+    }
+}
+
+// Raw 8N1, non-blocking
+static int open_port(const char *device, long baud) {
+    int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        fprintf(stderr, "ingest: can't open %s: %s\n", device, strerror(errno));
+        return -1;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        speed_t speed = baud_constant(baud);
+        if (speed == 0) {
+            fprintf(stderr, "ingest: unsupported baud rate %ld\n", baud);
+            close(fd);
+            return -1;
+        }
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+// The pty for the self test: the load generator gets the master, the
+// daemon opens the slave like a serial port
+static int open_pty(char *slave, size_t size) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, slave, size) != 0) {
+        fprintf(stderr, "ingest: can't make a pty: %s\n", strerror(errno));
+        if (master >= 0) {
+            close(master);
+        }
+        return -1;
+    }
+    return master;
+}
+
+// Everything the port has now, into the queue
+static bool read_port(int fd, frame_decoder_t *decoder, ingest_queue_t *queue, writer_t *writer,
+                      reader_stats_t *stats, uint8_t *buf) {
+    for (;;) {
+        ssize_t n = read(fd, buf, READ_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            return true;
+        }
+        if (n <= 0) {
+            // EOF, or EIO once the other end of a pty is gone
+            return false;
+        }
+
+        // One timestamp for everything in the read
+        int64_t read_us = clock_us(CLOCK_MONOTONIC);
+        int64_t wall_us = clock_us(CLOCK_REALTIME);
+        const uint8_t *data = buf;
+        size_t left = (size_t)n;
+        bool published = false;
+        stats->reads++;
+        stats->bytes += (uint64_t)n;
+
+        while (left > 0) {
+            const uint8_t *packet;
+            size_t length = 0;
+            size_t used = frame_decoder_feed(decoder, data, left, &packet, &length);
+            data += used;
+            left -= used;
+            if (length == 0) {
+                continue;
+            }
+
+            ingest_item_t *item;
+            while ((item = ingest_queue_reserve(queue)) == NULL) {
+                // the writer is behind: let it catch up, the port buffers meanwhile
+                if (published) {
+                    eventfd_write(writer->wake_fd, 1);
+                    published = false;
+                }
+                stats->stalls++;
+                struct timespec pause = {0, 100000};
+                nanosleep(&pause, NULL);
+            }
+            item->read_us = read_us;
+            item->wall_us = wall_us;
+            item->length = (uint16_t)length;
+            memcpy(item->data, packet, length);
+            ingest_queue_publish(queue);
+            published = true;
+        }
+        if (published) {
+            eventfd_write(writer->wake_fd, 1);
+        }
+    }
+}
+
+static void print_stats(const frame_decoder_t *decoder, const reader_stats_t *reader, const writer_stats_t *w,
+                        double seconds) {
+    static const char *const names[] = {
+        [PKT_TYPE_DATA] = "data", [PKT_TYPE_HEARTBEAT] = "heartbeat", [PKT_TYPE_BATCH] = "batch",
+        [PKT_TYPE_PROFILE] = "profile", [PKT_TYPE_FEATURES] = "features", [PKT_TYPE_AGGREGATE] = "aggregate",
+        [PKT_TYPE_NODES] = "nodes", [PKT_TYPE_TASKS] = "tasks",
+    };
+    uint64_t packets = 0;
+
+    printf("serial: %llu bytes in %llu reads, %u frames, %u CRC errors, %u length errors, %u overruns\n",
+           (unsigned long long)reader->bytes, (unsigned long long)reader->reads, decoder->stats.frames,
+           decoder->stats.crc_errors, decoder->stats.length_errors, decoder->stats.overruns);
+    printf("packets:");
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (names[i] != NULL && w->counts.packets[i] > 0) {
+            printf(" %s %llu", names[i], (unsigned long long)w->counts.packets[i]);
+            packets += w->counts.packets[i];
+        }
+    }
+    printf(", %llu bad, %llu unknown\n", (unsigned long long)w->counts.bad, (unsigned long long)w->counts.unknown);
+    printf("stored: %llu readings, %llu profile rows, %llu state changes; %llu nodes heard, "
+           "%llu duplicates\n", (unsigned long long)w->counts.readings, (unsigned long long)w->counts.profiles,
+           (unsigned long long)w->statuses, (unsigned long long)w->seen, (unsigned long long)w->counts.duplicates);
+    printf("commits: %llu, %.1f serial frames each (largest %llu), %llu failed, %llu packets lost; "
+           "%llu ACKs, %llu not sent; %llu reader stalls\n", (unsigned long long)w->commits,
+           w->commits ? (double)(decoder->stats.frames) / w->commits : 0.0, (unsigned long long)w->group_max,
+           (unsigned long long)w->failed_commits, (unsigned long long)w->lost, (unsigned long long)w->acks,
+           (unsigned long long)w->acks_dropped, (unsigned long long)reader->stalls);
+    printf("ingest latency (read to committed and ACKed): p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           writer_latency_us(w, 0.5) / 1000.0, writer_latency_us(w, 0.99) / 1000.0, w->latency_max_us / 1000.0);
+    if (seconds > 0) {
+        printf("throughput: %.0f frames/s, %.0f packets/s, %.0f readings/s over %.2f s\n",
+               decoder->stats.frames / seconds, packets / seconds, w->counts.readings / seconds, seconds);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-d device] [-b baud] [-D conninfo | -s sqlite_file] [-g group_ms]\n"
+            "          [-G group_packets] [-q queue_depth]\n"
+            "       %s -T [-n nodes] [-c frames] [-r frames_per_s] [-R dup_every] [-U] [-s sqlite_file]\n"
+            "  -T  self test: simulated nodes and coordinator on a pty, SQLite in memory\n"
+            "  -U  self test without the coordinator, one serial frame per node frame\n",
+            name, name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *device = DEFAULT_DEVICE;
+    const char *conninfo = DEFAULT_CONNINFO;
+    const char *sqlite_path = NULL;
+    long baud = 115200;
+    size_t queue_depth = 4096;
+    writer_config_t config = {.group_items = 1024, .group_rows = 8192, .group_us = 2000};
+    bool self_test = false;
+    loadgen_config_t test = {.nodes = 300, .frames = 100000, .rate = 0, .duplicate_every = 0, .direct = false};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:D:s:g:G:q:Tn:c:r:R:Uh")) != -1) {
+        switch (opt) {
+        case 'd': device = optarg; break;
+        case 'b': baud = atol(optarg); break;
+        case 'D': conninfo = optarg; break;
+        case 's': sqlite_path = optarg; break;
+        case 'g': config.group_us = (int64_t)(atof(optarg) * 1000); break;
+        case 'G': config.group_items = (size_t)atol(optarg); break;
+        case 'q': queue_depth = (size_t)atol(optarg); break;
+        case 'T': self_test = true; break;
+        case 'n': test.nodes = (uint32_t)atol(optarg); break;
+        case 'c': test.frames = (uint32_t)atol(optarg); break;
+        case 'r': test.rate = (uint32_t)atol(optarg); break;
+        case 'R': test.duplicate_every = (uint32_t)atol(optarg); break;
+        case 'U': test.direct = true; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    char slave[64];
+    int master = -1;
+    if (self_test) {
+        master = open_pty(slave, sizeof(slave));
+        if (master < 0) {
+            return 1;
+        }
+        device = slave;
+        if (sqlite_path == NULL) {
+            sqlite_path = ":memory:";
+        }
+    }
+
+    ingest_sink_t *sink = sqlite_path != NULL ? sink_sqlite_open(sqlite_path) : sink_pg_open(conninfo);
+    if (sink == NULL) {
+        return 1;
+    }
+    int fd = open_port(device, baud);
+    if (fd < 0) {
+        sink->close(sink);
+        return 1;
+    }
+
+    ingest_queue_t queue;
+    writer_t writer;
+    if (!ingest_queue_init(&queue, queue_depth) || !writer_init(&writer, &queue, sink, fd, &config)) {
+        fprintf(stderr, "ingest: bad queue depth (power of 2) or group size (less than the depth)\n");
+        return 1;
+    }
+
+    loadgen_t loadgen;
+    pthread_t loadgen_thread;
+    if (self_test && !loadgen_init(&loadgen, master, &test)) {
+        fprintf(stderr, "ingest: bad self test size\n");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int ep = epoll_create1(0);
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+    if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, fd, &event) != 0) {
+        fprintf(stderr, "ingest: epoll: %s\n", strerror(errno));
+        return 1;
+    }
+
+    pthread_t writer_thread;
+    pthread_create(&writer_thread, NULL, writer_run, &writer);
+    if (self_test) {
+        pthread_create(&loadgen_thread, NULL, loadgen_run, &loadgen);
+    } else {
+        fprintf(stderr, "ingest: reading %s\n", device);
+    }
+
+    frame_decoder_t decoder;
+    reader_stats_t reader = {0};
+    uint8_t *buf = malloc(READ_SIZE);
+    int64_t start = clock_us(CLOCK_MONOTONIC);
+    frame_decoder_init(&decoder);
+
+    while (!stop_requested && !(self_test && atomic_load(&loadgen.done))) {
+        int ready = epoll_wait(ep, &event, 1, 100);
+        if (ready < 0 && errno != EINTR) {
+            fprintf(stderr, "ingest: epoll: %s\n", strerror(errno));
+            break;
+        }
+        if (ready > 0 && !read_port(fd, &decoder, &queue, &writer, &reader, buf)) {
+            fprintf(stderr, "ingest: %s closed\n", device);
+            break;
+        }
+    }
+
+    // The writer stores what is queued, then exits
+    atomic_store(&writer.stop, true);
+    eventfd_write(writer.wake_fd, 1);
+    pthread_join(writer_thread, NULL);
+    double seconds = (clock_us(CLOCK_MONOTONIC) - start) / 1e6;
+
+    int status = 0;
+    if (self_test) {
+        pthread_join(loadgen_thread, NULL);
+        const loadgen_stats_t *lg = &loadgen.stats;
+        seconds = lg->elapsed_us / 1e6;
+        print_stats(&decoder, &reader, &writer.stats, seconds);
+
+        long readings = sink->count(sink, "machine_readings");
+        long machines = sink->count(sink, "machine_status");
+        printf("self test: %u nodes, %llu frames (%llu duplicates) in %llu serial frames, %llu bytes%s\n",
+               test.nodes, (unsigned long long)lg->frames, (unsigned long long)(lg->frames - test.frames),
+               (unsigned long long)lg->serial_frames, (unsigned long long)lg->bytes,
+               test.direct ? ", no coordinator" : "");
+        printf("           %llu/%u frames ACKed, %llu ACKed again, %.0f frames/s, %.0f readings/s\n",
+               (unsigned long long)lg->acked, test.frames, (unsigned long long)lg->duplicate_acks,
+               seconds > 0 ? lg->acked / seconds : 0.0, seconds > 0 ? lg->readings / seconds : 0.0);
+        printf("           end to end latency: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+               lg->latency_p50_us / 1000.0, lg->latency_p99_us / 1000.0, lg->latency_max_us / 1000.0);
+        printf("           database: %ld readings (expected %llu), %ld machines (expected %u)\n",
+               readings, (unsigned long long)lg->readings, machines,
+               test.nodes < test.frames ? test.nodes : test.frames);
+
+        bool ok = lg->acked == test.frames && readings == (long)lg->readings &&
+                  machines == (long)(test.nodes < test.frames ? test.nodes : test.frames) &&
+                  lg->duplicate_acks == lg->frames - test.frames;
+        printf("self test %s\n", ok ? "passed" : "FAILED");
+        status = ok ? 0 : 1;
+        loadgen_free(&loadgen);
+        close(master);
+    } else {
+        print_stats(&decoder, &reader, &writer.stats, seconds);
+    }
+
+    free(buf);
+    close(ep);
+    close(fd);
+    writer_free(&writer);
+    ingest_queue_free(&queue);
+    sink->close(sink);
+    return status;
+}
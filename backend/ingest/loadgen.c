@@ -0,0 +1,361 @@
+#include "loadgen.h"
+#include "decode.h"
+#include "coordinator.h"
+#include "frame_codec.h"
+#include "telemetry.h"
+#include "zigbee_handler.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OUT_SIZE 65536
+#define OUT_LOW 4096              // make more frames once less than this waits
+#define IDLE_TIMEOUT_US 5000000   // give up on missing ACKs
+#define REPORT_INTERVAL_MS 5000   // TRANSMIT_INTERVAL_MS on the node
+
+struct loadgen_state {
+    coordinator_t coord;
+    uint32_t now_ms;              // the coordinator's virtual clock
+    uint32_t next;                // next frame to make
+    bool duplicate;               // frame next - 1 goes again first
+
+    uint8_t out[OUT_SIZE];        // framed, waiting for the pty
+    size_t out_length;
+    size_t out_sent;
+
+    frame_decoder_t decoder;      // ACKs
+    int64_t *sent_us;             // per frame, 0 until it is in the pty buffer
+    int64_t *latency_us;          // per frame, -1 until ACKed
+};
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Frame i: node i % nodes + 1, its (i / nodes + 1)th
+static uint16_t frame_node(const loadgen_t *lg, uint32_t i) {
+    return (uint16_t)(i % lg->config.nodes + 1);
+}
+
+static uint16_t frame_seq(const loadgen_t *lg, uint32_t i) {
+    return (uint16_t)(i / lg->config.nodes + 1);
+}
+
+static size_t build_frame(const loadgen_t *lg, uint32_t i, uint8_t *out) {
+    uint16_t node = frame_node(lg, i);
+    uint16_t seq = frame_seq(lg, i);
+    uint32_t sent_ms = node * 7919u + seq * (uint32_t)(TELEMETRY_BATCH_MAX * REPORT_INTERVAL_MS);
+    uint32_t seed = i * 2654435761u;
+    telemetry_t batch;
+
+    telemetry_init(&batch);
+    for (int k = 0; k < TELEMETRY_BATCH_MAX; k++) {
+        telemetry_report_t report;
+        memset(&report, 0, sizeof(report));
+        seed = seed * 1103515245u + 12345u;
+        report.state = (uint8_t)((seed >> 16) % 4);
+        report.rms_mg = (uint16_t)(50 + (seed >> 8) % 400);
+#if TELEMETRY_FEATURES
+        for (int j = 0; j < TELEMETRY_VECTOR_SIZE; j++) {
+            report.vector[j] = (uint8_t)(k > 0 && (seed >> (j + 3)) & 1 ? seed >> 20 : i + j);
+        }
+#else
+        report.freq_dhz = (uint16_t)(100 + (seed >> 12) % 200);
+#endif
+        report.timestamp = sent_ms - (uint32_t)(TELEMETRY_BATCH_MAX - k) * REPORT_INTERVAL_MS;
+        if (!telemetry_add_report(&batch, &report)) {
+            break;
+        }
+    }
+    return telemetry_encode(&batch, node, 0, seq, sent_ms, out);
+}
+
+static void mark_sent(loadgen_t *lg, const uint8_t *packet, size_t length, int64_t now) {
+    loadgen_state_t *s = lg->state;
+
+    if (length < 11 || (packet[0] != PKT_TYPE_FEATURES && packet[0] != PKT_TYPE_BATCH)) {
+        return;
+    }
+    uint16_t node = (uint16_t)(packet[1] | packet[2] << 8);
+    uint16_t seq = (uint16_t)(packet[9] | packet[10] << 8);
+    uint32_t i = (uint32_t)(seq - 1) * lg->config.nodes + (node - 1);
+    if (i < lg->config.frames && s->sent_us[i] == 0) {
+        s->sent_us[i] = now;
+    }
+}
+
+// One frame for the pty; the node frames in it count as sent now
+static void emit(loadgen_t *lg, const uint8_t *packet, size_t length) {
+    loadgen_state_t *s = lg->state;
+    int64_t now = monotonic_us();
+    decode_iter_t it;
+
+    if (decode_aggregate_begin(packet, length, &it)) {
+        uint32_t age_ms;
+        const uint8_t *inner;
+        size_t inner_length;
+        while (decode_aggregate_next(&it, &age_ms, &inner, &inner_length)) {
+            mark_sent(lg, inner, inner_length, now);
+        }
+    } else {
+        mark_sent(lg, packet, length, now);
+    }
+
+    s->out_length += frame_encode(packet, length, &s->out[s->out_length]);
+    lg->stats.serial_frames++;
+}
+
+// Whatever the coordinator has due; `flush` runs its clock on until it is empty
+static void drain_coordinator(loadgen_t *lg, bool flush) {
+    loadgen_state_t *s = lg->state;
+    uint8_t packet[FRAME_PAYLOAD_MAX];
+
+    while (s->out_length + FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX) <= OUT_SIZE) {
+        size_t length = coordinator_poll(&s->coord, s->now_ms, packet);
+        if (length > 0) {
+            emit(lg, packet, length);
+        } else if (flush && s->coord.queued > 0) {
+            uint32_t wait = coordinator_timeout(&s->coord, s->now_ms);
+            s->now_ms += wait > 0 ? wait : 1;
+        } else {
+            return;
+        }
+    }
+}
+
+// One node frame (`again`: a retry of it): straight to the pty, or to the
+// coordinator. False if it has to wait for the pty to take some of what is
+// buffered, in which case it is sent again later.
+static bool send_frame(loadgen_t *lg, uint32_t i, bool again) {
+    loadgen_state_t *s = lg->state;
+    uint8_t packet[FRAME_PAYLOAD_MAX];
+    size_t length = build_frame(lg, i, packet);
+
+    if (lg->config.direct) {
+        emit(lg, packet, length);
+        goto sent;
+    }
+    // The link pacing holds the queue up: move the clock to when it frees
+    while (!coordinator_receive(&s->coord, packet, length, frame_node(lg, i), 200, s->now_ms)) {
+        if (s->coord.queued == 0) {
+            lg->stats.coordinator_dropped++;
+            goto sent;
+        }
+        if (s->out_length + FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX) > OUT_SIZE) {
+            return false;
+        }
+        size_t before = s->out_length;
+        drain_coordinator(lg, false);
+        if (s->out_length == before) {
+            uint32_t wait = coordinator_timeout(&s->coord, s->now_ms);
+            s->now_ms += wait > 0 ? wait : 1;
+        }
+    }
+    drain_coordinator(lg, false);
+sent:
+    lg->stats.frames++;
+    if (!again) {
+        lg->stats.readings += packet[4];
+    }
+    return true;
+}
+
+static void produce(loadgen_t *lg, int64_t start) {
+    loadgen_state_t *s = lg->state;
+
+    if (s->out_sent >= OUT_SIZE / 2) {
+        memmove(s->out, &s->out[s->out_sent], s->out_length - s->out_sent);
+        s->out_length -= s->out_sent;
+        s->out_sent = 0;
+    }
+    if (!lg->config.direct) {
+        uint32_t real_ms = (uint32_t)((monotonic_us() - start) / 1000);
+        if ((int32_t)(real_ms - s->now_ms) > 0) {
+            s->now_ms = real_ms;
+        }
+        drain_coordinator(lg, false);
+    }
+
+    while (s->out_length - s->out_sent < OUT_LOW &&
+           s->out_length + FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX) <= OUT_SIZE &&
+           (s->next < lg->config.frames || s->duplicate)) {
+        if (lg->config.rate > 0 &&
+            monotonic_us() - start < (int64_t)s->next * 1000000 / lg->config.rate) {
+            break;
+        }
+        if (s->duplicate) {
+            if (!send_frame(lg, s->next - 1, true)) {
+                break;
+            }
+            s->duplicate = false;
+            continue;
+        }
+        if (!send_frame(lg, s->next, false)) {
+            break;
+        }
+        s->next++;
+        s->duplicate = lg->config.duplicate_every > 0 && s->next % lg->config.duplicate_every == 0;
+    }
+
+    if (!lg->config.direct && s->next == lg->config.frames && !s->duplicate) {
+        drain_coordinator(lg, true);
+    }
+}
+
+static void read_acks(loadgen_t *lg, int64_t now) {
+    loadgen_state_t *s = lg->state;
+    uint8_t buf[4096];
+    ssize_t n;
+
+    while ((n = read(lg->master, buf, sizeof(buf))) > 0) {
+        const uint8_t *data = buf;
+        size_t left = (size_t)n;
+        while (left > 0) {
+            const uint8_t *packet;
+            size_t length = 0;
+            size_t used = frame_decoder_feed(&s->decoder, data, left, &packet, &length);
+            data += used;
+            left -= used;
+            if (length != sizeof(zigbee_ack_t) || packet[0] != PKT_TYPE_ACK || !decode_checksum(packet, length)) {
+                continue;
+            }
+
+            uint16_t node = (uint16_t)(packet[1] | packet[2] << 8);
+            uint16_t seq = (uint16_t)(packet[3] | packet[4] << 8);
+            uint32_t i = (uint32_t)(seq - 1) * lg->config.nodes + (node - 1);
+            if (node == 0 || seq == 0 || i >= lg->config.frames) {
+                continue;
+            }
+            if (s->latency_us[i] >= 0) {
+                lg->stats.duplicate_acks++;
+            } else {
+                s->latency_us[i] = now - s->sent_us[i];
+                lg->stats.acked++;
+            }
+        }
+    }
+}
+
+static int compare_latency(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void summarize(loadgen_t *lg) {
+    loadgen_state_t *s = lg->state;
+    size_t count = 0;
+
+    for (uint32_t i = 0; i < lg->config.frames; i++) {
+        if (s->latency_us[i] >= 0) {
+            s->latency_us[count++] = s->latency_us[i];
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    qsort(s->latency_us, count, sizeof(int64_t), compare_latency);
+    lg->stats.latency_p50_us = s->latency_us[count / 2];
+    lg->stats.latency_p99_us = s->latency_us[count * 99 / 100];
+    lg->stats.latency_max_us = s->latency_us[count - 1];
+}
+
+void *loadgen_run(void *arg) {
+    loadgen_t *lg = arg;
+    loadgen_state_t *s = lg->state;
+    int64_t start = monotonic_us();
+    int64_t last_activity = start;
+    int64_t last_ack = start;
+
+    while (lg->stats.acked < lg->config.frames && monotonic_us() - last_activity < IDLE_TIMEOUT_US) {
+        produce(lg, start);
+
+        struct pollfd pfd = {lg->master, POLLIN, 0};
+        if (s->out_sent < s->out_length) {
+            pfd.events |= POLLOUT;
+        }
+        int timeout = s->out_sent < s->out_length || s->next < lg->config.frames ? 1 : 100;
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+            break;
+        }
+        int64_t now = monotonic_us();
+
+        if (pfd.revents & POLLIN) {
+            uint64_t acked = lg->stats.acked + lg->stats.duplicate_acks;
+            read_acks(lg, now);
+            if (lg->stats.acked + lg->stats.duplicate_acks != acked) {
+                last_activity = now;
+                last_ack = now;
+            }
+        }
+        if (pfd.revents & POLLOUT) {
+            ssize_t n = write(lg->master, &s->out[s->out_sent], s->out_length - s->out_sent);
+            if (n > 0) {
+                s->out_sent += (size_t)n;
+                lg->stats.bytes += (uint64_t)n;
+                last_activity = now;
+            }
+            if (s->out_sent == s->out_length) {
+                s->out_sent = s->out_length = 0;
+            }
+        }
+        if (pfd.revents & (POLLERR | POLLHUP)) {
+            break;
+        }
+    }
+
+    // A duplicate sent last may still be on its way back
+    if (lg->config.duplicate_every > 0) {
+        struct pollfd pfd = {lg->master, POLLIN, 0};
+        while (poll(&pfd, 1, 100) > 0 && (pfd.revents & POLLIN)) {
+            read_acks(lg, monotonic_us());
+        }
+    }
+
+    lg->stats.elapsed_us = last_ack - start;
+    summarize(lg);
+    atomic_store(&lg->done, true);
+    return NULL;
+}
+
+bool loadgen_init(loadgen_t *lg, int master, const loadgen_config_t *config) {
+    memset(lg, 0, sizeof(*lg));
+    if (config->nodes == 0 || config->nodes > 65535 || config->frames == 0 ||
+        config->frames / config->nodes >= 65535) {
+        return false;
+    }
+    lg->state = calloc(1, sizeof(loadgen_state_t));
+    if (lg->state == NULL) {
+        return false;
+    }
+    lg->state->sent_us = calloc(config->frames, sizeof(int64_t));
+    lg->state->latency_us = malloc(config->frames * sizeof(int64_t));
+    if (lg->state->sent_us == NULL || lg->state->latency_us == NULL) {
+        loadgen_free(lg);
+        return false;
+    }
+    for (uint32_t i = 0; i < config->frames; i++) {
+        lg->state->latency_us[i] = -1;
+    }
+
+    lg->master = master;
+    lg->config = *config;
+    atomic_init(&lg->done, false);
+    coordinator_init(&lg->state->coord, 0);
+    frame_decoder_init(&lg->state->decoder);
+    return true;
+}
+
+void loadgen_free(loadgen_t *lg) {
+    if (lg->state != NULL) {
+        free(lg->state->sent_us);
+        free(lg->state->latency_us);
+        free(lg->state);
+        lg->state = NULL;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Self test traffic (ingest -T): a fleet of nodes on the master side of a
+// pty, the daemon reading the slave side as if it were the coordinator's
+// serial port.
+//
+// Each node sends PKT_TYPE_FEATURES frames of TELEMETRY_BATCH_MAX reports
+// built by the firmware's own telemetry.c, and they go through the
+// firmware's coordinator.c on their way to the pty, so the daemon sees
+// what a real coordinator sends: PKT_TYPE_AGGREGATE frames, lone packets
+// and PKT_TYPE_NODES lists. The coordinator runs on a virtual clock that
+// moves on whenever its link pacing would hold things up, which makes the
+// link as fast as the daemon reads it.
+//
+// Every frame's ACK is waited for. Latency is from the frame leaving the
+// coordinator (or the node, direct) to its ACK coming back, the time it
+// queues for the pty while the daemon is behind included.
+
+typedef struct {
+    uint32_t nodes;
+    uint32_t frames;          // telemetry frames in all
+    uint32_t rate;            // frames/s, 0 = as fast as the daemon takes them
+    uint32_t duplicate_every; // send every n-th frame twice (a lost ACK), 0 = never
+    bool direct;              // without the coordinator, one serial frame per node frame
+} loadgen_config_t;
+
+typedef struct {
+    uint64_t frames;          // node frames sent, duplicates included
+    uint64_t readings;        // in them, duplicates not included
+    uint64_t serial_frames;   // frames written to the pty
+    uint64_t bytes;
+    uint64_t acked;           // node frames ACKed
+    uint64_t duplicate_acks;  // ACKs for frames already ACKed
+    uint64_t coordinator_dropped;
+    int64_t elapsed_us;       // first write to last ACK
+    int64_t latency_p50_us;
+    int64_t latency_p99_us;
+    int64_t latency_max_us;
+} loadgen_stats_t;
+
+typedef struct loadgen_state loadgen_state_t;
+
+typedef struct {
+    int master;               // pty master
+    loadgen_config_t config;
+    atomic_bool done;         // all ACKed, or gave up waiting
+    loadgen_stats_t stats;    // read once done
+    loadgen_state_t *state;
+} loadgen_t;
+
+// Function prototypes
+bool loadgen_init(loadgen_t *lg, int master, const loadgen_config_t *config);
+void loadgen_free(loadgen_t *lg);
+void *loadgen_run(void *arg);  // pthread entry, arg is the loadgen_t
+
+#endif // LOADGEN_H
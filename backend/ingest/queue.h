@@ -0,0 +1,88 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "frame_codec.h"
+
+// Bounded single-producer single-consumer ring between the serial reader
+// and the writer. No locks: head is only written by the reader, tail only
+// by the writer, each published with release and read with acquire.
+//
+// Packets are decoded where the frame decoder left them, straight into a
+// slot (the one copy on the way to the database), and stay there until the
+// transaction they went into commits: the writer peeks ahead and releases a
+// whole group at once, so it can replay the group one packet at a time if
+// the commit fails.
+
+typedef struct {
+    int64_t read_us;          // CLOCK_MONOTONIC, when the read that completed it returned
+    int64_t wall_us;          // CLOCK_REALTIME, the same moment, dates the rows
+    uint16_t length;
+    uint8_t data[FRAME_PAYLOAD_MAX];
+} ingest_item_t;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;  // next slot the reader fills
+    _Alignas(64) _Atomic size_t tail;  // oldest slot the writer still holds
+    _Alignas(64) size_t mask;          // depth - 1, depth a power of 2
+    ingest_item_t *items;
+} ingest_queue_t;
+
+static inline bool ingest_queue_init(ingest_queue_t *q, size_t depth) {
+    if (depth < 2 || (depth & (depth - 1)) != 0) {
+        return false;
+    }
+    q->items = calloc(depth, sizeof(ingest_item_t));
+    if (q->items == NULL) {
+        return false;
+    }
+    q->mask = depth - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return true;
+}
+
+static inline void ingest_queue_free(ingest_queue_t *q) {
+    free(q->items);
+    q->items = NULL;
+}
+
+// Reader: the next free slot, NULL when full
+static inline ingest_item_t *ingest_queue_reserve(ingest_queue_t *q) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&q->tail, memory_order_acquire) > q->mask) {
+        return NULL;
+    }
+    return &q->items[head & q->mask];
+}
+
+// Reader: hand the reserved slot over
+static inline void ingest_queue_publish(ingest_queue_t *q) {
+    atomic_store_explicit(&q->head, atomic_load_explicit(&q->head, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+// Writer: the index-th item not yet released, NULL if it hasn't arrived
+static inline ingest_item_t *ingest_queue_peek(ingest_queue_t *q, size_t index) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (atomic_load_explicit(&q->head, memory_order_acquire) - tail <= index) {
+        return NULL;
+    }
+    return &q->items[(tail + index) & q->mask];
+}
+
+// Writer: give the oldest `count` slots back to the reader
+static inline void ingest_queue_release(ingest_queue_t *q, size_t count) {
+    atomic_store_explicit(&q->tail, atomic_load_explicit(&q->tail, memory_order_relaxed) + count,
+                          memory_order_release);
+}
+
+static inline size_t ingest_queue_depth(const ingest_queue_t *q) {
+    return q->mask + 1;
+}
+
+#endif // QUEUE_H
@@ -0,0 +1,37 @@
+#include "sink.h"
+#include <string.h>
+#include <time.h>
+
+static const char *const state_names[] = {"IDLE", "WASHING", "SPINNING", "DONE", "UNKNOWN"};
+#define STATE_COUNT (sizeof(state_names) / sizeof(state_names[0]))
+
+const char *sink_state_name(uint8_t state) {
+    return state_names[sink_state_number(state)];
+}
+
+uint8_t sink_state_number(uint8_t state) {
+    return state < STATE_COUNT ? state : (uint8_t)(STATE_COUNT - 1);
+}
+
+void sink_format_time(int64_t time_us, char *out) {
+    // Rows come in bursts from the same second: localtime once per second.
+    // Only the writer thread formats times.
+    static time_t cached_second = -1;
+    static char cached[20];
+
+    time_t second = (time_t)(time_us / 1000000);
+    if (second != cached_second) {
+        struct tm tm;
+        localtime_r(&second, &tm);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_second = second;
+    }
+    memcpy(out, cached, 19);
+    out[19] = '.';
+    uint32_t fraction = (uint32_t)(time_us % 1000000);
+    for (int i = 25; i > 19; i--) {
+        out[i] = (char)('0' + fraction % 10);
+        fraction /= 10;
+    }
+    out[26] = '\0';
+}
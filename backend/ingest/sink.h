@@ -0,0 +1,81 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Where the writer's rows go: PostgreSQL (sink_pg.c, the tables of
+// database/schema.sql) or SQLite (sink_sqlite.c, the same tables, for the
+// self test). One connection, kept open.
+//
+// Rows accumulate until commit(), which stores all of them in one
+// transaction or none: false means nothing from this group is stored and
+// the sink is ready for the next one (reconnecting if it has to).
+// machine_status rows come last, status() before seen().
+//
+// The PostgreSQL sink also tells server.py (INGEST=external) what changed,
+// so it doesn't have to poll: a committed group sends NOTIFY SINK_CHANNEL
+// with a JSON array of events, several NOTIFYs if it doesn't fit one,
+//   ["s", machine, "STATE", "time"]   state change, time it began
+//   ["h", node_id, "time"]            node heard, latest time in the group
+//   ["r"]                             new machine_readings rows
+// times as sink_format_time() writes them.
+
+#define SINK_CHANNEL "ingest_events"
+
+typedef struct {
+    uint32_t machine;         // node_id | sensor << 16, as in server.py
+    uint8_t state;            // firmware machine_state_t
+    double rms;               // g
+    double freq_hz;
+    bool has_freq;            // NULL otherwise
+    const uint8_t *features;  // DECODE_FEATURES_SIZE bytes, or NULL
+    int64_t time_us;          // wall clock
+} sink_reading_t;
+
+typedef struct {
+    uint16_t node_id;
+    int64_t time_us;
+    uint32_t period_ms;
+    const char *stage;
+    uint32_t count;
+    float min_us, max_us, mean_us;
+    uint8_t bucket_shift;
+    uint8_t first_bucket;
+    uint8_t buckets;
+    const uint8_t *histogram;
+} sink_profile_t;
+
+typedef struct ingest_sink ingest_sink_t;
+
+struct ingest_sink {
+    bool (*reading)(ingest_sink_t *sink, const sink_reading_t *row);
+    bool (*profile)(ingest_sink_t *sink, const sink_profile_t *row);
+    // A machine's state changed at time_us, INSERT ... ON CONFLICT into
+    // machine_status (last_updated is when the state began; a row already
+    // in that state is left alone)
+    bool (*status)(ingest_sink_t *sink, uint32_t machine, uint8_t state, int64_t time_us);
+    // The node was heard: liveness for server.py, nothing is stored
+    bool (*seen)(ingest_sink_t *sink, uint16_t node_id, int64_t time_us);
+    bool (*commit)(ingest_sink_t *sink);
+    void (*rollback)(ingest_sink_t *sink);
+    long (*count)(ingest_sink_t *sink, const char *table);  // -1 on error
+    void (*close)(ingest_sink_t *sink);
+};
+
+// Function prototypes
+ingest_sink_t *sink_pg_open(const char *conninfo);
+ingest_sink_t *sink_sqlite_open(const char *path);  // ":memory:" works
+
+// Shared by the sinks
+const char *sink_state_name(uint8_t state);  // STATE_MAP in server.py
+// machine_readings.machine_state (machine_states): the firmware number,
+// UNKNOWN for anything else
+uint8_t sink_state_number(uint8_t state);
+// "YYYY-MM-DD HH:MM:SS.ffffff" local time, like the naive datetime.now()
+// server.py stores. `out` holds SINK_TIME_SIZE.
+#define SINK_TIME_SIZE 27
+void sink_format_time(int64_t time_us, char *out);
+
+#endif // SINK_H
@@ -0,0 +1,306 @@
+#include "sink.h"
+#include "decode.h"
+#include <libpq-fe.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One persistent connection. A group goes in as one transaction: readings
+// and profiles through COPY, the state changes as one multi-row upsert, the
+// events for server.py (sink.h) as NOTIFYs, so five round trips or so
+// however many packets it holds. NOTIFY is delivered on COMMIT, so server.py never
+// hears of a change that didn't get stored.
+
+#define NOTIFY_PAYLOAD_MAX 7900  // PostgreSQL takes up to 8000 bytes
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t size;
+} text_t;
+
+typedef struct {
+    ingest_sink_t base;
+    PGconn *conn;
+    text_t readings;          // COPY text
+    text_t profiles;          // COPY text
+    text_t status;            // VALUES rows
+    text_t events;            // NOTIFY payload being built, without the brackets
+    text_t notify;            // NOTIFY statements of the payloads done
+} pg_sink_t;
+
+static bool text_printf(text_t *t, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(t->data ? t->data + t->length : NULL, t->size - t->length, format, args);
+        va_end(args);
+        if (n < 0) {
+            return false;
+        }
+        if ((size_t)n < t->size - t->length) {
+            t->length += (size_t)n;
+            return true;
+        }
+        size_t size = t->size ? t->size * 2 : 65536;
+        while (size - t->length <= (size_t)n) {
+            size *= 2;
+        }
+        char *data = realloc(t->data, size);
+        if (data == NULL) {
+            return false;
+        }
+        t->data = data;
+        t->size = size;
+    }
+}
+
+static void pg_clear(pg_sink_t *pg) {
+    pg->readings.length = 0;
+    pg->profiles.length = 0;
+    pg->status.length = 0;
+    pg->events.length = 0;
+    pg->notify.length = 0;
+}
+
+static bool pg_exec(pg_sink_t *pg, const char *sql, ExecStatusType expect) {
+    PGresult *result = PQexec(pg->conn, sql);
+    bool ok = PQresultStatus(result) == expect;
+    if (!ok) {
+        fprintf(stderr, "ingest: %s", PQerrorMessage(pg->conn));
+    }
+    PQclear(result);
+    return ok;
+}
+
+static bool pg_copy(pg_sink_t *pg, const char *sql, const text_t *t) {
+    if (!pg_exec(pg, sql, PGRES_COPY_IN)) {
+        return false;
+    }
+    bool ok = PQputCopyData(pg->conn, t->data, (int)t->length) == 1;
+    if (PQputCopyEnd(pg->conn, ok ? NULL : "out of memory") != 1) {
+        ok = false;
+    }
+
+    PGresult *result;
+    while ((result = PQgetResult(pg->conn)) != NULL) {
+        if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+            fprintf(stderr, "ingest: %s", PQerrorMessage(pg->conn));
+            ok = false;
+        }
+        PQclear(result);
+    }
+    return ok;
+}
+
+static bool pg_reading(ingest_sink_t *sink, const sink_reading_t *row) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    char time[SINK_TIME_SIZE];
+    char freq[24] = "\\N";
+    char features[4 + 2 * DECODE_FEATURES_SIZE + 1] = "\\N";
+
+    sink_format_time(row->time_us, time);
+    if (row->has_freq) {
+        snprintf(freq, sizeof(freq), "%.10g", row->freq_hz);
+    }
+    if (row->features != NULL) {
+        // bytea hex, the backslash escaped for COPY
+        memcpy(features, "\\\\x", 3);
+        for (int i = 0; i < DECODE_FEATURES_SIZE; i++) {
+            snprintf(&features[3 + 2 * i], 3, "%02x", row->features[i]);
+        }
+    }
+    return text_printf(&pg->readings, "%u\t%u\t%.10g\t%s\t%s\t%s\n", row->machine,
+                       sink_state_number(row->state), row->rms, freq, time, features);
+}
+
+static bool pg_profile(ingest_sink_t *sink, const sink_profile_t *row) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    char time[SINK_TIME_SIZE];
+
+    sink_format_time(row->time_us, time);
+    if (!text_printf(&pg->profiles, "%u\t%s\t%u\t%s\t%u\t%.9g\t%.9g\t%.9g\t%u\t%u\t{", row->node_id, time,
+                     row->period_ms, row->stage, row->count, row->min_us, row->max_us, row->mean_us,
+                     row->bucket_shift, row->first_bucket)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < row->buckets; i++) {
+        if (!text_printf(&pg->profiles, i ? ",%u" : "%u", row->histogram[i])) {
+            return false;
+        }
+    }
+    return text_printf(&pg->profiles, "}\n");
+}
+
+// The payload so far goes into a NOTIFY of its own
+static bool pg_flush_events(pg_sink_t *pg) {
+    if (pg->events.length == 0) {
+        return true;
+    }
+    bool ok = text_printf(&pg->notify, "NOTIFY " SINK_CHANNEL ", '[%s]';", pg->events.data);
+    pg->events.length = 0;
+    return ok;
+}
+
+static bool pg_event(pg_sink_t *pg, const char *format, ...) {
+    char event[128];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(event, sizeof(event), format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(event)) {
+        return false;
+    }
+    if (pg->events.length + (size_t)n + 3 > NOTIFY_PAYLOAD_MAX && !pg_flush_events(pg)) {
+        return false;
+    }
+    return text_printf(&pg->events, "%s%s", pg->events.length ? "," : "", event);
+}
+
+static bool pg_status(ingest_sink_t *sink, uint32_t machine, uint8_t state, int64_t time_us) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    char time[SINK_TIME_SIZE];
+
+    sink_format_time(time_us, time);
+    return text_printf(&pg->status, "%s(%u,'%s','%s')", pg->status.length ? "," : "", machine,
+                       sink_state_name(state), time);
+}
+
+static bool pg_seen(ingest_sink_t *sink, uint16_t node_id, int64_t time_us) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    char time[SINK_TIME_SIZE];
+
+    sink_format_time(time_us, time);
+    return pg_event(pg, "[\"h\",%u,\"%s\"]", node_id, time);
+}
+
+static bool pg_commit(ingest_sink_t *sink) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    text_t sql = {0};
+    bool ok = false;
+
+    if (pg->readings.length == 0 && pg->profiles.length == 0 && pg->status.length == 0 &&
+        pg->events.length == 0) {
+        return true;
+    }
+
+    if (PQstatus(pg->conn) != CONNECTION_OK) {
+        PQreset(pg->conn);
+        if (PQstatus(pg->conn) != CONNECTION_OK) {
+            fprintf(stderr, "ingest: database connection lost: %s", PQerrorMessage(pg->conn));
+            goto done;
+        }
+    }
+
+    if (!pg_exec(pg, "BEGIN", PGRES_COMMAND_OK)) {
+        goto done;
+    }
+    if (pg->readings.length > 0 &&
+        !pg_copy(pg, "COPY machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, "
+                     "timestamp, features) FROM STDIN", &pg->readings)) {
+        goto rollback;
+    }
+    if (pg->profiles.length > 0 &&
+        !pg_copy(pg, "COPY node_profiles (node_id, received_at, period_ms, stage, sample_count, min_us, "
+                     "max_us, mean_us, bucket_shift, first_bucket, histogram) FROM STDIN", &pg->profiles)) {
+        goto rollback;
+    }
+    // One row per machine (the writer merges them): ON CONFLICT can't
+    // update the same row twice in one statement. A machine the daemon
+    // hadn't heard from since it started may be in that state already, then
+    // the row keeps its time and server.py hears of no change.
+    if (pg->status.length > 0) {
+        if (!text_printf(&sql, "INSERT INTO machine_status (node_id, current_state, last_updated) VALUES %s "
+                               "ON CONFLICT (node_id) DO UPDATE SET current_state = EXCLUDED.current_state, "
+                               "last_updated = EXCLUDED.last_updated "
+                               "WHERE machine_status.current_state IS DISTINCT FROM EXCLUDED.current_state "
+                               "RETURNING node_id, current_state, last_updated", pg->status.data)) {
+            goto rollback;
+        }
+        PGresult *result = PQexec(pg->conn, sql.data);
+        bool changed = PQresultStatus(result) == PGRES_TUPLES_OK;
+        if (!changed) {
+            fprintf(stderr, "ingest: %s", PQerrorMessage(pg->conn));
+        }
+        for (int i = 0; changed && i < PQntuples(result); i++) {
+            changed = pg_event(pg, "[\"s\",%s,\"%s\",\"%s\"]", PQgetvalue(result, i, 0),
+                               PQgetvalue(result, i, 1), PQgetvalue(result, i, 2));
+        }
+        PQclear(result);
+        if (!changed) {
+            goto rollback;
+        }
+    }
+    if ((pg->readings.length > 0 && !pg_event(pg, "[\"r\"]")) || !pg_flush_events(pg) ||
+        (pg->notify.length > 0 && !pg_exec(pg, pg->notify.data, PGRES_COMMAND_OK))) {
+        goto rollback;
+    }
+    ok = pg_exec(pg, "COMMIT", PGRES_COMMAND_OK);
+    goto done;
+
+rollback:
+    if (PQstatus(pg->conn) == CONNECTION_OK) {
+        pg_exec(pg, "ROLLBACK", PGRES_COMMAND_OK);
+    }
+done:
+    free(sql.data);
+    pg_clear(pg);
+    return ok;
+}
+
+static void pg_rollback(ingest_sink_t *sink) {
+    pg_clear((pg_sink_t *)sink);
+}
+
+static long pg_count(ingest_sink_t *sink, const char *table) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+    char sql[128];
+    long count = -1;
+
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s", table);
+    PGresult *result = PQexec(pg->conn, sql);
+    if (PQresultStatus(result) == PGRES_TUPLES_OK && PQntuples(result) == 1) {
+        count = atol(PQgetvalue(result, 0, 0));
+    }
+    PQclear(result);
+    return count;
+}
+
+static void pg_close(ingest_sink_t *sink) {
+    pg_sink_t *pg = (pg_sink_t *)sink;
+
+    PQfinish(pg->conn);
+    free(pg->readings.data);
+    free(pg->profiles.data);
+    free(pg->status.data);
+    free(pg->events.data);
+    free(pg->notify.data);
+    free(pg);
+}
+
+ingest_sink_t *sink_pg_open(const char *conninfo) {
+    pg_sink_t *pg = calloc(1, sizeof(pg_sink_t));
+    if (pg == NULL) {
+        return NULL;
+    }
+
+    pg->conn = PQconnectdb(conninfo);
+    if (PQstatus(pg->conn) != CONNECTION_OK) {
+        fprintf(stderr, "ingest: can't connect to the database: %s", PQerrorMessage(pg->conn));
+        PQfinish(pg->conn);
+        free(pg);
+        return NULL;
+    }
+
+    pg->base.reading = pg_reading;
+    pg->base.profile = pg_profile;
+    pg->base.status = pg_status;
+    pg->base.seen = pg_seen;
+    pg->base.commit = pg_commit;
+    pg->base.rollback = pg_rollback;
+    pg->base.count = pg_count;
+    pg->base.close = pg_close;
+    return &pg->base;
+}
@@ -0,0 +1,249 @@
+#include "sink.h"
+#include "decode.h"
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The tables of database/schema.sql in SQLite, for the self test (ingest -T)
+// and for trying the daemon without a PostgreSQL server. Prepared
+// statements inside one transaction per group.
+
+static const char schema[] =
+    "CREATE TABLE IF NOT EXISTS machine_status ("
+    "    node_id INTEGER PRIMARY KEY, current_state TEXT, last_updated TEXT, is_online INTEGER DEFAULT 1);"
+    "CREATE TABLE IF NOT EXISTS machine_readings ("
+    "    id INTEGER PRIMARY KEY, node_id INTEGER, machine_state INTEGER, rms_magnitude REAL,"
+    "    dominant_freq REAL, timestamp TEXT, features BLOB);"
+    "CREATE INDEX IF NOT EXISTS idx_readings_node_time ON machine_readings(node_id, timestamp);"
+    "CREATE TABLE IF NOT EXISTS node_profiles ("
+    "    id INTEGER PRIMARY KEY, node_id INTEGER, received_at TEXT, period_ms INTEGER, stage TEXT,"
+    "    sample_count INTEGER, min_us REAL, max_us REAL, mean_us REAL, bucket_shift INTEGER,"
+    "    first_bucket INTEGER, histogram TEXT);";
+
+enum {
+    STMT_READING,
+    STMT_PROFILE,
+    STMT_STATUS,
+    STMT_COUNT
+};
+
+static const char *const statements[STMT_COUNT] = {
+    "INSERT INTO machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6)",
+    "INSERT INTO node_profiles (node_id, received_at, period_ms, stage, sample_count, min_us, max_us, mean_us, "
+    "bucket_shift, first_bucket, histogram) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11)",
+    "INSERT INTO machine_status (node_id, current_state, last_updated) VALUES (?1, ?2, ?3) "
+    "ON CONFLICT (node_id) DO UPDATE SET current_state = excluded.current_state, "
+    "last_updated = excluded.last_updated WHERE current_state IS NOT excluded.current_state",
+};
+
+typedef struct {
+    ingest_sink_t base;
+    sqlite3 *db;
+    sqlite3_stmt *stmt[STMT_COUNT];
+    bool open;                // transaction started
+    bool failed;              // a statement in it failed
+} sqlite_sink_t;
+
+static bool sq_exec(sqlite_sink_t *sq, const char *sql) {
+    char *error = NULL;
+
+    if (sqlite3_exec(sq->db, sql, NULL, NULL, &error) != SQLITE_OK) {
+        fprintf(stderr, "ingest: %s\n", error);
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+// Starts the transaction on the group's first row
+static sqlite3_stmt *sq_begin(sqlite_sink_t *sq, int index) {
+    if (!sq->open) {
+        if (!sq_exec(sq, "BEGIN")) {
+            return NULL;
+        }
+        sq->open = true;
+    }
+    return sq->stmt[index];
+}
+
+static bool sq_step(sqlite_sink_t *sq, sqlite3_stmt *stmt) {
+    int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "ingest: %s\n", sqlite3_errmsg(sq->db));
+        sq->failed = true;
+        return false;
+    }
+    return true;
+}
+
+static bool sq_reading(ingest_sink_t *sink, const sink_reading_t *row) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+    sqlite3_stmt *stmt = sq_begin(sq, STMT_READING);
+    char time[SINK_TIME_SIZE];
+
+    if (stmt == NULL) {
+        return false;
+    }
+    sink_format_time(row->time_us, time);
+    sqlite3_bind_int64(stmt, 1, row->machine);
+    sqlite3_bind_int(stmt, 2, sink_state_number(row->state));
+    sqlite3_bind_double(stmt, 3, row->rms);
+    if (row->has_freq) {
+        sqlite3_bind_double(stmt, 4, row->freq_hz);
+    } else {
+        sqlite3_bind_null(stmt, 4);
+    }
+    sqlite3_bind_text(stmt, 5, time, -1, SQLITE_TRANSIENT);
+    if (row->features != NULL) {
+        sqlite3_bind_blob(stmt, 6, row->features, DECODE_FEATURES_SIZE, SQLITE_TRANSIENT);
+    } else {
+        sqlite3_bind_null(stmt, 6);
+    }
+    return sq_step(sq, stmt);
+}
+
+static bool sq_profile(ingest_sink_t *sink, const sink_profile_t *row) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+    sqlite3_stmt *stmt = sq_begin(sq, STMT_PROFILE);
+    char time[SINK_TIME_SIZE];
+    char histogram[4 * DECODE_HISTOGRAM_MAX + 3];
+    size_t length = 0;
+
+    if (stmt == NULL) {
+        return false;
+    }
+    histogram[length++] = '{';
+    for (uint8_t i = 0; i < row->buckets && i < DECODE_HISTOGRAM_MAX; i++) {
+        length += (size_t)snprintf(&histogram[length], sizeof(histogram) - length, i ? ",%u" : "%u",
+                                   row->histogram[i]);
+    }
+    histogram[length++] = '}';
+
+    sink_format_time(row->time_us, time);
+    sqlite3_bind_int(stmt, 1, row->node_id);
+    sqlite3_bind_text(stmt, 2, time, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, row->period_ms);
+    sqlite3_bind_text(stmt, 4, row->stage, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 5, row->count);
+    sqlite3_bind_double(stmt, 6, row->min_us);
+    sqlite3_bind_double(stmt, 7, row->max_us);
+    sqlite3_bind_double(stmt, 8, row->mean_us);
+    sqlite3_bind_int(stmt, 9, row->bucket_shift);
+    sqlite3_bind_int(stmt, 10, row->first_bucket);
+    sqlite3_bind_text(stmt, 11, histogram, (int)length, SQLITE_TRANSIENT);
+    return sq_step(sq, stmt);
+}
+
+static bool sq_status(ingest_sink_t *sink, uint32_t machine, uint8_t state, int64_t time_us) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+    sqlite3_stmt *stmt = sq_begin(sq, STMT_STATUS);
+    char time[SINK_TIME_SIZE];
+
+    if (stmt == NULL) {
+        return false;
+    }
+    sink_format_time(time_us, time);
+    sqlite3_bind_int64(stmt, 1, machine);
+    sqlite3_bind_text(stmt, 2, sink_state_name(state), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, time, -1, SQLITE_TRANSIENT);
+    return sq_step(sq, stmt);
+}
+
+// Nobody listens to a SQLite file
+static bool sq_seen(ingest_sink_t *sink, uint16_t node_id, int64_t time_us) {
+    (void)sink;
+    (void)node_id;
+    (void)time_us;
+    return true;
+}
+
+static void sq_rollback(ingest_sink_t *sink) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+
+    if (sq->open) {
+        sq_exec(sq, "ROLLBACK");
+    }
+    sq->open = false;
+    sq->failed = false;
+}
+
+static bool sq_commit(ingest_sink_t *sink) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+
+    if (!sq->open) {
+        return true;
+    }
+    if (sq->failed || !sq_exec(sq, "COMMIT")) {
+        sq_rollback(sink);
+        return false;
+    }
+    sq->open = false;
+    return true;
+}
+
+static long sq_count(ingest_sink_t *sink, const char *table) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+    sqlite3_stmt *stmt;
+    char sql[128];
+    long count = -1;
+
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s", table);
+    if (sqlite3_prepare_v2(sq->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = (long)sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+static void sq_close(ingest_sink_t *sink) {
+    sqlite_sink_t *sq = (sqlite_sink_t *)sink;
+
+    for (int i = 0; i < STMT_COUNT; i++) {
+        sqlite3_finalize(sq->stmt[i]);
+    }
+    sqlite3_close(sq->db);
+    free(sq);
+}
+
+ingest_sink_t *sink_sqlite_open(const char *path) {
+    sqlite_sink_t *sq = calloc(1, sizeof(sqlite_sink_t));
+    if (sq == NULL) {
+        return NULL;
+    }
+
+    if (sqlite3_open(path, &sq->db) != SQLITE_OK) {
+        fprintf(stderr, "ingest: can't open %s: %s\n", path, sqlite3_errmsg(sq->db));
+        goto fail;
+    }
+    // synchronous NORMAL: a power cut can lose the last groups although
+    // they were ACKed. Fine for testing; PostgreSQL is what deployments use.
+    if (!sq_exec(sq, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL") || !sq_exec(sq, schema)) {
+        goto fail;
+    }
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (sqlite3_prepare_v2(sq->db, statements[i], -1, &sq->stmt[i], NULL) != SQLITE_OK) {
+            fprintf(stderr, "ingest: %s\n", sqlite3_errmsg(sq->db));
+            goto fail;
+        }
+    }
+
+    sq->base.reading = sq_reading;
+    sq->base.profile = sq_profile;
+    sq->base.status = sq_status;
+    sq->base.seen = sq_seen;
+    sq->base.commit = sq_commit;
+    sq->base.rollback = sq_rollback;
+    sq->base.count = sq_count;
+    sq->base.close = sq_close;
+    return &sq->base;
+
+fail:
+    sq_close(&sq->base);
+    return NULL;
+}
@@ -0,0 +1,588 @@
+#include "writer.h"
+#include "decode.h"
+#include "zigbee_handler.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define MACHINE_SENSOR_SHIFT 16
+#define MACHINES (1u << 18)   // node ids and 4 sensors
+#define NODES 65536
+// Most status/seen/ACK entries a single packet can add (an entry takes
+// more than a byte of it)
+#define PACKET_ENTRIES_MAX FRAME_PAYLOAD_MAX
+#define LIST_MAX 65536
+#define ACK_FRAME_MAX FRAME_ENCODED_MAX(sizeof(zigbee_ack_t))
+#define STATE_NONE 0x100      // machine not heard from since the daemon started
+
+static const char *const stage_names[] = {"sensor_read", "add_sample", "rms", "spectrum", "classify", "send"};
+
+// A telemetry frame as server.py tells retries apart: (seq, node clock time
+// of its first report)
+typedef struct {
+    uint16_t seq;
+    uint32_t start;
+    bool valid;
+} frame_key_t;
+
+typedef struct {
+    uint32_t machine;
+    uint8_t state;
+    int64_t time_us;
+} status_entry_t;
+
+typedef struct {
+    uint16_t node_id;
+    int64_t time_us;
+} seen_entry_t;
+
+// Per group, reset by bumping `group`: an entry of the *_slot maps counts
+// only if its *_group matches
+struct writer_state {
+    uint32_t group;
+
+    status_entry_t status[LIST_MAX];   // state changes, when the new state began
+    size_t status_count;
+    uint32_t status_slot[MACHINES];
+    uint32_t status_group[MACHINES];
+    uint16_t stored_state[MACHINES];   // as of the last commit, or STATE_NONE
+
+    seen_entry_t seen[LIST_MAX];
+    size_t seen_count;
+    uint32_t seen_slot[NODES];
+    uint32_t seen_group[NODES];
+
+    frame_key_t stored[NODES];     // last frame committed per node
+    frame_key_t pending[NODES];    // ... and in this group
+    uint32_t pending_group[NODES];
+    uint16_t pending_nodes[LIST_MAX];
+    size_t pending_count;
+
+    uint8_t acks[LIST_MAX * ACK_FRAME_MAX];
+    size_t ack_bytes;
+    size_t ack_count;
+
+    size_t rows;
+    writer_counts_t counts;
+    bool broken;                   // the sink failed a row, the group can't commit
+    decode_batch_t batch;
+    decode_profile_t profile;
+};
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void group_reset(writer_state_t *s) {
+    s->group++;
+    s->status_count = 0;
+    s->seen_count = 0;
+    s->pending_count = 0;
+    s->ack_bytes = 0;
+    s->ack_count = 0;
+    s->rows = 0;
+    memset(&s->counts, 0, sizeof(s->counts));
+    s->broken = false;
+}
+
+static bool group_has_room(const writer_state_t *s) {
+    return s->status_count + PACKET_ENTRIES_MAX <= LIST_MAX && s->seen_count + PACKET_ENTRIES_MAX <= LIST_MAX &&
+           s->pending_count + PACKET_ENTRIES_MAX <= LIST_MAX && s->ack_count + PACKET_ENTRIES_MAX <= LIST_MAX;
+}
+
+static void add_seen(writer_t *w, uint16_t node_id, int64_t time_us) {
+    writer_state_t *s = w->state;
+
+    if (s->seen_group[node_id] != s->group) {
+        s->seen_group[node_id] = s->group;
+        s->seen_slot[node_id] = (uint32_t)s->seen_count++;
+        s->seen[s->seen_slot[node_id]].node_id = node_id;
+        s->seen[s->seen_slot[node_id]].time_us = time_us;
+    } else if (time_us > s->seen[s->seen_slot[node_id]].time_us) {
+        s->seen[s->seen_slot[node_id]].time_us = time_us;
+    }
+}
+
+// A machine reported `state` at `time_us`: its node was heard, and if the
+// state isn't the one it was in, machine_status gets it with this time as
+// when it began (live_status.py's `since`). The last change in the group
+// wins; commit() drops one that ends in the state the group started with.
+static void add_status(writer_t *w, uint32_t machine, uint8_t state, int64_t time_us) {
+    writer_state_t *s = w->state;
+    bool in_group = s->status_group[machine] == s->group;
+    uint16_t last = in_group ? s->status[s->status_slot[machine]].state : s->stored_state[machine];
+
+    add_seen(w, (uint16_t)machine, time_us);
+    if (state == last) {
+        return;
+    }
+    if (!in_group) {
+        s->status_group[machine] = s->group;
+        s->status_slot[machine] = (uint32_t)s->status_count++;
+        s->status[s->status_slot[machine]].machine = machine;
+    }
+    status_entry_t *entry = &s->status[s->status_slot[machine]];
+    entry->state = state;
+    entry->time_us = time_us;
+}
+
+static void add_ack(writer_t *w, uint16_t node_id, uint16_t seq) {
+    writer_state_t *s = w->state;
+    zigbee_ack_t ack = {PKT_TYPE_ACK, node_id, seq, 0};
+
+    ack.checksum = frame_crc16((const uint8_t *)&ack, sizeof(ack) - sizeof(ack.checksum));
+    s->ack_bytes += frame_encode((const uint8_t *)&ack, sizeof(ack), &s->acks[s->ack_bytes]);
+    s->ack_count++;
+}
+
+static void add_reading(writer_t *w, const sink_reading_t *row) {
+    if (!w->sink->reading(w->sink, row)) {
+        w->state->broken = true;
+    }
+    w->state->rows++;
+}
+
+static bool same_frame(const frame_key_t *a, const frame_key_t *b) {
+    return a->valid && b->valid && a->seq == b->seq && a->start == b->start;
+}
+
+static void process_batch(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us) {
+    writer_state_t *s = w->state;
+    decode_batch_t *batch = &s->batch;
+
+    if (!decode_batch(packet, length, batch)) {
+        w->state->counts.bad++;
+        return;
+    }
+
+    if (batch->count == 0) {
+        // heartbeat only, for the whole node
+        add_seen(w, batch->node_id, time_us);
+        return;
+    }
+
+    uint32_t machine = batch->node_id | (uint32_t)(batch->flags >> 6) << MACHINE_SENSOR_SHIFT;
+    frame_key_t frame = {batch->seq, batch->sent_ms - batch->readings[0].age_ms, true};
+    const frame_key_t *pending = s->pending_group[batch->node_id] == s->group ? &s->pending[batch->node_id] : NULL;
+    if ((pending != NULL && same_frame(pending, &frame)) ||
+        (pending == NULL && same_frame(&s->stored[batch->node_id], &frame))) {
+        w->state->counts.duplicates++;
+        add_ack(w, batch->node_id, batch->seq);
+        return;
+    }
+
+    for (uint8_t i = 0; i < batch->count; i++) {
+        const decode_reading_t *r = &batch->readings[i];
+        sink_reading_t row = {
+            .machine = machine,
+            .state = r->state,
+            .rms = r->rms,
+            .freq_hz = r->freq_hz,
+            .has_freq = !batch->features,
+            .features = batch->features ? r->features : NULL,
+            .time_us = time_us - (int64_t)r->age_ms * 1000,
+        };
+        add_reading(w, &row);
+    }
+    w->state->counts.readings += batch->count;
+    add_status(w, machine, batch->readings[batch->count - 1].state, time_us);
+
+    if (pending == NULL) {
+        s->pending_group[batch->node_id] = s->group;
+        s->pending_nodes[s->pending_count++] = batch->node_id;
+    }
+    s->pending[batch->node_id] = frame;
+    add_ack(w, batch->node_id, batch->seq);
+}
+
+static void process_profile(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us) {
+    decode_profile_t *profile = &w->state->profile;
+    char name[16];
+
+    if (!decode_profile(packet, length, profile)) {
+        w->state->counts.bad++;
+        return;
+    }
+
+    for (uint8_t i = 0; i < profile->count; i++) {
+        const decode_stage_t *stage = &profile->stages[i];
+        const char *stage_name = name;
+        if (stage->stage < sizeof(stage_names) / sizeof(stage_names[0])) {
+            stage_name = stage_names[stage->stage];
+        } else {
+            snprintf(name, sizeof(name), "stage_%u", stage->stage);
+        }
+
+        sink_profile_t row = {
+            .node_id = profile->node_id,
+            .time_us = time_us,
+            .period_ms = profile->period_ms,
+            .stage = stage_name,
+            .count = stage->count,
+            .min_us = stage->min_us,
+            .max_us = stage->max_us,
+            .mean_us = stage->mean_us,
+            .bucket_shift = profile->bucket_shift,
+            .first_bucket = stage->first_bucket,
+            .buckets = stage->buckets,
+            .histogram = stage->histogram,
+        };
+        if (!w->sink->profile(w->sink, &row)) {
+            w->state->broken = true;
+        }
+        w->state->rows++;
+    }
+    w->state->counts.profiles += profile->count;
+    add_seen(w, profile->node_id, time_us);
+}
+
+static void process_packet(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us, bool nested);
+
+// Checked whole first, like server.py's decode_aggregate: a bad one stores nothing
+static void process_aggregate(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us) {
+    decode_iter_t it;
+    uint32_t age_ms;
+    const uint8_t *inner;
+    size_t inner_length;
+
+    if (!decode_aggregate_begin(packet, length, &it)) {
+        w->state->counts.bad++;
+        return;
+    }
+    while (decode_aggregate_next(&it, &age_ms, &inner, &inner_length)) {
+    }
+    if (it.left != 0 || it.p != it.end) {
+        w->state->counts.bad++;
+        return;
+    }
+
+    decode_aggregate_begin(packet, length, &it);
+    while (decode_aggregate_next(&it, &age_ms, &inner, &inner_length)) {
+        process_packet(w, inner, inner_length, time_us - (int64_t)age_ms * 1000, true);
+    }
+}
+
+static void process_nodes(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us) {
+    decode_iter_t it;
+    uint16_t node_id;
+    uint8_t lqi;
+    uint32_t age_ms;
+
+    if (!decode_nodes_begin(packet, length, &it)) {
+        w->state->counts.bad++;
+        return;
+    }
+    while (decode_nodes_next(&it, &node_id, &lqi, &age_ms)) {
+    }
+    if (it.left != 0 || it.p != it.end) {
+        w->state->counts.bad++;
+        return;
+    }
+
+    decode_nodes_begin(packet, length, &it);
+    while (decode_nodes_next(&it, &node_id, &lqi, &age_ms)) {
+        add_seen(w, node_id, time_us - (int64_t)age_ms * 1000);
+    }
+}
+
+// `time_us` is when the coordinator got it from the node if it says
+// (aggregate frames), otherwise when it was read
+static void process_packet(writer_t *w, const uint8_t *packet, size_t length, int64_t time_us, bool nested) {
+    uint16_t node_id;
+    uint8_t state;
+    float rms, freq_hz;
+
+    if (length == 0) {
+        w->state->counts.bad++;
+        return;
+    }
+    if (packet[0] < sizeof(w->state->counts.packets) / sizeof(w->state->counts.packets[0])) {
+        w->state->counts.packets[packet[0]]++;
+    }
+
+    switch (packet[0]) {
+    case PKT_TYPE_DATA: {
+        if (!decode_legacy(packet, length, &node_id, &state, &rms, &freq_hz)) {
+            w->state->counts.bad++;
+            break;
+        }
+        sink_reading_t row = {
+            .machine = node_id, .state = state, .rms = rms, .freq_hz = freq_hz, .has_freq = true,
+            .time_us = time_us,
+        };
+        add_reading(w, &row);
+        w->state->counts.readings++;
+        add_status(w, node_id, state, time_us);
+        break;
+    }
+    case PKT_TYPE_HEARTBEAT:
+        if (!decode_legacy(packet, length, &node_id, &state, &rms, &freq_hz)) {
+            w->state->counts.bad++;
+            break;
+        }
+        add_seen(w, node_id, time_us);
+        break;
+    case PKT_TYPE_BATCH:
+    case PKT_TYPE_FEATURES:
+        process_batch(w, packet, length, time_us);
+        break;
+    case PKT_TYPE_PROFILE:
+        process_profile(w, packet, length, time_us);
+        break;
+    case PKT_TYPE_TASKS:
+        if (!decode_tasks(packet, length, &node_id)) {
+            w->state->counts.bad++;
+            break;
+        }
+        add_seen(w, node_id, time_us);
+        break;
+    case PKT_TYPE_AGGREGATE:
+    case PKT_TYPE_NODES:
+        if (nested) {
+            w->state->counts.bad++;  // coordinator frame inside an aggregate
+        } else if (packet[0] == PKT_TYPE_AGGREGATE) {
+            process_aggregate(w, packet, length, time_us);
+        } else {
+            process_nodes(w, packet, length, time_us);
+        }
+        break;
+    default:
+        w->state->counts.unknown++;
+        break;
+    }
+}
+
+static void write_acks(writer_t *w) {
+    writer_state_t *s = w->state;
+    const uint8_t *p = s->acks;
+    size_t left = s->ack_bytes;
+
+    while (left > 0) {
+        ssize_t n = write(w->fd, p, left);
+        if (n > 0) {
+            p += n;
+            left -= (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        struct pollfd pfd = {w->fd, POLLOUT, 0};
+        if (n < 0 && errno == EAGAIN && poll(&pfd, 1, 1000) > 0) {
+            continue;
+        }
+        // the node sends the frame again and gets the ACK then
+        w->stats.acks_dropped += s->ack_count * left / s->ack_bytes;
+        return;
+    }
+}
+
+static void record_latency(writer_t *w, size_t items) {
+    int64_t now = monotonic_us();
+
+    for (size_t i = 0; i < items; i++) {
+        int64_t latency = now - ingest_queue_peek(w->queue, i)->read_us;
+        size_t bucket = (size_t)(latency / WRITER_LATENCY_STEP_US);
+        w->stats.latency[bucket < WRITER_LATENCY_BUCKETS ? bucket : WRITER_LATENCY_BUCKETS - 1]++;
+        if (latency > w->stats.latency_max_us) {
+            w->stats.latency_max_us = latency;
+        }
+    }
+}
+
+// Store what the group holds and ACK it. False if nothing was stored.
+static bool commit(writer_t *w) {
+    writer_state_t *s = w->state;
+    bool ok = !s->broken;
+
+    size_t changes = 0;
+    for (size_t i = 0; ok && i < s->status_count; i++) {
+        const status_entry_t *entry = &s->status[i];
+        if (entry->state != s->stored_state[entry->machine]) {
+            ok = w->sink->status(w->sink, entry->machine, entry->state, entry->time_us);
+            changes++;
+        }
+    }
+    for (size_t i = 0; ok && i < s->seen_count; i++) {
+        ok = w->sink->seen(w->sink, s->seen[i].node_id, s->seen[i].time_us);
+    }
+    ok = ok && w->sink->commit(w->sink);
+
+    if (!ok) {
+        w->sink->rollback(w->sink);
+        group_reset(s);
+        return false;
+    }
+
+    for (size_t i = 0; i < s->pending_count; i++) {
+        s->stored[s->pending_nodes[i]] = s->pending[s->pending_nodes[i]];
+    }
+    for (size_t i = 0; i < s->status_count; i++) {
+        s->stored_state[s->status[i].machine] = s->status[i].state;
+    }
+    write_acks(w);
+
+    writer_counts_t *total = &w->stats.counts;
+    for (size_t i = 0; i < sizeof(total->packets) / sizeof(total->packets[0]); i++) {
+        total->packets[i] += s->counts.packets[i];
+    }
+    total->unknown += s->counts.unknown;
+    total->bad += s->counts.bad;
+    total->readings += s->counts.readings;
+    total->profiles += s->counts.profiles;
+    total->duplicates += s->counts.duplicates;
+    w->stats.commits++;
+    w->stats.statuses += changes;
+    w->stats.seen += s->seen_count;
+    w->stats.acks += s->ack_count;
+    group_reset(s);
+    return true;
+}
+
+// After a failed commit: every node packet in its own transaction, the
+// way server.py stores them, so only what the database refuses is lost
+static void store_one_by_one(writer_t *w, size_t items) {
+    for (size_t i = 0; i < items; i++) {
+        ingest_item_t *item = ingest_queue_peek(w->queue, 0);
+        decode_iter_t it;
+        uint32_t age_ms;
+        const uint8_t *inner;
+        size_t inner_length;
+
+        if (item->length > 0 && item->data[0] == PKT_TYPE_AGGREGATE &&
+            decode_aggregate_begin(item->data, item->length, &it)) {
+            while (decode_aggregate_next(&it, &age_ms, &inner, &inner_length)) {
+                process_packet(w, inner, inner_length, item->wall_us - (int64_t)age_ms * 1000, true);
+                if (!commit(w)) {
+                    w->stats.lost++;
+                }
+            }
+            w->stats.counts.packets[PKT_TYPE_AGGREGATE]++;
+        } else {
+            process_packet(w, item->data, item->length, item->wall_us, false);
+            if (!commit(w)) {
+                w->stats.lost++;
+            }
+        }
+        record_latency(w, 1);
+        ingest_queue_release(w->queue, 1);
+    }
+}
+
+static void commit_group(writer_t *w, size_t items) {
+    if (commit(w)) {
+        record_latency(w, items);
+        ingest_queue_release(w->queue, items);
+        if (items > w->stats.group_max) {
+            w->stats.group_max = items;
+        }
+        return;
+    }
+    w->stats.failed_commits++;
+    store_one_by_one(w, items);
+}
+
+static void wait_for_packets(writer_t *w, int64_t timeout_us) {
+    struct pollfd pfd = {w->wake_fd, POLLIN, 0};
+    struct timespec timeout = {timeout_us / 1000000, (timeout_us % 1000000) * 1000};
+    eventfd_t value;
+
+    if (ppoll(&pfd, 1, &timeout, NULL) > 0) {
+        eventfd_read(w->wake_fd, &value);
+    }
+}
+
+void *writer_run(void *arg) {
+    writer_t *w = arg;
+    size_t items = 0;  // in the current group, still in the queue
+
+    for (;;) {
+        ingest_item_t *item = ingest_queue_peek(w->queue, items);
+        if (item != NULL) {
+            if (!group_has_room(w->state)) {
+                commit_group(w, items);
+                items = 0;
+                continue;
+            }
+            process_packet(w, item->data, item->length, item->wall_us, false);
+            items++;
+            if (items >= w->config.group_items || w->state->rows >= w->config.group_rows) {
+                commit_group(w, items);
+                items = 0;
+            }
+            continue;
+        }
+
+        // The reader only sets stop after its last publish
+        bool stop = atomic_load(&w->stop);
+        if (items > 0) {
+            int64_t wait = ingest_queue_peek(w->queue, 0)->read_us + w->config.group_us - monotonic_us();
+            if (wait <= 0 || stop) {
+                commit_group(w, items);
+                items = 0;
+                continue;
+            }
+            wait_for_packets(w, wait);
+        } else if (stop) {
+            break;
+        } else {
+            wait_for_packets(w, 100000);
+        }
+    }
+    return NULL;
+}
+
+bool writer_init(writer_t *writer, ingest_queue_t *queue, ingest_sink_t *sink, int fd,
+                 const writer_config_t *config) {
+    memset(writer, 0, sizeof(*writer));
+    if (config->group_items == 0 || config->group_items >= ingest_queue_depth(queue)) {
+        return false;
+    }
+    writer->state = calloc(1, sizeof(writer_state_t));
+    if (writer->state == NULL) {
+        return false;
+    }
+    writer->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (writer->wake_fd < 0) {
+        free(writer->state);
+        return false;
+    }
+    writer->queue = queue;
+    writer->sink = sink;
+    writer->fd = fd;
+    writer->config = *config;
+    atomic_init(&writer->stop, false);
+    writer->state->group = 1;
+    for (size_t i = 0; i < MACHINES; i++) {
+        writer->state->stored_state[i] = STATE_NONE;
+    }
+    return true;
+}
+
+void writer_free(writer_t *writer) {
+    close(writer->wake_fd);
+    free(writer->state);
+    writer->state = NULL;
+}
+
+int64_t writer_latency_us(const writer_stats_t *stats, double fraction) {
+    uint64_t total = 0, seen = 0;
+
+    for (size_t i = 0; i < WRITER_LATENCY_BUCKETS; i++) {
+        total += stats->latency[i];
+    }
+    for (size_t i = 0; i < WRITER_LATENCY_BUCKETS; i++) {
+        seen += stats->latency[i];
+        if (total > 0 && seen >= fraction * total) {
+            return (int64_t)(i + 1) * WRITER_LATENCY_STEP_US;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "sink.h"
+
+// The writer thread: takes packets off the queue, does what server.py's
+// ZigbeeReader.process_packet does with each, and stores them a group at a
+// time (group commit). A group is committed when
+//
+//   - it holds group_items packets or group_rows readings, or
+//   - the queue is empty and its oldest packet has waited group_us.
+//
+// So under load groups grow to whatever arrived during the previous commit,
+// and when it's quiet a packet waits group_us at most.
+//
+// ACKs for a group's telemetry frames are written to the serial port in one
+// go once it is committed, never before: a frame that didn't make it to the
+// database is never ACKed, and its node sends it again. If a commit fails
+// the group is stored again one packet per transaction, so a packet the
+// database refuses (say a node missing from the nodes table) only costs
+// its own rows.
+
+#define WRITER_LATENCY_STEP_US 10
+#define WRITER_LATENCY_BUCKETS 100000  // up to 1 s, the last bucket is everything above
+
+typedef struct {
+    size_t group_items;       // < the queue depth
+    size_t group_rows;
+    int64_t group_us;
+} writer_config_t;
+
+// What the packets held, counted once their group is committed
+typedef struct {
+    uint64_t packets[16];     // by packet type, aggregated ones included
+    uint64_t unknown;         // other packet types
+    uint64_t bad;             // failed to decode, nothing stored
+    uint64_t readings;
+    uint64_t profiles;        // stage rows
+    uint64_t duplicates;      // telemetry frames stored before, only ACKed again
+} writer_counts_t;
+
+typedef struct {
+    writer_counts_t counts;
+    uint64_t statuses;        // machine state changes stored
+    uint64_t seen;            // nodes heard, per group
+    uint64_t commits;
+    uint64_t failed_commits;  // groups that had to be stored again packet by packet
+    uint64_t lost;            // packets the database refused on their own (not ACKed)
+    uint64_t acks;
+    uint64_t acks_dropped;    // serial port didn't take them within a second
+    uint64_t group_max;       // packets in the largest group
+    // Packet read to its group committed (and ACKed)
+    uint32_t latency[WRITER_LATENCY_BUCKETS];
+    int64_t latency_max_us;
+} writer_stats_t;
+
+typedef struct writer_state writer_state_t;
+
+typedef struct {
+    ingest_queue_t *queue;
+    ingest_sink_t *sink;
+    int fd;                   // ACKs go here, the serial port
+    int wake_fd;              // eventfd, bumped by the reader after publishing
+    writer_config_t config;
+    atomic_bool stop;         // set after the reader's last publish: drain and exit
+    writer_stats_t stats;     // read once the thread has exited
+    writer_state_t *state;
+} writer_t;
+
+// Function prototypes
+bool writer_init(writer_t *writer, ingest_queue_t *queue, ingest_sink_t *sink, int fd,
+                 const writer_config_t *config);
+void writer_free(writer_t *writer);
+void *writer_run(void *arg);  // pthread entry, arg is the writer_t
+
+// Latency below which `fraction` of the packets were stored, us
+int64_t writer_latency_us(const writer_stats_t *stats, double fraction);
+
+#endif // WRITER_H
@@ -0,0 +1,243 @@
+"""
+Live machine status
+
+The current state of every machine, kept in memory by whatever ingests the
+coordinator's frames, and what /api/machines serves. A machine is online
+while it's heard from (any frame of its node counts, heartbeats included)
+and goes offline OFFLINE_AFTER after the last one, worked out on a timer
+(expire()) rather than when a row happens to be written.
+
+Only transitions change anything the API lists: a new state, online or
+offline. Each one bumps the version (the list's ETag and the event id of
+the change stream) and marks the machine dirty, so the database is written
+once per change (take_dirty()), not once per frame.
+
+A machine's detail (last_seen, the last RECENT_READINGS readings) changes
+with every frame and has its own version.
+"""
+
+import collections
+import threading
+import time
+from datetime import datetime, timedelta
+
+
+# Four missed heartbeats (firmware HEARTBEAT_INTERVAL_MS), as the
+# check_node_online trigger has it
+OFFLINE_AFTER = timedelta(minutes=2)
+
+RECENT_READINGS = 20
+EVENT_BACKLOG = 1024  # transitions kept for clients catching up on the stream
+
+NODE_ID_MASK = 0xFFFF  # machine id = node id | sensor << 16
+
+
+class Machine:
+    __slots__ = ('node_id', 'state', 'online', 'since', 'last_seen', 'touched', 'readings')
+
+    def __init__(self, node_id, state, online, since, last_seen):
+        self.node_id = node_id
+        self.state = state
+        self.online = online
+        self.since = since          # when the state or online status last changed
+        self.last_seen = last_seen
+        self.touched = 0            # detail version
+        self.readings = collections.deque(maxlen=RECENT_READINGS)
+
+    def status(self):
+        """The machine_status row. last_updated is `since`: when it got into
+        this state, or for an offline machine when it was last heard."""
+        return {
+            'node_id': self.node_id,
+            'current_state': self.state,
+            'last_updated': self.since,
+            'is_online': self.online,
+        }
+
+
+class LiveStatus:
+    """Thread safe: one ingest thread, a timer and any number of API requests"""
+
+    def __init__(self, offline_after=OFFLINE_AFTER):
+        self.offline_after = offline_after
+        # Versions restart with the process: the epoch keeps an old ETag or
+        # event id from matching a new one
+        self.epoch = format(time.time_ns() // 1000, 'x')
+        self._lock = threading.Condition()
+        self._machines = {}
+        self._nodes = collections.defaultdict(list)    # node id -> its machines
+        self._version = 0
+        self._touches = 0
+        self._events = collections.deque(maxlen=EVENT_BACKLOG)  # (version, status)
+        self._listing = (0, [])
+        self._dirty = set()
+        self.ready = False
+
+    def load(self, statuses, readings=(), now=None):
+        """Start from the machine_status rows (dicts, as the API returns them)
+        and their latest readings. A machine stored as online gets
+        offline_after from now to be heard from again."""
+        now = now or datetime.now()
+        with self._lock:
+            for row in statuses:
+                if row['node_id'] in self._machines:
+                    continue  # heard from before the load, that's newer
+                online = bool(row['is_online'])
+                since = row['last_updated'] or now
+                self._add(Machine(row['node_id'], row['current_state'], online, since,
+                                  now if online else since))
+            for row in sorted(readings, key=lambda r: r['timestamp']):
+                machine = self._machines.get(row['node_id'])
+                if machine is not None:
+                    machine.readings.append(_reading(row))
+            self._version += 1
+            self.ready = True
+            self._lock.notify_all()
+
+    def _add(self, machine):
+        self._machines[machine.node_id] = machine
+        self._nodes[machine.node_id & NODE_ID_MASK].append(machine)
+
+    def _touch(self, machine):
+        self._touches += 1
+        machine.touched = self._touches
+
+    def _transition(self, machine):
+        self._version += 1
+        self._events.append((self._version, machine.status()))
+        self._dirty.add(machine.node_id)
+
+    def _fresh(self, when, now):
+        return when > now - self.offline_after
+
+    def update(self, node_id, state, when, readings=()):
+        """A machine reported `state` at `when`, with these new readings
+        (dicts with the machine_readings columns)"""
+        now = datetime.now()
+        with self._lock:
+            machine = self._machines.get(node_id)
+            if machine is None:
+                machine = Machine(node_id, None, False, when, when)
+                self._add(machine)
+            touched = when > machine.last_seen or readings
+            machine.last_seen = max(machine.last_seen, when)
+            machine.readings.extend(_reading(row) for row in readings)
+
+            online = machine.online or self._fresh(when, now)
+            if state != machine.state or online != machine.online:
+                machine.state = state
+                machine.online = online
+                machine.since = when
+                self._transition(machine)
+                self._lock.notify_all()
+                touched = True
+            if touched:
+                self._touch(machine)
+
+    def add_readings(self, node_id, readings):
+        """Readings of a known machine, its state left alone"""
+        with self._lock:
+            machine = self._machines.get(node_id)
+            if machine is not None:
+                machine.readings.extend(_reading(row) for row in readings)
+                self._touch(machine)
+
+    def heard(self, node_id, when):
+        """Something came from the node (radio node id): all its machines
+        are online"""
+        now = datetime.now()
+        with self._lock:
+            changed = False
+            for machine in self._nodes.get(node_id, ()):
+                if when > machine.last_seen:
+                    machine.last_seen = when
+                    self._touch(machine)
+                if not machine.online and self._fresh(when, now):
+                    machine.online = True
+                    machine.since = when
+                    self._touch(machine)
+                    self._transition(machine)
+                    changed = True
+            if changed:
+                self._lock.notify_all()
+
+    def expire(self, now=None):
+        """Take machines not heard from in offline_after offline. Call it
+        every second or so."""
+        now = now or datetime.now()
+        with self._lock:
+            changed = False
+            for machine in self._machines.values():
+                if machine.online and not self._fresh(machine.last_seen, now):
+                    machine.online = False
+                    machine.since = machine.last_seen
+                    self._touch(machine)
+                    self._transition(machine)
+                    changed = True
+            if changed:
+                self._lock.notify_all()
+
+    def take_dirty(self):
+        """machine_status rows changed since the last call, to store"""
+        with self._lock:
+            rows = [self._machines[node_id].status() for node_id in sorted(self._dirty)]
+            self._dirty.clear()
+            return rows
+
+    def mark_dirty(self, rows):
+        """Rows from take_dirty() that didn't get stored, to try again"""
+        with self._lock:
+            self._dirty.update(row['node_id'] for row in rows)
+
+    def etag(self, version):
+        return f'{self.epoch}-{version}'
+
+    def machines(self):
+        """(version, status rows by node id). The list is shared, don't
+        modify it."""
+        with self._lock:
+            if self._listing[0] != self._version:
+                self._listing = (self._version, [self._machines[node_id].status()
+                                                 for node_id in sorted(self._machines)])
+            return self._listing
+
+    def machine(self, node_id):
+        """(version, status with last_seen, recent readings newest first),
+        None for a machine never heard of"""
+        with self._lock:
+            machine = self._machines.get(node_id)
+            if machine is None:
+                return None
+            status = machine.status()
+            status['last_seen'] = machine.last_seen
+            readings = sorted(machine.readings, key=lambda r: r['timestamp'], reverse=True)
+            return machine.touched, status, [dict(r) for r in readings]
+
+    def changes(self, event_id, timeout):
+        """Transitions after event id `event_id` (an etag() string), waiting
+        up to `timeout` s for one. Returns a list of (version, status), empty
+        on timeout, or None when the caller has to start over from
+        machines(): an id from another process or one too far back."""
+        epoch, _, version = (event_id or '').partition('-')
+        if epoch != self.epoch or not version.isdigit():
+            return None
+        version = int(version)
+        with self._lock:
+            if version > self._version:
+                return None
+            self._lock.wait_for(lambda: self._version > version, timeout)
+            if self._version == version:
+                return []
+            if not self._events or self._events[0][0] > version + 1:
+                return None
+            return [event for event in self._events if event[0] > version]
+
+
+def _reading(row):
+    return {
+        'machine_state': row['machine_state'],
+        'rms_magnitude': row['rms_magnitude'],
+        'dominant_freq': row['dominant_freq'],
+        'timestamp': row['timestamp'],
+        'features': row['features'],
+    }
@@ -0,0 +1,133 @@
+"""
+History rollups
+
+machine_readings summed up per machine and minute (machine_rollups_1m) and
+per hour (machine_rollups_1h), so a history of days reads a few hundred
+rows instead of every reading. Each bucket holds
+
+  - readings: how many readings fell into it
+  - state_ms: time spent in each state (STATES order), in ms
+  - rms_sum, rms_count, rms_max: for the mean and the peak vibration, over
+    the readings that have an RMS
+  - freq_hist: readings per frequency band (FREQ_BAND_EDGES_HZ): the
+    dominant frequency, or the spectral centroid of feature readings
+
+A state lasts from its reading to the machine's next one, split over the
+buckets it spans. Gaps longer than MAX_GAP (the machine was offline) go
+uncounted, except after IDLE: a node in deep sleep sends nothing while its
+machine stays idle, so IDLE holds up to MAX_IDLE_GAP.
+
+Rollups.add() turns new readings into bucket increments. Buckets only ever
+add up, so they can be merged into the stored rows (ON CONFLICT ... +)
+whenever, in any number of steps.
+"""
+
+import bisect
+from datetime import timedelta
+
+
+# machine_readings.machine_state numbers (machine_states, STATE_MAP)
+STATES = ['IDLE', 'WASHING', 'SPINNING', 'DONE', 'UNKNOWN']
+STATE_IDLE = 0
+STATE_UNKNOWN = 4
+
+# The feature vector's bands (FEATURE_BAND_EDGES_HZ in server.py)
+FREQ_BAND_EDGES_HZ = [0.0, 1.0, 2.0, 4.0, 6.0, 9.0, 12.0, 25.0, 50.0]
+FREQ_BANDS = len(FREQ_BAND_EDGES_HZ) - 1
+
+MAX_GAP = timedelta(minutes=2)       # four missed heartbeats: offline
+MAX_IDLE_GAP = timedelta(hours=24)
+
+RESOLUTIONS = {
+    '1m': timedelta(minutes=1),
+    '1h': timedelta(hours=1),
+}
+
+
+def bucket_start(t, resolution):
+    if resolution == '1m':
+        return t.replace(second=0, microsecond=0)
+    return t.replace(minute=0, second=0, microsecond=0)
+
+
+def freq_band(reading):
+    """Band of the reading's dominant frequency (the centroid for feature
+    readings, vector byte 4 in 0.2 Hz), None if it has neither"""
+    freq = reading['dominant_freq']
+    if freq is None:
+        features = reading['features']
+        if features is None or len(features) != 5:
+            return None
+        freq = bytes(features)[4] / 5.0
+    band = bisect.bisect_right(FREQ_BAND_EDGES_HZ, freq) - 1
+    return min(max(band, 0), FREQ_BANDS - 1)
+
+
+class Bucket:
+    __slots__ = ('readings', 'state_ms', 'rms_sum', 'rms_count', 'rms_max', 'freq_hist')
+
+    def __init__(self):
+        self.readings = 0
+        self.state_ms = [0] * len(STATES)
+        self.rms_sum = 0.0
+        self.rms_count = 0
+        self.rms_max = None
+        self.freq_hist = [0] * FREQ_BANDS
+
+
+class Rollups:
+    """Not thread safe, one per rollup worker"""
+
+    def __init__(self):
+        self.last = {}  # node_id -> (timestamp, state) of its latest reading
+
+    def add(self, readings):
+        """Readings (dicts with the machine_readings columns) in the order
+        they were stored. Returns {(resolution, node_id, bucket start):
+        Bucket}. A reading older than its machine's latest is counted but
+        doesn't move the state timeline."""
+        buckets = {}
+
+        def bucket(resolution, node_id, t):
+            key = (resolution, node_id, bucket_start(t, resolution))
+            found = buckets.get(key)
+            if found is None:
+                found = buckets[key] = Bucket()
+            return found
+
+        for reading in readings:
+            node_id = reading['node_id']
+            t = reading['timestamp']
+            state = reading['machine_state']
+            if state is None or not 0 <= state < len(STATES):
+                state = STATE_UNKNOWN
+            rms = reading['rms_magnitude']
+            band = freq_band(reading)
+
+            for resolution in RESOLUTIONS:
+                b = bucket(resolution, node_id, t)
+                b.readings += 1
+                if rms is not None:
+                    b.rms_sum += rms
+                    b.rms_count += 1
+                    b.rms_max = rms if b.rms_max is None else max(b.rms_max, rms)
+                if band is not None:
+                    b.freq_hist[band] += 1
+
+            last = self.last.get(node_id)
+            if last is not None and t < last[0]:
+                continue
+            if last is not None:
+                start, last_state = last
+                limit = MAX_IDLE_GAP if last_state == STATE_IDLE else MAX_GAP
+                if t - start <= limit:
+                    for resolution, size in RESOLUTIONS.items():
+                        spread = start
+                        while spread < t:
+                            stop = min(t, bucket_start(spread, resolution) + size)
+                            ms = round((stop - spread).total_seconds() * 1000)
+                            bucket(resolution, node_id, spread).state_ms[last_state] += ms
+                            spread = stop
+            self.last[node_id] = (t, state)
+
+        return buckets
@@ -8,14 +8,20 @@ Flask API for querying machine status
 from flask import Flask, jsonify, request
 from flask_cors import CORS
 import psycopg2
-from psycopg2.extras import RealDictCursor
+from psycopg2.extras import RealDictCursor, execute_values
 import serial
 import threading
 import struct
 import time
-from datetime import datetime
+import os
+import json
+from datetime import datetime, timedelta
 import logging
 
+from framing import FrameDecoder, crc16_ccitt, encode_frame, native_available
+from live_status import LiveStatus, RECENT_READINGS
+from rollups import Rollups, STATES, FREQ_BAND_EDGES_HZ
+
 app = Flask(__name__)
 CORS(app)  # enable CORS for frontend
 
@@ -23,19 +29,56 @@ CORS(app)  # enable CORS for frontend
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
 
-# Database config
+# Database config (DB_HOST, DB_NAME to use another, bench_fleet.py does)
 DB_CONFIG = {
-    'host': 'localhost',
-    'database': 'wasche_db',
+    'host': os.environ.get('DB_HOST', 'localhost'),
+    'database': os.environ.get('DB_NAME', 'wasche_db'),
     'user': 'wasche_user',
     'password': 'wasche_pass'  # yeah I know, should use env vars
 }
 
 # Serial port for Zigbee coordinator
-SERIAL_PORT = '/dev/ttyUSB0'  # adjust for your system
+SERIAL_PORT = os.environ.get('SERIAL_PORT', '/dev/ttyUSB0')  # adjust for your system
 SERIAL_BAUD = 115200
 
-# Machine state mapping (matches firmware enum)
+API_PORT = int(os.environ.get('API_PORT', '5000'))
+
+# INGEST=external: the serial port belongs to the native ingest daemon
+# (backend/ingest), this process only serves the API. The daemon NOTIFYs
+# what it committed on this channel (ingest/sink.h).
+INGEST_EXTERNAL = os.environ.get('INGEST') == 'external'
+INGEST_CHANNEL = 'ingest_events'
+
+# Live status upkeep (StatusKeeper): offline timeouts, storing transitions
+# and, with INGEST=external, applying the ingest daemon's events
+STATUS_INTERVAL = 1.0  # s
+# Comment line on an idle event stream, so dead clients get noticed
+EVENTS_KEEPALIVE = 15  # s
+
+# History rollups (RollupKeeper): how often new readings get summed up, and
+# how many at most per transaction when catching up on an existing table
+ROLLUP_INTERVAL = 10  # s
+ROLLUP_BATCH = 50000
+
+# machine_readings' day partitions (PartitionKeeper): created this many days
+# ahead. READINGS_KEEP_DAYS=n drops the ones older than n days (with
+# READINGS_EXPIRE=detach they're detached instead, to archive); unset keeps
+# everything.
+PARTITION_INTERVAL = 3600  # s
+PARTITION_DAYS_AHEAD = 7
+READINGS_KEEP_DAYS = int(os.environ.get('READINGS_KEEP_DAYS', '0'))
+READINGS_EXPIRE = os.environ.get('READINGS_EXPIRE', 'drop')
+
+# /api/history: rows per page (limit=), and the resolution a range gets
+# unless it asks for one (resolution=raw|1m|1h): raw readings (one per
+# 5 s) up to an hour, minutes up to two days, hours beyond
+HISTORY_LIMIT = 1000
+HISTORY_LIMIT_MAX = 10000
+HISTORY_RAW_HOURS = 1
+HISTORY_MINUTE_HOURS = 48
+
+# Machine state mapping (matches firmware enum). machine_readings stores the
+# number (machine_states in the database), the API the name.
 STATE_MAP = {
     0: 'IDLE',
     1: 'WASHING',
@@ -43,16 +86,370 @@ STATE_MAP = {
     3: 'DONE',
     4: 'UNKNOWN'
 }
+STATE_UNKNOWN = 4
+
+# Packet types (match firmware zigbee_handler.h)
+PKT_TYPE_DATA = 0x01
+PKT_TYPE_HEARTBEAT = 0x02
+PKT_TYPE_ACK = 0x03
+PKT_TYPE_BATCH = 0x04
+PKT_TYPE_PROFILE = 0x06
+PKT_TYPE_FEATURES = 0x07
+PKT_TYPE_AGGREGATE = 0x08
+PKT_TYPE_NODES = 0x09
+PKT_TYPE_TASKS = 0x0A
+
+# Spectral feature vector (firmware telemetry.h, FEATURE_BAND_EDGES_HZ in config.h)
+FEATURE_BAND_EDGES_HZ = [0.0, 1.0, 2.0, 4.0, 6.0, 9.0, 12.0, 25.0, 50.0]
+FEATURE_VECTOR_SIZE = 5
+
+# Profiled stages, in firmware profile_stage_t order (profile.h)
+PROFILE_STAGES = ['sensor_read', 'add_sample', 'rms', 'spectrum', 'classify', 'send']
+
+# Tasks in a PKT_TYPE_TASKS report, in firmware main.c order (profile.h)
+REPORT_TASKS = ['acquisition', 'analysis', 'transmit']
+TASK_STACK_WARN = 0.9       # share of a task's stack used before it's worth a warning
+
+# Batch frame flags (match firmware telemetry.h)
+BATCH_FLAG_STATE_CHANGE = 0x01
+BATCH_FLAG_SLEEPING = 0x02
+BATCH_SENSOR_SHIFT = 6      # bits 6-7: which of the node's sensors (TELEMETRY_FLAG_SENSOR)
+
+# A node with several sensors (stacked washer/dryer) reports several
+# machines. Each gets its own node_id in the tables: the radio's node id plus
+# the sensor number << 16, so sensor 0 is the node id itself.
+MACHINE_SENSOR_SHIFT = 16
+NODE_ID_MASK = 0xFFFF
+
+
+def machine_id(node_id, sensor):
+    return node_id | (sensor << MACHINE_SENSOR_SHIFT)
+
+
+# Legacy zigbee_packet_t: type(1) + node_id(2) + state(1) + rms(4) + freq(4) + timestamp(4) + checksum(2)
+LEGACY_PACKET = struct.Struct('<BHBffIH')
+
+# zigbee_ack_t without its checksum: type(1) + node_id(2) + seq(2)
+ACK_PACKET = struct.Struct('<BHH')
+
+# Coordinator frames (firmware coordinator.h): type(1) + coordinator ms(4) + count(1)
+COORDINATOR_HEADER = struct.Struct('<BIB')
+
+
+def encode_ack(node_id, seq):
+    """PKT_TYPE_ACK for telemetry frame `seq` of the node (firmware outbox.h)"""
+    packet = ACK_PACKET.pack(PKT_TYPE_ACK, node_id, seq)
+    return packet + struct.pack('<H', crc16_ccitt(packet))
+
+
+def read_varint(packet, pos):
+    """LEB128 varint: 7 bits per byte, low bits first, top bit = more follows.
+    Returns (value, next position)."""
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(packet):
+            raise ValueError("Truncated varint")
+        byte = packet[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+        if shift > 28:
+            raise ValueError("Varint too long")
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def verify_checksum(packet):
+    """Packets end in a little-endian CRC-16/CCITT over everything before it"""
+    if len(packet) < 3:
+        return False
+    return crc16_ccitt(packet[:-2]) == struct.unpack_from('<H', packet, len(packet) - 2)[0]
+
+
+def decode_batch(packet):
+    """
+    Decode a complete PKT_TYPE_BATCH or PKT_TYPE_FEATURES packet (layout in
+    firmware/telemetry.h), type byte included, as it comes out of the frame
+    decoder.
+
+    Returns (node_id, flags, seq, sent_ms, reports) where reports is a list
+    of (state, rms, freq, age_ms, features) oldest first; age_ms is how long
+    before the frame was sent the report was taken. Batch frames have
+    features None, feature frames freq None and features the raw 5-byte
+    vector (see expand_features). Raises ValueError on a bad frame.
+    """
+    if len(packet) < 13 or packet[0] not in (PKT_TYPE_BATCH, PKT_TYPE_FEATURES):
+        raise ValueError("Not a batch frame")
+    if not verify_checksum(packet):
+        raise ValueError("Batch checksum mismatch")
+
+    feature_frame = packet[0] == PKT_TYPE_FEATURES
+    end = len(packet) - 2
+    node_id, flags, count, sent_ms, seq = struct.unpack_from('<HBBIH', packet, 1)
+    pos = 11
+
+    reports = []
+    if count > 0:
+        bitmap_size = (count + 6) // 8
+        first_size = 3 + (FEATURE_VECTOR_SIZE if feature_frame else 2)
+        if pos + first_size + bitmap_size > end:
+            raise ValueError("Truncated batch frame")
+        state, rms = struct.unpack_from('<BH', packet, pos)
+        pos += 3
+        if feature_frame:
+            vector = bytearray(packet[pos:pos + FEATURE_VECTOR_SIZE])
+            freq = None
+        else:
+            freq = struct.unpack_from('<H', packet, pos)[0]
+        pos += first_size - 3
+        bitmap = packet[pos:pos + bitmap_size]
+        pos += bitmap_size
+
+        states = [state]
+        for i in range(1, count):
+            if bitmap[(i - 1) // 8] & (1 << ((i - 1) % 8)):
+                if pos >= end:
+                    raise ValueError("Truncated batch frame")
+                state = packet[pos]
+                pos += 1
+            states.append(state)
+
+        def report(i, age):
+            if feature_frame:
+                return (states[i], rms / 1000.0, None, max(age, 0), bytes(vector))
+            return (states[i], rms / 1000.0, freq / 10.0, max(age, 0), None)
+
+        age, pos = read_varint(packet, pos)
+        reports.append(report(0, age))
+        for i in range(1, count):
+            dt, pos = read_varint(packet, pos)
+            drms, pos = read_varint(packet, pos)
+            age -= dt
+            rms += unzigzag(drms)
+            if feature_frame:
+                if pos >= end:
+                    raise ValueError("Truncated batch frame")
+                mask = packet[pos]
+                pos += 1
+                for j in range(FEATURE_VECTOR_SIZE):
+                    if mask & (1 << j):
+                        if pos >= end:
+                            raise ValueError("Truncated batch frame")
+                        vector[j] = packet[pos]
+                        pos += 1
+            else:
+                dfreq, pos = read_varint(packet, pos)
+                freq += unzigzag(dfreq)
+            reports.append(report(i, age))
+
+    if pos != end:
+        raise ValueError("Batch frame length mismatch")
+
+    return node_id, flags, seq, sent_ms, reports
+
+
+def decode_aggregate(packet):
+    """
+    Decode a complete PKT_TYPE_AGGREGATE frame (firmware coordinator.h): the
+    node packets the coordinator put together. Returns a list of
+    (age_ms, packet), age_ms being how long the coordinator held it. Raises
+    ValueError on a bad frame.
+    """
+    if len(packet) < COORDINATOR_HEADER.size + 2 or packet[0] != PKT_TYPE_AGGREGATE:
+        raise ValueError("Not an aggregate frame")
+    if not verify_checksum(packet):
+        raise ValueError("Aggregate checksum mismatch")
+
+    _, _, count = COORDINATOR_HEADER.unpack_from(packet)
+    end = len(packet) - 2
+    pos = COORDINATOR_HEADER.size
+    packets = []
+    for _ in range(count):
+        age, pos = read_varint(packet, pos)
+        if pos >= end or pos + 1 + packet[pos] > end:
+            raise ValueError("Truncated aggregate frame")
+        length = packet[pos]
+        packets.append((age, bytes(packet[pos + 1:pos + 1 + length])))
+        pos += 1 + length
+
+    if pos != end:
+        raise ValueError("Aggregate frame length mismatch")
+    return packets
+
+
+def decode_nodes(packet):
+    """
+    Decode a complete PKT_TYPE_NODES frame (firmware coordinator.h): the end
+    devices the coordinator heard since its last one. Returns a list of
+    (node_id, lqi, age_ms), age_ms being how long ago it last heard the
+    node. Raises ValueError on a bad frame.
+    """
+    if len(packet) < COORDINATOR_HEADER.size + 2 or packet[0] != PKT_TYPE_NODES:
+        raise ValueError("Not a node list")
+    if not verify_checksum(packet):
+        raise ValueError("Node list checksum mismatch")
+
+    _, _, count = COORDINATOR_HEADER.unpack_from(packet)
+    end = len(packet) - 2
+    pos = COORDINATOR_HEADER.size
+    nodes = []
+    for _ in range(count):
+        if pos + 3 > end:
+            raise ValueError("Truncated node list")
+        node_id, lqi = struct.unpack_from('<HB', packet, pos)
+        age, pos = read_varint(packet, pos + 3)
+        nodes.append((node_id, lqi, age))
+
+    if pos != end:
+        raise ValueError("Node list length mismatch")
+    return nodes
+
+
+def expand_features(vector):
+    """
+    Raw feature vector (as stored in machine_readings.features) to
+    {'band_db': [...], 'bands_hz': [...], 'centroid_hz': x}. band_db is each
+    band's share of the vibration energy in dB, None below -43.5 dB; the
+    absolute band RMS is rms * 10 ** (band_db / 20). None for readings
+    that came without one.
+    """
+    if vector is None:
+        return None
+    vector = bytes(vector)
+    if len(vector) != FEATURE_VECTOR_SIZE:
+        return None
+    levels = [(vector[b // 2] >> (4 * (b & 1))) & 0x0F for b in range(8)]
+    return {
+        'band_db': [None if level == 15 else -3 * level for level in levels],
+        'bands_hz': [[FEATURE_BAND_EDGES_HZ[b], FEATURE_BAND_EDGES_HZ[b + 1]] for b in range(8)],
+        'centroid_hz': vector[4] / 5.0,
+    }
+
+
+def with_features(readings):
+    """Expand the features column of API rows in place"""
+    for reading in readings:
+        reading['features'] = expand_features(reading.get('features'))
+    return readings
+
+
+def with_state_names(readings):
+    """machine_readings rows with the state number replaced by its name, in place"""
+    for reading in readings:
+        if reading['machine_state'] is not None:
+            reading['machine_state'] = STATE_MAP.get(reading['machine_state'], 'UNKNOWN')
+    return readings
+
+
+def decode_profile(packet):
+    """
+    Decode a complete PKT_TYPE_PROFILE packet (layout in firmware/profile.h).
+
+    Returns (node_id, period_ms, bucket_shift, stages) where stages is a list
+    of dicts with the stage name, sample count, min/max/mean in microseconds,
+    the first histogram bucket and the bucket shares (1/255ths).
+    Raises ValueError on a bad packet.
+    """
+    if len(packet) < 19 or packet[0] != PKT_TYPE_PROFILE:
+        raise ValueError("Not a profile packet")
+    if not verify_checksum(packet):
+        raise ValueError("Profile checksum mismatch")
+
+    end = len(packet) - 2
+    node_id, _sent_ms, cycle_hz, period_ms, bucket_shift, count = \
+        struct.unpack_from('<HIIIBB', packet, 1)
+    if cycle_hz == 0:
+        raise ValueError("Profile cycle rate is zero")
+    pos = 17
+    us_per_cycle = 1e6 / cycle_hz
+
+    stages = []
+    for _ in range(count):
+        if pos >= end:
+            raise ValueError("Truncated profile packet")
+        stage = packet[pos]
+        samples, pos = read_varint(packet, pos + 1)
+        low, pos = read_varint(packet, pos)
+        high, pos = read_varint(packet, pos)
+        mean, pos = read_varint(packet, pos)
+        if pos + 2 > end:
+            raise ValueError("Truncated profile packet")
+        first_bucket, buckets = packet[pos], packet[pos + 1]
+        pos += 2
+        if pos + buckets > end:
+            raise ValueError("Truncated profile packet")
+        stages.append({
+            'stage': PROFILE_STAGES[stage] if stage < len(PROFILE_STAGES) else f'stage_{stage}',
+            'count': samples,
+            'min_us': low * us_per_cycle,
+            'max_us': high * us_per_cycle,
+            'mean_us': mean * us_per_cycle,
+            'first_bucket': first_bucket,
+            'histogram': list(packet[pos:pos + buckets]),
+        })
+        pos += buckets
+
+    if pos != end:
+        raise ValueError("Profile packet length mismatch")
+
+    return node_id, period_ms, bucket_shift, stages
+
+
+def decode_tasks(packet):
+    """
+    Decode a complete PKT_TYPE_TASKS packet (layout in firmware/profile.h).
+
+    Returns (node_id, cpu_percent, overruns, tasks) where tasks is a list of
+    dicts with the task name, stack high water mark and size in bytes and
+    CPU percent. Raises ValueError on a bad packet.
+    """
+    if len(packet) < 15 or packet[0] != PKT_TYPE_TASKS:
+        raise ValueError("Not a task report")
+    if not verify_checksum(packet):
+        raise ValueError("Task report checksum mismatch")
+
+    node_id, _sent_ms, cpu_percent, overruns, count = struct.unpack_from('<HIBIB', packet, 1)
+    if len(packet) != 15 + 5 * count:
+        raise ValueError("Task report length mismatch")
+
+    tasks = []
+    for i in range(count):
+        stack_used, stack_size, task_cpu = struct.unpack_from('<HHB', packet, 13 + 5 * i)
+        tasks.append({
+            'task': REPORT_TASKS[i] if i < len(REPORT_TASKS) else f'task_{i}',
+            'stack_used': stack_used,
+            'stack_size': stack_size,
+            'cpu_percent': task_cpu,
+        })
+
+    return node_id, cpu_percent, overruns, tasks
+
 
 class ZigbeeReader(threading.Thread):
-    """Thread that reads from Zigbee coordinator serial port"""
+    """Thread that reads from Zigbee coordinator serial port
     
-    def __init__(self, port, baudrate):
+    Readings and profiles go to the database as they come; the current state
+    of each machine goes to `live` (LiveStatus), which stores it when it
+    changes."""
+    
+    def __init__(self, port, baudrate, live):
         super().__init__()
         self.port = port
         self.baudrate = baudrate
+        self.live = live
         self.running = False
         self.serial_conn = None
+        # node_id -> (seq, node clock time of its first report) of the last
+        # telemetry frame stored. A retry repeats both; a node that reset
+        # starts again at seq 1 but not at the same time.
+        self.last_frame = {}
+        # node_id -> sample buffer overruns in its last task report
+        self.overruns = {}
         
     def run(self):
         """Main loop - reads packets and processes them"""
@@ -65,42 +462,96 @@ class ZigbeeReader(threading.Thread):
             logger.error(f"Failed to open serial port: {e}")
             return
         
+        decoder = FrameDecoder()
+        logger.info("Frame decoder: %s", "native" if native_available() else "Python fallback")
+        
         while self.running:
             try:
-                # Read packet header to determine packet type
-                packet_type = self.serial_conn.read(1)
-                if not packet_type:
+                # Whatever has arrived, at least one byte (blocks up to the timeout)
+                data = self.serial_conn.read(self.serial_conn.in_waiting or 1)
+                if not data:
                     continue
                 
-                packet_type = struct.unpack('B', packet_type)[0]
-                
-                if packet_type == 0x01:  # DATA packet
-                    self.process_data_packet()
-                elif packet_type == 0x02:  # HEARTBEAT packet
-                    self.process_heartbeat_packet()
-                else:
-                    logger.warning(f"Unknown packet type: {packet_type}")
+                for packet in decoder.feed(data):
+                    self.process_packet(packet)
                     
             except Exception as e:
                 logger.error(f"Error reading from serial: {e}")
                 time.sleep(1)
         
+        stats = decoder.stats
+        logger.info(f"Serial frames: {stats.frames} good, {stats.crc_errors} CRC errors, "
+                    f"{stats.length_errors} length errors, {stats.overruns} overruns")
+        
         if self.serial_conn:
             self.serial_conn.close()
     
-    def process_data_packet(self):
+    def process_packet(self, packet, received=None):
+        """Dispatch one packet (CRC already checked by the framing).
+        `received` is when the coordinator got it from the node if it says
+        (aggregate frames), otherwise now."""
+        packet_type = packet[0]
+        if received is None:
+            received = datetime.now()
+        
+        if packet_type == PKT_TYPE_DATA:
+            self.process_data_packet(packet, received)
+        elif packet_type == PKT_TYPE_HEARTBEAT:
+            self.process_heartbeat_packet(packet, received)
+        elif packet_type in (PKT_TYPE_BATCH, PKT_TYPE_FEATURES):
+            self.process_batch_packet(packet, received)
+        elif packet_type == PKT_TYPE_PROFILE:
+            self.process_profile_packet(packet, received)
+        elif packet_type == PKT_TYPE_TASKS:
+            self.process_tasks_packet(packet, received)
+        elif packet_type == PKT_TYPE_AGGREGATE:
+            self.process_aggregate_packet(packet, received)
+        elif packet_type == PKT_TYPE_NODES:
+            self.process_nodes_packet(packet, received)
+        else:
+            logger.warning(f"Unknown packet type: {packet_type}")
+    
+    def process_aggregate_packet(self, packet, received):
+        """Node packets the coordinator batched, each handled as if it had
+        come on its own when the coordinator received it"""
+        try:
+            packets = decode_aggregate(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            logger.warning(f"Bad aggregate frame: {e}")
+            return
+        
+        for age, inner in packets:
+            if not inner or inner[0] in (PKT_TYPE_AGGREGATE, PKT_TYPE_NODES):
+                logger.warning("Coordinator frame inside an aggregate")
+                continue
+            self.process_packet(inner, received - timedelta(milliseconds=age))
+    
+    def process_nodes_packet(self, packet, received):
+        """The coordinator's list of nodes it heard (it doesn't forward
+        heartbeats): last seen for each"""
+        try:
+            nodes = decode_nodes(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            logger.warning(f"Bad node list: {e}")
+            return
+        
+        logger.debug("Coordinator heard %d nodes: %s", len(nodes),
+                     ", ".join(f"{node_id} (LQI {lqi})" for node_id, lqi, _ in nodes))
+        for node_id, _, age in nodes:
+            self.live.heard(node_id, received - timedelta(milliseconds=age))
+    
+    def process_data_packet(self, packet, received):
         """Process a data packet from a node"""
-        # Packet structure: type(1) + node_id(2) + state(1) + rms(4) + freq(4) + timestamp(4) + checksum(2)
-        # Already read type, need 17 more bytes
-        data = self.serial_conn.read(17)
-        if len(data) != 17:
+        if len(packet) != LEGACY_PACKET.size:
             logger.warning("Incomplete data packet")
             return
         
         # Unpack data
-        node_id, state, rms, freq, timestamp, checksum = struct.unpack('<HBFFIH', data)
+        _, node_id, state, rms, freq, timestamp, checksum = LEGACY_PACKET.unpack(packet)
         
-        # TODO: verify checksum
+        if not verify_checksum(packet):
+            logger.warning(f"Node {node_id}: data packet checksum mismatch")
+            return
         
         state_str = STATE_MAP.get(state, 'UNKNOWN')
         logger.info(f"Node {node_id}: state={state_str}, rms={rms:.2f}, freq={freq:.1f}Hz")
@@ -113,15 +564,7 @@ class ZigbeeReader(threading.Thread):
             cur.execute("""
                 INSERT INTO machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, timestamp)
                 VALUES (%s, %s, %s, %s, %s)
-            """, (node_id, state_str, rms, freq, datetime.now()))
-            
-            # Update machine status
-            cur.execute("""
-                INSERT INTO machine_status (node_id, current_state, last_updated)
-                VALUES (%s, %s, %s)
-                ON CONFLICT (node_id) 
-                DO UPDATE SET current_state = %s, last_updated = %s
-            """, (node_id, state_str, datetime.now(), state_str, datetime.now()))
+            """, (node_id, state if state in STATE_MAP else STATE_UNKNOWN, rms, freq, received))
             
             conn.commit()
             cur.close()
@@ -129,26 +572,145 @@ class ZigbeeReader(threading.Thread):
             
         except Exception as e:
             logger.error(f"Database error: {e}")
+            return
+        
+        self.live.update(node_id, state_str, received, [{
+            'machine_state': state_str, 'rms_magnitude': rms, 'dominant_freq': freq,
+            'timestamp': received, 'features': None,
+        }])
     
-    def process_heartbeat_packet(self):
+    def process_heartbeat_packet(self, packet, received):
         """Process a heartbeat packet"""
-        data = self.serial_conn.read(17)  # same size as data packet
-        if len(data) != 17:
+        if len(packet) != LEGACY_PACKET.size or not verify_checksum(packet):
             return
         
-        node_id = struct.unpack('<H', data[:2])[0]
+        node_id = struct.unpack_from('<H', packet, 1)[0]
         logger.debug(f"Heartbeat from node {node_id}")
+        self.live.heard(node_id, received)
+    
+    def send_ack(self, node_id, seq):
+        """Tell the node frame `seq` is stored, via the coordinator"""
+        try:
+            self.serial_conn.write(encode_frame(encode_ack(node_id, seq)))
+        except Exception as e:
+            logger.error(f"Failed to send ACK to node {node_id}: {e}")
+    
+    def process_batch_packet(self, packet, received):
+        """Process a batched telemetry frame (several readings + heartbeat)
+        
+        Frames with readings are ACKed once committed, so the node drops them
+        from its backlog; without an ACK it sends them again. A frame already
+        stored is only ACKed again (its first ACK got lost)."""
+        
+        try:
+            node_id, flags, seq, sent_ms, reports = decode_batch(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            logger.warning(f"Bad batch frame: {e}")
+            return
+        
+        sensor = flags >> BATCH_SENSOR_SHIFT
+        machine = machine_id(node_id, sensor)
+        frame = (seq, (sent_ms - reports[0][3]) & 0xFFFFFFFF) if reports else None
+        if frame is not None and self.last_frame.get(node_id) == frame:
+            logger.info(f"Node {node_id}/{sensor}: frame {seq} again, already stored")
+            self.live.heard(node_id, received)
+            self.send_ack(node_id, seq)
+            return
+        logger.info(f"Node {node_id}/{sensor}: batch {seq} of {len(reports)} readings, flags=0x{flags:02X}")
+        
+        if not reports:
+            # heartbeat only, for the whole node
+            self.live.heard(node_id, received)
+            return
+        
+        readings = [{
+            'machine_state': STATE_MAP.get(state, 'UNKNOWN'), 'rms_magnitude': rms,
+            'dominant_freq': freq, 'timestamp': received - timedelta(milliseconds=age),
+            'features': features,
+        } for state, rms, freq, age, features in reports]
         
-        # Update last_seen in database
         try:
             conn = psycopg2.connect(**DB_CONFIG)
             cur = conn.cursor()
-            cur.execute("""
-                UPDATE machine_status SET last_updated = %s WHERE node_id = %s
-            """, (datetime.now(), node_id))
+            
+            cur.executemany("""
+                INSERT INTO machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features)
+                VALUES (%s, %s, %s, %s, %s, %s)
+            """, [
+                (machine, state if state in STATE_MAP else STATE_UNKNOWN, rms, freq,
+                 r['timestamp'], psycopg2.Binary(features) if features is not None else None)
+                for (state, rms, freq, _, features), r in zip(reports, readings)
+            ])
+            
+            conn.commit()
+            cur.close()
+            conn.close()
+            
+        except Exception as e:
+            # no ACK: the node keeps the readings and tries again
+            logger.error(f"Database error: {e}")
+            return
+        
+        self.live.update(machine, readings[-1]['machine_state'], received, readings)
+        self.live.heard(node_id, received)
+        self.last_frame[node_id] = frame
+        self.send_ack(node_id, seq)
+    
+    def process_tasks_packet(self, packet, received):
+        """Process a task stack/CPU report (also counts as a heartbeat).
+        Logged, with a warning when a stack is nearly full or samples were
+        lost; nothing is stored."""
+        
+        try:
+            node_id, cpu_percent, overruns, tasks = decode_tasks(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            logger.warning(f"Bad task report: {e}")
+            return
+        
+        self.live.heard(node_id, received)
+        summary = ', '.join(f"{t['task']} stack {t['stack_used']}/{t['stack_size']} cpu {t['cpu_percent']}%"
+                            for t in tasks)
+        logger.debug(f"Node {node_id}: cpu {cpu_percent}%, {overruns} sample buffer overruns; {summary}")
+        
+        full = [t['task'] for t in tasks if t['stack_used'] >= TASK_STACK_WARN * t['stack_size']]
+        if full:
+            logger.warning(f"Node {node_id}: stack nearly full in {', '.join(full)} ({summary})")
+        if overruns > self.overruns.get(node_id, overruns):
+            logger.warning(f"Node {node_id}: sample buffer overruns up to {overruns} (cpu {cpu_percent}%)")
+        self.overruns[node_id] = overruns
+    
+    def process_profile_packet(self, packet, received):
+        """Process a stage timing report (also counts as a heartbeat)"""
+        
+        try:
+            node_id, period_ms, bucket_shift, stages = decode_profile(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            logger.warning(f"Bad profile packet: {e}")
+            return
+        
+        logger.info(f"Node {node_id}: profile of {len(stages)} stages over {period_ms / 1000:.0f}s")
+        self.live.heard(node_id, received)
+        if not stages:
+            return
+        
+        try:
+            conn = psycopg2.connect(**DB_CONFIG)
+            cur = conn.cursor()
+            
+            cur.executemany("""
+                INSERT INTO node_profiles (node_id, received_at, period_ms, stage, sample_count,
+                                           min_us, max_us, mean_us, bucket_shift, first_bucket, histogram)
+                VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s)
+            """, [
+                (node_id, received, period_ms, s['stage'], s['count'], s['min_us'], s['max_us'],
+                 s['mean_us'], bucket_shift, s['first_bucket'], s['histogram'])
+                for s in stages
+            ])
+            
             conn.commit()
             cur.close()
             conn.close()
+            
         except Exception as e:
             logger.error(f"Database error: {e}")
     
@@ -156,115 +718,580 @@ class ZigbeeReader(threading.Thread):
         """Stop the reader thread"""
         self.running = False
 
+
+class StatusKeeper(threading.Thread):
+    """Thread that keeps the live status going: loads it from the database,
+    takes machines offline when they go quiet and stores transitions, all
+    on one connection once a second.
+    
+    With INGEST=external nothing here hears the nodes. The ingest daemon
+    NOTIFYs what each group it commits changed (state changes, nodes heard,
+    whether there are new readings) and this applies it, reading
+    machine_readings only when there are new ones and machine_status only
+    after a reconnect, when events may have been missed. It only stores
+    is_online."""
+    
+    def __init__(self, live, external):
+        super().__init__()
+        self.live = live
+        self.external = external
+        self.running = False
+        self.last_reading = 0   # machine_readings id followed up to (external)
+    
+    def run(self):
+        self.running = True
+        conn = None
+        
+        while self.running:
+            try:
+                if conn is None or conn.closed:
+                    conn = self.connect()
+                if not self.live.ready:
+                    self.load(conn)
+                elif self.external:
+                    self.follow(conn)
+                self.live.expire()
+                self.store(conn)
+            except Exception as e:
+                logger.error(f"Live status: {e}")
+                if conn is not None:
+                    conn.close()
+                conn = None
+            time.sleep(STATUS_INTERVAL)
+        
+        if conn is not None:
+            conn.close()
+    
+    def connect(self):
+        conn = psycopg2.connect(**DB_CONFIG)
+        if self.external:
+            # listening before anything is read, so nothing falls in between
+            cur = conn.cursor()
+            cur.execute(f"LISTEN {INGEST_CHANNEL}")
+            conn.commit()
+            cur.close()
+            if self.live.ready:
+                self.resync(conn)
+        return conn
+    
+    def load(self, conn):
+        cur = conn.cursor(cursor_factory=RealDictCursor)
+        cur.execute("""
+            SELECT node_id, current_state, last_updated, is_online FROM machine_status
+        """)
+        statuses = cur.fetchall()
+        cur.execute("""
+            SELECT node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features
+            FROM (
+                SELECT *, row_number() OVER (PARTITION BY node_id ORDER BY timestamp DESC) AS n
+                FROM machine_readings
+                WHERE timestamp > NOW() - INTERVAL '1 day'
+            ) recent
+            WHERE n <= %s
+        """, (RECENT_READINGS,))
+        readings = with_state_names(cur.fetchall())
+        cur.execute("SELECT COALESCE(MAX(id), 0) AS id FROM machine_readings")
+        self.last_reading = cur.fetchone()['id']
+        conn.commit()
+        cur.close()
+        
+        self.live.load(statuses, readings)
+        logger.info(f"Live status: {len(statuses)} machines")
+    
+    def resync(self, conn):
+        """States and readings stored while the connection was down"""
+        cur = conn.cursor(cursor_factory=RealDictCursor)
+        cur.execute("SELECT node_id, current_state, last_updated FROM machine_status")
+        statuses = cur.fetchall()
+        conn.commit()
+        cur.close()
+        
+        for row in statuses:
+            self.live.update(row['node_id'], row['current_state'], row['last_updated'])
+        self.follow_readings(conn)
+    
+    def follow(self, conn):
+        """Apply the ingest daemon's events since the last call (ingest/sink.h)"""
+        conn.poll()
+        readings = False
+        for notify in conn.notifies:
+            for event in json.loads(notify.payload):
+                if event[0] == 's':
+                    self.live.update(event[1], event[2], datetime.fromisoformat(event[3]))
+                elif event[0] == 'h':
+                    self.live.heard(event[1], datetime.fromisoformat(event[2]))
+                elif event[0] == 'r':
+                    readings = True
+        conn.notifies.clear()
+        if readings:
+            self.follow_readings(conn)
+    
+    def follow_readings(self, conn):
+        """machine_readings rows stored since the last call, into the machines' detail"""
+        cur = conn.cursor(cursor_factory=RealDictCursor)
+        while True:
+            cur.execute("""
+                SELECT id, node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features
+                FROM machine_readings
+                WHERE id > %s
+                ORDER BY id
+                LIMIT 10000
+            """, (self.last_reading,))
+            rows = cur.fetchall()
+            readings = {}
+            for row in with_state_names(rows):
+                readings.setdefault(row['node_id'], []).append(row)
+                self.last_reading = row['id']
+            for node_id, machine_rows in readings.items():
+                self.live.add_readings(node_id, machine_rows)
+            if len(rows) < 10000:
+                break
+        conn.commit()
+        cur.close()
+    
+    def store(self, conn):
+        rows = self.live.take_dirty()
+        if not rows:
+            return
+        try:
+            self.write(conn, rows)
+        except psycopg2.OperationalError:
+            self.live.mark_dirty(rows)
+            raise
+        except psycopg2.Error:
+            # one by one, so a machine the database refuses doesn't hold up the rest
+            conn.rollback()
+            for row in rows:
+                try:
+                    self.write(conn, [row])
+                except psycopg2.OperationalError:
+                    self.live.mark_dirty(rows)
+                    raise
+                except psycopg2.Error as e:
+                    conn.rollback()
+                    logger.error(f"Machine {row['node_id']}: status not stored: {e}")
+    
+    def write(self, conn, rows):
+        cur = conn.cursor()
+        if self.external:
+            execute_values(cur, """
+                UPDATE machine_status m SET is_online = v.is_online
+                FROM (VALUES %s) AS v(node_id, is_online)
+                WHERE m.node_id = v.node_id
+            """, [(row['node_id'], row['is_online']) for row in rows])
+        else:
+            execute_values(cur, """
+                INSERT INTO machine_status (node_id, current_state, last_updated, is_online)
+                VALUES %s
+                ON CONFLICT (node_id)
+                DO UPDATE SET current_state = EXCLUDED.current_state,
+                              last_updated = EXCLUDED.last_updated,
+                              is_online = EXCLUDED.is_online
+            """, [(row['node_id'], row['current_state'], row['last_updated'], row['is_online'])
+                  for row in rows])
+        conn.commit()
+        cur.close()
+    
+    def stop(self):
+        self.running = False
+
+
+class RollupKeeper(threading.Thread):
+    """Thread that keeps the history rollups (rollups.py) up to date: every
+    ROLLUP_INTERVAL it sums up the readings stored since, by id, and adds
+    them to machine_rollups_1m/1h in the transaction that moves
+    rollup_progress on, so each reading counts once. It doesn't matter who
+    stored them (INGEST=external too), as long as ids are committed in
+    order (one writer). A new rollup table fills up from the existing
+    readings, ROLLUP_BATCH per transaction."""
+    
+    def __init__(self):
+        super().__init__()
+        self.running = False
+        self.rollups = None     # loaded from rollup_machines
+        self.last_reading = 0
+    
+    def run(self):
+        self.running = True
+        conn = None
+        
+        while self.running:
+            try:
+                if conn is None or conn.closed:
+                    conn = psycopg2.connect(**DB_CONFIG)
+                if self.rollups is None:
+                    self.load(conn)
+                while self.running and self.step(conn) == ROLLUP_BATCH:
+                    pass
+            except Exception as e:
+                logger.error(f"Rollups: {e}")
+                if conn is not None:
+                    conn.close()
+                conn = None
+                self.rollups = None  # ahead of what got committed
+            time.sleep(ROLLUP_INTERVAL)
+        
+        if conn is not None:
+            conn.close()
+    
+    def load(self, conn):
+        cur = conn.cursor(cursor_factory=RealDictCursor)
+        cur.execute("SELECT last_reading_id FROM rollup_progress")
+        self.last_reading = cur.fetchone()['last_reading_id']
+        cur.execute("SELECT node_id, machine_state, timestamp FROM rollup_machines")
+        rollups = Rollups()
+        for row in cur.fetchall():
+            rollups.last[row['node_id']] = (row['timestamp'], row['machine_state'])
+        conn.commit()
+        cur.close()
+        self.rollups = rollups
+    
+    def step(self, conn):
+        """Roll up the next readings, returns how many"""
+        cur = conn.cursor(cursor_factory=RealDictCursor)
+        cur.execute("""
+            SELECT id, node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features
+            FROM machine_readings
+            WHERE id > %s
+            ORDER BY id
+            LIMIT %s
+        """, (self.last_reading, ROLLUP_BATCH))
+        readings = cur.fetchall()
+        if not readings:
+            conn.commit()
+            cur.close()
+            return 0
+        
+        buckets = self.rollups.add(readings)
+        for resolution in ('1m', '1h'):
+            execute_values(cur, f"""
+                INSERT INTO machine_rollups_{resolution} AS r
+                    (node_id, bucket, readings, state_ms, rms_sum, rms_count, rms_max, freq_hist)
+                VALUES %s
+                ON CONFLICT (node_id, bucket)
+                DO UPDATE SET readings = r.readings + EXCLUDED.readings,
+                              state_ms = array_add(r.state_ms, EXCLUDED.state_ms),
+                              rms_sum = r.rms_sum + EXCLUDED.rms_sum,
+                              rms_count = r.rms_count + EXCLUDED.rms_count,
+                              rms_max = GREATEST(r.rms_max, EXCLUDED.rms_max),
+                              freq_hist = array_add(r.freq_hist, EXCLUDED.freq_hist)
+            """, [(node_id, start, b.readings, b.state_ms, b.rms_sum, b.rms_count, b.rms_max, b.freq_hist)
+                  for (res, node_id, start), b in buckets.items() if res == resolution])
+        
+        machines = {row['node_id'] for row in readings}
+        execute_values(cur, """
+            INSERT INTO rollup_machines (node_id, machine_state, timestamp)
+            VALUES %s
+            ON CONFLICT (node_id)
+            DO UPDATE SET machine_state = EXCLUDED.machine_state, timestamp = EXCLUDED.timestamp
+        """, [(node_id, self.rollups.last[node_id][1], self.rollups.last[node_id][0])
+              for node_id in sorted(machines)])
+        cur.execute("UPDATE rollup_progress SET last_reading_id = %s", (readings[-1]['id'],))
+        conn.commit()
+        cur.close()
+        
+        self.last_reading = readings[-1]['id']
+        return len(readings)
+    
+    def stop(self):
+        self.running = False
+
+
+class PartitionKeeper(threading.Thread):
+    """Thread that looks after machine_readings' day partitions
+    (database/readings.sql) once an hour: creates the coming days' and
+    expires the old ones, if there's a retention policy"""
+    
+    def __init__(self):
+        super().__init__()
+        self.running = False
+    
+    def run(self):
+        self.running = True
+        
+        while self.running:
+            try:
+                conn = psycopg2.connect(**DB_CONFIG)
+                cur = conn.cursor()
+                cur.execute("SELECT create_reading_partitions(CURRENT_DATE, CURRENT_DATE + %s)",
+                            (PARTITION_DAYS_AHEAD,))
+                created = cur.fetchone()[0]
+                expired = 0
+                if READINGS_KEEP_DAYS > 0:
+                    cur.execute("SELECT expire_reading_partitions(%s, %s)",
+                                (READINGS_KEEP_DAYS, READINGS_EXPIRE == 'detach'))
+                    expired = cur.fetchone()[0]
+                conn.commit()
+                cur.close()
+                conn.close()
+                if created or expired:
+                    logger.info(f"Readings partitions: {created} created, {expired} "
+                                f"{'detached' if READINGS_EXPIRE == 'detach' else 'dropped'}")
+            except Exception as e:
+                logger.error(f"Readings partitions: {e}")
+            time.sleep(PARTITION_INTERVAL)
+    
+    def stop(self):
+        self.running = False
+
+
+live = LiveStatus()
+
+# /api/machines as sent, rendered once per version
+machines_body = (None, None)
+
+
+def not_ready():
+    return jsonify({
+        'success': False,
+        'error': 'Machine status not loaded yet'
+    }), 503
+
+
+def conditional(body, etag):
+    """JSON response with an ETag, 304 if the client already has it"""
+    response = app.response_class(body, mimetype='application/json')
+    response.set_etag(etag)
+    response.headers['Cache-Control'] = 'no-cache'
+    return response.make_conditional(request)
+
+
+def server_event(event, event_id, data):
+    return f"id: {event_id}\nevent: {event}\ndata: {app.json.dumps(data)}\n\n"
+
 # API Routes
 
 @app.route('/api/machines', methods=['GET'])
 def get_machines():
-    """Get all machines and their current status"""
+    """Get all machines and their current status (from memory, no database;
+    send If-None-Match to get a 304 when nothing changed)"""
+    global machines_body
+    if not live.ready:
+        return not_ready()
+    
+    version, machines = live.machines()
+    if machines_body[0] != version:
+        machines_body = (version, app.json.dumps({
+            'success': True,
+            'machines': machines
+        }))
+    return conditional(machines_body[1], live.etag(version))
+
+@app.route('/api/machines/<int:node_id>', methods=['GET'])
+def get_machine_status(node_id):
+    """Get detailed status for a specific machine (from memory, with
+    last_seen and its last RECENT_READINGS readings)"""
+    if not live.ready:
+        return not_ready()
+    
+    machine = live.machine(node_id)
+    if machine is None:
+        return jsonify({
+            'success': False,
+            'error': 'Machine not found'
+        }), 404
+    
+    version, status, readings = machine
+    etag = live.etag(f"{node_id}.{version}")
+    if request.if_none_match.contains(etag):
+        return conditional(b'', etag)
+    return conditional(app.json.dumps({
+        'success': True,
+        'status': status,
+        'recent_readings': with_features(readings)
+    }), etag)
+
+@app.route('/api/machines/events', methods=['GET'])
+def machine_events():
+    """Server-sent events: `machines` with the whole list to start with (and
+    whenever the client has fallen too far behind), then `state` with the
+    machine's new status on every change. Reconnecting clients send the
+    Last-Event-ID they got and only get what they missed."""
+    if not live.ready:
+        return not_ready()
+    
+    def stream(event_id):
+        yield "retry: 5000\n\n"
+        while True:
+            changes = live.changes(event_id, EVENTS_KEEPALIVE)
+            if changes is None:
+                version, machines = live.machines()
+                event_id = live.etag(version)
+                yield server_event('machines', event_id, machines)
+            elif not changes:
+                yield ": keepalive\n\n"
+            else:
+                for version, status in changes:
+                    event_id = live.etag(version)
+                    yield server_event('state', event_id, status)
+    
+    return app.response_class(stream(request.headers.get('Last-Event-ID')),
+                              mimetype='text/event-stream',
+                              headers={'Cache-Control': 'no-cache', 'X-Accel-Buffering': 'no'})
+
+def rollup_row(row):
+    """A machine_rollups_* row as the history API returns it"""
+    return {
+        'timestamp': row['bucket'],
+        'readings': row['readings'],
+        'state_seconds': {state: ms / 1000 for state, ms in zip(STATES, row['state_ms'])},
+        'rms_mean': row['rms_sum'] / row['rms_count'] if row['rms_count'] else None,
+        'rms_max': row['rms_max'],
+        'freq_histogram': row['freq_hist'],
+    }
+
+@app.route('/api/history/<int:node_id>', methods=['GET'])
+def get_machine_history(node_id):
+    """Get historical data for a machine, oldest first, a page at a time:
+    while `next` isn't null, pass it as `after` for the following page.
+    Raw readings for short ranges, minute or hour rollups for longer ones
+    (state_seconds, rms_mean/max, freq_histogram over freq_bands_hz)."""
+    # Get optional query params
+    hours = request.args.get('hours', default=24, type=int)
+    limit = min(max(request.args.get('limit', default=HISTORY_LIMIT, type=int), 1), HISTORY_LIMIT_MAX)
+    resolution = request.args.get('resolution')
+    if resolution is None:
+        resolution = ('raw' if hours <= HISTORY_RAW_HOURS else
+                      '1m' if hours <= HISTORY_MINUTE_HOURS else '1h')
+    if resolution not in ('raw', '1m', '1h'):
+        return jsonify({
+            'success': False,
+            'error': 'resolution is raw, 1m or 1h'
+        }), 400
+    
+    # Cursor: timestamp of the last row sent, and its id for raw readings
+    after = request.args.get('after')
+    try:
+        if after is not None:
+            after_time, _, after_id = after.partition('_')
+            after = (datetime.fromisoformat(after_time), int(after_id or 0))
+    except ValueError:
+        return jsonify({
+            'success': False,
+            'error': 'Bad cursor'
+        }), 400
+    
     try:
         conn = psycopg2.connect(**DB_CONFIG)
         cur = conn.cursor(cursor_factory=RealDictCursor)
         
-        cur.execute("""
-            SELECT node_id, current_state, last_updated
-            FROM machine_status
-            ORDER BY node_id
-        """)
+        if resolution == 'raw':
+            cur.execute("""
+                SELECT id, machine_state, rms_magnitude, dominant_freq, timestamp, features
+                FROM machine_readings
+                WHERE node_id = %s 
+                AND timestamp > NOW() - INTERVAL '%s hours'
+                AND (timestamp, id) > (%s, %s)
+                ORDER BY timestamp, id
+                LIMIT %s
+            """, (node_id, hours, *(after or (datetime.min, 0)), limit + 1))
+        else:
+            trunc = 'minute' if resolution == '1m' else 'hour'
+            cur.execute(f"""
+                SELECT bucket, readings, state_ms, rms_sum, rms_count, rms_max, freq_hist
+                FROM machine_rollups_{resolution}
+                WHERE node_id = %s
+                AND bucket >= date_trunc('{trunc}', NOW() - INTERVAL '%s hours')
+                AND bucket > %s
+                ORDER BY bucket
+                LIMIT %s
+            """, (node_id, hours, after[0] if after else datetime.min, limit + 1))
         
-        machines = cur.fetchall()
+        rows = cur.fetchall()
         cur.close()
         conn.close()
         
-        return jsonify({
+        more = len(rows) > limit
+        rows = rows[:limit]
+        if resolution == 'raw':
+            cursor = f"{rows[-1]['timestamp'].isoformat()}_{rows[-1]['id']}" if more else None
+            for row in rows:
+                del row['id']
+            history = with_features(with_state_names(rows))
+        else:
+            cursor = rows[-1]['bucket'].isoformat() if more else None
+            history = [rollup_row(row) for row in rows]
+        
+        response = {
             'success': True,
-            'machines': machines
-        })
+            'resolution': resolution,
+            'history': history,
+            'next': cursor
+        }
+        if resolution != 'raw':
+            response['freq_bands_hz'] = FREQ_BAND_EDGES_HZ
+        return jsonify(response)
         
     except Exception as e:
-        logger.error(f"Error fetching machines: {e}")
+        logger.error(f"Error fetching history: {e}")
         return jsonify({
             'success': False,
             'error': str(e)
         }), 500
 
-@app.route('/api/machines/<int:node_id>', methods=['GET'])
-def get_machine_status(node_id):
-    """Get detailed status for a specific machine"""
+@app.route('/api/machines/<int:node_id>/profile', methods=['GET'])
+def get_machine_profile(node_id):
+    """Get stage timing reports of one node"""
+    hours = request.args.get('hours', default=24, type=int)
+    
     try:
         conn = psycopg2.connect(**DB_CONFIG)
         cur = conn.cursor(cursor_factory=RealDictCursor)
         
-        # Get current status
-        cur.execute("""
-            SELECT node_id, current_state, last_updated
-            FROM machine_status
-            WHERE node_id = %s
-        """, (node_id,))
-        
-        status = cur.fetchone()
-        
-        if not status:
-            return jsonify({
-                'success': False,
-                'error': 'Machine not found'
-            }), 404
-        
-        # Get recent readings
         cur.execute("""
-            SELECT machine_state, rms_magnitude, dominant_freq, timestamp
-            FROM machine_readings
+            SELECT received_at, period_ms, stage, sample_count, min_us, max_us, mean_us,
+                   bucket_shift, first_bucket, histogram
+            FROM node_profiles
             WHERE node_id = %s
-            ORDER BY timestamp DESC
-            LIMIT 20
-        """, (node_id,))
-        
-        readings = cur.fetchall()
+            AND received_at > NOW() - INTERVAL '%s hours'
+            ORDER BY received_at ASC, stage
+        """, (node_id, hours))
         
+        profile = cur.fetchall()
         cur.close()
         conn.close()
         
         return jsonify({
             'success': True,
-            'status': status,
-            'recent_readings': readings
+            'profile': profile
         })
         
     except Exception as e:
-        logger.error(f"Error fetching machine status: {e}")
+        logger.error(f"Error fetching profile: {e}")
         return jsonify({
             'success': False,
             'error': str(e)
         }), 500
 
-@app.route('/api/history/<int:node_id>', methods=['GET'])
-def get_machine_history(node_id):
-    """Get historical data for a machine"""
-    # Get optional query params
-    hours = request.args.get('hours', default=24, type=int)
-    
+@app.route('/api/profile', methods=['GET'])
+def get_fleet_profile():
+    """Latest timing report of every stage on every node, slowest first,
+    to spot nodes that take longer than the rest"""
     try:
         conn = psycopg2.connect(**DB_CONFIG)
         cur = conn.cursor(cursor_factory=RealDictCursor)
         
         cur.execute("""
-            SELECT machine_state, rms_magnitude, dominant_freq, timestamp
-            FROM machine_readings
-            WHERE node_id = %s 
-            AND timestamp > NOW() - INTERVAL '%s hours'
-            ORDER BY timestamp ASC
-        """, (node_id, hours))
+            SELECT * FROM (
+                SELECT DISTINCT ON (node_id, stage)
+                       node_id, stage, received_at, sample_count, min_us, max_us, mean_us
+                FROM node_profiles
+                ORDER BY node_id, stage, received_at DESC
+            ) latest
+            ORDER BY stage, mean_us DESC
+        """)
         
-        history = cur.fetchall()
+        profile = cur.fetchall()
         cur.close()
         conn.close()
         
         return jsonify({
             'success': True,
-            'history': history
+            'profile': profile
         })
         
     except Exception as e:
-        logger.error(f"Error fetching history: {e}")
+        logger.error(f"Error fetching fleet profile: {e}")
         return jsonify({
             'success': False,
             'error': str(e)
@@ -281,10 +1308,27 @@ def health_check():
 
 if __name__ == '__main__':
     # Start Zigbee reader thread
-    reader = ZigbeeReader(SERIAL_PORT, SERIAL_BAUD)
-    reader.daemon = True
-    reader.start()
+    if INGEST_EXTERNAL:
+        logger.info("Serial ingest runs externally (backend/ingest)")
+    else:
+        reader = ZigbeeReader(SERIAL_PORT, SERIAL_BAUD, live)
+        reader.daemon = True
+        reader.start()
+    
+    keeper = StatusKeeper(live, INGEST_EXTERNAL)
+    keeper.daemon = True
+    keeper.start()
+    
+    rollup_keeper = RollupKeeper()
+    rollup_keeper.daemon = True
+    rollup_keeper.start()
+    
+    partition_keeper = PartitionKeeper()
+    partition_keeper.daemon = True
+    partition_keeper.start()
     
     # Start Flask server
     logger.info("Starting Wasche backend server...")
-    app.run(host='0.0.0.0', port=5000, debug=True)
+    # No reloader: it runs this file again in a child process, which would
+    # start a second set of threads reading the same serial port
+    app.run(host='0.0.0.0', port=API_PORT, debug=True, use_reloader=False)
@@ -40,6 +40,28 @@ def test_get_machine_status(node_id=1):
         print(f"Recent readings: {len(data['recent_readings'])} entries")
     print()
 
+def test_conditional_get():
+    """Test that an unchanged machine list comes back as 304"""
+    print("Testing conditional get of all machines...")
+    response = requests.get(f"{BASE_URL}/machines")
+    etag = response.headers.get('ETag')
+    print(f"ETag: {etag}")
+    response = requests.get(f"{BASE_URL}/machines", headers={'If-None-Match': etag})
+    print(f"Status: {response.status_code} (304 unless a machine changed in between)")
+    print()
+
+def test_events():
+    """Test the status event stream: the full list comes first"""
+    print("Testing machine status events...")
+    response = requests.get(f"{BASE_URL}/machines/events", stream=True, timeout=5)
+    print(f"Status: {response.status_code}")
+    for line in response.iter_lines(decode_unicode=True):
+        if line.startswith('event:'):
+            print(f"First event: {line[6:].strip()}")
+            break
+    response.close()
+    print()
+
 def test_get_history(node_id=1, hours=24):
     """Test getting historical data"""
     print(f"Testing get history for node {node_id}...")
@@ -47,7 +69,8 @@ def test_get_history(node_id=1, hours=24):
     print(f"Status: {response.status_code}")
     data = response.json()
     if data['success']:
-        print(f"History: {len(data['history'])} readings in last {hours} hours")
+        print(f"History: {len(data['history'])} rows ({data['resolution']}) in last {hours} hours, "
+              f"next page: {data['next']}")
     print()
 
 if __name__ == "__main__":
@@ -60,7 +83,10 @@ if __name__ == "__main__":
         test_health()
         test_get_machines()
         test_get_machine_status(1)
+        test_conditional_get()
+        test_events()
         test_get_history(1, 24)
+        test_get_history(1, 168)
         
         print("All tests completed!")
         
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""
+machine_readings storage: the old layout against readings.sql
+
+Builds both in scratch schemas of the database (the old one: SERIAL id,
+VARCHAR state, three B-trees; the new one: SMALLINT state, a partition per
+day, BRIN), stores the same readings into each the way the ingest paths do
+(COPY, as the ingest daemon, and execute_values, as server.py) in batches of
+BATCH, and reports rows/s, WAL written and table and index size. The
+schemas are dropped afterwards.
+
+Usage: python bench_storage.py [readings] [nodes]
+  DSN in WASCHE_DSN, default the backend's wasche_db
+"""
+
+import io
+import os
+import random
+import sys
+import time
+from datetime import datetime, timedelta
+
+import psycopg2
+from psycopg2.extras import execute_values
+
+DSN = os.environ.get('WASCHE_DSN', 'host=localhost dbname=wasche_db user=wasche_user password=wasche_pass')
+BATCH = 1000
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+STATES = ['IDLE', 'WASHING', 'SPINNING', 'DONE', 'UNKNOWN']
+
+# machine_readings as schema.sql had it before readings.sql
+OLD_LAYOUT = """
+CREATE TABLE machine_readings (
+    id SERIAL PRIMARY KEY,
+    node_id INTEGER REFERENCES nodes(node_id),
+    machine_state VARCHAR(20) CHECK (machine_state IN ('IDLE', 'WASHING', 'SPINNING', 'DONE', 'UNKNOWN')),
+    rms_magnitude REAL,
+    dominant_freq REAL,
+    timestamp TIMESTAMP DEFAULT NOW(),
+    features BYTEA
+);
+CREATE INDEX idx_readings_node_id ON machine_readings(node_id);
+CREATE INDEX idx_readings_timestamp ON machine_readings(timestamp);
+CREATE INDEX idx_readings_node_time ON machine_readings(node_id, timestamp);
+"""
+
+NULL = '\\N'  # COPY text format
+
+NODES = "CREATE TABLE nodes (node_id INTEGER PRIMARY KEY);"
+
+
+def make_readings(count, nodes):
+    """(node_id, timestamp, state, rms, freq, features) over the last day:
+    every node reports every few seconds, half of them feature vectors"""
+    rng = random.Random(1)
+    start = datetime.now() - timedelta(hours=20)
+    step = timedelta(hours=19) / (count / nodes)
+    state = {node: rng.randrange(4) for node in range(1, nodes + 1)}
+    readings = []
+    for i in range(count):
+        node = i % nodes + 1
+        if rng.random() < 0.01:
+            state[node] = (state[node] + 1) % 4
+        t = start + step * (i // nodes) + timedelta(milliseconds=rng.randrange(2000))
+        rms = round(rng.uniform(0.01, 2.5), 3)
+        if node % 2:
+            features = bytes(rng.randrange(256) for _ in range(5))
+            readings.append((node, t, state[node], rms, None, features))
+        else:
+            readings.append((node, t, state[node], rms, round(rng.uniform(0.5, 40), 1), None))
+    return readings
+
+
+def setup(cur, schema, layout):
+    cur.execute(f"DROP SCHEMA IF EXISTS {schema} CASCADE; CREATE SCHEMA {schema}; SET search_path = {schema}")
+    cur.execute(NODES)
+    cur.execute(layout)
+
+
+def row(reading, named):
+    node, t, state, rms, freq, features = reading
+    return (node, STATES[state] if named else state, rms, freq, t, features)
+
+
+def copy_batch(cur, batch, named):
+    buf = io.StringIO()
+    for reading in batch:
+        node, state, rms, freq, t, features = row(reading, named)
+        freq = NULL if freq is None else freq
+        features = NULL if features is None else '\\\\x' + features.hex()
+        buf.write(f"{node}\t{state}\t{rms}\t{freq}\t{t.isoformat(' ')}\t{features}\n")
+    buf.seek(0)
+    cur.copy_expert("COPY machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, "
+                    "timestamp, features) FROM STDIN", buf)
+
+
+def insert_batch(cur, batch, named):
+    execute_values(cur, """
+        INSERT INTO machine_readings (node_id, machine_state, rms_magnitude, dominant_freq, timestamp, features)
+        VALUES %s
+    """, [row(reading, named) for reading in batch], page_size=BATCH)
+
+
+def wal_lsn(cur):
+    cur.execute("SELECT pg_current_wal_lsn()")
+    return cur.fetchone()[0]
+
+
+def sizes(cur, schema):
+    """(table bytes, index bytes) over machine_readings and its partitions,
+    if it has any"""
+    cur.execute("""
+        SELECT sum(pg_table_size(relid)), sum(pg_indexes_size(relid))
+        FROM (SELECT relid FROM pg_partition_tree(%(table)s::regclass)
+              UNION SELECT %(table)s::regclass) AS parts
+    """, {'table': f'{schema}.machine_readings'})
+    return cur.fetchone()
+
+
+def run(conn, name, schema, layout, named, store, readings, nodes):
+    cur = conn.cursor()
+    setup(cur, schema, layout)
+    execute_values(cur, "INSERT INTO nodes VALUES %s", [(n,) for n in range(1, nodes + 1)])
+    conn.commit()
+
+    lsn = wal_lsn(cur)
+    start = time.perf_counter()
+    for pos in range(0, len(readings), BATCH):
+        store(cur, readings[pos:pos + BATCH], named)
+        conn.commit()
+    elapsed = time.perf_counter() - start
+    cur.execute("SELECT pg_wal_lsn_diff(pg_current_wal_lsn(), %s)", (lsn,))
+    wal = int(cur.fetchone()[0])
+
+    table, index = sizes(cur, schema)
+    count = len(readings)
+    print(f"{name:<20} {count / elapsed:9.0f} rows/s  WAL {wal / count:6.0f} B/row  "
+          f"table {table / 2**20:7.1f} MB ({table / count:4.0f} B/row)  "
+          f"indexes {index / 2**20:7.1f} MB ({index / count:4.0f} B/row)")
+    cur.execute(f"DROP SCHEMA {schema} CASCADE")
+    conn.commit()
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+    nodes = int(sys.argv[2]) if len(sys.argv) > 2 else 100
+
+    with open(os.path.join(HERE, 'readings.sql')) as f:
+        new_layout = f.read()
+    readings = make_readings(count, nodes)
+    print(f"{count} readings from {nodes} nodes, batches of {BATCH}")
+
+    conn = psycopg2.connect(DSN)
+    try:
+        for method, store in (('COPY', copy_batch), ('INSERT', insert_batch)):
+            run(conn, f"old {method}", 'bench_old', OLD_LAYOUT, True, store, readings, nodes)
+            run(conn, f"partitioned {method}", 'bench_new', new_layout, False, store, readings, nodes)
+    finally:
+        conn.close()
+
+
+if __name__ == '__main__':
+    main()
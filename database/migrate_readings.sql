@@ -0,0 +1,75 @@
+-- Wasche: move an existing machine_readings to the layout of readings.sql
+-- (state as SMALLINT, a partition per day, BRIN indexes), every reading kept
+-- with its id so the rollups carry on where they were.
+--
+-- Run once as wasche_user with the backend and ingest daemon stopped:
+--   psql -U wasche_user -d wasche_db -f migrate_readings.sql
+--
+-- It copies the readings, so it needs room for a second copy while it runs.
+-- The old table stays as machine_readings_old until you drop it.
+
+\set ON_ERROR_STOP on
+
+BEGIN;
+
+-- Out of the way, names and all
+ALTER TABLE machine_readings RENAME TO machine_readings_old;
+ALTER TABLE machine_readings_old RENAME CONSTRAINT machine_readings_pkey TO machine_readings_old_pkey;
+ALTER SEQUENCE machine_readings_id_seq RENAME TO machine_readings_old_id_seq;
+ALTER INDEX idx_readings_node_id RENAME TO idx_readings_old_node_id;
+ALTER INDEX idx_readings_timestamp RENAME TO idx_readings_old_timestamp;
+ALTER INDEX idx_readings_node_time RENAME TO idx_readings_old_node_time;
+
+\ir readings.sql
+
+-- A partition for every day there are readings for
+SELECT create_reading_partitions(COALESCE(min(timestamp)::DATE, CURRENT_DATE), CURRENT_DATE + 7)
+FROM machine_readings_old;
+
+-- In id order, which keeps the BRIN ranges tight
+INSERT INTO machine_readings (id, timestamp, node_id, rms_magnitude, dominant_freq, machine_state, features)
+SELECT o.id, COALESCE(o.timestamp, NOW()), o.node_id, o.rms_magnitude, o.dominant_freq, s.state, o.features
+FROM machine_readings_old o
+LEFT JOIN machine_states s ON s.name = o.machine_state
+ORDER BY o.id;
+
+SELECT setval(pg_get_serial_sequence('machine_readings', 'id'), COALESCE(max(id), 0) + 1, false)
+FROM machine_readings;
+
+-- The rollups' per-machine state, cursor and RMS counts, if they're set up;
+-- the cursor follows machine_readings.id past 2^31
+DO $$
+BEGIN
+    IF to_regclass('rollup_progress') IS NOT NULL THEN
+        ALTER TABLE rollup_progress ALTER COLUMN last_reading_id TYPE BIGINT;
+    END IF;
+    -- The mean's count: rollups from before it summed every reading (0 for
+    -- none), so readings is what their sum is over
+    IF to_regclass('machine_rollups_1m') IS NOT NULL THEN
+        ALTER TABLE machine_rollups_1m ADD COLUMN IF NOT EXISTS rms_count INTEGER;
+        ALTER TABLE machine_rollups_1h ADD COLUMN IF NOT EXISTS rms_count INTEGER;
+        UPDATE machine_rollups_1m SET rms_count = readings WHERE rms_count IS NULL;
+        UPDATE machine_rollups_1h SET rms_count = readings WHERE rms_count IS NULL;
+    END IF;
+    IF to_regclass('rollup_machines') IS NOT NULL THEN
+        ALTER TABLE rollup_machines ALTER COLUMN machine_state TYPE SMALLINT USING
+            CASE machine_state WHEN 'IDLE' THEN 0 WHEN 'WASHING' THEN 1 WHEN 'SPINNING' THEN 2
+                               WHEN 'DONE' THEN 3 ELSE 4 END;
+    END IF;
+END
+$$;
+
+GRANT SELECT ON machine_states TO wasche_user;
+
+COMMIT;
+
+ANALYZE machine_readings;
+
+SELECT (SELECT count(*) FROM machine_readings_old) AS old_readings,
+       (SELECT count(*) FROM machine_readings) AS new_readings,
+       pg_size_pretty(pg_total_relation_size('machine_readings_old')) AS old_size,
+       (SELECT pg_size_pretty(sum(pg_total_relation_size(relid)))
+        FROM pg_partition_tree('machine_readings')) AS new_size;
+
+-- Once the numbers match and the backend runs:
+--   DROP TABLE machine_readings_old;
@@ -0,0 +1,98 @@
+-- Wasche readings layout
+-- machine_readings and what goes with it, included by schema.sql and
+-- migrate_readings.sql (plain SQL, bench_storage.py runs it too)
+--
+-- A reading is about 60 bytes: the state as a SMALLINT, the columns
+-- ordered so nothing needs padding. The table is split into a partition per
+-- day, so retention drops whole tables instead of deleting rows, and time
+-- and id are indexed with BRIN. One B-tree is left to maintain per insert.
+
+-- Machine states as readings store them: the firmware's machine_state_t
+CREATE TABLE machine_states (
+    state SMALLINT PRIMARY KEY,
+    name VARCHAR(20) UNIQUE
+);
+
+INSERT INTO machine_states VALUES (0, 'IDLE'), (1, 'WASHING'), (2, 'SPINNING'), (3, 'DONE'), (4, 'UNKNOWN');
+
+-- Create machine_readings table (historical data), one partition per day
+-- (machine_readings_YYYYMMDD, see create_reading_partitions below)
+CREATE TABLE machine_readings (
+    id BIGINT GENERATED BY DEFAULT AS IDENTITY,  -- insertion order, for following new rows
+    timestamp TIMESTAMP NOT NULL DEFAULT NOW(),
+    node_id INTEGER REFERENCES nodes(node_id),
+    rms_magnitude REAL,
+    dominant_freq REAL,          -- NULL for readings with a feature vector
+    machine_state SMALLINT CHECK (machine_state BETWEEN 0 AND 4),  -- machine_states
+    features BYTEA               -- PKT_TYPE_FEATURES vector as sent, 5 bytes: 8 band levels
+                                 -- (4 bits, 3 dB steps) and the centroid (0.2 Hz)
+) PARTITION BY RANGE (timestamp);
+
+-- Catches readings dated outside the day partitions (a node with its clock
+-- way off); create_reading_partitions moves them into a new day's partition
+CREATE TABLE machine_readings_default PARTITION OF machine_readings DEFAULT;
+
+-- Create indexes for faster queries: one B-tree for a machine's history,
+-- BRIN for the rest (a few pages per partition, next to nothing to keep
+-- up on insert since both columns grow with the insertion order)
+CREATE INDEX idx_readings_node_time ON machine_readings(node_id, timestamp);
+CREATE INDEX idx_readings_time_brin ON machine_readings USING BRIN (timestamp);
+CREATE INDEX idx_readings_id_brin ON machine_readings USING BRIN (id);
+
+-- Day partitions from first_day to last_day that don't exist yet, with any
+-- readings for those days in the default partition moved in. Returns how
+-- many it created. The backend runs it every hour for the days ahead.
+CREATE OR REPLACE FUNCTION create_reading_partitions(first_day DATE, last_day DATE)
+RETURNS INTEGER AS $$
+DECLARE
+    day DATE;
+    part TEXT;
+    created INTEGER := 0;
+BEGIN
+    FOR day IN SELECT generate_series(first_day, last_day, INTERVAL '1 day')::DATE LOOP
+        part := 'machine_readings_' || to_char(day, 'YYYYMMDD');
+        IF to_regclass(part) IS NULL THEN
+            EXECUTE format('CREATE TABLE %I (LIKE machine_readings INCLUDING DEFAULTS INCLUDING CONSTRAINTS)',
+                           part);
+            EXECUTE format('WITH moved AS (DELETE FROM machine_readings_default
+                                           WHERE timestamp >= %L AND timestamp < %L RETURNING *)
+                            INSERT INTO %I SELECT * FROM moved', day, day + 1, part);
+            EXECUTE format('ALTER TABLE machine_readings ATTACH PARTITION %I FOR VALUES FROM (%L) TO (%L)',
+                           part, day, day + 1);
+            created := created + 1;
+        END IF;
+    END LOOP;
+    RETURN created;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Retention: drops the day partitions older than keep_days (before today),
+-- or with detach_only leaves them as tables of their own to archive, and
+-- deletes readings that old from the default partition. Returns how many
+-- partitions it took off.
+CREATE OR REPLACE FUNCTION expire_reading_partitions(keep_days INTEGER, detach_only BOOLEAN DEFAULT FALSE)
+RETURNS INTEGER AS $$
+DECLARE
+    part TEXT;
+    cutoff DATE := CURRENT_DATE - keep_days;
+    expired INTEGER := 0;
+BEGIN
+    FOR part IN
+        SELECT c.relname FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid
+        WHERE i.inhparent = 'machine_readings'::regclass
+        AND c.relname ~ '^machine_readings_[0-9]{8}$'
+        AND to_date(right(c.relname, 8), 'YYYYMMDD') < cutoff
+        ORDER BY c.relname
+    LOOP
+        EXECUTE format('ALTER TABLE machine_readings DETACH PARTITION %I', part);
+        IF NOT detach_only THEN
+            EXECUTE format('DROP TABLE %I', part);
+        END IF;
+        expired := expired + 1;
+    END LOOP;
+    DELETE FROM machine_readings_default WHERE timestamp < cutoff;
+    RETURN expired;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT create_reading_partitions(CURRENT_DATE - 1, CURRENT_DATE + 7);
@@ -2,7 +2,13 @@
 -- PostgreSQL database for storing laundry machine data
 
 -- Drop existing tables if they exist
+DROP TABLE IF EXISTS rollup_machines CASCADE;
+DROP TABLE IF EXISTS rollup_progress CASCADE;
+DROP TABLE IF EXISTS machine_rollups_1h CASCADE;
+DROP TABLE IF EXISTS machine_rollups_1m CASCADE;
+DROP TABLE IF EXISTS node_profiles CASCADE;
 DROP TABLE IF EXISTS machine_readings CASCADE;
+DROP TABLE IF EXISTS machine_states CASCADE;
 DROP TABLE IF EXISTS machine_status CASCADE;
 DROP TABLE IF EXISTS nodes CASCADE;
 
@@ -25,22 +31,69 @@ CREATE TABLE machine_status (
     is_online BOOLEAN DEFAULT TRUE
 );
 
--- Create machine_readings table (historical data)
-CREATE TABLE machine_readings (
+-- Create machine_states and machine_readings (historical data, partitioned
+-- by day), see readings.sql. Existing databases: migrate_readings.sql.
+\ir readings.sql
+
+-- Create node_profiles table (stage timings from PKT_TYPE_PROFILE reports,
+-- one row per node, report and stage)
+CREATE TABLE node_profiles (
     id SERIAL PRIMARY KEY,
     node_id INTEGER REFERENCES nodes(node_id),
-    machine_state VARCHAR(20) CHECK (machine_state IN ('IDLE', 'WASHING', 'SPINNING', 'DONE', 'UNKNOWN')),
-    rms_magnitude REAL,
-    dominant_freq REAL,
-    timestamp TIMESTAMP DEFAULT NOW()
+    received_at TIMESTAMP DEFAULT NOW(),
+    period_ms INTEGER,           -- time the report covers
+    stage VARCHAR(20),           -- sensor_read, add_sample, rms, spectrum, classify, send
+    sample_count INTEGER,
+    min_us REAL,
+    max_us REAL,
+    mean_us REAL,
+    bucket_shift SMALLINT,       -- histogram bucket k > 0 is [2^(k+shift), 2^(k+shift+1)) cycles
+    first_bucket SMALLINT,
+    histogram SMALLINT[]         -- share of the samples per bucket from first_bucket, 1/255ths
+);
+
+CREATE INDEX idx_profiles_node_time ON node_profiles(node_id, received_at);
+
+-- History rollups (backend/rollups.py): machine_readings summed up per machine
+-- and minute / hour, kept up to date by the backend as readings come in.
+-- Existing databases: run this part, the backend fills them from what's there.
+CREATE TABLE machine_rollups_1m (
+    node_id INTEGER,
+    bucket TIMESTAMP,            -- start of the minute
+    readings INTEGER,
+    state_ms INTEGER[],          -- time in IDLE, WASHING, SPINNING, DONE, UNKNOWN
+    rms_sum DOUBLE PRECISION,
+    rms_count INTEGER,           -- readings with an RMS, for the mean
+    rms_max REAL,                -- NULL if none of them did (state time only)
+    freq_hist INTEGER[],         -- readings per band 0-1-2-4-6-9-12-25-50 Hz
+    PRIMARY KEY (node_id, bucket)
+);
+
+CREATE TABLE machine_rollups_1h (LIKE machine_rollups_1m INCLUDING ALL);
+
+-- How far the rollups got: last machine_readings id, and each machine's
+-- latest reading (where its current state started)
+CREATE TABLE rollup_progress (
+    last_reading_id BIGINT NOT NULL   -- machine_readings.id is BIGINT
+);
+INSERT INTO rollup_progress VALUES (0);
+
+CREATE TABLE rollup_machines (
+    node_id INTEGER PRIMARY KEY,
+    machine_state SMALLINT,
+    timestamp TIMESTAMP
 );
 
--- Create indexes for faster queries
-CREATE INDEX idx_readings_node_id ON machine_readings(node_id);
-CREATE INDEX idx_readings_timestamp ON machine_readings(timestamp);
-CREATE INDEX idx_readings_node_time ON machine_readings(node_id, timestamp);
+-- Element-wise sum of two arrays, for merging rollup buckets
+CREATE OR REPLACE FUNCTION array_add(a INTEGER[], b INTEGER[])
+RETURNS INTEGER[] AS $$
+    SELECT array_agg(COALESCE(x, 0) + COALESCE(y, 0) ORDER BY i)
+    FROM unnest(a, b) WITH ORDINALITY AS t(x, y, i);
+$$ LANGUAGE sql IMMUTABLE;
 
 -- Create function to check node online status
+-- (the backend times machines out itself, backend/live_status.py, and writes
+-- is_online with last_updated = when it was last heard, so this agrees)
 CREATE OR REPLACE FUNCTION check_node_online()
 RETURNS TRIGGER AS $$
 BEGIN
@@ -62,12 +115,16 @@ EXECUTE FUNCTION check_node_online();
 
 -- Insert some sample nodes (for testing)
 -- In production these would be added as nodes are deployed
+-- A node_id is one machine: the radio's node id, plus sensor << 16 for the
+-- second sensor of a node on a stacked pair (SENSOR_COUNT in firmware config.h)
 INSERT INTO nodes (node_id, location, machine_type, building, floor, notes) VALUES
 (1, 'Laundry Room A - Left', 'washer', 'Mellby Hall', 1, 'Front-loading washer'),
 (2, 'Laundry Room A - Center', 'washer', 'Mellby Hall', 1, 'Top-loading washer'),
 (3, 'Laundry Room A - Right', 'dryer', 'Mellby Hall', 1, 'Standard dryer'),
 (4, 'Laundry Room B - Left', 'washer', 'Ytterboe Hall', 2, 'Front-loading washer'),
-(5, 'Laundry Room B - Right', 'dryer', 'Ytterboe Hall', 2, 'Standard dryer');
+(5, 'Laundry Room B - Right', 'dryer', 'Ytterboe Hall', 2, 'Standard dryer'),
+(6, 'Laundry Room C - Stack', 'washer', 'Hoyme Hall', 1, 'Stacked pair, bottom (sensor 0)'),
+(6 + 65536, 'Laundry Room C - Stack', 'dryer', 'Hoyme Hall', 1, 'Stacked pair, top (sensor 1 of node 6)');
 
 -- Initialize machine status for all nodes
 INSERT INTO machine_status (node_id, current_state, is_online)
@@ -92,7 +149,15 @@ LEFT JOIN machine_status ms ON n.node_id = ms.node_id;
 GRANT ALL PRIVILEGES ON TABLE nodes TO wasche_user;
 GRANT ALL PRIVILEGES ON TABLE machine_status TO wasche_user;
 GRANT ALL PRIVILEGES ON TABLE machine_readings TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE machine_readings_default TO wasche_user;
 GRANT ALL PRIVILEGES ON SEQUENCE machine_readings_id_seq TO wasche_user;
+GRANT SELECT ON machine_states TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE node_profiles TO wasche_user;
+GRANT ALL PRIVILEGES ON SEQUENCE node_profiles_id_seq TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE machine_rollups_1m TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE machine_rollups_1h TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE rollup_progress TO wasche_user;
+GRANT ALL PRIVILEGES ON TABLE rollup_machines TO wasche_user;
 GRANT SELECT ON machine_info TO wasche_user;
 
 -- Some useful queries for monitoring:
@@ -106,10 +171,10 @@ GRANT SELECT ON machine_info TO wasche_user;
 -- Get usage statistics for the last 24 hours
 -- SELECT 
 --     node_id,
---     machine_state,
+--     s.name AS machine_state,
 --     COUNT(*) as state_count,
 --     AVG(rms_magnitude) as avg_vibration
--- FROM machine_readings
+-- FROM machine_readings r JOIN machine_states s ON s.state = r.machine_state
 -- WHERE timestamp > NOW() - INTERVAL '24 hours'
--- GROUP BY node_id, machine_state
+-- GROUP BY node_id, s.name
 -- ORDER BY node_id;
@@ -1,58 +1,104 @@
 #include "adxl345.h"
 #include "config.h"
-#include <ti/drivers/I2C.h>
-#include <ti/drivers/GPIO.h>
-#include <unistd.h>
+#include "hal.h"
 #include <math.h>
 
-// I2C handle - initialized externally
-static I2C_Handle i2c_handle = NULL;
+// INT1 lines to the sensors on them (watermark or activity)
+static adxl345_t *int_devices[HAL_GPIO_MAX];
+
+// I2C transactions are queued and left to the hardware, so FIFO reads don't
+// block. Register access still looks blocking: transfer() waits for its own
+// transaction's callback. One register access at a time, whichever sensor.
+static hal_sem_t transfer_sem = NULL;
+static volatile bool transfer_status = false;
+static const uint8_t fifo_reg = ADXL345_REG_DATAX0;
+
+// register access from transfer()
+static void transfer_callback(hal_i2c_transaction_t *transaction, bool ok) {
+    (void)transaction;
+    transfer_status = ok;
+    hal_sem_post(transfer_sem);
+}
+
+// queued FIFO entries complete in order
+static void fifo_callback(hal_i2c_transaction_t *transaction, bool ok) {
+    adxl345_t *dev = transaction->context;
+    
+    if (!ok) {
+        dev->fifo_failed = true;
+    } else if (!dev->fifo_failed) {
+        dev->fifo_good++;
+    }
+    
+    if (++dev->fifo_completed == dev->fifo_queued && !dev->fifo_queuing) {
+        dev->fifo_done(dev);
+    }
+}
+
+static bool transfer(adxl345_t *dev, hal_i2c_transaction_t *transaction) {
+    transaction->address = dev->address;
+    transaction->callback = transfer_callback;
+    transaction->context = NULL;
+    
+    if (!hal_i2c_queue(transaction)) {
+        return false;
+    }
+    hal_sem_pend(transfer_sem, HAL_WAIT_FOREVER);
+    return transfer_status;
+}
 
 // Helper function to write a register
-static bool write_register(uint8_t reg, uint8_t value) {
+static bool write_register(adxl345_t *dev, uint8_t reg, uint8_t value) {
     uint8_t txBuffer[2];
-    I2C_Transaction i2cTransaction;
+    hal_i2c_transaction_t i2cTransaction;
     
     txBuffer[0] = reg;
     txBuffer[1] = value;
     
-    i2cTransaction.writeBuf = txBuffer;
-    i2cTransaction.writeCount = 2;
-    i2cTransaction.readBuf = NULL;
-    i2cTransaction.readCount = 0;
-    i2cTransaction.slaveAddress = ADXL345_ADDR;
+    i2cTransaction.write_buf = txBuffer;
+    i2cTransaction.write_count = 2;
+    i2cTransaction.read_buf = NULL;
+    i2cTransaction.read_count = 0;
     
-    return I2C_transfer(i2c_handle, &i2cTransaction);
+    return transfer(dev, &i2cTransaction);
 }
 
 // Helper function to read registers
-static bool read_registers(uint8_t reg, uint8_t *buffer, size_t length) {
-    I2C_Transaction i2cTransaction;
+static bool read_registers(adxl345_t *dev, uint8_t reg, uint8_t *buffer, size_t length) {
+    hal_i2c_transaction_t i2cTransaction;
     
     // first write the register address
-    i2cTransaction.writeBuf = &reg;
-    i2cTransaction.writeCount = 1;
-    i2cTransaction.readBuf = buffer;
-    i2cTransaction.readCount = length;
-    i2cTransaction.slaveAddress = ADXL345_ADDR;
+    i2cTransaction.write_buf = &reg;
+    i2cTransaction.write_count = 1;
+    i2cTransaction.read_buf = buffer;
+    i2cTransaction.read_count = length;
     
-    return I2C_transfer(i2c_handle, &i2cTransaction);
+    return transfer(dev, &i2cTransaction);
 }
 
-bool adxl345_init(void) {
-    // Open I2C
-    I2C_Params i2cParams;
-    I2C_Params_init(&i2cParams);
-    i2cParams.bitRate = I2C_400kHz;  // fast mode
+bool adxl345_init(adxl345_t *dev, uint8_t address, uint8_t int_gpio) {
+    dev->address = address;
+    dev->int_gpio = int_gpio;
+    dev->int1_callback = NULL;
+    dev->fifo_queued = 0;
+    dev->fifo_completed = 0;
+    dev->fifo_queuing = false;
+
+    if (transfer_sem == NULL) {
+        transfer_sem = hal_sem_create(true);
+        if (transfer_sem == NULL) {
+            return false;
+        }
+    }
     
-    i2c_handle = I2C_open(0, &i2cParams);
-    if (i2c_handle == NULL) {
+    // Open I2C, fast mode (already open for the second sensor)
+    if (!hal_i2c_open(I2C_CLOCK_SPEED)) {
         return false;  // rip
     }
     
     // Check device ID
     uint8_t devid;
-    if (!read_registers(ADXL345_REG_DEVID, &devid, 1)) {
+    if (!read_registers(dev, ADXL345_REG_DEVID, &devid, 1)) {
         return false;
     }
     
@@ -62,38 +108,42 @@ bool adxl345_init(void) {
     
     // Set data format: full resolution, +/- 16g range
     // full res gives us 4mg/LSB regardless of range which is nice
-    if (!write_register(ADXL345_REG_DATA_FORMAT, ADXL345_FULL_RES | ADXL345_RANGE_16G)) {
+    if (!write_register(dev, ADXL345_REG_DATA_FORMAT, ADXL345_FULL_RES | ADXL345_RANGE_16G)) {
         return false;
     }
     
     // Set bandwidth/output data rate to 100Hz
     // BW_RATE register: 0x0A = 100Hz
-    if (!write_register(ADXL345_REG_BW_RATE, 0x0A)) {
+    if (!write_register(dev, ADXL345_REG_BW_RATE, 0x0A)) {
         return false;
     }
     
     // Enable measurement mode
-    if (!write_register(ADXL345_REG_POWER_CTL, ADXL345_MEASURE)) {
+    if (!write_register(dev, ADXL345_REG_POWER_CTL, ADXL345_MEASURE)) {
         return false;
     }
     
-    usleep(10000);  // give it a moment to start up
+    hal_delay_ms(10);  // give it a moment to start up
     
     return true;
 }
 
-bool adxl345_read_data(accel_data_t *data) {
+// Combine DATAX0..DATAZ1 bytes (little-endian)
+static void decode_sample(const uint8_t *buffer, accel_data_t *data) {
+    data->x = (int16_t)((buffer[1] << 8) | buffer[0]);
+    data->y = (int16_t)((buffer[3] << 8) | buffer[2]);
+    data->z = (int16_t)((buffer[5] << 8) | buffer[4]);
+}
+
+bool adxl345_read_data(adxl345_t *dev, accel_data_t *data) {
     uint8_t buffer[6];
     
     // Read all 6 bytes (X, Y, Z as 16-bit values)
-    if (!read_registers(ADXL345_REG_DATAX0, buffer, 6)) {
+    if (!read_registers(dev, ADXL345_REG_DATAX0, buffer, 6)) {
         return false;
     }
     
-    // Combine bytes (little-endian)
-    data->x = (int16_t)((buffer[1] << 8) | buffer[0]);
-    data->y = (int16_t)((buffer[3] << 8) | buffer[2]);
-    data->z = (int16_t)((buffer[5] << 8) | buffer[4]);
+    decode_sample(buffer, data);
     
     return true;
 }
@@ -101,13 +151,195 @@ bool adxl345_read_data(accel_data_t *data) {
 float adxl345_convert_to_g(int16_t raw_value) {
     // In full resolution mode, scale factor is 4 mg/LSB
     // so multiply by 0.004 to get g's
-    return raw_value * 0.004f;
+    return raw_value * ADXL345_SCALE_G;
 }
 
-bool adxl345_test_connection(void) {
+bool adxl345_test_connection(adxl345_t *dev) {
     uint8_t devid;
-    if (!read_registers(ADXL345_REG_DEVID, &devid, 1)) {
+    if (!read_registers(dev, ADXL345_REG_DEVID, &devid, 1)) {
         return false;
     }
     return (devid == ADXL345_DEVICE_ID);
 }
+
+static void int1_isr(uint8_t index) {
+    adxl345_t *dev = index < HAL_GPIO_MAX ? int_devices[index] : NULL;
+    if (dev != NULL && dev->int1_callback != NULL) {
+        dev->int1_callback(dev);
+    }
+}
+
+// Flush the FIFO and (re)start stream mode with the watermark interrupt
+static bool configure_fifo(adxl345_t *dev, uint8_t watermark) {
+    if (watermark == 0 || watermark > ADXL345_FIFO_SAMPLES_MASK) {
+        return false;
+    }
+    
+    // Interrupts off and FIFO flushed (bypass mode) while reconfiguring
+    if (!write_register(dev, ADXL345_REG_INT_ENABLE, 0) ||
+        !write_register(dev, ADXL345_REG_FIFO_CTL, ADXL345_FIFO_MODE_BYPASS)) {
+        return false;
+    }
+    
+    // Stream mode: keeps the newest 32 samples, watermark when `watermark` are waiting
+    if (!write_register(dev, ADXL345_REG_FIFO_CTL, ADXL345_FIFO_MODE_STREAM | watermark)) {
+        return false;
+    }
+    
+    return write_register(dev, ADXL345_REG_INT_ENABLE, ADXL345_INT_WATERMARK);
+}
+
+bool adxl345_fifo_init(adxl345_t *dev, uint8_t watermark, adxl345_int1_callback_t callback) {
+    if (dev->int_gpio >= HAL_GPIO_MAX) {
+        return false;
+    }
+    dev->int1_callback = callback;
+    int_devices[dev->int_gpio] = dev;
+    
+    // All interrupts go to INT1 (INT_MAP bit = 0)
+    if (!write_register(dev, ADXL345_REG_INT_MAP, 0)) {
+        return false;
+    }
+    
+    if (!hal_gpio_enable_int(dev->int_gpio, int1_isr)) {
+        return false;
+    }
+    
+    return configure_fifo(dev, watermark);
+}
+
+bool adxl345_start_fifo_read(adxl345_t *dev, size_t max, adxl345_read_callback_t done) {
+    uint8_t status;
+    if (dev->fifo_queuing || dev->fifo_completed != dev->fifo_queued) {
+        return false;  // previous read still in flight
+    }
+    if (!read_registers(dev, ADXL345_REG_FIFO_STATUS, &status, 1)) {
+        return false;
+    }
+    
+    size_t entries = status & ADXL345_FIFO_ENTRIES_MASK;
+    if (entries > max) {
+        entries = max;
+    }
+    if (entries > ADXL345_FIFO_SIZE) {
+        entries = ADXL345_FIFO_SIZE;
+    }
+    if (entries == 0) {
+        return false;
+    }
+    
+    // Each 6-byte read of DATAX0..DATAZ1 pops one FIFO entry. The chip won't
+    // auto-increment past DATAZ1 into the next entry, so this is one short
+    // transaction per sample. They all go in the driver's queue now and run
+    // back to back without waking us. (The datasheet wants 5us between
+    // entries; the I2C start/address phase alone is longer.)
+    dev->fifo_done = done;
+    dev->fifo_completed = 0;
+    dev->fifo_good = 0;
+    dev->fifo_failed = false;
+    dev->fifo_queued = 0;
+    dev->fifo_queuing = true;
+    
+    for (size_t i = 0; i < entries; i++) {
+        hal_i2c_transaction_t *t = &dev->fifo_transactions[i];
+        t->write_buf = &fifo_reg;
+        t->write_count = 1;
+        t->read_buf = dev->fifo_raw[i];
+        t->read_count = 6;
+        t->address = dev->address;
+        t->callback = fifo_callback;
+        t->context = dev;
+        
+        if (!hal_i2c_queue(t)) {
+            break;
+        }
+        dev->fifo_queued++;
+    }
+    
+    // transactions may all have finished while we were still queueing
+    uintptr_t key = hal_irq_disable();
+    dev->fifo_queuing = false;
+    bool finished = (dev->fifo_completed == dev->fifo_queued);
+    hal_irq_restore(key);
+    
+    if (dev->fifo_queued == 0) {
+        return false;
+    }
+    if (finished) {
+        done(dev);
+    }
+    return true;
+}
+
+size_t adxl345_finish_fifo_read(adxl345_t *dev, accel_data_t *out) {
+    for (size_t i = 0; i < dev->fifo_good; i++) {
+        decode_sample(dev->fifo_raw[i], &out[i]);
+    }
+    return dev->fifo_good;
+}
+
+void adxl345_cancel_fifo_read(adxl345_t *dev) {
+    (void)dev;
+    // completes everything queued with a failed status, which calls done
+    hal_i2c_cancel();
+}
+
+bool adxl345_set_rate(adxl345_t *dev, uint16_t rate_hz, bool low_power) {
+    // each rate code step halves the rate, 0x0A = 100Hz
+    uint8_t code = ADXL345_RATE_100HZ;
+    for (uint16_t r = 100; r > rate_hz && code > 0x07; r /= 2) {
+        code--;
+    }
+    
+    if (low_power) {
+        code |= ADXL345_LOW_POWER;
+    }
+    
+    return write_register(dev, ADXL345_REG_BW_RATE, code);
+}
+
+bool adxl345_enable_activity_wake(adxl345_t *dev, uint8_t threshold) {
+    uint8_t source;
+    
+    // FIFO and watermark off, nothing to buffer while we sleep
+    if (!write_register(dev, ADXL345_REG_INT_ENABLE, 0) ||
+        !write_register(dev, ADXL345_REG_FIFO_CTL, ADXL345_FIFO_MODE_BYPASS)) {
+        return false;
+    }
+    
+    // 12.5Hz is plenty to notice a machine starting up
+    if (!adxl345_set_rate(dev, 12, true)) {
+        return false;
+    }
+    
+    if (!write_register(dev, ADXL345_REG_THRESH_ACT, threshold) ||
+        !write_register(dev, ADXL345_REG_ACT_INACT_CTL, ADXL345_ACT_AC_XYZ)) {
+        return false;
+    }
+    
+    // clear anything latched
+    if (!read_registers(dev, ADXL345_REG_INT_SOURCE, &source, 1)) {
+        return false;
+    }
+    
+    return write_register(dev, ADXL345_REG_INT_ENABLE, ADXL345_INT_ACTIVITY);
+}
+
+bool adxl345_activity_detected(adxl345_t *dev) {
+    // INT1 may still be a late watermark from before we went to sleep, so
+    // check what actually fired. Reading INT_SOURCE also clears the latched activity bit
+    uint8_t source;
+    if (!read_registers(dev, ADXL345_REG_INT_SOURCE, &source, 1)) {
+        return false;
+    }
+    return (source & ADXL345_INT_ACTIVITY) != 0;
+}
+
+bool adxl345_resume_fifo(adxl345_t *dev, uint8_t watermark, uint16_t rate_hz) {
+    if (!write_register(dev, ADXL345_REG_INT_ENABLE, 0) ||
+        !adxl345_set_rate(dev, rate_hz, rate_hz < SAMPLE_RATE_HZ)) {
+        return false;
+    }
+    
+    return configure_fifo(dev, watermark);
+}
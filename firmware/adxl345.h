@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
 
 // ADXL345 Register Map
 #define ADXL345_REG_DEVID 0x00
@@ -12,10 +14,37 @@
 #define ADXL345_REG_DATAX0 0x32
 #define ADXL345_REG_DATAY0 0x34
 #define ADXL345_REG_DATAZ0 0x36
+#define ADXL345_REG_INT_ENABLE 0x2E
+#define ADXL345_REG_INT_MAP 0x2F
+#define ADXL345_REG_INT_SOURCE 0x30
+#define ADXL345_REG_THRESH_ACT 0x24
+#define ADXL345_REG_ACT_INACT_CTL 0x27
+#define ADXL345_REG_FIFO_CTL 0x38
+#define ADXL345_REG_FIFO_STATUS 0x39
 
 // Power Control bits
 #define ADXL345_MEASURE (1 << 3)
 
+// Interrupt bits (INT_ENABLE / INT_MAP / INT_SOURCE)
+#define ADXL345_INT_DATA_READY (1 << 7)
+#define ADXL345_INT_ACTIVITY (1 << 4)
+#define ADXL345_INT_WATERMARK (1 << 1)
+#define ADXL345_INT_OVERRUN (1 << 0)
+
+// FIFO_CTL: mode in bits 7:6, watermark (samples) in bits 4:0
+#define ADXL345_FIFO_MODE_BYPASS (0 << 6)
+#define ADXL345_FIFO_MODE_STREAM (2 << 6)
+#define ADXL345_FIFO_SAMPLES_MASK 0x1F
+#define ADXL345_FIFO_ENTRIES_MASK 0x3F  // FIFO_STATUS
+#define ADXL345_FIFO_SIZE 32
+
+// BW_RATE: rate code in bits 3:0 (0x0A = 100Hz, each step down halves it)
+#define ADXL345_RATE_100HZ 0x0A
+#define ADXL345_LOW_POWER (1 << 4)
+
+// ACT_INACT_CTL: ac-coupled activity on all three axes
+#define ADXL345_ACT_AC_XYZ 0xF0
+
 // Data format bits
 #define ADXL345_FULL_RES (1 << 3)
 #define ADXL345_RANGE_16G 0x03
@@ -23,6 +52,9 @@
 // Device ID
 #define ADXL345_DEVICE_ID 0xE5
 
+// Full resolution scale factor: 4 mg/LSB on every range
+#define ADXL345_SCALE_G 0.004f
+
 // Acceleration data structure
 typedef struct {
     int16_t x;
@@ -30,10 +62,65 @@ typedef struct {
     int16_t z;
 } accel_data_t;
 
+// One ADXL345. Several can share the I2C bus (0x53 and 0x1D, picked with
+// the SDO/ALT ADDRESS pin), each with its own INT1 line. Everything the
+// driver keeps per sensor is in here, so a node can run one per sensor;
+// register access from one task at a time.
+typedef struct adxl345 adxl345_t;
+
+// Runs in interrupt context on every INT1 rising edge
+typedef void (*adxl345_int1_callback_t)(adxl345_t *dev);
+
+// Runs in interrupt context when a queued FIFO read has finished
+typedef void (*adxl345_read_callback_t)(adxl345_t *dev);
+
+struct adxl345 {
+    uint8_t address;
+    uint8_t int_gpio;         // hal GPIO index wired to INT1
+    adxl345_int1_callback_t int1_callback;
+
+    // queued FIFO read, one transaction per entry
+    hal_i2c_transaction_t fifo_transactions[ADXL345_FIFO_SIZE];
+    uint8_t fifo_raw[ADXL345_FIFO_SIZE][6];
+    size_t fifo_queued;
+    volatile size_t fifo_completed;
+    volatile size_t fifo_good;      // entries read before the first failure
+    volatile bool fifo_failed;
+    volatile bool fifo_queuing;
+    adxl345_read_callback_t fifo_done;
+};
+
 // Function prototypes
-bool adxl345_init(void);
-bool adxl345_read_data(accel_data_t *data);
+bool adxl345_init(adxl345_t *dev, uint8_t address, uint8_t int_gpio);
+bool adxl345_read_data(adxl345_t *dev, accel_data_t *data);
 float adxl345_convert_to_g(int16_t raw_value);
-bool adxl345_test_connection(void);
+bool adxl345_test_connection(adxl345_t *dev);
+
+// FIFO stream mode: the sensor buffers samples itself and raises INT1 when
+// `watermark` (1-31) samples are waiting, so the MCU can sleep in between
+bool adxl345_fifo_init(adxl345_t *dev, uint8_t watermark, adxl345_int1_callback_t callback);
+
+// Non-blocking FIFO drain: queues one I2C read per waiting entry (up to
+// max) and returns straight away; `done` runs in interrupt context once the
+// last one completes. Then adxl345_finish_fifo_read copies out the samples
+// that were read successfully. Returns false if nothing was queued (FIFO
+// empty, I2C error or a read already in flight). Reads of different
+// sensors can be in flight at the same time, they queue up on the bus.
+bool adxl345_start_fifo_read(adxl345_t *dev, size_t max, adxl345_read_callback_t done);
+size_t adxl345_finish_fifo_read(adxl345_t *dev, accel_data_t *out);
+// Fails everything queued on the bus, other sensors' reads included
+void adxl345_cancel_fifo_read(adxl345_t *dev);
+
+// Output data rate, 100/50/25/12Hz (12 = 12.5Hz). low_power trades a bit of
+// noise for lower sensor current.
+bool adxl345_set_rate(adxl345_t *dev, uint16_t rate_hz, bool low_power);
+
+// Deep sleep support: stop the FIFO, drop to 12.5Hz low power and raise INT1
+// on motion above `threshold` (62.5 mg/LSB, ac-coupled). After INT1,
+// adxl345_activity_detected says whether it was really that (and clears it);
+// adxl345_resume_fifo goes back to streaming.
+bool adxl345_enable_activity_wake(adxl345_t *dev, uint8_t threshold);
+bool adxl345_activity_detected(adxl345_t *dev);
+bool adxl345_resume_fifo(adxl345_t *dev, uint8_t watermark, uint16_t rate_hz);
 
 #endif // ADXL345_H
@@ -6,12 +6,53 @@
 
 // Device Configuration
 #define NODE_ID 0x0001  // change this for each device
-#define DEVICE_TYPE_END_DEVICE  // or DEVICE_TYPE_COORDINATOR
+#ifndef DEVICE_TYPE_COORDINATOR
+#define DEVICE_TYPE_END_DEVICE  // or DEVICE_TYPE_COORDINATOR (make coordinator)
+#endif
 
 // Sampling Configuration
 #define SAMPLE_RATE_HZ 100
 #define SAMPLE_PERIOD_MS (1000 / SAMPLE_RATE_HZ)
+#ifndef BUFFER_SIZE
 #define BUFFER_SIZE 128  // power of 2 for FFT
+#endif
+
+// Sliding window: analyse the last BUFFER_SIZE samples every ANALYSIS_HOP_SIZE
+// new samples (32 = every 0.32s at 100Hz). BUFFER_SIZE gives non-overlapping windows.
+#ifndef ANALYSIS_HOP_SIZE
+#define ANALYSIS_HOP_SIZE 32
+#endif
+
+// Analysis arithmetic
+// 0 = float pipeline (samples converted to g's)
+// 1 = Q15/Q31 integer pipeline on raw ADXL345 counts (half the buffer RAM, no FPU)
+#ifndef ANALYSIS_FIXED_POINT
+#define ANALYSIS_FIXED_POINT 0
+#endif
+
+// Spectral engine
+// FFT:  full spectrum once per hop, classify on the peak frequency
+// SDFT: sliding DFT of only the washing/spinning band bins, updated every
+//       sample, classify on band energies (much cheaper for 2 bands)
+#define SPECTRAL_ENGINE_FFT 0
+#define SPECTRAL_ENGINE_SDFT 1
+#ifndef SPECTRAL_ENGINE
+#define SPECTRAL_ENGINE SPECTRAL_ENGINE_FFT
+#endif
+
+// Zoom analysis (FFT engine): the magnitude is low-pass filtered and
+// decimated by ZOOM_DECIMATION as it comes in, and the FFT runs on the last
+// ZOOM_FFT_SIZE decimated samples. 4 and 128 at 100Hz: 0.2Hz bins over
+// 0-12.5Hz from a 5.1s window, instead of 0.78Hz over 0-50Hz; the bands
+// above 12.5Hz read empty. The RMS still comes from the BUFFER_SIZE window.
+// Lower sample rates decimate less and keep the decimated rate (and the
+// window) as it is. 1 = off; 2, 4 or 8 (filters in zoom_tables.c).
+#ifndef ZOOM_DECIMATION
+#define ZOOM_DECIMATION 1
+#endif
+#ifndef ZOOM_FFT_SIZE
+#define ZOOM_FFT_SIZE 128  // power of 2 up to FFT_TABLE_SIZE, 256 needs a bigger analysis stack
+#endif
 
 // Vibration Thresholds (in g's)
 #define IDLE_THRESHOLD 0.1
@@ -19,6 +60,33 @@
 #define WASHING_MAX 0.8
 #define SPINNING_MIN 1.5
 
+// Frequency bands (Hz)
+#define WASHING_FREQ_MIN 2.0f  // agitator
+#define WASHING_FREQ_MAX 4.0f
+#define SPINNING_FREQ_MIN 6.0f  // drum
+#define SPINNING_FREQ_MAX 12.0f
+#define BAND_DOMINANCE 0.25f  // share of vibration energy for a band to count (SDFT engine)
+
+// Spectral feature vector (FFT engine): vibration energy in 8 roughly
+// logarithmic bands, edges on the washing/spinning bands, plus the spectral
+// centroid. Sent in PKT_TYPE_FEATURES frames instead of the peak frequency
+// so the backend can classify on more than the argmax (telemetry.h).
+#define FEATURE_BAND_EDGES_HZ { 0.0f, 1.0f, 2.0f, 4.0f, 6.0f, 9.0f, 12.0f, 25.0f, 50.0f }
+#ifndef TELEMETRY_FEATURES
+#define TELEMETRY_FEATURES (SPECTRAL_ENGINE == SPECTRAL_ENGINE_FFT)
+#endif
+
+// State tracking (state_tracker.h): smooths the per-window classification
+// into IDLE -> WASHING <-> SPINNING -> DONE -> IDLE. Quiet this long ends
+// the cycle (longer after washing, which has soaks and pauses), and DONE
+// turns back into IDLE after TRACKER_DONE_HOLD_MS or when someone unloads.
+#ifndef STATE_TRACKER_ENABLE
+#define STATE_TRACKER_ENABLE 1
+#endif
+#define TRACKER_DONE_AFTER_WASH_MS 600000  // 10 min
+#define TRACKER_DONE_AFTER_SPIN_MS 120000  // 2 min
+#define TRACKER_DONE_HOLD_MS 1800000  // 30 min
+
 // Zigbee Network Config
 #define ZIGBEE_CHANNEL 15  // 2.4GHz channel (11-26)
 #define ZIGBEE_PAN_ID 0xFACE  // lol
@@ -26,14 +94,95 @@
 
 // I2C Configuration
 #define I2C_CLOCK_SPEED 400000  // 400kHz
-#define ADXL345_ADDR 0x53  // default I2C address
+#define ADXL345_ADDR 0x53  // default I2C address (SDO/ALT ADDRESS to GND)
+#define ADXL345_ADDR_ALT 0x1D  // SDO/ALT ADDRESS to VDDIO
+#define ADXL345_INT_GPIO 0  // GPIO driver index wired to ADXL345 INT1 (DIO7)
+#define ADXL345_ALT_INT_GPIO 1  // second sensor's INT1 (DIO8)
+
+// Sensors per node: 2 for a stacked washer/dryer pair on one node, both on
+// the same bus. Each gets its own analysis, state tracking, power mode and
+// telemetry frames (sensor sub-id in the frame flags, telemetry.h).
+#ifndef SENSOR_COUNT
+#define SENSOR_COUNT 1
+#endif
+#define SENSOR_ADDRESSES { ADXL345_ADDR, ADXL345_ADDR_ALT }
+#define SENSOR_INT_GPIOS { ADXL345_INT_GPIO, ADXL345_ALT_INT_GPIO }
+
+// ADXL345 FIFO: let the sensor buffer samples and wake us on a watermark
+// interrupt instead of polling every SAMPLE_PERIOD_MS
+#define ADXL345_USE_FIFO 1
+#define ADXL345_FIFO_WATERMARK 25  // samples per wakeup (max 31), 250ms at 100Hz
+
+// Power management: drop the sample rate while nothing is happening and
+// deep sleep (ADXL345 activity wake) once the machine has been idle a while.
+// Needs ADXL345_USE_FIFO.
+#ifndef POWER_MANAGEMENT_ENABLE
+#define POWER_MANAGEMENT_ENABLE 1
+#endif
+#define POWER_REDUCED_RATE_HZ 50  // 50Hz still covers the 6-12Hz spin band
+#define POWER_REDUCE_AFTER_MS 10000  // no washing/spinning for 10 sec
+#define POWER_SLEEP_AFTER_MS 120000  // IDLE for 2 min
+#define POWER_WAKE_THRESHOLD 2  // ADXL345 THRESH_ACT, 62.5 mg/LSB (0.125g)
+
+// TI-RTOS tasks (higher priority number runs first). Acquisition preempts
+// analysis, analysis preempts the radio, so sampling never waits on either.
+#define TASK_ACQ_PRIORITY 3
+#define TASK_ACQ_STACK_SIZE 1024
+#define TASK_ANALYSIS_PRIORITY 2
+#define TASK_ANALYSIS_STACK_SIZE 2048  // FFT window + spectrum live on the stack
+#define TASK_TX_PRIORITY 1
+#define TASK_TX_STACK_SIZE 1024
+#define TX_QUEUE_DEPTH (8 * SENSOR_COUNT)  // results/heartbeats waiting for the radio
+#define TASK_STATS_INTERVAL_MS 60000  // stack/CPU usage report, PKT_TYPE_TASKS (profile.h)
+
+// Stage profiling: cycle counts of the sensor read, analysis stages and
+// radio send, reported in a PKT_TYPE_PROFILE extended heartbeat (profile.h)
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE 1
+#endif
+#define PROFILE_REPORT_INTERVAL_MS 600000  // 10 min
+#define CPU_CLOCK_HZ 48000000  // CC2652 M4, DWT cycle counter rate
 
 // Timing
-#define TRANSMIT_INTERVAL_MS 5000  // send data every 5 seconds
+#define TRANSMIT_INTERVAL_MS 5000  // one report every 5 seconds
 #define HEARTBEAT_INTERVAL_MS 30000  // 30 sec keepalive
 
-// Debug
+// Telemetry batching: reports are coalesced into one radio frame, sent when
+// TELEMETRY_BATCH_MAX are queued, the oldest has waited HEARTBEAT_INTERVAL_MS,
+// or straight away on a state change. Every frame doubles as the heartbeat.
+#define TELEMETRY_BATCH_MAX 6  // 6 x 5 sec = one frame per 30 sec while nothing changes
+
+// Reliable delivery (outbox.h): frames with reports are sent again until the
+// backend ACKs them; reports wait in a RAM ring per sensor meanwhile, thinned
+// out rather than dropped when it fills up
+#define OUTBOX_DEPTH 256  // reports per sensor, 21 min at TRANSMIT_INTERVAL_MS before thinning
+#define OUTBOX_ACK_TIMEOUT_MS 2000  // first retry, doubles from there
+#define OUTBOX_RETRY_MAX_MS 60000
+
+// Coordinator (coordinator.h): the nodes' packets go to the backend several
+// to a PKT_TYPE_AGGREGATE frame, paced to the UART, heartbeats folded into a
+// PKT_TYPE_NODES list
+#define COORDINATOR_NODE_SLOTS 512  // node table, power of 2, 12 KB
+#define COORDINATOR_MAX_NODES (COORDINATOR_NODE_SLOTS * 3 / 4)  // then the stalest is forgotten
+#define COORDINATOR_QUEUE_BYTES 4096  // waiting for the UART, 0.36 s of it at 115200
+#define COORDINATOR_FLUSH_MS 50  // longest a packet waits for others to share a frame
+#define COORDINATOR_STATUS_INTERVAL_MS HEARTBEAT_INTERVAL_MS
+#define COORDINATOR_RX_DEPTH 16  // packets from the radio/UART waiting for the task
+#define TASK_COORD_PRIORITY 1
+#define TASK_COORD_STACK_SIZE 1536
+
+// Debug / host link (framed packets to the backend, see host_link.h)
+#ifndef DEBUG_UART_ENABLE
 #define DEBUG_UART_ENABLE 1
+#endif
 #define DEBUG_BAUD_RATE 115200
+#define HOST_UART_INDEX 0  // UART2 driver index of the USB serial port
+
+// Raw sample capture: stream every sample over the host link for
+// tools/trace_record (see trace_capture.h). Records at one fixed rate, so
+// needs POWER_MANAGEMENT_ENABLE 0.
+#ifndef TRACE_CAPTURE_ENABLE
+#define TRACE_CAPTURE_ENABLE 0
+#endif
 
 #endif // CONFIG_H
@@ -0,0 +1,383 @@
+#include "coordinator.h"
+#include "frame_codec.h"
+#include "zigbee_handler.h"
+#include <string.h>
+
+_Static_assert((COORDINATOR_NODE_SLOTS & (COORDINATOR_NODE_SLOTS - 1)) == 0, "node slots a power of 2");
+_Static_assert(COORDINATOR_QUEUE_BYTES <= UINT16_MAX, "queue offsets are 16 bits");
+
+#define RECORD_HEADER 5       // received_ms, length
+#define AGGREGATE_ROOM (FRAME_PAYLOAD_MAX - COORDINATOR_HEADER_SIZE - 2)
+#define STATUS_ENTRY_MAX (2 + 1 + 5)
+
+void coordinator_init(coordinator_t *coord, uint32_t now_ms) {
+    memset(coord, 0, sizeof(*coord));
+    coord->link_free_ms = now_ms;
+    coord->status_ms = now_ms + COORDINATOR_STATUS_INTERVAL_MS;
+}
+
+/* Node table -------------------------------------------------------------- */
+
+static uint16_t home_slot(uint16_t node_id) {
+    return (uint16_t)(((uint32_t)node_id * 2654435761u >> 16) & (COORDINATOR_NODE_SLOTS - 1));
+}
+
+static int find_slot(const coordinator_t *coord, uint16_t node_id) {
+    for (uint16_t i = home_slot(node_id);; i = (i + 1) & (COORDINATOR_NODE_SLOTS - 1)) {
+        if (!coord->nodes[i].used) {
+            return -1;
+        }
+        if (coord->nodes[i].node_id == node_id) {
+            return i;
+        }
+    }
+}
+
+// Backward shift: entries after the hole that would have landed in it move
+// up, so lookups never stop early at a gap
+static void remove_slot(coordinator_t *coord, uint16_t hole) {
+    uint16_t i = hole;
+
+    while (true) {
+        i = (i + 1) & (COORDINATOR_NODE_SLOTS - 1);
+        if (!coord->nodes[i].used) {
+            break;
+        }
+        uint16_t home = home_slot(coord->nodes[i].node_id);
+        // move it unless its home lies cyclically in (hole, i]
+        if (((i - home) & (COORDINATOR_NODE_SLOTS - 1)) >= ((i - hole) & (COORDINATOR_NODE_SLOTS - 1))) {
+            coord->nodes[hole] = coord->nodes[i];
+            hole = i;
+        }
+    }
+    coord->nodes[hole].used = false;
+    coord->node_count--;
+}
+
+static coordinator_node_t *node_for(coordinator_t *coord, uint16_t node_id, uint32_t now_ms) {
+    int slot = find_slot(coord, node_id);
+    if (slot >= 0) {
+        return &coord->nodes[slot];
+    }
+
+    if (coord->node_count >= COORDINATOR_MAX_NODES) {
+        // forget whoever has been quiet longest
+        uint16_t stalest = 0;
+        uint32_t age = 0;
+        for (uint16_t i = 0; i < COORDINATOR_NODE_SLOTS; i++) {
+            if (coord->nodes[i].used && now_ms - coord->nodes[i].last_seen_ms >= age) {
+                age = now_ms - coord->nodes[i].last_seen_ms;
+                stalest = i;
+            }
+        }
+        remove_slot(coord, stalest);
+        coord->stats.untracked++;
+    }
+
+    uint16_t i = home_slot(node_id);
+    while (coord->nodes[i].used) {
+        i = (i + 1) & (COORDINATOR_NODE_SLOTS - 1);
+    }
+    coordinator_node_t *node = &coord->nodes[i];
+    memset(node, 0, sizeof(*node));
+    node->used = true;
+    node->node_id = node_id;
+    coord->node_count++;
+    return node;
+}
+
+const coordinator_node_t *coordinator_find(const coordinator_t *coord, uint16_t node_id) {
+    int slot = find_slot(coord, node_id);
+    return slot >= 0 ? &coord->nodes[slot] : NULL;
+}
+
+/* Queue ------------------------------------------------------------------- */
+
+static void ring_write(coordinator_t *coord, uint16_t at, const void *data, uint16_t length) {
+    uint16_t first = COORDINATOR_QUEUE_BYTES - at < length ? COORDINATOR_QUEUE_BYTES - at : length;
+    memcpy(&coord->queue[at], data, first);
+    memcpy(coord->queue, (const uint8_t *)data + first, length - first);
+}
+
+static void ring_read(const coordinator_t *coord, uint16_t at, void *data, uint16_t length) {
+    uint16_t first = COORDINATOR_QUEUE_BYTES - at < length ? COORDINATOR_QUEUE_BYTES - at : length;
+    memcpy(data, &coord->queue[at], first);
+    memcpy((uint8_t *)data + first, coord->queue, length - first);
+}
+
+static uint16_t ring_at(const coordinator_t *coord, uint16_t offset) {
+    return (uint16_t)((coord->head + offset) % COORDINATOR_QUEUE_BYTES);
+}
+
+// The record `offset` bytes into the queue
+static void peek(const coordinator_t *coord, uint16_t offset, uint32_t *received_ms, uint8_t *length) {
+    uint8_t header[RECORD_HEADER];
+
+    ring_read(coord, ring_at(coord, offset), header, RECORD_HEADER);
+    memcpy(received_ms, header, 4);
+    *length = header[4];
+}
+
+static void pop(coordinator_t *coord, uint8_t *packet, uint8_t *length, uint32_t *received_ms) {
+    peek(coord, 0, received_ms, length);
+    ring_read(coord, ring_at(coord, RECORD_HEADER), packet, *length);
+    coord->head = ring_at(coord, RECORD_HEADER + *length);
+    coord->used -= RECORD_HEADER + *length;
+    coord->queued--;
+}
+
+static size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static size_t finish(uint8_t *out, uint8_t *p, uint8_t type, uint32_t now_ms, uint8_t count) {
+    out[0] = type;
+    memcpy(&out[1], &now_ms, 4);
+    out[5] = count;
+
+    uint16_t crc = frame_crc16(out, (size_t)(p - out));
+    *p++ = (uint8_t)crc;
+    *p++ = (uint8_t)(crc >> 8);
+    return (size_t)(p - out);
+}
+
+/* Nodes -> host ----------------------------------------------------------- */
+
+static bool telemetry_frame(const uint8_t *packet, size_t length) {
+    return (packet[0] == PKT_TYPE_BATCH || packet[0] == PKT_TYPE_FEATURES) && length >= 13;
+}
+
+bool coordinator_receive(coordinator_t *coord, const uint8_t *packet, size_t length,
+                         uint16_t address, uint8_t lqi, uint32_t now_ms) {
+    // every node packet is type, node id, ..., CRC-16
+    if (length < 5 || length > FRAME_PAYLOAD_MAX ||
+        frame_crc16(packet, length - 2) != (uint16_t)(packet[length - 2] | packet[length - 1] << 8)) {
+        coord->stats.corrupt++;
+        return false;
+    }
+    coord->stats.received++;
+
+    coordinator_node_t *node = node_for(coord, (uint16_t)(packet[1] | packet[2] << 8), now_ms);
+    node->lqi = node->packets == 0 ? lqi : (uint8_t)((3 * node->lqi + lqi + 2) / 4);
+    node->address = address;
+    node->last_seen_ms = now_ms;
+    node->heard = true;
+    node->packets++;
+
+    bool heartbeat = packet[0] == PKT_TYPE_HEARTBEAT;
+    if (telemetry_frame(packet, length)) {
+        uint16_t seq = (uint16_t)(packet[9] | packet[10] << 8);
+        heartbeat = packet[4] == 0;
+        if (!heartbeat) {
+            if (seq == node->last_seq) {
+                node->retries++;
+            }
+            node->last_seq = seq;
+        }
+    }
+    if (heartbeat) {
+        // the next PKT_TYPE_NODES says it was heard
+        coord->stats.absorbed++;
+        return true;
+    }
+
+    if (coord->used + RECORD_HEADER + length > COORDINATOR_QUEUE_BYTES) {
+        coord->stats.dropped++;
+        return false;
+    }
+
+    uint8_t header[RECORD_HEADER];
+    memcpy(header, &now_ms, 4);
+    header[4] = (uint8_t)length;
+    ring_write(coord, ring_at(coord, coord->used), header, RECORD_HEADER);
+    ring_write(coord, ring_at(coord, coord->used + RECORD_HEADER), packet, (uint16_t)length);
+    coord->used += RECORD_HEADER + length;
+    coord->queued++;
+    if (coord->used > coord->stats.queue_max) {
+        coord->stats.queue_max = coord->used;
+    }
+    return true;
+}
+
+// Packets from the head that fit one aggregate, 0 if the first never will
+static uint8_t fits(const coordinator_t *coord, uint32_t now_ms, bool *more) {
+    size_t size = 0;
+    uint16_t offset = 0;
+    uint8_t count = 0;
+
+    *more = false;
+    while (count < coord->queued && count < UINT8_MAX) {
+        uint32_t received_ms;
+        uint8_t length;
+
+        peek(coord, offset, &received_ms, &length);
+        size_t entry = varint_size(now_ms - received_ms) + 1 + length;
+        if (size + entry > AGGREGATE_ROOM) {
+            *more = true;
+            break;
+        }
+        size += entry;
+        offset += RECORD_HEADER + length;
+        count++;
+    }
+    return count;
+}
+
+// ms until the queue should go out, UINT32_MAX for empty
+static uint32_t queue_due_in(const coordinator_t *coord, uint32_t now_ms) {
+    uint32_t received_ms;
+    uint8_t length;
+    bool more;
+
+    if (coord->queued == 0) {
+        return UINT32_MAX;
+    }
+    if (fits(coord, now_ms, &more) == 0 || more) {
+        return 0;
+    }
+    peek(coord, 0, &received_ms, &length);
+    uint32_t age = now_ms - received_ms;
+    return age >= COORDINATOR_FLUSH_MS ? 0 : COORDINATOR_FLUSH_MS - age;
+}
+
+static size_t build_aggregate(coordinator_t *coord, uint32_t now_ms, uint8_t count, uint8_t *out) {
+    uint8_t *p = out + COORDINATOR_HEADER_SIZE;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t received_ms;
+        uint8_t length;
+
+        peek(coord, 0, &received_ms, &length);
+        p = put_varint(p, now_ms - received_ms);
+        *p++ = length;
+        pop(coord, p, &length, &received_ms);
+        p += length;
+    }
+
+    coord->stats.aggregates++;
+    coord->stats.aggregated += count;
+    return finish(out, p, PKT_TYPE_AGGREGATE, now_ms, count);
+}
+
+// The next PKT_TYPE_NODES of the round, 0 once it has listed everyone heard
+static size_t build_status(coordinator_t *coord, uint32_t now_ms, uint8_t *out) {
+    uint8_t *p = out + COORDINATOR_HEADER_SIZE;
+    uint8_t count = 0;
+
+    while (coord->status_cursor < COORDINATOR_NODE_SLOTS &&
+           (size_t)(p - out) + STATUS_ENTRY_MAX + 2 <= FRAME_PAYLOAD_MAX) {
+        coordinator_node_t *node = &coord->nodes[coord->status_cursor++];
+        if (!node->used || !node->heard) {
+            continue;
+        }
+        node->heard = false;
+        *p++ = (uint8_t)node->node_id;
+        *p++ = (uint8_t)(node->node_id >> 8);
+        *p++ = node->lqi;
+        p = put_varint(p, now_ms - node->last_seen_ms);
+        count++;
+    }
+
+    if (coord->status_cursor == COORDINATOR_NODE_SLOTS) {
+        coord->status_pending = false;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    coord->stats.statuses++;
+    return finish(out, p, PKT_TYPE_NODES, now_ms, count);
+}
+
+size_t coordinator_poll(coordinator_t *coord, uint32_t now_ms, uint8_t *out) {
+    size_t length = 0;
+
+    if ((int32_t)(now_ms - coord->link_free_ms) < 0) {
+        return 0;
+    }
+
+    if (!coord->status_pending && (int32_t)(now_ms - coord->status_ms) >= 0) {
+        coord->status_pending = true;
+        coord->status_cursor = 0;
+        coord->status_ms += COORDINATOR_STATUS_INTERVAL_MS;
+        if ((int32_t)(now_ms - coord->status_ms) >= 0) {
+            coord->status_ms = now_ms + COORDINATOR_STATUS_INTERVAL_MS;
+        }
+    }
+
+    // node packets first, the node list can wait for a gap
+    if (queue_due_in(coord, now_ms) == 0) {
+        bool more;
+        uint8_t count = fits(coord, now_ms, &more);
+
+        if (count > 1) {
+            length = build_aggregate(coord, now_ms, count, out);
+        } else {
+            // alone (too big to share, or nothing else came): a frame
+            // around it would only add bytes
+            uint32_t received_ms;
+            uint8_t packet_length;
+
+            pop(coord, out, &packet_length, &received_ms);
+            length = packet_length;
+            coord->stats.unwrapped++;
+        }
+    }
+    while (length == 0 && coord->status_pending) {
+        length = build_status(coord, now_ms, out);
+    }
+
+    if (length > 0) {
+        coord->link_free_ms = now_ms + COORDINATOR_LINK_MS(FRAME_ENCODED_MAX(length));
+    }
+    return length;
+}
+
+uint32_t coordinator_timeout(const coordinator_t *coord, uint32_t now_ms) {
+    uint32_t timeout = queue_due_in(coord, now_ms);
+
+    if (coord->status_pending) {
+        timeout = 0;
+    } else {
+        int32_t status_in = (int32_t)(coord->status_ms - now_ms);
+        uint32_t in = status_in > 0 ? (uint32_t)status_in : 0;
+        if (in < timeout) {
+            timeout = in;
+        }
+    }
+
+    int32_t busy = (int32_t)(coord->link_free_ms - now_ms);
+    if (busy > 0 && timeout < (uint32_t)busy) {
+        timeout = (uint32_t)busy;
+    }
+    return timeout;
+}
+
+/* Host -> nodes ----------------------------------------------------------- */
+
+bool coordinator_route(coordinator_t *coord, const uint8_t *packet, size_t length, uint16_t *address) {
+    if (length < 3) {
+        return false;
+    }
+
+    int slot = find_slot(coord, (uint16_t)(packet[1] | packet[2] << 8));
+    if (slot < 0) {
+        return false;
+    }
+    *address = coord->nodes[slot].address;
+    coord->stats.routed++;
+    return true;
+}
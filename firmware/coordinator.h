@@ -0,0 +1,122 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+
+// Coordinator: every end device's packets onto the one serial link
+//
+// Packets from the nodes queue in a byte ring and leave as PKT_TYPE_AGGREGATE
+// frames, several per frame, each with how long it waited:
+//
+//   off  size  field
+//   0    1     packet_type (PKT_TYPE_AGGREGATE)
+//   1    4     coordinator clock (systime_ms) when the frame was built
+//   5    1     count, packets in this frame
+//   -- per packet:
+//        ..    varint age, ms it waited before the frame was built
+//        1     length
+//        n     the packet as the node sent it (its own type, node id, checksum)
+//   end  2     checksum, CRC-16/CCITT (frame_crc16) over everything before it
+//
+// A frame goes out once the queue fills one or its oldest packet has waited
+// COORDINATOR_FLUSH_MS. A packet that would be alone in it (nothing else
+// came in time, or too big to share, like profile reports) goes out
+// unwrapped instead, the way the node sent it.
+//
+// Writes are paced to what DEBUG_BAUD_RATE drains, so the queue is the only
+// backlog and its size bounds the latency. When it is full new packets are
+// dropped: telemetry frames come again since nothing ACKs them (outbox.h),
+// so a burst ends up spread over the nodes' retries instead of piling up
+// here.
+//
+// The node table keeps, per node: its network address (ACKs from the
+// backend go back through coordinator_route), when it was last heard, its
+// last telemetry sequence number (a repeat is a retry) and a smoothed LQI.
+// Heartbeat-only packets aren't forwarded at all; instead every
+// COORDINATOR_STATUS_INTERVAL_MS a PKT_TYPE_NODES frame lists the nodes heard
+// since the last one:
+//
+//   0    1     packet_type (PKT_TYPE_NODES)
+//   1    4     coordinator clock
+//   5    1     count
+//   -- per node:
+//        2     node_id
+//        1     LQI
+//        ..    varint age, ms since it was last heard
+//   end  2     checksum
+//
+// Not thread safe, the coordinator task owns it.
+
+#define COORDINATOR_HEADER_SIZE 6
+#define COORDINATOR_LINK_MS(bytes) (((uint32_t)(bytes) * 10000 + DEBUG_BAUD_RATE - 1) / DEBUG_BAUD_RATE)
+
+typedef struct {
+    uint16_t node_id;
+    uint16_t address;         // network address
+    uint32_t last_seen_ms;
+    uint16_t last_seq;        // of the last telemetry frame with reports
+    uint8_t lqi;              // smoothed
+    bool used;
+    bool heard;               // since the last PKT_TYPE_NODES
+    uint32_t packets;
+    uint32_t retries;         // telemetry frames seen again (lost ACK)
+} coordinator_node_t;
+
+typedef struct {
+    uint32_t received;        // packets from nodes
+    uint32_t corrupt;         // bad length or checksum, not forwarded
+    uint32_t absorbed;        // heartbeats, in PKT_TYPE_NODES instead
+    uint32_t dropped;         // queue full
+    uint32_t untracked;       // node table full, stalest node forgotten
+    uint32_t aggregates;      // PKT_TYPE_AGGREGATE frames
+    uint32_t aggregated;      // packets in them
+    uint32_t unwrapped;       // packets sent on their own
+    uint32_t statuses;        // PKT_TYPE_NODES frames
+    uint32_t routed;          // packets from the backend passed on
+    uint16_t queue_max;       // bytes, high water
+} coordinator_stats_t;
+
+typedef struct {
+    coordinator_node_t nodes[COORDINATOR_NODE_SLOTS];  // open addressing on node_id
+    uint16_t node_count;      // up to COORDINATOR_MAX_NODES
+
+    // Packets waiting for the link: [received_ms:4][length:1][packet], wrapping
+    uint8_t queue[COORDINATOR_QUEUE_BYTES];
+    uint16_t head;
+    uint16_t used;
+    uint16_t queued;
+
+    uint32_t link_free_ms;    // the UART is done with what was written by then
+    uint32_t status_ms;       // next PKT_TYPE_NODES due
+    uint16_t status_cursor;   // node slot the current round of them has got to
+    bool status_pending;
+
+    coordinator_stats_t stats;
+} coordinator_t;
+
+// Function prototypes
+void coordinator_init(coordinator_t *coord, uint32_t now_ms);
+
+// A packet from a node (LQI as the radio measured it). Returns false if it
+// was dropped.
+bool coordinator_receive(coordinator_t *coord, const uint8_t *packet, size_t length,
+                         uint16_t address, uint8_t lqi, uint32_t now_ms);
+
+// The next packet for host_link_send, if one is due and the link has
+// caught up. Builds it into `out` (FRAME_PAYLOAD_MAX bytes) and returns its
+// length, 0 for nothing.
+size_t coordinator_poll(coordinator_t *coord, uint32_t now_ms, uint8_t *out);
+
+// ms until coordinator_poll has something
+uint32_t coordinator_timeout(const coordinator_t *coord, uint32_t now_ms);
+
+// Where a packet from the backend (an ACK) goes: false for a node not in
+// the table
+bool coordinator_route(coordinator_t *coord, const uint8_t *packet, size_t length, uint16_t *address);
+
+const coordinator_node_t *coordinator_find(const coordinator_t *coord, uint16_t node_id);
+
+#endif // COORDINATOR_H
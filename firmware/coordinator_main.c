@@ -0,0 +1,143 @@
+/*
+ * Wasche IoT Laundry System - Coordinator Firmware
+ *
+ * This runs on the CC2652 plugged into the server by USB. It forms the
+ * Zigbee network, puts every end device's packets on the serial link to
+ * backend/server.py (coordinator.h) and passes the backend's ACKs back to
+ * the nodes they are for.
+ *
+ * Build with: make coordinator
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#include "hal.h"
+#include "coordinator.h"
+#include "frame_codec.h"
+#include "host_link.h"
+#include "systime.h"
+#include "zigbee_handler.h"
+
+#ifndef DEVICE_TYPE_COORDINATOR
+#error "coordinator_main.c is the DEVICE_TYPE_COORDINATOR image"
+#endif
+
+// One task. The radio and UART callbacks (interrupt context) only copy what
+// arrived into the mailbox; the task queues node packets in coordinator.c,
+// writes whatever is due to the UART, and decodes the backend's frames. A
+// full mailbox loses the packet, which the node sends again like any other
+// lost one.
+
+typedef enum {
+    MSG_RADIO,                // a packet from a node
+    MSG_UART                  // bytes from the backend
+} coord_msg_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t lqi;
+    uint16_t source;          // network address
+    uint16_t length;
+    uint8_t data[FRAME_PAYLOAD_MAX];
+} coord_msg_t;
+
+static hal_mbox_t rx_mailbox;
+static uint8_t coord_stack[TASK_COORD_STACK_SIZE];
+
+static coordinator_t coord;
+static frame_decoder_t decoder;
+
+// Radio ISR
+static void on_packet(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi) {
+    coord_msg_t msg;
+
+    if (length > sizeof(msg.data)) {
+        return;
+    }
+    msg.kind = MSG_RADIO;
+    msg.lqi = lqi;
+    msg.source = source;
+    msg.length = (uint16_t)length;
+    memcpy(msg.data, packet, length);
+    hal_mbox_post(rx_mailbox, &msg, HAL_NO_WAIT);
+}
+
+// UART read callback
+static void on_uart(const uint8_t *data, size_t length) {
+    coord_msg_t msg;
+
+    msg.kind = MSG_UART;
+    while (length > 0) {
+        msg.length = (uint16_t)(length < sizeof(msg.data) ? length : sizeof(msg.data));
+        memcpy(msg.data, data, msg.length);
+        hal_mbox_post(rx_mailbox, &msg, HAL_NO_WAIT);
+        data += msg.length;
+        length -= msg.length;
+    }
+}
+
+// Frames from the backend: ACKs go to the node in their node_id
+static void from_host(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        const uint8_t *packet;
+        size_t packet_length = 0;
+        size_t used = frame_decoder_feed(&decoder, data, length, &packet, &packet_length);
+        data += used;
+        length -= used;
+
+        uint16_t address;
+        if (packet_length > 0 && packet[0] == PKT_TYPE_ACK &&
+            coordinator_route(&coord, packet, packet_length, &address)) {
+            zigbee_send_to(address, packet, packet_length);
+        }
+    }
+}
+
+static void coord_task(void) {
+    coord_msg_t msg;
+    uint8_t out[FRAME_PAYLOAD_MAX];
+
+    if (!systime_init()) {
+        return;
+    }
+    frame_decoder_init(&decoder);
+    coordinator_init(&coord, systime_ms());
+    zigbee_set_packet_handler(on_packet);
+    hal_uart_set_receive(on_uart);
+    if (!zigbee_init()) {
+        return;
+    }
+
+    while (1) {
+        if (hal_mbox_pend(rx_mailbox, &msg, coordinator_timeout(&coord, systime_ms()))) {
+            if (msg.kind == MSG_RADIO) {
+                coordinator_receive(&coord, msg.data, msg.length, msg.source, msg.lqi, systime_ms());
+            } else {
+                from_host(msg.data, msg.length);
+            }
+        }
+
+        size_t length = coordinator_poll(&coord, systime_ms(), out);
+        if (length > 0) {
+            host_link_send(out, length);
+        }
+    }
+}
+
+int main(void) {
+    rx_mailbox = hal_mbox_create(sizeof(coord_msg_t), COORDINATOR_RX_DEPTH);
+    if (rx_mailbox == NULL) {
+        return 1;
+    }
+
+    if (hal_task_create("coordinator", coord_task, TASK_COORD_PRIORITY,
+                        coord_stack, sizeof(coord_stack)) == NULL) {
+        return 1;
+    }
+
+    hal_start();
+
+    return 0;  // only the host build gets here, when the simulation ends
+}
@@ -0,0 +1,107 @@
+#ifndef DSP_FIXED_H
+#define DSP_FIXED_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Fixed-point helpers for the integer analysis pipeline
+//
+// Packed values hold two signed 16-bit halves in one 32-bit word, low half
+// first (same layout as an int16_t[2] in memory). On the Cortex-M4 these
+// map onto the DSP/SIMD instructions; everywhere else (host builds) they
+// fall back to plain C with identical results.
+
+#if defined(__ARM_FEATURE_SIMD32) && defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define DSP_HAVE_SIMD32 1
+#else
+#define DSP_HAVE_SIMD32 0
+#endif
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+static inline uint32_t dsp_pack16(int16_t lo, int16_t hi) {
+    return (uint32_t)(uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+}
+
+static inline int16_t dsp_lo16(uint32_t v) {
+    return (int16_t)(v & 0xFFFF);
+}
+
+static inline int16_t dsp_hi16(uint32_t v) {
+    return (int16_t)(v >> 16);
+}
+
+// unaligned-safe load/store of a packed pair (compiles to LDR/STR on the M4)
+static inline uint32_t dsp_load_pair(const void *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void dsp_store_pair(void *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+// lo(a)*lo(b) + hi(a)*hi(b)
+static inline int32_t dsp_smuad(uint32_t a, uint32_t b) {
+#if DSP_HAVE_SIMD32
+    return __smuad((int16x2_t)a, (int16x2_t)b);
+#else
+    return (int32_t)dsp_lo16(a) * dsp_lo16(b) + (int32_t)dsp_hi16(a) * dsp_hi16(b);
+#endif
+}
+
+// lo(a)*lo(b) - hi(a)*hi(b)
+static inline int32_t dsp_smusd(uint32_t a, uint32_t b) {
+#if DSP_HAVE_SIMD32
+    return __smusd((int16x2_t)a, (int16x2_t)b);
+#else
+    return (int32_t)dsp_lo16(a) * dsp_lo16(b) - (int32_t)dsp_hi16(a) * dsp_hi16(b);
+#endif
+}
+
+// lo(a)*hi(b) + hi(a)*lo(b)
+static inline int32_t dsp_smuadx(uint32_t a, uint32_t b) {
+#if DSP_HAVE_SIMD32
+    return __smuadx((int16x2_t)a, (int16x2_t)b);
+#else
+    return (int32_t)dsp_lo16(a) * dsp_hi16(b) + (int32_t)dsp_hi16(a) * dsp_lo16(b);
+#endif
+}
+
+// acc + lo(a)*lo(b) + hi(a)*hi(b), 64-bit accumulator
+static inline uint64_t dsp_smlald(uint32_t a, uint32_t b, uint64_t acc) {
+#if DSP_HAVE_SIMD32
+    return (uint64_t)__smlald((int16x2_t)a, (int16x2_t)b, (int64_t)acc);
+#else
+    return acc + (uint64_t)(int64_t)dsp_smuad(a, b);
+#endif
+}
+
+// per-half (a + b) / 2, can't overflow
+static inline uint32_t dsp_shadd16(uint32_t a, uint32_t b) {
+#if DSP_HAVE_SIMD32
+    return (uint32_t)__shadd16((int16x2_t)a, (int16x2_t)b);
+#else
+    return dsp_pack16((int16_t)(((int32_t)dsp_lo16(a) + dsp_lo16(b)) >> 1),
+                      (int16_t)(((int32_t)dsp_hi16(a) + dsp_hi16(b)) >> 1));
+#endif
+}
+
+// per-half (a - b) / 2, can't overflow
+static inline uint32_t dsp_shsub16(uint32_t a, uint32_t b) {
+#if DSP_HAVE_SIMD32
+    return (uint32_t)__shsub16((int16x2_t)a, (int16x2_t)b);
+#else
+    return dsp_pack16((int16_t)(((int32_t)dsp_lo16(a) - dsp_lo16(b)) >> 1),
+                      (int16_t)(((int32_t)dsp_hi16(a) - dsp_hi16(b)) >> 1));
+#endif
+}
+
+// Integer square roots (floor)
+uint32_t dsp_isqrt32(uint32_t value);
+uint32_t dsp_isqrt64(uint64_t value);
+
+#endif // DSP_FIXED_H
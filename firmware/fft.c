@@ -0,0 +1,180 @@
+#include "fft.h"
+
+// Real-input FFT using the precomputed tables in fft_tables.c
+//
+// The n real samples are packed as n/2 complex values (even samples in the
+// real part, odd samples in the imag part), transformed with a radix-2 FFT
+// of half the length, then split back into the spectrum of the real signal.
+// Saves roughly half the work compared to feeding a complex FFT with imag=0.
+
+static uint16_t log2_u16(uint16_t n) {
+    uint16_t bits = 0;
+    while (n > 1) {
+        bits++;
+        n >>= 1;
+    }
+    return bits;
+}
+
+bool fft_real_forward(const float *input, complex_t *output, uint16_t n) {
+    if (n < 4 || n > FFT_TABLE_SIZE || (n & (n - 1)) != 0) {
+        return false;
+    }
+
+    uint16_t m = n / 2;  // complex FFT length
+
+    // fft_bitrev is for FFT_TABLE_SIZE/2 points, shift it down for smaller m
+    uint16_t shift = (FFT_TABLE_LOG2 - 1) - log2_u16(m);
+
+    // pack and bit-reverse in one pass (no swap loop needed since out of place)
+    for (uint16_t i = 0; i < m; i++) {
+        uint16_t j = fft_bitrev[i] >> shift;
+        output[j].real = input[2 * i];
+        output[j].imag = input[2 * i + 1];
+    }
+
+    // first stage has twiddle = 1, no multiplies needed
+    for (uint16_t i = 0; i < m; i += 2) {
+        complex_t u = output[i];
+        complex_t v = output[i + 1];
+        output[i].real = u.real + v.real;
+        output[i].imag = u.imag + v.imag;
+        output[i + 1].real = u.real - v.real;
+        output[i + 1].imag = u.imag - v.imag;
+    }
+
+    // remaining radix-2 stages
+    for (uint16_t size = 4; size <= m; size *= 2) {
+        uint16_t half = size / 2;
+        uint16_t tw_step = FFT_TABLE_SIZE / size;
+
+        for (uint16_t j = 0; j < half; j++) {
+            float wr = fft_twiddle_cos[j * tw_step];
+            float wi = fft_twiddle_sin[j * tw_step];
+
+            for (uint16_t i = j; i < m; i += size) {
+                complex_t *a = &output[i];
+                complex_t *b = &output[i + half];
+
+                float vr = wr * b->real - wi * b->imag;
+                float vi = wr * b->imag + wi * b->real;
+
+                b->real = a->real - vr;
+                b->imag = a->imag - vi;
+                a->real += vr;
+                a->imag += vi;
+            }
+        }
+    }
+
+    // split step: turn the packed n/2-point result into bins 0..n/2
+    //   Fe[k] = (Z[k] + conj(Z[m-k])) / 2     (spectrum of even samples)
+    //   Fo[k] = (Z[k] - conj(Z[m-k])) / 2i    (spectrum of odd samples)
+    //   X[k]   = Fe[k] + W^k Fo[k]
+    //   X[m-k] = conj(Fe[k] - W^k Fo[k])
+    uint16_t tw_stride = FFT_TABLE_SIZE / n;
+
+    float z0r = output[0].real;
+    float z0i = output[0].imag;
+    output[0].real = z0r + z0i;
+    output[0].imag = 0.0f;
+    output[m].real = z0r - z0i;
+    output[m].imag = 0.0f;
+
+    for (uint16_t k = 1; k <= m / 2; k++) {
+        complex_t zk = output[k];
+        complex_t zmk = output[m - k];
+
+        float fe_r = 0.5f * (zk.real + zmk.real);
+        float fe_i = 0.5f * (zk.imag - zmk.imag);
+        float fo_r = 0.5f * (zk.imag + zmk.imag);
+        float fo_i = -0.5f * (zk.real - zmk.real);
+
+        float wr = fft_twiddle_cos[k * tw_stride];
+        float wi = fft_twiddle_sin[k * tw_stride];
+        float tr = wr * fo_r - wi * fo_i;
+        float ti = wr * fo_i + wi * fo_r;
+
+        output[k].real = fe_r + tr;
+        output[k].imag = fe_i + ti;
+        output[m - k].real = fe_r - tr;
+        output[m - k].imag = -(fe_i - ti);
+    }
+
+    return true;
+}
+
+bool fft_real_forward_q15(const q15_t *input, complex_q15_t *output, uint16_t n) {
+    if (n < 4 || n > FFT_TABLE_SIZE || (n & (n - 1)) != 0) {
+        return false;
+    }
+
+    uint16_t m = n / 2;
+    uint16_t shift = (FFT_TABLE_LOG2 - 1) - log2_u16(m);
+
+    // (x[2i], x[2i+1]) is already a packed (real, imag) pair
+    for (uint16_t i = 0; i < m; i++) {
+        uint16_t j = fft_bitrev[i] >> shift;
+        dsp_store_pair(&output[j], dsp_load_pair(&input[2 * i]));
+    }
+
+    for (uint16_t i = 0; i < m; i += 2) {
+        uint32_t a = dsp_load_pair(&output[i]);
+        uint32_t b = dsp_load_pair(&output[i + 1]);
+        dsp_store_pair(&output[i], dsp_shadd16(a, b));
+        dsp_store_pair(&output[i + 1], dsp_shsub16(a, b));
+    }
+
+    for (uint16_t size = 4; size <= m; size *= 2) {
+        uint16_t half = size / 2;
+        uint16_t tw_step = FFT_TABLE_SIZE / size;
+
+        for (uint16_t j = 0; j < half; j++) {
+            uint32_t w = dsp_load_pair(&fft_twiddle_q15[2 * j * tw_step]);
+
+            for (uint16_t i = j; i < m; i += size) {
+                uint32_t a = dsp_load_pair(&output[i]);
+                uint32_t b = dsp_load_pair(&output[i + half]);
+
+                // v = w * b, back to Q15
+                uint32_t v = dsp_pack16((int16_t)(dsp_smusd(w, b) >> 15),
+                                        (int16_t)(dsp_smuadx(w, b) >> 15));
+
+                dsp_store_pair(&output[i], dsp_shadd16(a, v));
+                dsp_store_pair(&output[i + half], dsp_shsub16(a, v));
+            }
+        }
+    }
+
+    // split step, same math as the float version with one more halving
+    uint16_t tw_stride = FFT_TABLE_SIZE / n;
+
+    int32_t z0r = output[0].real;
+    int32_t z0i = output[0].imag;
+    output[0].real = (q15_t)((z0r + z0i) >> 1);
+    output[0].imag = 0;
+    output[m].real = (q15_t)((z0r - z0i) >> 1);
+    output[m].imag = 0;
+
+    for (uint16_t k = 1; k <= m / 2; k++) {
+        int32_t zkr = output[k].real;
+        int32_t zki = output[k].imag;
+        int32_t zmr = output[m - k].real;
+        int32_t zmi = output[m - k].imag;
+
+        int32_t fe_r = (zkr + zmr) >> 1;
+        int32_t fe_i = (zki - zmi) >> 1;
+        uint32_t fo = dsp_pack16((int16_t)((zki + zmi) >> 1), (int16_t)((zmr - zkr) >> 1));
+
+        uint32_t w = dsp_load_pair(&fft_twiddle_q15[2 * k * tw_stride]);
+        int32_t tr = dsp_smusd(w, fo) >> 15;
+        int32_t ti = dsp_smuadx(w, fo) >> 15;
+
+        output[k].real = (q15_t)((fe_r + tr) >> 1);
+        output[k].imag = (q15_t)((fe_i + ti) >> 1);
+        output[m - k].real = (q15_t)((fe_r - tr) >> 1);
+        output[m - k].imag = (q15_t)(-((fe_i - ti) >> 1));
+    }
+
+    return true;
+}
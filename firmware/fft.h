@@ -0,0 +1,31 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fft_tables.h"
+#include "dsp_fixed.h"
+
+// Complex value used for FFT input/output
+typedef struct {
+    float real;
+    float imag;
+} complex_t;
+
+// Q15 complex value (real first, so it loads as one packed 32-bit word)
+typedef struct {
+    q15_t real;
+    q15_t imag;
+} complex_q15_t;
+
+// Forward FFT of n real samples (n = power of 2, 4..FFT_TABLE_SIZE).
+// Writes bins 0..n/2 to output, so output needs room for n/2 + 1 values.
+// Internally this is an n/2-point complex FFT plus a split step.
+bool fft_real_forward(const float *input, complex_t *output, uint16_t n);
+
+// Q15 version of fft_real_forward. Every stage halves its output so nothing
+// can overflow; the result is the true spectrum scaled by 1/n. Keep the
+// input below 0.5 (|x| < 16384) for full accuracy.
+bool fft_real_forward_q15(const q15_t *input, complex_q15_t *output, uint16_t n);
+
+#endif // FFT_H
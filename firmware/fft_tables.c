@@ -0,0 +1,222 @@
+// Generated by tools/gen_tables.py - do not edit
+#include "fft_tables.h"
+
+const float fft_twiddle_cos[256] = {
+     1.000000000f,  0.999924702f,  0.999698819f,  0.999322385f,
+     0.998795456f,  0.998118113f,  0.997290457f,  0.996312612f,
+     0.995184727f,  0.993906970f,  0.992479535f,  0.990902635f,
+     0.989176510f,  0.987301418f,  0.985277642f,  0.983105487f,
+     0.980785280f,  0.978317371f,  0.975702130f,  0.972939952f,
+     0.970031253f,  0.966976471f,  0.963776066f,  0.960430519f,
+     0.956940336f,  0.953306040f,  0.949528181f,  0.945607325f,
+     0.941544065f,  0.937339012f,  0.932992799f,  0.928506080f,
+     0.923879533f,  0.919113852f,  0.914209756f,  0.909167983f,
+     0.903989293f,  0.898674466f,  0.893224301f,  0.887639620f,
+     0.881921264f,  0.876070094f,  0.870086991f,  0.863972856f,
+     0.857728610f,  0.851355193f,  0.844853565f,  0.838224706f,
+     0.831469612f,  0.824589303f,  0.817584813f,  0.810457198f,
+     0.803207531f,  0.795836905f,  0.788346428f,  0.780737229f,
+     0.773010453f,  0.765167266f,  0.757208847f,  0.749136395f,
+     0.740951125f,  0.732654272f,  0.724247083f,  0.715730825f,
+     0.707106781f,  0.698376249f,  0.689540545f,  0.680600998f,
+     0.671558955f,  0.662415778f,  0.653172843f,  0.643831543f,
+     0.634393284f,  0.624859488f,  0.615231591f,  0.605511041f,
+     0.595699304f,  0.585797857f,  0.575808191f,  0.565731811f,
+     0.555570233f,  0.545324988f,  0.534997620f,  0.524589683f,
+     0.514102744f,  0.503538384f,  0.492898192f,  0.482183772f,
+     0.471396737f,  0.460538711f,  0.449611330f,  0.438616239f,
+     0.427555093f,  0.416429560f,  0.405241314f,  0.393992040f,
+     0.382683432f,  0.371317194f,  0.359895037f,  0.348418680f,
+     0.336889853f,  0.325310292f,  0.313681740f,  0.302005949f,
+     0.290284677f,  0.278519689f,  0.266712757f,  0.254865660f,
+     0.242980180f,  0.231058108f,  0.219101240f,  0.207111376f,
+     0.195090322f,  0.183039888f,  0.170961889f,  0.158858143f,
+     0.146730474f,  0.134580709f,  0.122410675f,  0.110222207f,
+     0.098017140f,  0.085797312f,  0.073564564f,  0.061320736f,
+     0.049067674f,  0.036807223f,  0.024541229f,  0.012271538f,
+     0.000000000f, -0.012271538f, -0.024541229f, -0.036807223f,
+    -0.049067674f, -0.061320736f, -0.073564564f, -0.085797312f,
+    -0.098017140f, -0.110222207f, -0.122410675f, -0.134580709f,
+    -0.146730474f, -0.158858143f, -0.170961889f, -0.183039888f,
+    -0.195090322f, -0.207111376f, -0.219101240f, -0.231058108f,
+    -0.242980180f, -0.254865660f, -0.266712757f, -0.278519689f,
+    -0.290284677f, -0.302005949f, -0.313681740f, -0.325310292f,
+    -0.336889853f, -0.348418680f, -0.359895037f, -0.371317194f,
+    -0.382683432f, -0.393992040f, -0.405241314f, -0.416429560f,
+    -0.427555093f, -0.438616239f, -0.449611330f, -0.460538711f,
+    -0.471396737f, -0.482183772f, -0.492898192f, -0.503538384f,
+    -0.514102744f, -0.524589683f, -0.534997620f, -0.545324988f,
+    -0.555570233f, -0.565731811f, -0.575808191f, -0.585797857f,
+    -0.595699304f, -0.605511041f, -0.615231591f, -0.624859488f,
+    -0.634393284f, -0.643831543f, -0.653172843f, -0.662415778f,
+    -0.671558955f, -0.680600998f, -0.689540545f, -0.698376249f,
+    -0.707106781f, -0.715730825f, -0.724247083f, -0.732654272f,
+    -0.740951125f, -0.749136395f, -0.757208847f, -0.765167266f,
+    -0.773010453f, -0.780737229f, -0.788346428f, -0.795836905f,
+    -0.803207531f, -0.810457198f, -0.817584813f, -0.824589303f,
+    -0.831469612f, -0.838224706f, -0.844853565f, -0.851355193f,
+    -0.857728610f, -0.863972856f, -0.870086991f, -0.876070094f,
+    -0.881921264f, -0.887639620f, -0.893224301f, -0.898674466f,
+    -0.903989293f, -0.909167983f, -0.914209756f, -0.919113852f,
+    -0.923879533f, -0.928506080f, -0.932992799f, -0.937339012f,
+    -0.941544065f, -0.945607325f, -0.949528181f, -0.953306040f,
+    -0.956940336f, -0.960430519f, -0.963776066f, -0.966976471f,
+    -0.970031253f, -0.972939952f, -0.975702130f, -0.978317371f,
+    -0.980785280f, -0.983105487f, -0.985277642f, -0.987301418f,
+    -0.989176510f, -0.990902635f, -0.992479535f, -0.993906970f,
+    -0.995184727f, -0.996312612f, -0.997290457f, -0.998118113f,
+    -0.998795456f, -0.999322385f, -0.999698819f, -0.999924702f,
+};
+
+const float fft_twiddle_sin[256] = {
+     0.000000000f, -0.012271538f, -0.024541229f, -0.036807223f,
+    -0.049067674f, -0.061320736f, -0.073564564f, -0.085797312f,
+    -0.098017140f, -0.110222207f, -0.122410675f, -0.134580709f,
+    -0.146730474f, -0.158858143f, -0.170961889f, -0.183039888f,
+    -0.195090322f, -0.207111376f, -0.219101240f, -0.231058108f,
+    -0.242980180f, -0.254865660f, -0.266712757f, -0.278519689f,
+    -0.290284677f, -0.302005949f, -0.313681740f, -0.325310292f,
+    -0.336889853f, -0.348418680f, -0.359895037f, -0.371317194f,
+    -0.382683432f, -0.393992040f, -0.405241314f, -0.416429560f,
+    -0.427555093f, -0.438616239f, -0.449611330f, -0.460538711f,
+    -0.471396737f, -0.482183772f, -0.492898192f, -0.503538384f,
+    -0.514102744f, -0.524589683f, -0.534997620f, -0.545324988f,
+    -0.555570233f, -0.565731811f, -0.575808191f, -0.585797857f,
+    -0.595699304f, -0.605511041f, -0.615231591f, -0.624859488f,
+    -0.634393284f, -0.643831543f, -0.653172843f, -0.662415778f,
+    -0.671558955f, -0.680600998f, -0.689540545f, -0.698376249f,
+    -0.707106781f, -0.715730825f, -0.724247083f, -0.732654272f,
+    -0.740951125f, -0.749136395f, -0.757208847f, -0.765167266f,
+    -0.773010453f, -0.780737229f, -0.788346428f, -0.795836905f,
+    -0.803207531f, -0.810457198f, -0.817584813f, -0.824589303f,
+    -0.831469612f, -0.838224706f, -0.844853565f, -0.851355193f,
+    -0.857728610f, -0.863972856f, -0.870086991f, -0.876070094f,
+    -0.881921264f, -0.887639620f, -0.893224301f, -0.898674466f,
+    -0.903989293f, -0.909167983f, -0.914209756f, -0.919113852f,
+    -0.923879533f, -0.928506080f, -0.932992799f, -0.937339012f,
+    -0.941544065f, -0.945607325f, -0.949528181f, -0.953306040f,
+    -0.956940336f, -0.960430519f, -0.963776066f, -0.966976471f,
+    -0.970031253f, -0.972939952f, -0.975702130f, -0.978317371f,
+    -0.980785280f, -0.983105487f, -0.985277642f, -0.987301418f,
+    -0.989176510f, -0.990902635f, -0.992479535f, -0.993906970f,
+    -0.995184727f, -0.996312612f, -0.997290457f, -0.998118113f,
+    -0.998795456f, -0.999322385f, -0.999698819f, -0.999924702f,
+    -1.000000000f, -0.999924702f, -0.999698819f, -0.999322385f,
+    -0.998795456f, -0.998118113f, -0.997290457f, -0.996312612f,
+    -0.995184727f, -0.993906970f, -0.992479535f, -0.990902635f,
+    -0.989176510f, -0.987301418f, -0.985277642f, -0.983105487f,
+    -0.980785280f, -0.978317371f, -0.975702130f, -0.972939952f,
+    -0.970031253f, -0.966976471f, -0.963776066f, -0.960430519f,
+    -0.956940336f, -0.953306040f, -0.949528181f, -0.945607325f,
+    -0.941544065f, -0.937339012f, -0.932992799f, -0.928506080f,
+    -0.923879533f, -0.919113852f, -0.914209756f, -0.909167983f,
+    -0.903989293f, -0.898674466f, -0.893224301f, -0.887639620f,
+    -0.881921264f, -0.876070094f, -0.870086991f, -0.863972856f,
+    -0.857728610f, -0.851355193f, -0.844853565f, -0.838224706f,
+    -0.831469612f, -0.824589303f, -0.817584813f, -0.810457198f,
+    -0.803207531f, -0.795836905f, -0.788346428f, -0.780737229f,
+    -0.773010453f, -0.765167266f, -0.757208847f, -0.749136395f,
+    -0.740951125f, -0.732654272f, -0.724247083f, -0.715730825f,
+    -0.707106781f, -0.698376249f, -0.689540545f, -0.680600998f,
+    -0.671558955f, -0.662415778f, -0.653172843f, -0.643831543f,
+    -0.634393284f, -0.624859488f, -0.615231591f, -0.605511041f,
+    -0.595699304f, -0.585797857f, -0.575808191f, -0.565731811f,
+    -0.555570233f, -0.545324988f, -0.534997620f, -0.524589683f,
+    -0.514102744f, -0.503538384f, -0.492898192f, -0.482183772f,
+    -0.471396737f, -0.460538711f, -0.449611330f, -0.438616239f,
+    -0.427555093f, -0.416429560f, -0.405241314f, -0.393992040f,
+    -0.382683432f, -0.371317194f, -0.359895037f, -0.348418680f,
+    -0.336889853f, -0.325310292f, -0.313681740f, -0.302005949f,
+    -0.290284677f, -0.278519689f, -0.266712757f, -0.254865660f,
+    -0.242980180f, -0.231058108f, -0.219101240f, -0.207111376f,
+    -0.195090322f, -0.183039888f, -0.170961889f, -0.158858143f,
+    -0.146730474f, -0.134580709f, -0.122410675f, -0.110222207f,
+    -0.098017140f, -0.085797312f, -0.073564564f, -0.061320736f,
+    -0.049067674f, -0.036807223f, -0.024541229f, -0.012271538f,
+};
+
+const int16_t fft_twiddle_q15[512] = {
+     32767,      0,  32766,   -402,  32758,   -804,  32746,  -1206,
+     32729,  -1608,  32706,  -2009,  32679,  -2411,  32647,  -2811,
+     32610,  -3212,  32568,  -3612,  32522,  -4011,  32470,  -4410,
+     32413,  -4808,  32352,  -5205,  32286,  -5602,  32214,  -5998,
+     32138,  -6393,  32058,  -6787,  31972,  -7180,  31881,  -7571,
+     31786,  -7962,  31686,  -8351,  31581,  -8740,  31471,  -9127,
+     31357,  -9512,  31238,  -9896,  31114, -10279,  30986, -10660,
+     30853, -11039,  30715, -11417,  30572, -11793,  30425, -12167,
+     30274, -12540,  30118, -12910,  29957, -13279,  29792, -13646,
+     29622, -14010,  29448, -14373,  29269, -14733,  29086, -15091,
+     28899, -15447,  28707, -15800,  28511, -16151,  28311, -16500,
+     28106, -16846,  27897, -17190,  27684, -17531,  27467, -17869,
+     27246, -18205,  27020, -18538,  26791, -18868,  26557, -19195,
+     26320, -19520,  26078, -19841,  25833, -20160,  25583, -20475,
+     25330, -20788,  25073, -21097,  24812, -21403,  24548, -21706,
+     24279, -22006,  24008, -22302,  23732, -22595,  23453, -22884,
+     23170, -23170,  22884, -23453,  22595, -23732,  22302, -24008,
+     22006, -24279,  21706, -24548,  21403, -24812,  21097, -25073,
+     20788, -25330,  20475, -25583,  20160, -25833,  19841, -26078,
+     19520, -26320,  19195, -26557,  18868, -26791,  18538, -27020,
+     18205, -27246,  17869, -27467,  17531, -27684,  17190, -27897,
+     16846, -28106,  16500, -28311,  16151, -28511,  15800, -28707,
+     15447, -28899,  15091, -29086,  14733, -29269,  14373, -29448,
+     14010, -29622,  13646, -29792,  13279, -29957,  12910, -30118,
+     12540, -30274,  12167, -30425,  11793, -30572,  11417, -30715,
+     11039, -30853,  10660, -30986,  10279, -31114,   9896, -31238,
+      9512, -31357,   9127, -31471,   8740, -31581,   8351, -31686,
+      7962, -31786,   7571, -31881,   7180, -31972,   6787, -32058,
+      6393, -32138,   5998, -32214,   5602, -32286,   5205, -32352,
+      4808, -32413,   4410, -32470,   4011, -32522,   3612, -32568,
+      3212, -32610,   2811, -32647,   2411, -32679,   2009, -32706,
+      1608, -32729,   1206, -32746,    804, -32758,    402, -32766,
+         0, -32768,   -402, -32766,   -804, -32758,  -1206, -32746,
+     -1608, -32729,  -2009, -32706,  -2411, -32679,  -2811, -32647,
+     -3212, -32610,  -3612, -32568,  -4011, -32522,  -4410, -32470,
+     -4808, -32413,  -5205, -32352,  -5602, -32286,  -5998, -32214,
+     -6393, -32138,  -6787, -32058,  -7180, -31972,  -7571, -31881,
+     -7962, -31786,  -8351, -31686,  -8740, -31581,  -9127, -31471,
+     -9512, -31357,  -9896, -31238, -10279, -31114, -10660, -30986,
+    -11039, -30853, -11417, -30715, -11793, -30572, -12167, -30425,
+    -12540, -30274, -12910, -30118, -13279, -29957, -13646, -29792,
+    -14010, -29622, -14373, -29448, -14733, -29269, -15091, -29086,
+    -15447, -28899, -15800, -28707, -16151, -28511, -16500, -28311,
+    -16846, -28106, -17190, -27897, -17531, -27684, -17869, -27467,
+    -18205, -27246, -18538, -27020, -18868, -26791, -19195, -26557,
+    -19520, -26320, -19841, -26078, -20160, -25833, -20475, -25583,
+    -20788, -25330, -21097, -25073, -21403, -24812, -21706, -24548,
+    -22006, -24279, -22302, -24008, -22595, -23732, -22884, -23453,
+    -23170, -23170, -23453, -22884, -23732, -22595, -24008, -22302,
+    -24279, -22006, -24548, -21706, -24812, -21403, -25073, -21097,
+    -25330, -20788, -25583, -20475, -25833, -20160, -26078, -19841,
+    -26320, -19520, -26557, -19195, -26791, -18868, -27020, -18538,
+    -27246, -18205, -27467, -17869, -27684, -17531, -27897, -17190,
+    -28106, -16846, -28311, -16500, -28511, -16151, -28707, -15800,
+    -28899, -15447, -29086, -15091, -29269, -14733, -29448, -14373,
+    -29622, -14010, -29792, -13646, -29957, -13279, -30118, -12910,
+    -30274, -12540, -30425, -12167, -30572, -11793, -30715, -11417,
+    -30853, -11039, -30986, -10660, -31114, -10279, -31238,  -9896,
+    -31357,  -9512, -31471,  -9127, -31581,  -8740, -31686,  -8351,
+    -31786,  -7962, -31881,  -7571, -31972,  -7180, -32058,  -6787,
+    -32138,  -6393, -32214,  -5998, -32286,  -5602, -32352,  -5205,
+    -32413,  -4808, -32470,  -4410, -32522,  -4011, -32568,  -3612,
+    -32610,  -3212, -32647,  -2811, -32679,  -2411, -32706,  -2009,
+    -32729,  -1608, -32746,  -1206, -32758,   -804, -32766,   -402,
+};
+
+const uint8_t fft_bitrev[256] = {
+      0, 128,  64, 192,  32, 160,  96, 224,  16, 144,  80, 208,  48, 176, 112, 240,
+      8, 136,  72, 200,  40, 168, 104, 232,  24, 152,  88, 216,  56, 184, 120, 248,
+      4, 132,  68, 196,  36, 164, 100, 228,  20, 148,  84, 212,  52, 180, 116, 244,
+     12, 140,  76, 204,  44, 172, 108, 236,  28, 156,  92, 220,  60, 188, 124, 252,
+      2, 130,  66, 194,  34, 162,  98, 226,  18, 146,  82, 210,  50, 178, 114, 242,
+     10, 138,  74, 202,  42, 170, 106, 234,  26, 154,  90, 218,  58, 186, 122, 250,
+      6, 134,  70, 198,  38, 166, 102, 230,  22, 150,  86, 214,  54, 182, 118, 246,
+     14, 142,  78, 206,  46, 174, 110, 238,  30, 158,  94, 222,  62, 190, 126, 254,
+      1, 129,  65, 193,  33, 161,  97, 225,  17, 145,  81, 209,  49, 177, 113, 241,
+      9, 137,  73, 201,  41, 169, 105, 233,  25, 153,  89, 217,  57, 185, 121, 249,
+      5, 133,  69, 197,  37, 165, 101, 229,  21, 149,  85, 213,  53, 181, 117, 245,
+     13, 141,  77, 205,  45, 173, 109, 237,  29, 157,  93, 221,  61, 189, 125, 253,
+      3, 131,  67, 195,  35, 163,  99, 227,  19, 147,  83, 211,  51, 179, 115, 243,
+     11, 139,  75, 203,  43, 171, 107, 235,  27, 155,  91, 219,  59, 187, 123, 251,
+      7, 135,  71, 199,  39, 167, 103, 231,  23, 151,  87, 215,  55, 183, 119, 247,
+     15, 143,  79, 207,  47, 175, 111, 239,  31, 159,  95, 223,  63, 191, 127, 255,
+};
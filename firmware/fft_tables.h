@@ -0,0 +1,22 @@
+// Generated by tools/gen_tables.py - do not edit
+#ifndef FFT_TABLES_H
+#define FFT_TABLES_H
+
+#include <stdint.h>
+
+// Largest supported real-input FFT length
+#define FFT_TABLE_SIZE 512
+#define FFT_TABLE_LOG2 9
+
+// Twiddles W^k = exp(-2*pi*i*k / FFT_TABLE_SIZE) for k < FFT_TABLE_SIZE/2
+extern const float fft_twiddle_cos[256];
+extern const float fft_twiddle_sin[256];
+
+// Same twiddles in Q15, interleaved (cos, -sin) so one 32-bit load gives
+// a packed complex value for the M4 dual 16-bit multiply instructions
+extern const int16_t fft_twiddle_q15[512];
+
+// Bit reversal of i over log2(FFT_TABLE_SIZE/2) bits
+extern const uint8_t fft_bitrev[256];
+
+#endif // FFT_TABLES_H
@@ -0,0 +1,66 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Serial framing between the coordinator (or a node on USB) and the backend.
+// Shared with the backend, which loads it as build-host/libframe_codec.so
+// (make codec-lib), so keep it free of TI includes.
+//
+// Each packet goes on the wire as
+//
+//   COBS( length | packet | crc_hi | crc_lo ) 0x00
+//
+// length is the packet length (1 byte), the CRC is CRC-16/CCITT-FALSE
+// (poly 0x1021, init 0xFFFF) over length and packet, high byte first, so the
+// CRC over a whole good frame comes out 0. COBS takes every 0x00 out of the
+// frame, which leaves 0x00 as an unambiguous delimiter: a receiver that
+// loses or mangles bytes throws away at most the frame they were in and is
+// back in step at the next delimiter.
+
+#define FRAME_PAYLOAD_MAX 255
+#define FRAME_OVERHEAD 3  // length + CRC
+// COBS adds one byte per 254 plus one, then the delimiter
+#define FRAME_ENCODED_MAX(n) ((n) + FRAME_OVERHEAD + ((n) + FRAME_OVERHEAD) / 254 + 2)
+
+typedef struct {
+    uint32_t frames;         // good frames returned
+    uint32_t crc_errors;
+    uint32_t length_errors;  // length byte doesn't match, or too short
+    uint32_t overruns;       // no delimiter within FRAME_ENCODED_MAX bytes
+} frame_stats_t;
+
+// Streaming decoder state. `stats` stays the first member, the backend
+// reads it straight out of the struct.
+typedef struct {
+    frame_stats_t stats;
+    uint8_t buf[FRAME_PAYLOAD_MAX + FRAME_OVERHEAD];
+    uint16_t length;   // decoded bytes in buf
+    uint8_t code;      // data bytes left in the current COBS block
+    bool zero;         // current block ends in an implied 0x00
+    bool discard;      // frame overran buf, skip to the next delimiter
+} frame_decoder_t;
+
+// Function prototypes
+uint16_t frame_crc16(const uint8_t *data, size_t length);
+uint16_t frame_crc16_update(uint16_t crc, const uint8_t *data, size_t length);
+
+// Frame `length` (<= FRAME_PAYLOAD_MAX) bytes into `out`, which must hold
+// FRAME_ENCODED_MAX(length). Returns the bytes written, delimiter included,
+// or 0 if the packet is too long.
+size_t frame_encode(const uint8_t *packet, size_t length, uint8_t *out);
+
+void frame_decoder_init(frame_decoder_t *decoder);
+size_t frame_decoder_size(void);
+
+// Feed received bytes. Stops at the first good frame: points *packet at it
+// (valid until the next call) and sets *packet_length. Returns the bytes
+// consumed; call again with the rest. *packet_length is 0 if `length` bytes
+// went in without completing a frame (an empty packet is never handed back,
+// every real one starts with its type byte).
+size_t frame_decoder_feed(frame_decoder_t *decoder, const uint8_t *data, size_t length,
+                          const uint8_t **packet, size_t *packet_length);
+
+#endif // FRAME_CODEC_H
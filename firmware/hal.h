@@ -0,0 +1,127 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Hardware abstraction: everything the firmware needs from TI-RTOS and the
+// SimpleLink drivers goes through here. hal_ti.c implements it for the
+// CC2652; tools/hal_host.c implements it on Linux in virtual time, with a
+// simulated ADXL345 on the I2C bus and the radio writing frames to a pty
+// (make host).
+//
+// Timeouts are in milliseconds. Callbacks marked "interrupt context" may run
+// from an ISR on the target: post/wake only, no blocking.
+
+#define HAL_NO_WAIT 0
+#define HAL_WAIT_FOREVER UINT32_MAX
+
+/* Time -------------------------------------------------------------------- */
+
+uint64_t hal_time_us(void);           // monotonic, since hal_time_init
+bool hal_time_init(void);
+void hal_delay_ms(uint32_t ms);       // blocks the calling task
+
+// Free-running counter for profiling, hal_cycles_hz() counts per second:
+// the M4's DWT cycle counter on the target (running from hal_time_init,
+// stops while the core sleeps), thread CPU time in ns on the host. Wraps,
+// only differences mean anything.
+uint32_t hal_cycles(void);
+uint32_t hal_cycles_hz(void);
+
+/* Interrupt lock ---------------------------------------------------------- */
+
+uintptr_t hal_irq_disable(void);
+void hal_irq_restore(uintptr_t key);
+
+/* Tasks and synchronisation ----------------------------------------------- */
+
+typedef struct hal_task *hal_task_t;
+typedef struct hal_sem *hal_sem_t;
+typedef struct hal_mbox *hal_mbox_t;
+typedef void (*hal_task_fn_t)(void);
+
+typedef struct {
+    uint32_t stack_used;    // high water mark, bytes
+    uint32_t cpu_percent;   // since the previous call
+} hal_task_stat_t;
+
+// Higher priority runs first. `stack` is the task's stack on the target
+// (static, stack_size bytes); the host uses its own.
+hal_task_t hal_task_create(const char *name, hal_task_fn_t fn, int priority,
+                           uint8_t *stack, size_t stack_size);
+bool hal_task_stat(hal_task_t task, hal_task_stat_t *stat);
+uint32_t hal_cpu_load(void);          // percent, whole system
+void hal_start(void);                 // start the tasks, doesn't return on the target
+
+// Counting semaphore, or binary (posts don't accumulate). Post is
+// interrupt safe.
+hal_sem_t hal_sem_create(bool binary);
+void hal_sem_post(hal_sem_t sem);
+bool hal_sem_pend(hal_sem_t sem, uint32_t timeout_ms);
+
+// Fixed-size message queue
+hal_mbox_t hal_mbox_create(size_t msg_size, unsigned depth);
+bool hal_mbox_post(hal_mbox_t mbox, const void *msg, uint32_t timeout_ms);
+bool hal_mbox_pend(hal_mbox_t mbox, void *msg, uint32_t timeout_ms);
+
+/* I2C --------------------------------------------------------------------- */
+
+typedef struct hal_i2c_transaction hal_i2c_transaction_t;
+
+// Interrupt context, once per transaction, in the order they were queued
+typedef void (*hal_i2c_callback_t)(hal_i2c_transaction_t *transaction, bool ok);
+
+struct hal_i2c_transaction {
+    const uint8_t *write_buf;
+    size_t write_count;
+    uint8_t *read_buf;
+    size_t read_count;
+    uint8_t address;
+    hal_i2c_callback_t callback;
+    void *context;            // the callback's, the HAL doesn't touch it
+};
+
+#define HAL_I2C_QUEUE_MAX 72  // transactions in flight: two full ADXL345 FIFOs + register access
+
+// Opening an open bus is fine (several devices share it)
+bool hal_i2c_open(uint32_t bit_rate);
+// Queue a write-then-read transaction and return; `callback` reports the
+// result. The transaction must stay valid until then.
+bool hal_i2c_queue(hal_i2c_transaction_t *transaction);
+void hal_i2c_cancel(void);            // fail everything queued
+
+/* GPIO -------------------------------------------------------------------- */
+
+typedef void (*hal_gpio_isr_t)(uint8_t index);
+
+#define HAL_GPIO_MAX 8
+
+// Input, no pull, `isr` (interrupt context, gets `index`) on every rising edge
+bool hal_gpio_enable_int(uint8_t index, hal_gpio_isr_t isr);
+
+/* Radio and host UART ----------------------------------------------------- */
+
+// One packet to the coordinator
+bool hal_radio_send(const uint8_t *packet, size_t length);
+// Coordinator: one packet to the device at network address `address`
+bool hal_radio_send_to(uint16_t address, const uint8_t *packet, size_t length);
+
+// Packets addressed to this device, `callback` gets each one with the
+// sender's network address and the link quality it arrived at (interrupt
+// context). The packet stays valid only for the call. hal_ti.c has no
+// Zigbee stack yet, so there these are the packets that come framed over
+// the host UART (the backend's ACKs to a node plugged into the server)
+// while no hal_uart_set_receive callback takes its bytes.
+typedef void (*hal_radio_receive_t)(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi);
+void hal_radio_set_receive(hal_radio_receive_t callback);
+
+bool hal_uart_open(uint32_t baud_rate);
+bool hal_uart_write(const uint8_t *data, size_t length);
+
+// Bytes from the host as they arrive (interrupt context, valid for the call)
+typedef void (*hal_uart_receive_t)(const uint8_t *data, size_t length);
+void hal_uart_set_receive(hal_uart_receive_t callback);
+
+#endif // HAL_H
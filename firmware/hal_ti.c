@@ -0,0 +1,369 @@
+#include "hal.h"
+#include "config.h"
+#include "frame_codec.h"
+#include <ti/drivers/GPIO.h>
+#include <ti/drivers/I2C.h>
+#include <ti/drivers/UART2.h>
+#include <ti/drivers/dpl/ClockP.h>
+#include <ti/drivers/dpl/HwiP.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Mailbox.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/utils/Load.h>
+
+// CC2652 / TI-RTOS implementation of hal.h
+
+#define HAL_MAX_TASKS 4
+
+/* Time ---------------------------------------------------------------------
+ * The TI-RTOS tick on CC26xx is 10us and the 32-bit tick count wraps after
+ * ~12 hours, so we accumulate elapsed microseconds ourselves. Fine as long as
+ * hal_time_us() gets called at least once per wrap (the heartbeat alone does).
+ */
+
+static uint32_t tick_period_us = 0;
+static uint32_t last_ticks = 0;
+static uint64_t elapsed_us = 0;
+
+// Cortex-M4 debug registers: DEMCR.TRCENA powers the DWT, CTRL.CYCCNTENA
+// starts the cycle counter. Works without a debugger attached.
+#define CORE_DEMCR (*(volatile uint32_t *)0xE000EDFCu)
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000u)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004u)
+#define DEMCR_TRCENA (1u << 24)
+#define DWT_CTRL_CYCCNTENA (1u << 0)
+
+bool hal_time_init(void) {
+    tick_period_us = ClockP_getSystemTickPeriod();
+    last_ticks = ClockP_getSystemTicks();
+    elapsed_us = 0;
+
+    CORE_DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+    return tick_period_us != 0;
+}
+
+uint32_t hal_cycles(void) {
+    return DWT_CYCCNT;
+}
+
+uint32_t hal_cycles_hz(void) {
+    return CPU_CLOCK_HZ;
+}
+
+uint64_t hal_time_us(void) {
+    uintptr_t key = HwiP_disable();
+    uint32_t ticks = ClockP_getSystemTicks();
+
+    elapsed_us += (uint64_t)(ticks - last_ticks) * tick_period_us;
+    last_ticks = ticks;
+
+    uint64_t now = elapsed_us;
+    HwiP_restore(key);
+    return now;
+}
+
+// Kernel calls round down to whole ticks, add one so we never wake early
+static uint32_t ms_to_ticks(uint32_t ms) {
+    if (ms == HAL_WAIT_FOREVER) {
+        return BIOS_WAIT_FOREVER;
+    }
+    if (ms == HAL_NO_WAIT) {
+        return BIOS_NO_WAIT;
+    }
+    return (uint32_t)((uint64_t)ms * 1000 / Clock_tickPeriod) + 1;
+}
+
+void hal_delay_ms(uint32_t ms) {
+    Task_sleep(ms_to_ticks(ms));
+}
+
+/* Interrupt lock ---------------------------------------------------------- */
+
+uintptr_t hal_irq_disable(void) {
+    return HwiP_disable();
+}
+
+void hal_irq_restore(uintptr_t key) {
+    HwiP_restore(key);
+}
+
+/* Tasks and synchronisation ----------------------------------------------- */
+
+struct hal_task {
+    Task_Struct task;
+    hal_task_fn_t fn;
+};
+
+static struct hal_task tasks[HAL_MAX_TASKS];
+static size_t task_count = 0;
+
+static void task_entry(UArg arg0, UArg arg1) {
+    (void)arg1;
+    ((struct hal_task *)arg0)->fn();
+}
+
+hal_task_t hal_task_create(const char *name, hal_task_fn_t fn, int priority,
+                           uint8_t *stack, size_t stack_size) {
+    Task_Params params;
+    (void)name;
+
+    if (task_count >= HAL_MAX_TASKS) {
+        return NULL;
+    }
+
+    struct hal_task *t = &tasks[task_count++];
+    t->fn = fn;
+
+    Task_Params_init(&params);
+    params.priority = priority;
+    params.stack = stack;
+    params.stackSize = stack_size;
+    params.arg0 = (UArg)t;
+    Task_construct(&t->task, task_entry, &params, NULL);
+    return t;
+}
+
+// CPU load needs the Load module enabled in the TI-RTOS .cfg
+bool hal_task_stat(hal_task_t task, hal_task_stat_t *stat) {
+    Task_Handle handle = Task_handle(&task->task);
+    Task_Stat ts;
+    Load_Stat load;
+
+    Task_stat(handle, &ts);
+    stat->stack_used = ts.used;
+    stat->cpu_percent = Load_getTaskLoad(handle, &load) ? Load_calculateLoad(&load) : 0;
+    return true;
+}
+
+uint32_t hal_cpu_load(void) {
+    return Load_getCPULoad();
+}
+
+void hal_start(void) {
+    BIOS_start();
+}
+
+hal_sem_t hal_sem_create(bool binary) {
+    Semaphore_Params params;
+
+    Semaphore_Params_init(&params);
+    params.mode = binary ? Semaphore_Mode_BINARY : Semaphore_Mode_COUNTING;
+    return (hal_sem_t)Semaphore_create(0, &params, NULL);
+}
+
+void hal_sem_post(hal_sem_t sem) {
+    Semaphore_post((Semaphore_Handle)sem);
+}
+
+bool hal_sem_pend(hal_sem_t sem, uint32_t timeout_ms) {
+    return Semaphore_pend((Semaphore_Handle)sem, ms_to_ticks(timeout_ms));
+}
+
+hal_mbox_t hal_mbox_create(size_t msg_size, unsigned depth) {
+    return (hal_mbox_t)Mailbox_create(msg_size, depth, NULL, NULL);
+}
+
+bool hal_mbox_post(hal_mbox_t mbox, const void *msg, uint32_t timeout_ms) {
+    return Mailbox_post((Mailbox_Handle)mbox, (void *)msg, ms_to_ticks(timeout_ms));
+}
+
+bool hal_mbox_pend(hal_mbox_t mbox, void *msg, uint32_t timeout_ms) {
+    return Mailbox_pend((Mailbox_Handle)mbox, msg, ms_to_ticks(timeout_ms));
+}
+
+/* I2C ----------------------------------------------------------------------
+ * The driver runs in callback mode and completes transactions in the order
+ * they were queued, so the driver-side structs are a ring: a slot is free
+ * again once its callback has run.
+ */
+
+static I2C_Handle i2c_handle = NULL;
+static I2C_Transaction i2c_ring[HAL_I2C_QUEUE_MAX];
+static size_t i2c_head = 0;
+static volatile size_t i2c_pending = 0;
+
+static void i2c_callback(I2C_Handle handle, I2C_Transaction *transaction, bool status) {
+    hal_i2c_transaction_t *t = transaction->arg;
+    (void)handle;
+
+    i2c_pending--;
+    t->callback(t, status);
+}
+
+bool hal_i2c_open(uint32_t bit_rate) {
+    I2C_Params params;
+
+    if (i2c_handle != NULL) {
+        return true;
+    }
+
+    I2C_Params_init(&params);
+    params.bitRate = bit_rate >= 400000 ? I2C_400kHz : I2C_100kHz;
+    params.transferMode = I2C_MODE_CALLBACK;
+    params.transferCallbackFxn = i2c_callback;
+
+    i2c_handle = I2C_open(0, &params);
+    return i2c_handle != NULL;
+}
+
+bool hal_i2c_queue(hal_i2c_transaction_t *transaction) {
+    uintptr_t key = HwiP_disable();
+    if (i2c_pending >= HAL_I2C_QUEUE_MAX) {
+        HwiP_restore(key);
+        return false;
+    }
+    I2C_Transaction *t = &i2c_ring[i2c_head];
+    i2c_head = (i2c_head + 1) % HAL_I2C_QUEUE_MAX;
+    i2c_pending++;
+    HwiP_restore(key);
+
+    t->writeBuf = (void *)transaction->write_buf;
+    t->writeCount = transaction->write_count;
+    t->readBuf = transaction->read_buf;
+    t->readCount = transaction->read_count;
+    t->slaveAddress = transaction->address;
+    t->arg = transaction;
+
+    if (!I2C_transfer(i2c_handle, t)) {
+        // nothing queued after all, give the slot back
+        key = HwiP_disable();
+        i2c_head = (i2c_head + HAL_I2C_QUEUE_MAX - 1) % HAL_I2C_QUEUE_MAX;
+        i2c_pending--;
+        HwiP_restore(key);
+        return false;
+    }
+    return true;
+}
+
+void hal_i2c_cancel(void) {
+    // completes everything queued with a failed status
+    I2C_cancel(i2c_handle);
+}
+
+/* GPIO -------------------------------------------------------------------- */
+
+static hal_gpio_isr_t gpio_isrs[HAL_GPIO_MAX];
+
+static void gpio_callback(uint_least8_t index) {
+    if (index < HAL_GPIO_MAX && gpio_isrs[index] != NULL) {
+        gpio_isrs[index]((uint8_t)index);
+    }
+}
+
+bool hal_gpio_enable_int(uint8_t index, hal_gpio_isr_t isr) {
+    if (index >= HAL_GPIO_MAX) {
+        return false;
+    }
+
+    gpio_isrs[index] = isr;
+    GPIO_setConfig(index, GPIO_CFG_IN_NOPULL | GPIO_CFG_IN_INT_RISING);
+    GPIO_setCallback(index, gpio_callback);
+    GPIO_enableInt(index);
+    return true;
+}
+
+/* Radio and host UART ----------------------------------------------------- */
+
+bool hal_radio_send(const uint8_t *packet, size_t length) {
+    // In real implementation, would use Zigbee AF (Application Framework) to send
+    // af_DataRequest(packet, length, COORDINATOR_ADDR, ...);
+    // TODO: implement actual transmission, wait for ACK with timeout
+    (void)packet;
+    (void)length;
+    return true;
+}
+
+bool hal_radio_send_to(uint16_t address, const uint8_t *packet, size_t length) {
+    // af_DataRequest(packet, length, address, ...), same as above
+    (void)address;
+    (void)packet;
+    (void)length;
+    return true;
+}
+
+static hal_radio_receive_t radio_receive = NULL;
+static frame_decoder_t host_decoder;
+
+void hal_radio_set_receive(hal_radio_receive_t callback) {
+    // In real implementation, the AF incoming message callback
+    // (afIncomingMSGPacket_t) would hand its payload to this, with
+    // srcAddr.addr.shortAddr and LinkQuality. Until then only host_frames()
+    // below delivers.
+    radio_receive = callback;
+}
+
+// A node plugged straight into the server (DEBUG_UART_ENABLE, host_link.h)
+// gets the backend's ACKs on the host UART: framed like everything on that
+// link, handed over as if the coordinator had sent them. Interrupt context.
+static void host_frames(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        const uint8_t *packet;
+        size_t packet_length = 0;
+        size_t used = frame_decoder_feed(&host_decoder, data, length, &packet, &packet_length);
+        data += used;
+        length -= used;
+
+        if (packet_length > 0 && radio_receive != NULL) {
+            radio_receive(packet, packet_length, COORDINATOR_ADDR, UINT8_MAX);
+        }
+    }
+}
+
+static UART2_Handle uart_handle = NULL;
+static hal_uart_receive_t uart_receive = NULL;
+static uint8_t uart_rx[64];  // one read, handed over from the read callback
+
+// Read callback (interrupt context). PARTIAL return mode completes a read
+// with whatever came in once the line goes quiet, so an ACK doesn't wait
+// for 63 more bytes; the driver's ring buffer holds what arrives meanwhile.
+static void uart_read_done(UART2_Handle handle, void *buf, size_t count, void *user_arg,
+                           int_fast16_t status) {
+    (void)user_arg;
+
+    if (status == UART2_STATUS_ECANCELLED) {
+        return;
+    }
+    // the coordinator takes the bytes as they are, a node its ACKs
+    if (count > 0 && uart_receive != NULL) {
+        uart_receive((const uint8_t *)buf, count);
+    } else if (count > 0) {
+        host_frames((const uint8_t *)buf, count);
+    }
+    UART2_read(handle, uart_rx, sizeof(uart_rx), NULL);
+}
+
+bool hal_uart_open(uint32_t baud_rate) {
+    UART2_Params params;
+
+    UART2_Params_init(&params);
+    params.baudRate = baud_rate;
+    params.writeMode = UART2_Mode_BLOCKING;
+    params.readMode = UART2_Mode_CALLBACK;
+    params.readReturnMode = UART2_ReadReturnMode_PARTIAL;
+    params.readCallback = uart_read_done;
+
+    frame_decoder_init(&host_decoder);
+    uart_handle = UART2_open(HOST_UART_INDEX, &params);
+    return uart_handle != NULL &&
+           UART2_read(uart_handle, uart_rx, sizeof(uart_rx), NULL) == UART2_STATUS_SUCCESS;
+}
+
+bool hal_uart_write(const uint8_t *data, size_t length) {
+    size_t written = 0;
+
+    if (uart_handle == NULL) {
+        return false;
+    }
+    return UART2_write(uart_handle, data, length, &written) == UART2_STATUS_SUCCESS &&
+           written == length;
+}
+
+// Without a callback the bytes go to host_frames() instead
+void hal_uart_set_receive(hal_uart_receive_t callback) {
+    uart_receive = callback;
+}
@@ -0,0 +1,36 @@
+#include "host_link.h"
+#include "config.h"
+#include "frame_codec.h"
+#include "hal.h"
+
+static bool uart_open = false;
+static hal_sem_t frame_lock = NULL;  // one frame buffer, and frames mustn't interleave
+static uint8_t frame[FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX)];
+
+bool host_link_init(void) {
+    if (frame_lock == NULL) {
+        frame_lock = hal_sem_create(true);
+        if (frame_lock == NULL) {
+            return false;
+        }
+        hal_sem_post(frame_lock);
+    }
+    if (!uart_open) {
+        uart_open = hal_uart_open(DEBUG_BAUD_RATE);
+    }
+    return uart_open;
+}
+
+// Task context only: transmit (and analysis with TRACE_CAPTURE_ENABLE) on
+// a node, the stack's receive callback on the coordinator
+bool host_link_send(const uint8_t *packet, size_t length) {
+    if (!uart_open) {
+        return false;
+    }
+
+    hal_sem_pend(frame_lock, HAL_WAIT_FOREVER);
+    size_t frame_length = frame_encode(packet, length, frame);
+    bool ok = frame_length > 0 && hal_uart_write(frame, frame_length);
+    hal_sem_post(frame_lock);
+    return ok;
+}
@@ -0,0 +1,17 @@
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Packets to the backend over the UART (USB serial), framed with
+// frame_codec.h. The coordinator forwards everything it receives this way;
+// with DEBUG_UART_ENABLE an end device also copies what it sends, so a node
+// plugged straight into the server works without a coordinator.
+
+// Function prototypes
+bool host_link_init(void);
+bool host_link_send(const uint8_t *packet, size_t length);
+
+#endif // HOST_LINK_H
@@ -1,164 +1,890 @@
 /*
  * Wasche IoT Laundry System - Main Firmware
- * 
+ *
  * This runs on the CC2652 Zigbee nodes attached to washers/dryers
  * Samples accelerometer data, analyzes vibration patterns, sends to coordinator
- * 
+ *
  * Author: Eyuel Woldehanna
  * Date: Fall 2024
  */
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <unistd.h>
 #include "config.h"
+#include "hal.h"
 #include "adxl345.h"
 #include "vibration_analysis.h"
 #include "zigbee_handler.h"
+#include "power_manager.h"
+#include "sample_buffer.h"
+#include "telemetry.h"
+#include "outbox.h"
+#include "scheduler.h"
+#include "systime.h"
+#include "trace_capture.h"
+#include "profile.h"
+#include "state_tracker.h"
+
+#if POWER_MANAGEMENT_ENABLE && !ADXL345_USE_FIFO
+#error "POWER_MANAGEMENT_ENABLE needs ADXL345_USE_FIFO"
+#endif
+
+#if TRACE_CAPTURE_ENABLE && POWER_MANAGEMENT_ENABLE
+#error "TRACE_CAPTURE_ENABLE records at a fixed rate, turn off POWER_MANAGEMENT_ENABLE"
+#endif
+
+// Three TI-RTOS tasks (through hal.h, so the same code runs in the host
+// build), highest priority first:
+//
+//   acquisition  owns the ADXL345s. Runs the event scheduler (scheduler.c):
+//                INT1, FIFO reads queued on the I2C driver, heartbeat,
+//                power mode changes, error recovery. Fills the ping-pong
+//                sample buffer one hop at a time.
+//   analysis     takes full blocks from the sample buffer, runs
+//                vibration_analysis and the power manager, queues results.
+//   transmit     batches a report every TRANSMIT_INTERVAL_MS into telemetry
+//                frames, sent right away on a state change; the frames
+//                double as heartbeats. The outbox (outbox.c) keeps every
+//                report until the backend ACKs its frame, retrying with
+//                backoff, and holds a backlog while the network is gone.
+//
+// With SENSOR_COUNT 2 (a stacked washer/dryer pair) every sensor has its own
+// driver instance, sample blocks, analysis context, state tracker, power
+// mode and outbox queue; its frames carry its sub-id. The sensors share
+// the I2C bus (0x53 and 0x1D) and the tasks, and each sleeps and wakes on
+// its own. Events posted from interrupts set a bit per sensor.
+//
+// A slow FFT or a radio retry only delays the lower-priority tasks; the
+// acquisition task still gets every FIFO batch on time. When all three are
+// blocked TI-RTOS idles the MCU in standby.
 
-// State machine for main loop
 typedef enum {
     STATE_INIT,
     STATE_SAMPLING,
-    STATE_ANALYZING,
-    STATE_TRANSMITTING,
+    STATE_SLEEPING,
     STATE_ERROR
 } app_state_t;
 
-static app_state_t current_state = STATE_INIT;
-static uint32_t last_transmit_time = 0;
-static uint32_t last_heartbeat_time = 0;
+// Acquisition task state per sensor. `dev` first: the driver's callbacks
+// hand back the adxl345_t.
+typedef struct {
+    adxl345_t dev;
+    app_state_t state;
+    uint16_t rate_hz;
+    bool read_in_flight;
+    uint32_t last_read_ms;    // last FIFO drain started, for the backstop timer
+} sensor_t;
+
+typedef enum {
+    TX_RESULT,        // every analysis result, the transmit task picks reports
+    TX_RESULT_NOW,    // last result before sleeping, send right away
+    TX_HEARTBEAT,     // make sure something went out this heartbeat interval
+    TX_PROFILE,       // stage timings, goes out as an extended heartbeat
+    TX_TASKS,         // task stack/CPU usage, the same
+    TX_ACK            // the backend stored a frame
+} tx_kind_t;
+
+typedef struct {
+    tx_kind_t kind;
+    uint8_t sensor;
+    uint16_t seq;     // TX_ACK
+    vibration_result_t result;
+} tx_msg_t;
+
+// Transmit task state per sensor (the reports wait in the outbox)
+typedef struct {
+    machine_state_t last_state;
+    bool have_state;
+    uint32_t last_report_time;
+} tx_sensor_t;
+
+typedef struct {
+    const char *name;
+    hal_task_t handle;
+    uint32_t stack_size;
+    uint32_t stack_used;      // high water mark, bytes
+    uint32_t cpu_percent;     // since the last report
+} task_stats_t;
+
+#if ADXL345_USE_FIFO
+// How long to wait for the watermark interrupt before draining anyway
+// (two batches at the sensor's rate)
+#define FIFO_WAIT_TIMEOUT_MS(rate_hz) (2000 * ADXL345_FIFO_WATERMARK / (rate_hz))
+#endif
+
+#define RECOVERY_DELAY_MS 5000
+
+static bool radio_up = false;  // zigbee_init went through, else on_recovery retries it
+
+_Static_assert(SENSOR_COUNT >= 1 && SENSOR_COUNT <= 8, "one bit per sensor in the event masks");
+
+// Acquisition task state
+static sensor_t sensors[SENSOR_COUNT];
+static const uint8_t sensor_addresses[] = SENSOR_ADDRESSES;
+static const uint8_t sensor_int_gpios[] = SENSOR_INT_GPIOS;
+
+#if ADXL345_USE_FIFO
+// Set from interrupt context, one bit per sensor, taken by the events below
+static volatile uint8_t int_pending = 0;    // INT1 fired
+static volatile uint8_t read_done = 0;      // queued FIFO read finished
+#endif
+
+// Handed from the analysis task to the acquisition task
+static volatile power_mode_t pending_modes[SENSOR_COUNT];
+static volatile uint8_t power_pending = 0;
+
+#if POWER_MANAGEMENT_ENABLE
+// Decided by the analysis task, woken up by the acquisition task
+static power_manager_t power_managers[SENSOR_COUNT];
+#endif
+
+static hal_sem_t block_sem;    // a sample block is ready for analysis
+static hal_mbox_t tx_mailbox;
 
-// Simple delay function (would use proper timer in production)
-void delay_ms(uint32_t ms) {
-    usleep(ms * 1000);
+static uint8_t acq_stack[TASK_ACQ_STACK_SIZE];
+static uint8_t analysis_stack[TASK_ANALYSIS_STACK_SIZE];
+static uint8_t tx_stack[TASK_TX_STACK_SIZE];
+
+static task_stats_t task_stats[] = {
+    {"acquisition", NULL, TASK_ACQ_STACK_SIZE, 0, 0},
+    {"analysis", NULL, TASK_ANALYSIS_STACK_SIZE, 0, 0},
+    {"transmit", NULL, TASK_TX_STACK_SIZE, 0, 0},
+};
+_Static_assert(sizeof(task_stats) / sizeof(task_stats[0]) <= PROFILE_TASKS_MAX, "every task in the task report");
+
+static void on_sensor(void);
+static void on_fifo(void);
+static void on_sample(void);
+static void on_power(void);
+static void on_heartbeat(void);
+static void on_recovery(void);
+static void on_stats(void);
+static void on_profile(void);
+
+static sched_event_t sensor_event = SCHED_EVENT("sensor", on_sensor);
+static sched_event_t fifo_event = SCHED_EVENT("fifo", on_fifo);
+static sched_event_t sample_event = SCHED_EVENT("sample", on_sample);
+static sched_event_t power_event = SCHED_EVENT("power", on_power);
+static sched_event_t heartbeat_event = SCHED_EVENT("heartbeat", on_heartbeat);
+static sched_event_t recovery_event = SCHED_EVENT("recovery", on_recovery);
+static sched_event_t stats_event = SCHED_EVENT("stats", on_stats);
+static sched_event_t profile_event = SCHED_EVENT("profile", on_profile);
+
+#if ADXL345_USE_FIFO
+static void set_bit(volatile uint8_t *bits, uint8_t sensor) {
+    uintptr_t key = hal_irq_disable();
+    *bits |= (uint8_t)(1 << sensor);
+    hal_irq_restore(key);
 }
 
-// Get current time in milliseconds (would use proper RTC in production)
-uint32_t get_time_ms(void) {
-    // TODO: implement proper timestamp using RTC or system timer
-    static uint32_t fake_time = 0;
-    fake_time += 10;  // increment by 10ms each call (roughly)
-    return fake_time;
+static uint8_t take_bits(volatile uint8_t *bits) {
+    uintptr_t key = hal_irq_disable();
+    uint8_t taken = *bits;
+    *bits = 0;
+    hal_irq_restore(key);
+    return taken;
 }
+#endif
 
-int main(void) {
-    accel_data_t accel_data;
-    vibration_result_t vib_result;
-    
-    // Initialization
-    current_state = STATE_INIT;
-    
+static uint8_t sensor_index(const adxl345_t *dev) {
+    return (uint8_t)((const sensor_t *)dev - sensors);
+}
+
+static void queue_tx(tx_kind_t kind, uint8_t sensor, const vibration_result_t *result) {
+    tx_msg_t msg;
+
+    msg.kind = kind;
+    msg.sensor = sensor;
+    if (result != NULL) {
+        msg.result = *result;
+    }
+
+    // never block the caller on the radio, a full queue just drops
+    if (!hal_mbox_post(tx_mailbox, &msg, HAL_NO_WAIT)) {
+        #if DEBUG_UART_ENABLE
+        // uart_print("WARNING: transmit queue full\n");
+        #endif
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Acquisition task
+ * ------------------------------------------------------------------------- */
+
+#if POWER_MANAGEMENT_ENABLE
+// Put a sensor into a power mode. Returns false if the ADXL345 didn't take
+// the new configuration. The analysis task picks up the new rate from the
+// sample blocks.
+static bool apply_power_mode(sensor_t *s, power_mode_t mode) {
+    if (mode == POWER_MODE_SLEEP) {
+        return adxl345_enable_activity_wake(&s->dev, POWER_WAKE_THRESHOLD);
+    }
+
+    uint16_t rate = power_mode_sample_rate(mode);
+    if (!adxl345_resume_fifo(&s->dev, ADXL345_FIFO_WATERMARK, rate)) {
+        return false;
+    }
+    s->rate_hz = rate;
+    sample_buffer_restart(sensor_index(&s->dev));
+    return true;
+}
+#endif
+
+#if ADXL345_USE_FIFO
+// INT1 only fires on a rising edge, so keep a backstop timer in case one
+// gets missed: due when the sensor that has gone longest without a read
+// should have had its next one. Every read pushes it back.
+static void arm_backstop(void) {
+    uint32_t now = systime_ms();
+    uint32_t delay = UINT32_MAX;
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        const sensor_t *s = &sensors[i];
+        if (s->state != STATE_SAMPLING) {
+            continue;
+        }
+        uint32_t timeout = FIFO_WAIT_TIMEOUT_MS(s->rate_hz);
+        uint32_t elapsed = now - s->last_read_ms;
+        uint32_t left = elapsed >= timeout ? 1 : timeout - elapsed;
+        if (left < delay) {
+            delay = left;
+        }
+    }
+
+    if (delay == UINT32_MAX) {
+        scheduler_stop(&sample_event);
+    } else {
+        scheduler_start(&sample_event, delay, 0);
+    }
+}
+#endif
+
+#if !ADXL345_USE_FIFO
+static bool any_sampling(void) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].state == STATE_SAMPLING) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+static void start_sampling(sensor_t *s) {
+    s->state = STATE_SAMPLING;
+
+    #if ADXL345_USE_FIFO
+    s->last_read_ms = systime_ms();
+    arm_backstop();
+    #else
+    scheduler_start(&sample_event, SAMPLE_PERIOD_MS, SAMPLE_PERIOD_MS);
+    #endif
+}
+
+static void stop_sampling(sensor_t *s, app_state_t state) {
+    s->state = state;
+
+    #if ADXL345_USE_FIFO
+    arm_backstop();
+    #else
+    if (!any_sampling()) {
+        scheduler_stop(&sample_event);
+    }
+    #endif
+}
+
+static void enter_error(sensor_t *s) {
     #if DEBUG_UART_ENABLE
-    // Initialize UART for debugging
-    // uart_init(DEBUG_BAUD_RATE);
-    // uart_print("Wasche Node Starting...\n");
+    // uart_print("ERROR: sensor %u entering recovery\n", sensor_index(&s->dev));
+    #endif
+    stop_sampling(s, STATE_ERROR);
+    scheduler_start(&recovery_event, RECOVERY_DELAY_MS, 0);
+}
+
+static void push_sample(sensor_t *s, const accel_data_t *sample, uint32_t taken_ms) {
+    if (sample_buffer_push(sensor_index(&s->dev), sample, taken_ms, s->rate_hz)) {
+        hal_sem_post(block_sem);
+    }
+}
+
+#if ADXL345_USE_FIFO
+// INT1 interrupt context: just hand it to the scheduler
+static void sensor_int1(adxl345_t *dev) {
+    set_bit(&int_pending, sensor_index(dev));
+    scheduler_post(&sensor_event);
+}
+
+// I2C callback context, the last queued FIFO read finished
+static void fifo_read_done(adxl345_t *dev) {
+    set_bit(&read_done, sensor_index(dev));
+    scheduler_post(&fifo_event);
+}
+
+static void start_fifo_read(sensor_t *s) {
+    if (!s->read_in_flight) {
+        s->read_in_flight = adxl345_start_fifo_read(&s->dev, ADXL345_FIFO_SIZE, fifo_read_done);
+        if (!s->read_in_flight) {
+            #if DEBUG_UART_ENABLE
+            // uart_print("WARNING: accelerometer FIFO empty\n");
+            #endif
+        }
+    }
+
+    s->last_read_ms = systime_ms();
+    arm_backstop();
+}
+#endif
+
+static void on_sensor(void) {
+    #if ADXL345_USE_FIFO
+    uint8_t pending = take_bits(&int_pending);
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        if (!(pending & (1 << i))) {
+            continue;
+        }
+
+        if (s->state == STATE_SAMPLING) {
+            start_fifo_read(s);
+        }
+
+        #if POWER_MANAGEMENT_ENABLE
+        if (s->state == STATE_SLEEPING && adxl345_activity_detected(&s->dev)) {
+            if (apply_power_mode(s, power_manager_wake(&power_managers[i], systime_ms()))) {
+                start_sampling(s);
+            } else {
+                enter_error(s);
+            }
+        }
+        #endif
+    }
     #endif
-    
-    // Initialize accelerometer
-    if (!adxl345_init()) {
+}
+
+static void on_fifo(void) {
+    #if ADXL345_USE_FIFO
+    accel_data_t accel_batch[ADXL345_FIFO_SIZE];
+    uint8_t done = take_bits(&read_done);
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        if (!(done & (1 << i))) {
+            continue;
+        }
+
+        PROFILE_START(read_start);
+        s->read_in_flight = false;
+
+        // the newest entry is roughly "now", the rest are one sample period apart
+        size_t count = adxl345_finish_fifo_read(&s->dev, accel_batch);
+        uint32_t now = systime_ms();
+        uint32_t period_ms = 1000 / s->rate_hz;
+
+        if (s->state != STATE_SAMPLING) {
+            continue;
+        }
+
+        for (size_t j = 0; j < count; j++) {
+            push_sample(s, &accel_batch[j], now - (uint32_t)(count - 1 - j) * period_ms);
+        }
+        PROFILE_END(PROFILE_SENSOR_READ, read_start);
+    }
+    #endif
+}
+
+static void on_sample(void) {
+    #if ADXL345_USE_FIFO
+    uint32_t now = systime_ms();
+    bool cancel = false;
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->state != STATE_SAMPLING || now - s->last_read_ms < FIFO_WAIT_TIMEOUT_MS(s->rate_hz)) {
+            continue;
+        }
+
+        if (s->read_in_flight) {
+            // a queued read never completed, fail it (on_fifo runs) and retry next time
+            cancel = true;
+            s->last_read_ms = now;
+        } else {
+            // watermark interrupt didn't show up in time, drain anyway
+            start_fifo_read(s);
+        }
+    }
+
+    if (cancel) {
+        // fails everything on the bus, the other sensors' reads just retry
+        adxl345_cancel_fifo_read(&sensors[0].dev);
+    }
+    arm_backstop();
+    #else
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        accel_data_t accel_data;
+
+        if (s->state != STATE_SAMPLING) {
+            continue;
+        }
+
+        PROFILE_START(read_start);
+        bool ok = adxl345_read_data(&s->dev, &accel_data);
+        PROFILE_END(PROFILE_SENSOR_READ, read_start);
+
+        if (ok) {
+            push_sample(s, &accel_data, systime_ms());
+        } else {
+            // Read failed, maybe connection issue?
+            #if DEBUG_UART_ENABLE
+            // uart_print("WARNING: accelerometer read failed\n");
+            #endif
+        }
+    }
+    #endif
+}
+
+static void on_power(void) {
+    #if POWER_MANAGEMENT_ENABLE
+    uint8_t pending = take_bits(&power_pending);
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        power_mode_t mode = pending_modes[i];
+
+        if (!(pending & (1 << i)) || s->state != STATE_SAMPLING) {
+            continue;
+        }
+
+        if (!apply_power_mode(s, mode)) {
+            enter_error(s);
+        } else if (mode == POWER_MODE_SLEEP) {
+            stop_sampling(s, STATE_SLEEPING);
+        }
+    }
+    #endif
+}
+
+static void on_heartbeat(void) {
+    queue_tx(TX_HEARTBEAT, 0, NULL);
+}
+
+static void on_profile(void) {
+    queue_tx(TX_PROFILE, 0, NULL);
+}
+
+static void on_recovery(void) {
+    bool failed = false;
+
+    // Results queue in the outbox meanwhile, nothing waits for the radio
+    if (!radio_up) {
+        radio_up = zigbee_init();
+        failed = !radio_up;
+    }
+
+    // Try to reinit whichever sensors are down
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->state != STATE_ERROR) {
+            continue;
+        }
+        if (!adxl345_test_connection(&s->dev)) {
+            failed = true;
+            continue;
+        }
+
+        #if POWER_MANAGEMENT_ENABLE
+        // sensor may be half way through a mode change, start over at full rate
+        if (!apply_power_mode(s, power_manager_wake(&power_managers[i], systime_ms()))) {
+            failed = true;
+            continue;
+        }
+        #endif
+
         #if DEBUG_UART_ENABLE
-        // uart_print("ERROR: ADXL345 init failed\n");
+        // uart_print("Sensor %u recovered from error state\n", i);
+        #endif
+        start_sampling(s);
+    }
+
+    if (failed) {
+        scheduler_start(&recovery_event, RECOVERY_DELAY_MS, 0);
+    }
+}
+
+// Stack high water mark and CPU load per task (on the target the CPU
+// numbers need the Load module enabled in the TI-RTOS .cfg), reported in a
+// PKT_TYPE_TASKS packet
+static void on_stats(void) {
+    profile_task_t report[sizeof(task_stats) / sizeof(task_stats[0])];
+
+    for (size_t i = 0; i < sizeof(task_stats) / sizeof(task_stats[0]); i++) {
+        hal_task_stat_t stat;
+
+        if (hal_task_stat(task_stats[i].handle, &stat)) {
+            task_stats[i].stack_used = stat.stack_used;
+            task_stats[i].cpu_percent = stat.cpu_percent;
+        }
+        report[i].stack_used = (uint16_t)task_stats[i].stack_used;
+        report[i].stack_size = (uint16_t)task_stats[i].stack_size;
+        report[i].cpu_percent = (uint8_t)task_stats[i].cpu_percent;
+    }
+
+    profile_set_tasks(report, sizeof(report) / sizeof(report[0]), (uint8_t)hal_cpu_load(),
+                      sample_buffer_overruns());
+    queue_tx(TX_TASKS, 0, NULL);
+}
+
+static void acq_task(void) {
+    if (!systime_init()) {
+        return;  // no clock, nothing else will work either
+    }
+
+    scheduler_init();
+    scheduler_add(&sensor_event);
+    scheduler_add(&fifo_event);
+    scheduler_add(&sample_event);
+    scheduler_add(&power_event);
+    scheduler_add(&heartbeat_event);
+    scheduler_add(&recovery_event);
+    scheduler_add(&stats_event);
+    scheduler_add(&profile_event);
+
+    // Initialize the accelerometers, a failed one waits for recovery
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_t *s = &sensors[i];
+        bool sensor_ok = adxl345_init(&s->dev, sensor_addresses[i], sensor_int_gpios[i]);
+
+        s->state = STATE_INIT;
+        s->rate_hz = SAMPLE_RATE_HZ;
+        s->read_in_flight = false;
+
+        #if ADXL345_USE_FIFO
+        // Sensor buffers samples, we wake once per watermark instead of every 10ms
+        sensor_ok = sensor_ok && adxl345_fifo_init(&s->dev, ADXL345_FIFO_WATERMARK, sensor_int1);
         #endif
-        current_state = STATE_ERROR;
-    }
-    
-    // Initialize vibration analysis
-    vibration_analysis_init();
-    
-    // Initialize Zigbee
-    if (!zigbee_init()) {
+
+        if (!sensor_ok) {
+            #if DEBUG_UART_ENABLE
+            // uart_print("ERROR: ADXL345 %u init failed\n", i);
+            #endif
+            s->state = STATE_ERROR;
+        }
+    }
+
+    // Initialize Zigbee. Sampling doesn't wait for it, the outbox holds
+    // on to the results until frames get through.
+    radio_up = zigbee_init();
+    if (!radio_up) {
         #if DEBUG_UART_ENABLE
         // uart_print("ERROR: Zigbee init failed\n");
         #endif
-        current_state = STATE_ERROR;
+        scheduler_start(&recovery_event, RECOVERY_DELAY_MS, 0);
     }
-    
-    if (current_state != STATE_ERROR) {
-        current_state = STATE_SAMPLING;
+
+    scheduler_start(&heartbeat_event, HEARTBEAT_INTERVAL_MS, HEARTBEAT_INTERVAL_MS);
+    scheduler_start(&stats_event, TASK_STATS_INTERVAL_MS, TASK_STATS_INTERVAL_MS);
+    #if PROFILE_ENABLE
+    profile_init(systime_ms());
+    scheduler_start(&profile_event, PROFILE_REPORT_INTERVAL_MS, PROFILE_REPORT_INTERVAL_MS);
+    #endif
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].state != STATE_ERROR) {
+            start_sampling(&sensors[i]);
+        } else {
+            enter_error(&sensors[i]);
+        }
+    }
+    #if DEBUG_UART_ENABLE
+    // uart_print("Init complete. Node ID: 0x%04X, %u sensors\n", NODE_ID, SENSOR_COUNT);
+    #endif
+
+    scheduler_run();
+}
+
+/* ---------------------------------------------------------------------------
+ * Analysis task
+ * ------------------------------------------------------------------------- */
+
+// One analysis context (and tracker) per sensor
+static vibration_ctx_t contexts[SENSOR_COUNT];
+#if STATE_TRACKER_ENABLE
+static state_tracker_t trackers[SENSOR_COUNT];
+#endif
+
+static void analyze_block(sample_block_t *block) {
+    vibration_result_t result;
+    uint8_t sensor = block->sensor;
+    vibration_ctx_t *ctx = &contexts[sensor];
+    uint32_t period_ms = 1000 / block->rate_hz;
+
+    if (block->rate_hz != ctx->rate_hz) {
+        vibration_ctx_set_sample_rate(ctx, block->rate_hz);
+    }
+
+    for (uint16_t i = 0; i < ANALYSIS_HOP_SIZE; i++) {
+        PROFILE_START(add_start);
+        vibration_ctx_add_sample(ctx, &block->samples[i]);
+        PROFILE_END(PROFILE_ADD_SAMPLE, add_start);
+
+        if (!vibration_ctx_compute(ctx, &result)) {
+            continue;
+        }
+        result.timestamp = block->last_ms - (uint32_t)(ANALYSIS_HOP_SIZE - 1 - i) * period_ms;
+
+        #if STATE_TRACKER_ENABLE
+        // report the cycle, not every window's guess
+        result.state = state_tracker_update(&trackers[sensor], &result);
+        #endif
+
+        #if POWER_MANAGEMENT_ENABLE
+        // Let the machine state decide the sample rate / sleep
+        power_manager_t *pm = &power_managers[sensor];
+        power_mode_t old_mode = power_manager_get_mode(pm);
+        power_mode_t new_mode = power_manager_update(pm, result.state, result.timestamp);
+
+        if (new_mode != old_mode) {
+            pending_modes[sensor] = new_mode;
+            set_bit(&power_pending, sensor);
+            scheduler_post(&power_event);
+
+            if (new_mode == POWER_MODE_SLEEP) {
+                // still report the last result before going quiet
+                queue_tx(TX_RESULT_NOW, sensor, &result);
+                continue;
+            }
+        }
+        #endif
+
+        queue_tx(TX_RESULT, sensor, &result);
+    }
+}
+
+static void analysis_task(void) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        vibration_ctx_init(&contexts[i], SAMPLE_RATE_HZ, NULL);
+
+        #if STATE_TRACKER_ENABLE
+        state_tracker_init(&trackers[i]);
+        #endif
+
+        #if POWER_MANAGEMENT_ENABLE
+        power_manager_init(&power_managers[i]);
+        #endif
+    }
+
+    #if TRACE_CAPTURE_ENABLE
+    trace_capture_init();
+    #endif
+
+    while (1) {
+        hal_sem_pend(block_sem, HAL_WAIT_FOREVER);
+
+        sample_block_t *block;
+        while ((block = sample_buffer_take()) != NULL) {
+            #if TRACE_CAPTURE_ENABLE
+            // the first sensor only, a trace is one sensor's
+            if (block->sensor == 0) {
+                trace_capture_block(block->samples, ANALYSIS_HOP_SIZE, block->last_ms, block->rate_hz);
+            }
+            #endif
+            analyze_block(block);
+            sample_buffer_release(block);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Transmit task
+ * ------------------------------------------------------------------------- */
+
+static uint32_t last_frame_time = 0;
+static tx_sensor_t tx_sensors[SENSOR_COUNT];
+static outbox_t outbox;
+
+static bool send_timed(const uint8_t *frame, size_t length) {
+    PROFILE_START(send_start);
+    bool ok = zigbee_send_frame(frame, length);
+    PROFILE_END(PROFILE_SEND, send_start);
+    return ok;
+}
+
+static void send_frame(const uint8_t *frame, size_t length) {
+    if (send_timed(frame, length)) {
+        last_frame_time = systime_ms();
+
         #if DEBUG_UART_ENABLE
-        // uart_print("Init complete. Node ID: 0x%04X\n", NODE_ID);
+        // uart_print("Sent frame: %u bytes, flags 0x%02X\n", length, frame[3]);
         #endif
+    } else {
+        // the outbox sends it again
+        #if DEBUG_UART_ENABLE
+        // uart_print("WARNING: transmission failed\n");
+        #endif
+    }
+}
+
+// Whatever the outbox has due: a retry, or the next frame
+static void send_pending(void) {
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    size_t length = outbox_poll(&outbox, NODE_ID, systime_ms(), frame);
+
+    if (length > 0) {
+        send_frame(frame, length);
+    }
+}
+
+// Heartbeat only, no reports, nothing to ACK
+static void send_empty_frame(void) {
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    telemetry_t empty;
+
+    telemetry_init(&empty);
+    send_frame(frame, telemetry_encode(&empty, NODE_ID, 0, 0, systime_ms(), frame));
+}
+
+#if PROFILE_ENABLE
+// Stats since the last report; counts as a heartbeat at the backend
+static void send_profile(void) {
+    uint8_t packet[PROFILE_PACKET_MAX];
+    size_t length = profile_encode(NODE_ID, systime_ms(), packet);
+
+    if (send_timed(packet, length)) {
+        last_frame_time = systime_ms();
+    }
+}
+#endif
+
+// Task stack/CPU usage from on_stats; also counts as a heartbeat
+static void send_tasks(void) {
+    uint8_t packet[PROFILE_TASKS_PACKET_MAX];
+    size_t length = profile_encode_tasks(NODE_ID, systime_ms(), packet);
+
+    if (send_timed(packet, length)) {
+        last_frame_time = systime_ms();
     }
-    
-    // Main loop
+}
+
+// Radio receive context. A full queue loses the ACK, which only costs a retry.
+static void on_ack(uint16_t seq) {
+    tx_msg_t msg;
+
+    msg.kind = TX_ACK;
+    msg.sensor = 0;
+    msg.seq = seq;
+    hal_mbox_post(tx_mailbox, &msg, HAL_NO_WAIT);
+}
+
+static void on_result(uint8_t sensor, const vibration_result_t *result) {
+    tx_sensor_t *tx = &tx_sensors[sensor];
+    bool changed = !tx->have_state || result->state != tx->last_state;
+
+    tx->last_state = result->state;
+    tx->have_state = true;
+
+    if (!changed && result->timestamp - tx->last_report_time < TRANSMIT_INTERVAL_MS) {
+        return;
+    }
+
+    outbox_add(&outbox, sensor, result);
+    tx->last_report_time = result->timestamp;
+
+    if (changed) {
+        outbox_flush(&outbox, sensor, TELEMETRY_FLAG_STATE_CHANGE);
+    }
+}
+
+static void tx_task(void) {
+    tx_msg_t msg;
+
+    outbox_init(&outbox);
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        tx_sensors[i].have_state = false;
+        tx_sensors[i].last_report_time = 0;
+    }
+    zigbee_set_ack_handler(on_ack);
+
     while (1) {
-        uint32_t current_time = get_time_ms();
-        
-        switch (current_state) {
-            case STATE_SAMPLING:
-                // Read accelerometer data
-                if (adxl345_read_data(&accel_data)) {
-                    vibration_analysis_add_sample(&accel_data);
-                    
-                    // Check if we have enough samples to analyze
-                    if (vibration_analysis_compute(&vib_result)) {
-                        current_state = STATE_ANALYZING;
+        // sleep until a message arrives or the outbox has a frame due
+        // (a full one, the oldest report waited long enough, a retry)
+        if (!hal_mbox_pend(tx_mailbox, &msg, outbox_timeout(&outbox, systime_ms()))) {
+            send_pending();
+            continue;
+        }
+
+        switch (msg.kind) {
+            case TX_HEARTBEAT: {
+                // queued reports carry the heartbeat; with nothing queued an
+                // empty frame does, unless a frame went out recently anyway
+                bool queued = false;
+                for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+                    if (outbox_unsent(&outbox, i) > 0) {
+                        outbox_flush(&outbox, i, 0);
+                        queued = true;
                     }
-                } else {
-                    // Read failed, maybe connection issue?
-                    #if DEBUG_UART_ENABLE
-                    // uart_print("WARNING: accelerometer read failed\n");
-                    #endif
                 }
-                
-                delay_ms(SAMPLE_PERIOD_MS);
+                if (!queued && systime_ms() - last_frame_time >= HEARTBEAT_INTERVAL_MS / 2) {
+                    send_empty_frame();
+                }
                 break;
-                
-            case STATE_ANALYZING:
-                // Analysis already done by vibration_analysis_compute()
-                // Just transition to transmit state
-                current_state = STATE_TRANSMITTING;
+            }
+
+            case TX_PROFILE:
+                #if PROFILE_ENABLE
+                send_profile();
+                #endif
                 break;
-                
-            case STATE_TRANSMITTING:
-                // Check if it's time to transmit
-                if (current_time - last_transmit_time >= TRANSMIT_INTERVAL_MS) {
-                    if (zigbee_send_data(&vib_result)) {
-                        last_transmit_time = current_time;
-                        
-                        #if DEBUG_UART_ENABLE
-                        // uart_print("Sent data: state=%d, rms=%.2f, freq=%.1fHz\n",
-                        //           vib_result.state, vib_result.rms_magnitude, 
-                        //           vib_result.dominant_freq);
-                        #endif
-                    } else {
-                        #if DEBUG_UART_ENABLE
-                        // uart_print("WARNING: transmission failed\n");
-                        #endif
-                    }
-                }
-                
-                // Send heartbeat if needed
-                if (current_time - last_heartbeat_time >= HEARTBEAT_INTERVAL_MS) {
-                    zigbee_send_heartbeat();
-                    last_heartbeat_time = current_time;
-                }
-                
-                // Go back to sampling
-                current_state = STATE_SAMPLING;
+
+            case TX_TASKS:
+                send_tasks();
                 break;
-                
-            case STATE_ERROR:
-                // In error state, try to recover
-                delay_ms(5000);  // wait 5 seconds
-                
-                // Try to reinit
-                if (adxl345_test_connection() && zigbee_is_connected()) {
-                    #if DEBUG_UART_ENABLE
-                    // uart_print("Recovered from error state\n");
-                    #endif
-                    current_state = STATE_SAMPLING;
-                }
+
+            case TX_ACK:
+                outbox_ack(&outbox, msg.seq);
+                break;
+
+            case TX_RESULT_NOW:
+                outbox_add(&outbox, msg.sensor, &msg.result);
+                outbox_flush(&outbox, msg.sensor, TELEMETRY_FLAG_SLEEPING);
                 break;
-                
+
+            case TX_RESULT:
             default:
-                current_state = STATE_ERROR;
+                on_result(msg.sensor, &msg.result);
                 break;
         }
-        
-        // Watchdog timer would be kicked here in production
+
+        send_pending();
+    }
+}
+
+int main(void) {
+    #if DEBUG_UART_ENABLE
+    // Initialize UART for debugging
+    // uart_init(DEBUG_BAUD_RATE);
+    // uart_print("Wasche Node Starting...\n");
+    #endif
+
+    sample_buffer_init();
+
+    block_sem = hal_sem_create(false);
+    tx_mailbox = hal_mbox_create(sizeof(tx_msg_t), TX_QUEUE_DEPTH);
+    if (block_sem == NULL || tx_mailbox == NULL) {
+        return 1;
     }
-    
-    return 0;  // should never reach here
+
+    task_stats[0].handle = hal_task_create("acquisition", acq_task, TASK_ACQ_PRIORITY,
+                                           acq_stack, sizeof(acq_stack));
+    task_stats[1].handle = hal_task_create("analysis", analysis_task, TASK_ANALYSIS_PRIORITY,
+                                           analysis_stack, sizeof(analysis_stack));
+    task_stats[2].handle = hal_task_create("transmit", tx_task, TASK_TX_PRIORITY,
+                                           tx_stack, sizeof(tx_stack));
+    if (task_stats[0].handle == NULL || task_stats[1].handle == NULL || task_stats[2].handle == NULL) {
+        return 1;
+    }
+
+    hal_start();
+
+    return 0;  // only the host build gets here, when the simulation ends
 }
@@ -0,0 +1,204 @@
+#include "outbox.h"
+#include <string.h>
+
+_Static_assert(OUTBOX_DEPTH > TELEMETRY_BATCH_MAX, "the ring holds more than the frame in flight");
+
+#define RETRY_SHIFT_MAX 10   // doubling stops here whatever OUTBOX_RETRY_MAX_MS says
+
+static telemetry_report_t *at(outbox_queue_t *q, uint16_t i) {
+    return &q->reports[(q->head + i) % OUTBOX_DEPTH];
+}
+
+static const telemetry_report_t *at_const(const outbox_queue_t *q, uint16_t i) {
+    return &q->reports[(q->head + i) % OUTBOX_DEPTH];
+}
+
+void outbox_init(outbox_t *box) {
+    memset(box, 0, sizeof(*box));
+    box->next_seq = 1;
+}
+
+// Reports of the sensor's queue that are in the frame in flight
+static uint16_t in_flight_count(const outbox_t *box, uint8_t sensor) {
+    return box->in_flight && box->sensor == sensor ? box->sending : 0;
+}
+
+uint16_t outbox_unsent(const outbox_t *box, uint8_t sensor) {
+    return box->queues[sensor].count - in_flight_count(box, sensor);
+}
+
+uint32_t outbox_oldest_ms(const outbox_t *box, uint8_t sensor) {
+    const outbox_queue_t *q = &box->queues[sensor];
+    uint16_t first = in_flight_count(box, sensor);
+    return first < q->count ? at_const(q, first)->timestamp : 0;
+}
+
+// Make room: every other unsent report goes, oldest first, except state
+// changes and the newest
+static void thin(outbox_t *box, uint8_t sensor) {
+    outbox_queue_t *q = &box->queues[sensor];
+    uint16_t first = in_flight_count(box, sensor);
+    uint16_t kept = first;
+    int prev_state = first > 0 ? at(q, first - 1)->state : -1;
+
+    for (uint16_t i = first; i < q->count; i++) {
+        telemetry_report_t r = *at(q, i);
+        bool keep = ((i - first) & 1) == 0 || r.state != prev_state || i == q->count - 1;
+
+        prev_state = r.state;
+        if (keep) {
+            *at(q, kept++) = r;
+        }
+    }
+
+    if (kept == q->count) {
+        // nothing but state changes: lose the oldest one not in flight
+        for (uint16_t i = first; i + 1 < q->count; i++) {
+            *at(q, i) = *at(q, i + 1);
+        }
+        kept--;
+    }
+
+    box->thinned += q->count - kept;
+    q->count = kept;
+}
+
+void outbox_add(outbox_t *box, uint8_t sensor, const vibration_result_t *result) {
+    outbox_queue_t *q = &box->queues[sensor];
+
+    if (q->count == OUTBOX_DEPTH) {
+        thin(box, sensor);
+    }
+    telemetry_quantize(result, at(q, q->count));
+    q->count++;
+}
+
+void outbox_flush(outbox_t *box, uint8_t sensor, uint8_t flags) {
+    outbox_queue_t *q = &box->queues[sensor];
+
+    if (outbox_unsent(box, sensor) > 0) {
+        q->flags |= flags;
+        q->due = true;
+    }
+}
+
+// Up to `max` reports from the head of the queue, as many as fit one frame
+static uint8_t fill(const outbox_queue_t *q, uint16_t max, telemetry_t *batch) {
+    uint8_t n = 0;
+
+    telemetry_init(batch);
+    while (n < max && telemetry_add_report(batch, at_const(q, n))) {
+        n++;
+    }
+    return n;
+}
+
+// ms until the sensor's queue should go out, UINT32_MAX for not yet (no
+// reports). Only asked while nothing is in flight.
+static uint32_t send_in(const outbox_t *box, uint8_t sensor, uint32_t now_ms) {
+    const outbox_queue_t *q = &box->queues[sensor];
+    telemetry_t batch;
+
+    if (q->count == 0) {
+        return UINT32_MAX;
+    }
+    if (q->due) {
+        return 0;
+    }
+    fill(q, q->count, &batch);
+    if (telemetry_full(&batch)) {
+        return 0;
+    }
+
+    uint32_t age = now_ms - at_const(q, 0)->timestamp;
+    return age >= HEARTBEAT_INTERVAL_MS ? 0 : HEARTBEAT_INTERVAL_MS - age;
+}
+
+static uint32_t retry_delay(const outbox_t *box, uint16_t node_id) {
+    uint8_t shift = box->tries - 1 < RETRY_SHIFT_MAX ? box->tries - 1 : RETRY_SHIFT_MAX;
+    uint32_t delay = (uint32_t)OUTBOX_ACK_TIMEOUT_MS << shift;
+
+    if (delay > OUTBOX_RETRY_MAX_MS) {
+        delay = OUTBOX_RETRY_MAX_MS;
+    }
+
+    // jitter: a hash of node, frame and attempt, so nodes that lost the
+    // coordinator together don't all come back at once
+    uint32_t hash = ((uint32_t)node_id << 16 | box->seq) * 2654435761u + box->tries * 40503u;
+    return delay + (hash >> 16) % (delay / 4 + 1);
+}
+
+size_t outbox_poll(outbox_t *box, uint16_t node_id, uint32_t now_ms, uint8_t *out) {
+    telemetry_t batch;
+
+    if (box->in_flight) {
+        if ((int32_t)(now_ms - box->retry_ms) < 0) {
+            return 0;
+        }
+        fill(&box->queues[box->sensor], box->sending, &batch);
+        box->retries++;
+    } else {
+        uint8_t sensor = box->next_sensor;
+        uint8_t i;
+
+        for (i = 0; i < SENSOR_COUNT && send_in(box, sensor, now_ms) > 0; i++) {
+            sensor = (uint8_t)((sensor + 1) % SENSOR_COUNT);
+        }
+        if (i == SENSOR_COUNT) {
+            return 0;
+        }
+
+        outbox_queue_t *q = &box->queues[sensor];
+        box->in_flight = true;
+        box->sensor = sensor;
+        box->sending = fill(q, q->count, &batch);
+        box->seq = box->next_seq;
+        box->next_seq = box->next_seq == UINT16_MAX ? 1 : box->next_seq + 1;
+        box->tries = 0;
+        box->flags = 0;
+        box->next_sensor = (uint8_t)((sensor + 1) % SENSOR_COUNT);
+
+        // the frame that empties the queue carries the flush's flags;
+        // otherwise the queue stays due and drains frame after frame
+        if (box->sending == q->count) {
+            box->flags = q->flags;
+            q->flags = 0;
+            q->due = false;
+        }
+    }
+
+    box->tries++;
+    box->frames++;
+    box->retry_ms = now_ms + retry_delay(box, node_id);
+    return telemetry_encode(&batch, node_id, box->flags | TELEMETRY_FLAG_SENSOR(box->sensor),
+                            box->seq, now_ms, out);
+}
+
+uint32_t outbox_timeout(const outbox_t *box, uint32_t now_ms) {
+    if (box->in_flight) {
+        int32_t left = (int32_t)(box->retry_ms - now_ms);
+        return left > 0 ? (uint32_t)left : 0;
+    }
+
+    uint32_t timeout = UINT32_MAX;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        uint32_t in = send_in(box, i, now_ms);
+        if (in < timeout) {
+            timeout = in;
+        }
+    }
+    return timeout;
+}
+
+bool outbox_ack(outbox_t *box, uint16_t seq) {
+    if (!box->in_flight || seq != box->seq) {
+        return false;
+    }
+
+    outbox_queue_t *q = &box->queues[box->sensor];
+    q->head = (uint16_t)((q->head + box->sending) % OUTBOX_DEPTH);
+    q->count -= box->sending;
+    box->in_flight = false;
+    box->acked++;
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+#include "telemetry.h"
+
+// Store-and-forward for telemetry reports
+//
+// Reports queue per sensor in a RAM ring of OUTBOX_DEPTH and leave in
+// telemetry frames with a sequence number. One frame is in flight at a time:
+// its reports stay queued until the backend's PKT_TYPE_ACK for that number
+// comes back (zigbee_handler.h), and it is sent again with the same reports
+// and number (fresh sent_ms, so the ages stay right) OUTBOX_ACK_TIMEOUT_MS
+// later, doubling up to OUTBOX_RETRY_MAX_MS, plus up to a quarter of jitter
+// so a fleet coming back doesn't retry in step. The backend stores a
+// sequence number once and ACKs every copy.
+//
+// While nothing gets through the ring fills up; once ACKs come back it
+// drains in full frames, back to back. A full ring is thinned instead of
+// overwritten: every other report goes, state changes stay, so a long outage
+// comes back at a lower resolution rather than without its beginning.
+//
+// Sequence numbers start at 1 after a reset and skip 0 when they wrap (0 is
+// a frame without reports, never ACKed). Not thread safe, the transmit task
+// owns it.
+
+typedef struct {
+    telemetry_report_t reports[OUTBOX_DEPTH];
+    uint16_t head;            // oldest
+    uint16_t count;
+    uint8_t flags;            // TELEMETRY_FLAG_* for the frame that empties the queue
+    bool due;                 // send what's queued without waiting for a full frame
+} outbox_queue_t;
+
+typedef struct {
+    outbox_queue_t queues[SENSOR_COUNT];
+    uint16_t next_seq;
+    uint8_t next_sensor;      // round robin between the queues
+
+    // The frame in flight: the first `sending` reports of queues[sensor]
+    bool in_flight;
+    uint8_t sensor;
+    uint8_t sending;
+    uint8_t flags;
+    uint16_t seq;
+    uint8_t tries;            // sends so far
+    uint32_t retry_ms;        // when to send it again
+
+    // Since init
+    uint32_t frames;          // sent, retries included
+    uint32_t retries;
+    uint32_t acked;
+    uint32_t thinned;         // reports dropped to make room
+} outbox_t;
+
+// Function prototypes
+void outbox_init(outbox_t *box);
+
+// Queue a result (quantized for telemetry). A full queue is thinned first.
+void outbox_add(outbox_t *box, uint8_t sensor, const vibration_result_t *result);
+
+uint16_t outbox_unsent(const outbox_t *box, uint8_t sensor);      // queued, not in flight
+uint32_t outbox_oldest_ms(const outbox_t *box, uint8_t sensor);   // timestamp of the oldest unsent
+
+// Send the sensor's queued reports as soon as possible, the last frame
+// with `flags`. Without a flush a queue goes out a full frame at a time, or
+// once its oldest report has waited HEARTBEAT_INTERVAL_MS.
+void outbox_flush(outbox_t *box, uint8_t sensor, uint8_t flags);
+
+// The frame to send now, if any: a retry, or the next frame when none is in
+// flight. Builds it into `out` (TELEMETRY_FRAME_MAX bytes) and returns its
+// length, 0 for nothing. A failed send needs nothing else, it's retried
+// like a lost one.
+size_t outbox_poll(outbox_t *box, uint16_t node_id, uint32_t now_ms, uint8_t *out);
+
+// ms until outbox_poll has something, UINT32_MAX for nothing until the next
+// report, flush or ACK
+uint32_t outbox_timeout(const outbox_t *box, uint32_t now_ms);
+
+// The backend stored frame `seq`. Returns false for anything but the frame
+// in flight (a late duplicate ACK).
+bool outbox_ack(outbox_t *box, uint16_t seq);
+
+#endif // OUTBOX_H
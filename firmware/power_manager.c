@@ -0,0 +1,82 @@
+#include "power_manager.h"
+#include "config.h"
+
+// Activity-driven power management
+//
+// Pure decision logic, no hardware access: main.c applies the returned mode
+// to the ADXL345 and the analysis, and tools/power_sim.c runs the same code
+// against recorded traces. One power_manager_t per sensor.
+//
+//   FULL    --(no washing/spinning for POWER_REDUCE_AFTER_MS)--> REDUCED
+//   any     --(IDLE or DONE for POWER_SLEEP_AFTER_MS)--> SLEEP
+//   FULL/REDUCED --(WASHING or SPINNING)--> FULL
+//   SLEEP   --(ADXL345 activity interrupt)--> FULL
+
+void power_manager_init(power_manager_t *pm) {
+    pm->mode = POWER_MODE_FULL;
+    pm->quiet = false;
+    pm->quiet_since = 0;
+    pm->idle = false;
+    pm->idle_since = 0;
+}
+
+power_mode_t power_manager_update(power_manager_t *pm, machine_state_t state, uint32_t now_ms) {
+    // only the activity interrupt gets us out of sleep
+    if (pm->mode == POWER_MODE_SLEEP) {
+        return pm->mode;
+    }
+    
+    if (state == STATE_WASHING || state == STATE_SPINNING) {
+        pm->mode = POWER_MODE_FULL;
+        pm->quiet = false;
+        pm->idle = false;
+        return pm->mode;
+    }
+    
+    if (!pm->quiet) {
+        pm->quiet = true;
+        pm->quiet_since = now_ms;
+    }
+    
+    if (state == STATE_IDLE || state == STATE_DONE) {
+        if (!pm->idle) {
+            pm->idle = true;
+            pm->idle_since = now_ms;
+        }
+    } else {
+        pm->idle = false;
+    }
+    
+    if (pm->idle && now_ms - pm->idle_since >= POWER_SLEEP_AFTER_MS) {
+        pm->mode = POWER_MODE_SLEEP;
+    } else if (pm->mode == POWER_MODE_FULL && now_ms - pm->quiet_since >= POWER_REDUCE_AFTER_MS) {
+        pm->mode = POWER_MODE_REDUCED;
+    }
+    
+    return pm->mode;
+}
+
+power_mode_t power_manager_wake(power_manager_t *pm, uint32_t now_ms) {
+    (void)now_ms;
+    
+    // something moved, assume a cycle is starting
+    pm->mode = POWER_MODE_FULL;
+    pm->quiet = false;
+    pm->idle = false;
+    return pm->mode;
+}
+
+power_mode_t power_manager_get_mode(const power_manager_t *pm) {
+    return pm->mode;
+}
+
+uint16_t power_mode_sample_rate(power_mode_t mode) {
+    switch (mode) {
+        case POWER_MODE_FULL:
+            return SAMPLE_RATE_HZ;
+        case POWER_MODE_REDUCED:
+            return POWER_REDUCED_RATE_HZ;
+        default:
+            return 0;  // sensor isn't streaming in sleep
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vibration_analysis.h"
+
+// Power modes, picked from the classified machine state
+typedef enum {
+    POWER_MODE_FULL,      // SAMPLE_RATE_HZ, machine is washing/spinning
+    POWER_MODE_REDUCED,   // POWER_REDUCED_RATE_HZ, nothing going on right now
+    POWER_MODE_SLEEP      // idle for a while: MCU asleep, ADXL345 activity wake
+} power_mode_t;
+
+// One per sensor
+typedef struct {
+    power_mode_t mode;
+    bool quiet;               // no washing/spinning since quiet_since
+    uint32_t quiet_since;
+    bool idle;                // IDLE (or DONE, just as still) since idle_since
+    uint32_t idle_since;
+} power_manager_t;
+
+// Function prototypes
+void power_manager_init(power_manager_t *pm);
+power_mode_t power_manager_update(power_manager_t *pm, machine_state_t state, uint32_t now_ms);
+power_mode_t power_manager_wake(power_manager_t *pm, uint32_t now_ms);
+power_mode_t power_manager_get_mode(const power_manager_t *pm);
+uint16_t power_mode_sample_rate(power_mode_t mode);
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,202 @@
+#include "profile.h"
+#include "frame_codec.h"
+#include "hal.h"
+#include "zigbee_handler.h"
+#include <string.h>
+
+_Static_assert(PROFILE_PACKET_MAX <= FRAME_PAYLOAD_MAX, "profile report must fit one frame");
+_Static_assert(PROFILE_TASKS_PACKET_MAX <= FRAME_PAYLOAD_MAX, "task report must fit one frame");
+
+static profile_stats_t stats[PROFILE_STAGE_COUNT];
+static uint32_t period_start_ms = 0;
+
+static profile_task_t tasks[PROFILE_TASKS_MAX];
+static uint8_t task_count = 0;
+static uint8_t system_cpu_percent = 0;
+static uint32_t sample_overruns = 0;
+
+static const char *const stage_names[PROFILE_STAGE_COUNT] = {
+    "sensor_read", "add_sample", "rms", "spectrum", "classify", "send",
+};
+
+static void clear(void) {
+    memset(stats, 0, sizeof(stats));
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        stats[i].min = UINT32_MAX;
+    }
+}
+
+void profile_init(uint32_t now_ms) {
+    uintptr_t key = hal_irq_disable();
+    clear();
+    period_start_ms = now_ms;
+    hal_irq_restore(key);
+}
+
+uint8_t profile_bucket(uint32_t cycles) {
+    uint8_t log2 = 0;
+    while (log2 < 31 && (cycles >> (log2 + 1)) != 0) {
+        log2++;
+    }
+    if (log2 <= PROFILE_BUCKET_SHIFT) {
+        return 0;
+    }
+    log2 -= PROFILE_BUCKET_SHIFT;
+    return log2 < PROFILE_BUCKETS ? log2 : PROFILE_BUCKETS - 1;
+}
+
+void profile_record(profile_stage_t stage, uint32_t cycles) {
+    uint8_t bucket = profile_bucket(cycles);
+    uintptr_t key = hal_irq_disable();
+    profile_stats_t *s = &stats[stage];
+
+    s->count++;
+    s->total += cycles;
+    if (cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+    if (s->histogram[bucket] != UINT16_MAX) {
+        s->histogram[bucket]++;
+    }
+    hal_irq_restore(key);
+}
+
+void profile_snapshot(profile_stats_t *out, bool reset) {
+    uintptr_t key = hal_irq_disable();
+    memcpy(out, stats, sizeof(stats));
+    if (reset) {
+        clear();
+    }
+    hal_irq_restore(key);
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t *put_stage(uint8_t *p, uint8_t stage, const profile_stats_t *s) {
+    uint32_t histogram_total = 0;
+    int first = -1;
+    int last = -1;
+
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+        if (s->histogram[b] != 0) {
+            histogram_total += s->histogram[b];
+            last = b;
+            if (first < 0) {
+                first = b;
+            }
+        }
+    }
+
+    *p++ = stage;
+    p = put_varint(p, s->count);
+    p = put_varint(p, s->min);
+    p = put_varint(p, s->max);
+    p = put_varint(p, (uint32_t)(s->total / s->count));
+    *p++ = (uint8_t)first;
+    *p++ = (uint8_t)(last - first + 1);
+
+    for (int b = first; b <= last; b++) {
+        uint32_t share = (s->histogram[b] * 255u + histogram_total / 2) / histogram_total;
+        *p++ = (uint8_t)(share == 0 && s->histogram[b] != 0 ? 1 : share);
+    }
+    return p;
+}
+
+size_t profile_encode(uint16_t node_id, uint32_t now_ms, uint8_t *out) {
+    profile_stats_t snapshot[PROFILE_STAGE_COUNT];
+    uint32_t period_ms;
+    uint8_t *p = out;
+    uint8_t *stage_count;
+
+    profile_snapshot(snapshot, true);
+    period_ms = now_ms - period_start_ms;
+    period_start_ms = now_ms;
+
+    *p++ = PKT_TYPE_PROFILE;
+    p = put_u16(p, node_id);
+    p = put_u32(p, now_ms);
+    p = put_u32(p, hal_cycles_hz());
+    p = put_u32(p, period_ms);
+    *p++ = PROFILE_BUCKET_SHIFT;
+    stage_count = p++;
+    *stage_count = 0;
+
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        if (snapshot[i].count > 0) {
+            p = put_stage(p, (uint8_t)i, &snapshot[i]);
+            (*stage_count)++;
+        }
+    }
+
+    p = put_u16(p, frame_crc16(out, (size_t)(p - out)));
+    return (size_t)(p - out);
+}
+
+void profile_set_tasks(const profile_task_t *latest, uint8_t count, uint8_t cpu_percent,
+                       uint32_t overruns) {
+    if (count > PROFILE_TASKS_MAX) {
+        count = PROFILE_TASKS_MAX;
+    }
+
+    uintptr_t key = hal_irq_disable();
+    memcpy(tasks, latest, count * sizeof(tasks[0]));
+    task_count = count;
+    system_cpu_percent = cpu_percent;
+    sample_overruns = overruns;
+    hal_irq_restore(key);
+}
+
+size_t profile_encode_tasks(uint16_t node_id, uint32_t now_ms, uint8_t *out) {
+    profile_task_t snapshot[PROFILE_TASKS_MAX];
+    uint8_t count, cpu_percent;
+    uint32_t overruns;
+    uint8_t *p = out;
+
+    uintptr_t key = hal_irq_disable();
+    memcpy(snapshot, tasks, sizeof(snapshot));
+    count = task_count;
+    cpu_percent = system_cpu_percent;
+    overruns = sample_overruns;
+    hal_irq_restore(key);
+
+    *p++ = PKT_TYPE_TASKS;
+    p = put_u16(p, node_id);
+    p = put_u32(p, now_ms);
+    *p++ = cpu_percent;
+    p = put_u32(p, overruns);
+    *p++ = count;
+
+    for (uint8_t i = 0; i < count; i++) {
+        p = put_u16(p, snapshot[i].stack_used);
+        p = put_u16(p, snapshot[i].stack_size);
+        *p++ = snapshot[i].cpu_percent;
+    }
+
+    p = put_u16(p, frame_crc16(out, (size_t)(p - out)));
+    return (size_t)(p - out);
+}
+
+const char *profile_stage_name(profile_stage_t stage) {
+    return stage < PROFILE_STAGE_COUNT ? stage_names[stage] : "?";
+}
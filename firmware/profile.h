@@ -0,0 +1,126 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+
+// Stage profiling (PROFILE_ENABLE)
+//
+// PROFILE_START/PROFILE_END around a stage count the hal_cycles() it took
+// into fixed per-stage stats: count, min, max, total and a log2 histogram.
+// Every PROFILE_REPORT_INTERVAL_MS the transmit task sends them as a
+// PKT_TYPE_PROFILE packet, which also counts as the node's heartbeat, and
+// starts a new period. Stages may be recorded from any task.
+//
+//   off  size  field
+//   0    1     packet_type (PKT_TYPE_PROFILE)
+//   1    2     node_id
+//   3    4     sent_ms, node clock (systime_ms)
+//   7    4     cycle_hz, counts per second (CPU clock, 1e9 on the host)
+//   11   4     period_ms, time the stats cover
+//   15   1     bucket_shift, see below
+//   16   1     stage count n
+//   -- n times, stages with no samples left out:
+//        1     stage (profile_stage_t)
+//        ..    varint count, varint min, varint max, varint mean (cycles)
+//        1     first non-empty bucket f
+//        1     buckets sent b
+//        b     share of the samples in buckets f..f+b-1, 1/255ths (rounded,
+//              at least 1 if the bucket isn't empty)
+//   end  2     checksum, CRC-16/CCITT (frame_crc16) over everything before it
+//
+// Bucket 0 holds everything below 2^(bucket_shift+1) cycles, bucket k > 0
+// [2^(k+bucket_shift), 2^(k+bucket_shift+1)), the last one is open ended.
+// Multi-byte fields little-endian, varints LEB128 as in telemetry.h.
+
+typedef enum {
+    PROFILE_SENSOR_READ,    // FIFO batch unpacked and queued (or one polled read)
+    PROFILE_ADD_SAMPLE,     // vibration_analysis_add_sample: magnitude, running sums
+    PROFILE_RMS,            // window RMS
+    PROFILE_SPECTRUM,       // FFT and peak search, or the SDFT band energies
+    PROFILE_CLASSIFY,
+    PROFILE_SEND,           // zigbee_send_frame
+    PROFILE_STAGE_COUNT
+} profile_stage_t;
+
+#define PROFILE_BUCKETS 16
+#define PROFILE_BUCKET_SHIFT 4   // 16 buckets: <32 cycles .. >=2^19 (11ms at 48MHz)
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint16_t histogram[PROFILE_BUCKETS];  // saturates at 65535
+} profile_stats_t;
+
+#define PROFILE_HEADER_SIZE 17
+#define PROFILE_STAGE_MAX (1 + 4 * 5 + 2 + PROFILE_BUCKETS)
+#define PROFILE_PACKET_MAX (PROFILE_HEADER_SIZE + PROFILE_STAGE_COUNT * PROFILE_STAGE_MAX + 2)
+
+#if PROFILE_ENABLE
+#include "hal.h"
+#define PROFILE_START(name) uint32_t name = hal_cycles()
+#define PROFILE_END(stage, name) profile_record((stage), hal_cycles() - (name))
+#else
+#define PROFILE_START(name) ((void)0)
+#define PROFILE_END(stage, name) ((void)0)
+#endif
+
+// Function prototypes
+void profile_init(uint32_t now_ms);
+void profile_record(profile_stage_t stage, uint32_t cycles);
+uint8_t profile_bucket(uint32_t cycles);
+
+// Copy the stats of the current period into `out` (PROFILE_STAGE_COUNT
+// entries), and start a new period if `reset`
+void profile_snapshot(profile_stats_t *out, bool reset);
+
+// Snapshot, reset and build a report into `out` (PROFILE_PACKET_MAX
+// bytes). Returns its length.
+size_t profile_encode(uint16_t node_id, uint32_t now_ms, uint8_t *out);
+
+const char *profile_stage_name(profile_stage_t stage);
+
+// Task report (PKT_TYPE_TASKS)
+//
+// Every TASK_STATS_INTERVAL_MS the node samples each task's stack high water
+// mark and CPU load (profile_set_tasks) and the transmit task sends them,
+// another extended heartbeat. Not part of PKT_TYPE_PROFILE: its worst case
+// already fills a frame.
+//
+//   off  size  field
+//   0    1     packet_type (PKT_TYPE_TASKS)
+//   1    2     node_id
+//   3    4     sent_ms, node clock (systime_ms)
+//   7    1     cpu_percent, whole system since the last report
+//   8    4     sample buffer overruns since boot, all sensors
+//   12   1     task count n
+//   -- n times, in main.c's order (acquisition, analysis, transmit):
+//        2     stack_used, high water mark in bytes
+//        2     stack_size, bytes
+//        1     cpu_percent since the last report
+//   end  2     checksum, CRC-16/CCITT (frame_crc16) over everything before it
+
+#define PROFILE_TASKS_MAX 4
+
+typedef struct {
+    uint16_t stack_used;
+    uint16_t stack_size;
+    uint8_t cpu_percent;
+} profile_task_t;
+
+#define PROFILE_TASKS_HEADER_SIZE 13
+#define PROFILE_TASKS_PACKET_MAX (PROFILE_TASKS_HEADER_SIZE + PROFILE_TASKS_MAX * 5 + 2)
+
+// Latest task numbers for the next report, `count` up to PROFILE_TASKS_MAX
+void profile_set_tasks(const profile_task_t *tasks, uint8_t count, uint8_t cpu_percent,
+                       uint32_t overruns);
+
+// Build a task report from the latest numbers into `out`
+// (PROFILE_TASKS_PACKET_MAX bytes). Returns its length.
+size_t profile_encode_tasks(uint16_t node_id, uint32_t now_ms, uint8_t *out);
+
+#endif // PROFILE_H
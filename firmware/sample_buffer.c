@@ -0,0 +1,87 @@
+#include "sample_buffer.h"
+
+// Per sensor, blocks[fill] is the producer's, blocks[take] the consumer's
+// next. `ready` hands a block over: only the producer sets it, only the
+// consumer clears it.
+typedef struct {
+    sample_block_t blocks[2];
+    uint8_t fill;
+    uint16_t fill_count;
+    uint8_t take;
+} channel_t;
+
+static channel_t channels[SENSOR_COUNT];
+static uint8_t next_channel = 0;     // consumer's round robin
+static volatile uint32_t overruns = 0;
+
+void sample_buffer_init(void) {
+    for (uint8_t s = 0; s < SENSOR_COUNT; s++) {
+        channel_t *c = &channels[s];
+        c->blocks[0].ready = false;
+        c->blocks[1].ready = false;
+        c->blocks[0].sensor = s;
+        c->blocks[1].sensor = s;
+        c->fill = 0;
+        c->take = 0;
+        c->fill_count = 0;
+    }
+    next_channel = 0;
+    overruns = 0;
+}
+
+bool sample_buffer_push(uint8_t sensor, const accel_data_t *sample, uint32_t taken_ms, uint16_t rate_hz) {
+    channel_t *c = &channels[sensor];
+    sample_block_t *block = &c->blocks[c->fill];
+
+    // consumer is still on both blocks
+    if (block->ready) {
+        overruns++;
+        return false;
+    }
+
+    // a block only ever holds one rate
+    if (c->fill_count > 0 && block->rate_hz != rate_hz) {
+        c->fill_count = 0;
+    }
+
+    block->samples[c->fill_count++] = *sample;
+    block->rate_hz = rate_hz;
+    block->last_ms = taken_ms;
+
+    if (c->fill_count < ANALYSIS_HOP_SIZE) {
+        return false;
+    }
+
+    __sync_synchronize();  // samples written before the hand-over
+    block->ready = true;
+    c->fill ^= 1;
+    c->fill_count = 0;
+    return true;
+}
+
+void sample_buffer_restart(uint8_t sensor) {
+    channels[sensor].fill_count = 0;
+}
+
+sample_block_t *sample_buffer_take(void) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        channel_t *c = &channels[next_channel];
+        sample_block_t *block = &c->blocks[c->take];
+
+        next_channel = (uint8_t)((next_channel + 1) % SENSOR_COUNT);
+        if (block->ready) {
+            c->take ^= 1;
+            return block;
+        }
+    }
+    return NULL;
+}
+
+void sample_buffer_release(sample_block_t *block) {
+    __sync_synchronize();  // done reading before the producer may refill
+    block->ready = false;
+}
+
+uint32_t sample_buffer_overruns(void) {
+    return overruns;
+}
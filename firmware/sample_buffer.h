@@ -0,0 +1,41 @@
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+#include "adxl345.h"
+
+// Ping-pong buffer between the acquisition task (producer) and the analysis
+// task (consumer). The producer fills one block of ANALYSIS_HOP_SIZE samples
+// while the consumer works on the other, so a slow analysis never holds up
+// the I2C reads. Single producer, single consumer, no locks. One pair of
+// blocks per sensor (SENSOR_COUNT); the consumer takes whichever is full.
+
+typedef struct {
+    accel_data_t samples[ANALYSIS_HOP_SIZE];
+    uint16_t rate_hz;         // sensor output rate the block was taken at
+    uint32_t last_ms;         // systime_ms() of samples[ANALYSIS_HOP_SIZE - 1]
+    uint8_t sensor;
+    volatile bool ready;      // owned by the consumer until released
+} sample_block_t;
+
+// Function prototypes
+void sample_buffer_init(void);
+
+// Producer: returns true when this sample completed a block, which is now
+// waiting for sample_buffer_take(). Samples arriving while both blocks are
+// full are dropped and counted.
+bool sample_buffer_push(uint8_t sensor, const accel_data_t *sample, uint32_t taken_ms, uint16_t rate_hz);
+
+// Start a fresh block, e.g. after a rate change or sleep
+void sample_buffer_restart(uint8_t sensor);
+
+// Consumer: next full block (in order per sensor, round robin between
+// them), or NULL
+sample_block_t *sample_buffer_take(void);
+void sample_buffer_release(sample_block_t *block);
+
+uint32_t sample_buffer_overruns(void);   // all sensors
+
+#endif // SAMPLE_BUFFER_H
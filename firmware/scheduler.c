@@ -0,0 +1,210 @@
+#include "scheduler.h"
+#include "systime.h"
+#include <stddef.h>
+
+// Timer wheel
+//
+// An armed timer sits in slot (due_ms / SCHED_TICK_MS) % SCHED_WHEEL_SLOTS.
+// Each pass visits the slots for the ticks since the last pass (at most one
+// lap) and fires whatever is due there; timers due on a later lap stay put.
+// Periodic timers re-arm from their due time, not from when they ran, so
+// TRANSMIT/HEARTBEAT intervals don't drift with handler run time.
+
+static sched_event_t *wheel[SCHED_WHEEL_SLOTS];
+static uint32_t wheel_tick = 0;     // last tick visited
+
+static sched_event_t *events[SCHED_MAX_EVENTS];
+static uint8_t event_count = 0;
+static volatile bool posted_any = false;
+
+static uint32_t idle_ms = 0;
+
+// Wrap-safe "a is at or before b"
+static bool time_reached(uint32_t a, uint32_t b) {
+    return (int32_t)(b - a) >= 0;
+}
+
+static void wheel_insert(sched_event_t *event) {
+    uint32_t slot = (event->due_ms / SCHED_TICK_MS) % SCHED_WHEEL_SLOTS;
+
+    event->next = wheel[slot];
+    wheel[slot] = event;
+    event->armed = true;
+}
+
+static void wheel_remove(sched_event_t *event) {
+    uint32_t slot = (event->due_ms / SCHED_TICK_MS) % SCHED_WHEEL_SLOTS;
+
+    for (sched_event_t **link = &wheel[slot]; *link != NULL; link = &(*link)->next) {
+        if (*link == event) {
+            *link = event->next;
+            break;
+        }
+    }
+    event->next = NULL;
+    event->armed = false;
+}
+
+void scheduler_init(void) {
+    for (int i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+        wheel[i] = NULL;
+    }
+    event_count = 0;
+    posted_any = false;
+    idle_ms = 0;
+    wheel_tick = systime_ms() / SCHED_TICK_MS;
+}
+
+bool scheduler_add(sched_event_t *event) {
+    if (event_count >= SCHED_MAX_EVENTS) {
+        return false;
+    }
+
+    event->armed = false;
+    event->posted = false;
+    event->next = NULL;
+    event->runs = 0;
+    event->max_late_ms = 0;
+    events[event_count++] = event;
+    return true;
+}
+
+void scheduler_start(sched_event_t *event, uint32_t delay_ms, uint32_t period_ms) {
+    if (event->armed) {
+        wheel_remove(event);
+    }
+
+    event->due_ms = systime_ms() + delay_ms;
+    event->period_ms = period_ms;
+    wheel_insert(event);
+}
+
+void scheduler_stop(sched_event_t *event) {
+    if (event->armed) {
+        wheel_remove(event);
+    }
+}
+
+void scheduler_post(sched_event_t *event) {
+    event->posted = true;
+    posted_any = true;
+    systime_wake();
+}
+
+static void run_handler(sched_event_t *event) {
+    event->runs++;
+    event->handler();
+}
+
+static void dispatch_posted(void) {
+    while (posted_any) {
+        posted_any = false;
+
+        for (uint8_t i = 0; i < event_count; i++) {
+            if (events[i]->posted) {
+                events[i]->posted = false;
+                run_handler(events[i]);
+            }
+        }
+    }
+}
+
+static void dispatch_timers(uint32_t now) {
+    uint32_t now_tick = now / SCHED_TICK_MS;
+    uint32_t visits = now_tick - wheel_tick + 1;  // current slot again, it may have filled up
+    sched_event_t *ready = NULL;
+
+    if (visits > SCHED_WHEEL_SLOTS) {
+        visits = SCHED_WHEEL_SLOTS;
+    }
+
+    // Unhook everything due first, handlers are free to restart/stop timers
+    for (uint32_t v = 0; v < visits; v++) {
+        sched_event_t **link = &wheel[(now_tick - v) % SCHED_WHEEL_SLOTS];
+
+        while (*link != NULL) {
+            sched_event_t *event = *link;
+
+            if (time_reached(event->due_ms, now)) {
+                *link = event->next;
+                event->armed = false;
+                event->next = ready;
+                ready = event;
+            } else {
+                link = &event->next;
+            }
+        }
+    }
+    wheel_tick = now_tick;
+
+    while (ready != NULL) {
+        sched_event_t *event = ready;
+        ready = event->next;
+        event->next = NULL;
+
+        uint32_t late = now - event->due_ms;
+        if (late > event->max_late_ms) {
+            event->max_late_ms = late;
+        }
+
+        if (event->period_ms > 0) {
+            event->due_ms += event->period_ms;
+            if (time_reached(event->due_ms, now)) {
+                // fell more than a period behind, skip the missed runs
+                event->due_ms = now + event->period_ms;
+            }
+            wheel_insert(event);
+        }
+
+        run_handler(event);
+    }
+}
+
+// Milliseconds until the earliest armed timer
+static uint32_t next_timeout(uint32_t now) {
+    uint32_t timeout = SCHED_IDLE_MAX_MS;
+
+    for (int i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+        for (sched_event_t *event = wheel[i]; event != NULL; event = event->next) {
+            if (time_reached(event->due_ms, now)) {
+                return 0;
+            }
+            if (event->due_ms - now < timeout) {
+                timeout = event->due_ms - now;
+            }
+        }
+    }
+    return timeout;
+}
+
+void scheduler_run_once(void) {
+    dispatch_posted();
+    dispatch_timers(systime_ms());
+
+    if (posted_any) {
+        return;
+    }
+
+    uint32_t now = systime_ms();
+    uint32_t timeout = next_timeout(now);
+    if (timeout == 0) {
+        return;
+    }
+
+    // an interrupt posting between here and the pend leaves the wake
+    // semaphore set, so we can't sleep through it
+    systime_idle(timeout);
+    idle_ms += systime_ms() - now;
+}
+
+void scheduler_run(void) {
+    while (1) {
+        scheduler_run_once();
+
+        // Watchdog timer would be kicked here in production
+    }
+}
+
+uint32_t scheduler_idle_ms(void) {
+    return idle_ms;
+}
@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Event scheduler: timers on a hashed timer wheel plus events posted from
+// interrupts. Handlers run to completion one at a time from scheduler_run(),
+// and the MCU idles (systime_idle) until the next timer is due or something
+// gets posted.
+
+#define SCHED_TICK_MS 10        // wheel slot width
+#define SCHED_WHEEL_SLOTS 32    // one lap = 320ms, longer timers wait for their lap
+#define SCHED_MAX_EVENTS 8
+#define SCHED_IDLE_MAX_MS 60000 // nothing armed: still look around once a minute
+
+typedef void (*sched_handler_t)(void);
+
+typedef struct sched_event {
+    const char *name;
+    sched_handler_t handler;
+    uint32_t due_ms;
+    uint32_t period_ms;         // 0 = one-shot
+    bool armed;
+    volatile bool posted;
+    struct sched_event *next;   // wheel slot chain
+
+    // stats
+    uint32_t runs;
+    uint32_t max_late_ms;       // worst timer dispatch delay past due_ms
+} sched_event_t;
+
+#define SCHED_EVENT(name, handler) {name, handler, 0, 0, false, false, NULL, 0, 0}
+
+// Function prototypes
+void scheduler_init(void);
+bool scheduler_add(sched_event_t *event);
+
+// Run `event` in delay_ms, then every period_ms (0 = once). Restarting an
+// armed timer moves it.
+void scheduler_start(sched_event_t *event, uint32_t delay_ms, uint32_t period_ms);
+void scheduler_stop(sched_event_t *event);
+
+// Run `event` as soon as possible, safe to call from an interrupt
+void scheduler_post(sched_event_t *event);
+
+// Dispatch everything due, then idle until there's more to do
+void scheduler_run_once(void);
+void scheduler_run(void);
+
+uint32_t scheduler_idle_ms(void);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,138 @@
+#include "state_tracker.h"
+#include <math.h>
+
+// Where an observation pushes each state, and how many ms of it that takes.
+// A self entry means the observation argues for staying.
+typedef struct {
+    uint8_t next;             // machine_state_t
+    uint32_t after_ms;
+} tracker_edge_t;
+
+#define TRACKER_ENTER_MS 1000        // ~3 hops of wash/spin to start a cycle
+#define TRACKER_SPIN_MS 1500
+#define TRACKER_RINSE_MS 3000        // spin -> wash again (rinse between spins)
+#define TRACKER_UNLOAD_MS 3000       // handling a finished machine
+#define TRACKER_DRAIN 4              // staying-put windows drain evidence this much faster
+#define TRACKER_GAP_MS 10000         // longer between windows: the node was asleep
+
+#define SELF(s) { (s), 0 }
+
+static const tracker_edge_t edges[4][TRACKER_OBS_COUNT] = {
+    [STATE_IDLE] = {
+        [TRACKER_OBS_QUIET] = SELF(STATE_IDLE),
+        [TRACKER_OBS_WASHING] = { STATE_WASHING, TRACKER_ENTER_MS },
+        [TRACKER_OBS_SPINNING] = { STATE_SPINNING, TRACKER_ENTER_MS },
+        [TRACKER_OBS_ACTIVE] = SELF(STATE_IDLE),
+    },
+    [STATE_WASHING] = {
+        [TRACKER_OBS_QUIET] = { STATE_DONE, TRACKER_DONE_AFTER_WASH_MS },
+        [TRACKER_OBS_WASHING] = SELF(STATE_WASHING),
+        [TRACKER_OBS_SPINNING] = { STATE_SPINNING, TRACKER_SPIN_MS },
+        [TRACKER_OBS_ACTIVE] = SELF(STATE_WASHING),
+    },
+    [STATE_SPINNING] = {
+        [TRACKER_OBS_QUIET] = { STATE_DONE, TRACKER_DONE_AFTER_SPIN_MS },
+        [TRACKER_OBS_WASHING] = { STATE_WASHING, TRACKER_RINSE_MS },
+        [TRACKER_OBS_SPINNING] = SELF(STATE_SPINNING),
+        [TRACKER_OBS_ACTIVE] = SELF(STATE_SPINNING),
+    },
+    [STATE_DONE] = {
+        [TRACKER_OBS_QUIET] = { STATE_IDLE, TRACKER_DONE_HOLD_MS },
+        [TRACKER_OBS_WASHING] = { STATE_WASHING, TRACKER_ENTER_MS },
+        [TRACKER_OBS_SPINNING] = { STATE_SPINNING, TRACKER_ENTER_MS },
+        [TRACKER_OBS_ACTIVE] = { STATE_IDLE, TRACKER_UNLOAD_MS },
+    },
+};
+
+// Idle noise baseline: exponential averages over ~64 windows at rest,
+// quiet = under mean + 4 deviations, kept between half of IDLE_THRESHOLD
+// and most of WASHING_MIN. Starts out at exactly IDLE_THRESHOLD.
+#define NOISE_WINDOWS 64.0f
+#define NOISE_DEVIATIONS 4.0f
+#define NOISE_MIN ((float)IDLE_THRESHOLD * 0.5f)
+#define NOISE_MAX ((float)WASHING_MIN * 0.8f)
+
+void state_tracker_init(state_tracker_t *tracker) {
+    tracker->state = STATE_IDLE;
+    for (int i = 0; i < TRACKER_OBS_COUNT; i++) {
+        tracker->evidence_ms[i] = 0;
+    }
+    tracker->last_ms = 0;
+    tracker->started = false;
+    tracker->noise_mean = (float)IDLE_THRESHOLD * 0.5f;
+    tracker->noise_dev = (float)IDLE_THRESHOLD * 0.5f / NOISE_DEVIATIONS;
+}
+
+float state_tracker_idle_threshold(const state_tracker_t *tracker) {
+    float threshold = tracker->noise_mean + NOISE_DEVIATIONS * tracker->noise_dev;
+    if (threshold < NOISE_MIN) {
+        return NOISE_MIN;
+    }
+    return threshold > NOISE_MAX ? NOISE_MAX : threshold;
+}
+
+tracker_obs_t state_tracker_observe(const state_tracker_t *tracker, const vibration_result_t *result) {
+    if (result->rms_magnitude < state_tracker_idle_threshold(tracker)) {
+        return TRACKER_OBS_QUIET;
+    }
+    switch (result->state) {
+        case STATE_WASHING:
+            return TRACKER_OBS_WASHING;
+        case STATE_SPINNING:
+            return TRACKER_OBS_SPINNING;
+        default:
+            return TRACKER_OBS_ACTIVE;
+    }
+}
+
+static void learn_noise(state_tracker_t *tracker, float rms) {
+    tracker->noise_mean += (rms - tracker->noise_mean) / NOISE_WINDOWS;
+    tracker->noise_dev += (fabsf(rms - tracker->noise_mean) - tracker->noise_dev) / NOISE_WINDOWS;
+}
+
+static void step(state_tracker_t *tracker, tracker_obs_t obs, uint32_t dt) {
+    const tracker_edge_t *edge = &edges[tracker->state][obs];
+    uint32_t drain = dt * TRACKER_DRAIN;
+
+    for (int i = 0; i < TRACKER_OBS_COUNT; i++) {
+        if (i != (int)obs || edge->next == tracker->state) {
+            tracker->evidence_ms[i] = tracker->evidence_ms[i] > drain ? tracker->evidence_ms[i] - drain : 0;
+        }
+    }
+    if (edge->next == tracker->state) {
+        return;
+    }
+
+    tracker->evidence_ms[obs] += dt;
+    if (tracker->evidence_ms[obs] >= edge->after_ms) {
+        tracker->state = (machine_state_t)edge->next;
+        for (int i = 0; i < TRACKER_OBS_COUNT; i++) {
+            tracker->evidence_ms[i] = 0;
+        }
+    }
+}
+
+machine_state_t state_tracker_update(state_tracker_t *tracker, const vibration_result_t *result) {
+    uint32_t dt = tracker->started ? result->timestamp - tracker->last_ms : 0;
+    tracker->last_ms = result->timestamp;
+    tracker->started = true;
+
+    // the node only stops analysing (deep sleep) while the machine is quiet,
+    // so a gap counts as that much quiet, e.g. towards DONE -> IDLE
+    if (dt > TRACKER_GAP_MS) {
+        step(tracker, TRACKER_OBS_QUIET, dt);
+        dt = 0;
+    }
+
+    tracker_obs_t obs = state_tracker_observe(tracker, result);
+
+    // the baseline only learns at rest, and never from anything that
+    // could be the machine itself (or someone unloading it)
+    if ((obs == TRACKER_OBS_QUIET && (tracker->state == STATE_IDLE || tracker->state == STATE_DONE)) ||
+        (obs == TRACKER_OBS_ACTIVE && tracker->state == STATE_IDLE && result->rms_magnitude < NOISE_MAX)) {
+        learn_noise(tracker, result->rms_magnitude);
+    }
+
+    step(tracker, obs, dt);
+    return tracker->state;
+}
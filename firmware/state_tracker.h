@@ -0,0 +1,59 @@
+#ifndef STATE_TRACKER_H
+#define STATE_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+#include "vibration_analysis.h"
+
+// Machine state tracking over the per-window classification
+//
+// vibration_classify() looks at one window and knows nothing about the
+// cycle: pauses in the wash come out IDLE, anything between the bands
+// UNKNOWN, and it can never say DONE. The tracker turns that into
+//
+//   IDLE -> WASHING <-> SPINNING -> DONE -> IDLE
+//
+// Each window becomes one observation (quiet, washing, spinning, or some
+// other vibration). A fixed table says, per state and observation, which
+// state it argues for and for how long it has to keep arguing (ms of
+// agreeing windows). Every other window drains that evidence again, four
+// times as fast, so a glitch never switches state, short pauses in the wash
+// never add up to a DONE and a bump doesn't restart the DONE hold.
+//
+// "Quiet" is measured against a per-machine baseline: the RMS noise seen
+// while the machine is at rest (average and mean deviation), so a node
+// picking up a neighbour's spin doesn't read as a running machine and a
+// very still one can use a lower threshold than IDLE_THRESHOLD.
+//
+// O(1) per window, no buffers: a table lookup, a few compares and two
+// running averages.
+
+typedef enum {
+    TRACKER_OBS_QUIET,        // RMS under the idle baseline
+    TRACKER_OBS_WASHING,      // window classified WASHING
+    TRACKER_OBS_SPINNING,     // window classified SPINNING
+    TRACKER_OBS_ACTIVE,       // moving, but not like a wash or spin
+    TRACKER_OBS_COUNT
+} tracker_obs_t;
+
+typedef struct {
+    machine_state_t state;    // IDLE, WASHING, SPINNING or DONE
+    uint32_t evidence_ms[TRACKER_OBS_COUNT];  // how long each has argued for a change
+    uint32_t last_ms;
+    bool started;
+    float noise_mean;         // RMS at rest, g's
+    float noise_dev;
+} state_tracker_t;
+
+// Function prototypes
+void state_tracker_init(state_tracker_t *tracker);
+
+// One analysis window (state as classified, rms, timestamp). Returns the
+// tracked state.
+machine_state_t state_tracker_update(state_tracker_t *tracker, const vibration_result_t *result);
+
+tracker_obs_t state_tracker_observe(const state_tracker_t *tracker, const vibration_result_t *result);
+float state_tracker_idle_threshold(const state_tracker_t *tracker);
+
+#endif // STATE_TRACKER_H
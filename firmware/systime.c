@@ -0,0 +1,29 @@
+#include "systime.h"
+#include "hal.h"
+#include <stddef.h>
+
+// Idle is a semaphore pend with a timeout: while every task is blocked the
+// kernel drops the MCU into standby until the timeout or systime_wake.
+
+static hal_sem_t wake_sem = NULL;
+
+bool systime_init(void) {
+    wake_sem = hal_sem_create(true);
+    if (wake_sem == NULL) {
+        return false;
+    }
+
+    return hal_time_init();
+}
+
+uint32_t systime_ms(void) {
+    return (uint32_t)(hal_time_us() / 1000);
+}
+
+void systime_idle(uint32_t timeout_ms) {
+    hal_sem_pend(wake_sem, timeout_ms);
+}
+
+void systime_wake(void) {
+    hal_sem_post(wake_sem);
+}
@@ -0,0 +1,27 @@
+#ifndef SYSTIME_H
+#define SYSTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Time base and low-power idle for the scheduler
+//
+// systime.c sits on hal.h: on the CC2652 that's the TI-RTOS Clock, driven by
+// the RTC so it keeps counting in standby; in the host build the simulator's
+// virtual clock. tools/systime_virtual.c implements the same functions
+// directly for the single-context scheduler simulation (make sched-sim).
+
+// Function prototypes
+bool systime_init(void);
+
+// Milliseconds since boot, monotonic, wraps after ~49 days
+uint32_t systime_ms(void);
+
+// Sleep until systime_wake() is called or timeout_ms passes. Blocking here
+// lets the power policy put the MCU in standby.
+void systime_idle(uint32_t timeout_ms);
+
+// Cut systime_idle() short, safe to call from an interrupt
+void systime_wake(void);
+
+#endif // SYSTIME_H
@@ -0,0 +1,225 @@
+#include "telemetry.h"
+#include "zigbee_handler.h"
+#include "frame_codec.h"
+#include <math.h>
+#include <string.h>
+
+void telemetry_init(telemetry_t *batch) {
+    batch->count = 0;
+    batch->frame_bound = TELEMETRY_HEADER_SIZE + 2;
+}
+
+static uint16_t quantize(float value, float scale) {
+    float q = value * scale;
+
+    if (q <= 0.0f) {
+        return 0;
+    }
+    if (q >= 65535.0f) {
+        return 65535;
+    }
+    return (uint16_t)lrintf(q);
+}
+
+uint16_t telemetry_quantize_rms(float rms_g) {
+    return quantize(rms_g, 1000.0f);
+}
+
+uint16_t telemetry_quantize_freq(float freq_hz) {
+    return quantize(freq_hz, 10.0f);
+}
+
+uint8_t telemetry_quantize_centroid(float centroid_hz) {
+    uint16_t q = quantize(centroid_hz, 5.0f);
+    return q < 255 ? (uint8_t)q : 255;
+}
+
+void telemetry_feature_vector(const vibration_result_t *result, uint8_t *vector) {
+    for (int i = 0; i < VIBRATION_BANDS / 2; i++) {
+        vector[i] = (uint8_t)((result->band_level[2 * i] & 0x0F) |
+                              (result->band_level[2 * i + 1] & 0x0F) << 4);
+    }
+    vector[VIBRATION_BANDS / 2] = telemetry_quantize_centroid(result->centroid_hz);
+}
+
+static size_t varint_size(uint32_t v) {
+    size_t size = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// Small deltas of either sign stay small: 0,-1,1,-2,2.. -> 0,1,2,3,4..
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static size_t bitmap_size(uint8_t count) {
+    return (count + 6) / 8;
+}
+
+#if TELEMETRY_FEATURES
+static uint8_t vector_mask(const telemetry_report_t *r, const telemetry_report_t *prev) {
+    uint8_t mask = 0;
+    for (int j = 0; j < TELEMETRY_VECTOR_SIZE; j++) {
+        if (r->vector[j] != prev->vector[j]) {
+            mask |= (uint8_t)(1 << j);
+        }
+    }
+    return mask;
+}
+#endif
+
+// Bytes report i adds to the frame, apart from the bitmap
+static size_t report_size(const telemetry_t *batch, uint8_t i) {
+    if (i == 0) {
+        return TELEMETRY_REPORT0_SIZE + 5;
+    }
+
+    const telemetry_report_t *r = &batch->reports[i];
+    const telemetry_report_t *prev = &batch->reports[i - 1];
+    size_t size = varint_size(r->timestamp - prev->timestamp) +
+           varint_size(zigzag((int32_t)r->rms_mg - prev->rms_mg));
+#if TELEMETRY_FEATURES
+    uint8_t mask = vector_mask(r, prev);
+    size += 1;
+    for (int j = 0; j < TELEMETRY_VECTOR_SIZE; j++) {
+        size += (mask >> j) & 1;
+    }
+#else
+    size += varint_size(zigzag((int32_t)r->freq_dhz - prev->freq_dhz));
+#endif
+    return size + (r->state != prev->state ? 1 : 0);
+}
+
+void telemetry_quantize(const vibration_result_t *result, telemetry_report_t *report) {
+    report->state = (uint8_t)result->state;
+    report->rms_mg = telemetry_quantize_rms(result->rms_magnitude);
+#if TELEMETRY_FEATURES
+    telemetry_feature_vector(result, report->vector);
+#else
+    report->freq_dhz = telemetry_quantize_freq(result->dominant_freq);
+#endif
+    report->timestamp = result->timestamp;
+}
+
+bool telemetry_add(telemetry_t *batch, const vibration_result_t *result) {
+    telemetry_report_t report;
+
+    telemetry_quantize(result, &report);
+    return telemetry_add_report(batch, &report);
+}
+
+bool telemetry_add_report(telemetry_t *batch, const telemetry_report_t *report) {
+    if (telemetry_full(batch)) {
+        return false;
+    }
+
+    batch->reports[batch->count] = *report;
+    batch->frame_bound += report_size(batch, batch->count) +
+                          bitmap_size(batch->count + 1) - bitmap_size(batch->count);
+    batch->count++;
+    return true;
+}
+
+uint8_t telemetry_count(const telemetry_t *batch) {
+    return batch->count;
+}
+
+bool telemetry_full(const telemetry_t *batch) {
+    size_t next_max = TELEMETRY_REPORT_MAX + bitmap_size(batch->count + 1) - bitmap_size(batch->count);
+    return batch->count >= TELEMETRY_BATCH_MAX || batch->frame_bound + next_max > TELEMETRY_FRAME_MAX;
+}
+
+uint32_t telemetry_oldest_ms(const telemetry_t *batch) {
+    return batch->count > 0 ? batch->reports[0].timestamp : 0;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+size_t telemetry_encode(telemetry_t *batch, uint16_t node_id, uint8_t flags, uint16_t seq,
+                        uint32_t now_ms, uint8_t *out) {
+    const telemetry_report_t *reports = batch->reports;
+    uint8_t report_count = batch->count;
+    uint8_t *p = out;
+
+#if TELEMETRY_FEATURES
+    *p++ = PKT_TYPE_FEATURES;
+#else
+    *p++ = PKT_TYPE_BATCH;
+#endif
+    p = put_u16(p, node_id);
+    *p++ = flags;
+    *p++ = report_count;
+    p = put_u32(p, now_ms);
+    p = put_u16(p, seq);
+
+    if (report_count > 0) {
+        *p++ = reports[0].state;
+        p = put_u16(p, reports[0].rms_mg);
+#if TELEMETRY_FEATURES
+        memcpy(p, reports[0].vector, TELEMETRY_VECTOR_SIZE);
+        p += TELEMETRY_VECTOR_SIZE;
+#else
+        p = put_u16(p, reports[0].freq_dhz);
+#endif
+
+        // state change bitmap, then the new states
+        uint8_t *bitmap = p;
+        size_t bitmap_bytes = bitmap_size(report_count);
+        for (size_t i = 0; i < bitmap_bytes; i++) {
+            bitmap[i] = 0;
+        }
+        p += bitmap_bytes;
+
+        for (uint8_t i = 1; i < report_count; i++) {
+            if (reports[i].state != reports[i - 1].state) {
+                bitmap[(i - 1) / 8] |= (uint8_t)(1 << ((i - 1) % 8));
+                *p++ = reports[i].state;
+            }
+        }
+
+        p = put_varint(p, now_ms - reports[0].timestamp);
+
+        for (uint8_t i = 1; i < report_count; i++) {
+            p = put_varint(p, reports[i].timestamp - reports[i - 1].timestamp);
+            p = put_varint(p, zigzag((int32_t)reports[i].rms_mg - reports[i - 1].rms_mg));
+#if TELEMETRY_FEATURES
+            uint8_t mask = vector_mask(&reports[i], &reports[i - 1]);
+            *p++ = mask;
+            for (int j = 0; j < TELEMETRY_VECTOR_SIZE; j++) {
+                if (mask & (1 << j)) {
+                    *p++ = reports[i].vector[j];
+                }
+            }
+#else
+            p = put_varint(p, zigzag((int32_t)reports[i].freq_dhz - reports[i - 1].freq_dhz));
+#endif
+        }
+    }
+
+    p = put_u16(p, frame_crc16(out, (size_t)(p - out)));
+
+    telemetry_init(batch);
+    return (size_t)(p - out);
+}
@@ -0,0 +1,130 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+#include "vibration_analysis.h"
+
+// Batched telemetry frames (PKT_TYPE_BATCH)
+//
+// Several analysis results go out in one frame, with RMS/frequency
+// quantized and delta-encoded against the previous report. Any frame also
+// counts as the node's heartbeat; one with no reports is just that.
+//
+//   off  size  field
+//   0    1     packet_type (PKT_TYPE_BATCH)
+//   1    2     node_id
+//   3    1     flags (TELEMETRY_FLAG_*)
+//   4    1     count, reports in this frame (0 = heartbeat only)
+//   5    4     sent_ms, node clock (systime_ms) when the frame was built
+//   9    2     seq, the backend ACKs it (outbox.h); 0 in frames without reports
+//   -- only if count > 0:
+//   11   1     state of report 0
+//   12   2     rms of report 0, mg
+//   14   2     dominant freq of report 0, 0.1 Hz
+//   16   B     state change bitmap, B = (count + 6) / 8 bytes; bit i-1 set
+//              when report i has a different state than report i-1
+//        n     one state byte per set bit, in order
+//        ..    varint age of report 0 (sent_ms - timestamp)
+//        ..    per report 1..count-1: varint dt_ms from the previous report,
+//              zigzag varint rms delta (mg), zigzag varint freq delta (0.1 Hz)
+//   end  2     checksum, CRC-16/CCITT (frame_crc16) over everything before it
+//
+// All multi-byte fields little-endian. Varints are LEB128 (7 bits per byte,
+// low bits first, top bit = more follows).
+//
+// With TELEMETRY_FEATURES the frame is PKT_TYPE_FEATURES instead: the same,
+// except that the spectral feature vector takes the place of the dominant
+// frequency.
+//
+//   14   5     feature vector of report 0 (bitmap etc. follow at 19)
+//        ..    per report 1..count-1: varint dt_ms, zigzag varint rms delta,
+//              1 byte mask, bit j set when byte j of the feature vector
+//              differs from the previous report's, then those bytes in order
+//
+// Feature vector: bytes 0-3 the VIBRATION_BANDS band levels, 4 bits each,
+// band 2i in the low nibble of byte i (0 = the whole vibration energy,
+// 15 = -43.5 dB or less, see vibration_analysis.h). Byte 4 the spectral
+// centroid, 0.2 Hz. 5 bytes for what would take 36 as floats, and steady
+// machines repeat most of it, so later reports usually cost a byte or two.
+
+#if TELEMETRY_FEATURES && SPECTRAL_ENGINE != SPECTRAL_ENGINE_FFT
+#error "TELEMETRY_FEATURES needs the FFT spectral engine"
+#endif
+
+#define TELEMETRY_FLAG_STATE_CHANGE (1 << 0)  // sent early, last report changed state
+#define TELEMETRY_FLAG_SLEEPING (1 << 1)      // sensor is going into deep sleep
+// Bits 6-7: which of the node's sensors (SENSOR_COUNT) the reports are
+// from, 0 on single-sensor nodes. Empty frames are the node's heartbeat.
+#define TELEMETRY_SENSOR_SHIFT 6
+#define TELEMETRY_FLAG_SENSOR(sensor) ((uint8_t)((sensor) << TELEMETRY_SENSOR_SHIFT))
+
+#if SENSOR_COUNT > 4
+#error "the frame flags have room for 4 sensor sub-ids"
+#endif
+
+// Largest possible frame: header, report 0, bitmap + a state byte per
+// report, 5-byte age and 5 + 3 + 3 bytes per further report, checksum.
+// 84 bytes at TELEMETRY_BATCH_MAX 6, about all an unsecured Zigbee APS
+// frame takes without fragmentation.
+#define TELEMETRY_HEADER_SIZE 11
+#define TELEMETRY_VECTOR_SIZE 5
+#if TELEMETRY_FEATURES
+// Worst case a feature frame would be 102 bytes, so instead the batch counts
+// as full once one more worst-case report might not fit in 82
+#define TELEMETRY_REPORT0_SIZE (3 + TELEMETRY_VECTOR_SIZE)
+#define TELEMETRY_REPORT_MAX (1 + 5 + 3 + 1 + TELEMETRY_VECTOR_SIZE)  // state, dt, rms, mask, vector
+#define TELEMETRY_FRAME_MAX 82
+#else
+#define TELEMETRY_REPORT0_SIZE 5
+#define TELEMETRY_REPORT_MAX (1 + 5 + 3 + 3)  // state, dt, rms, freq
+#define TELEMETRY_FRAME_MAX (TELEMETRY_HEADER_SIZE + 5 + (TELEMETRY_BATCH_MAX + 6) / 8 + \
+                             (TELEMETRY_BATCH_MAX - 1) + 5 + (TELEMETRY_BATCH_MAX - 1) * 11 + 2)
+#endif
+
+// Reports are quantized on the way in, the frame only ever carries these
+typedef struct {
+    uint8_t state;
+    uint16_t rms_mg;
+#if TELEMETRY_FEATURES
+    uint8_t vector[TELEMETRY_VECTOR_SIZE];
+#else
+    uint16_t freq_dhz;      // 0.1 Hz
+#endif
+    uint32_t timestamp;
+} telemetry_report_t;
+
+// One batch, one per sensor
+typedef struct {
+    telemetry_report_t reports[TELEMETRY_BATCH_MAX];
+    uint8_t count;
+    size_t frame_bound;     // frame length if encoded now, report 0 age counted as 5 bytes
+} telemetry_t;
+
+// Function prototypes
+void telemetry_init(telemetry_t *batch);
+
+// Queue a report. Returns false (and drops it) if the batch is full.
+bool telemetry_add(telemetry_t *batch, const vibration_result_t *result);
+// Same for a report quantized earlier (telemetry_quantize)
+bool telemetry_add_report(telemetry_t *batch, const telemetry_report_t *report);
+uint8_t telemetry_count(const telemetry_t *batch);
+bool telemetry_full(const telemetry_t *batch);         // TELEMETRY_BATCH_MAX queued, or no room for another
+uint32_t telemetry_oldest_ms(const telemetry_t *batch);  // timestamp of the first queued report
+
+// Build a frame from the queued reports (possibly none) into `out`, which
+// must hold TELEMETRY_FRAME_MAX bytes, and empty the batch. Returns the
+// frame length. `flags` includes TELEMETRY_FLAG_SENSOR on multi-sensor nodes.
+size_t telemetry_encode(telemetry_t *batch, uint16_t node_id, uint8_t flags, uint16_t seq,
+                        uint32_t now_ms, uint8_t *out);
+
+// Quantization used on the wire
+void telemetry_quantize(const vibration_result_t *result, telemetry_report_t *report);
+uint16_t telemetry_quantize_rms(float rms_g);
+uint16_t telemetry_quantize_freq(float freq_hz);
+uint8_t telemetry_quantize_centroid(float centroid_hz);
+void telemetry_feature_vector(const vibration_result_t *result, uint8_t *vector);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,284 @@
+/*
+ * Host test: coordinator multiplexing (coordinator.c)
+ *
+ *   table          nodes are found again, LQI is smoothed, a full table
+ *                  forgets the stalest node, ACKs route to the address a
+ *                  node was last heard from
+ *   heartbeats     empty telemetry frames aren't forwarded, a repeated seq
+ *                  counts as a retry
+ *   aggregate      queued packets go out in one PKT_TYPE_AGGREGATE with
+ *                  their ages, byte for byte, checksum valid
+ *   timing         nothing before COORDINATOR_FLUSH_MS unless a frame's
+ *                  worth is queued, a lone packet goes unwrapped, writes
+ *                  wait for the link
+ *   full queue     drops new packets, loses nothing already queued
+ *   node list      PKT_TYPE_NODES every COORDINATOR_STATUS_INTERVAL_MS,
+ *                  each node heard once, split over frames
+ *
+ * Run with: make test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "coordinator.h"
+#include "frame_codec.h"
+#include "zigbee_handler.h"
+
+static int failures = 0;
+static coordinator_t coord;
+static uint8_t out[FRAME_PAYLOAD_MAX];
+static uint32_t now_ms;
+
+static void check(bool ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static void put_crc(uint8_t *packet, size_t length) {
+    uint16_t crc = frame_crc16(packet, length - 2);
+    packet[length - 2] = (uint8_t)crc;
+    packet[length - 1] = (uint8_t)(crc >> 8);
+}
+
+// A telemetry frame of `length` bytes with `count` reports (contents
+// don't matter here, only the header)
+static size_t telemetry(uint8_t *packet, uint16_t node_id, uint8_t count, uint16_t seq, size_t length) {
+    memset(packet, 0, length);
+    packet[0] = PKT_TYPE_FEATURES;
+    packet[1] = (uint8_t)node_id;
+    packet[2] = (uint8_t)(node_id >> 8);
+    packet[4] = count;
+    packet[9] = (uint8_t)seq;
+    packet[10] = (uint8_t)(seq >> 8);
+    for (size_t i = 11; i < length - 2; i++) {
+        packet[i] = (uint8_t)(i * 7 + node_id);
+    }
+    put_crc(packet, length);
+    return length;
+}
+
+static bool receive(uint16_t node_id, uint8_t count, uint16_t seq, size_t length, uint8_t lqi) {
+    uint8_t packet[FRAME_PAYLOAD_MAX];
+    telemetry(packet, node_id, count, seq, length);
+    return coordinator_receive(&coord, packet, length, (uint16_t)(0x1000 + node_id), lqi, now_ms);
+}
+
+static bool crc_ok(size_t length) {
+    return length >= 2 && frame_crc16(out, length - 2) == (uint16_t)(out[length - 2] | out[length - 1] << 8);
+}
+
+static uint32_t get_varint(const uint8_t **p) {
+    uint32_t v = 0;
+    int shift = 0;
+
+    while (**p & 0x80) {
+        v |= (uint32_t)(*(*p)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    return v | (uint32_t)*(*p)++ << shift;
+}
+
+static void start(void) {
+    now_ms = 0xFFFFF000u;   // wraps during the test
+    coordinator_init(&coord, now_ms);
+    // keep the node list out of the way unless a test wants it
+    coord.status_ms = now_ms + 0x40000000u;
+}
+
+static void table(void) {
+    start();
+    receive(7, 1, 1, 20, 200);
+    receive(7, 1, 2, 20, 100);
+    const coordinator_node_t *node = coordinator_find(&coord, 7);
+    check(node != NULL && node->packets == 2 && node->lqi == 175 && node->last_seq == 2,
+          "node found again, LQI smoothed");
+
+    uint8_t ack[7] = { PKT_TYPE_ACK, 7, 0, 2, 0 };
+    uint16_t address = 0;
+    check(coordinator_route(&coord, ack, sizeof(ack), &address) && address == 0x1007,
+          "ACK routed to the node's address");
+    ack[1] = 8;
+    check(!coordinator_route(&coord, ack, sizeof(ack), &address), "unknown node not routed");
+
+    // fill the table: node 7 is heard last, node 1000 is the stalest
+    start();
+    for (uint16_t i = 0; i < COORDINATOR_MAX_NODES; i++) {
+        now_ms++;
+        receive((uint16_t)(1000 + i), 0, 0, 13, 150);
+    }
+    now_ms++;
+    receive(1000 + 1, 0, 0, 13, 150);
+    now_ms++;
+    receive(7, 0, 0, 13, 150);
+
+    bool all = true;
+    for (uint16_t i = 1; i < COORDINATOR_MAX_NODES; i++) {
+        all = all && coordinator_find(&coord, (uint16_t)(1000 + i)) != NULL;
+    }
+    check(coord.node_count == COORDINATOR_MAX_NODES && coord.stats.untracked == 1 &&
+          coordinator_find(&coord, 1000) == NULL && coordinator_find(&coord, 7) != NULL && all,
+          "a full table forgets the stalest node, the rest are still found");
+}
+
+static void heartbeats(void) {
+    start();
+    check(receive(3, 0, 0, 13, 150) && coord.queued == 0 && coord.stats.absorbed == 1,
+          "an empty telemetry frame is absorbed");
+    receive(3, 2, 5, 30, 150);
+    receive(3, 2, 5, 30, 150);
+    check(coord.queued == 2 && coordinator_find(&coord, 3)->retries == 1, "a repeated seq is a retry");
+
+    uint8_t packet[20];
+    telemetry(packet, 3, 1, 6, sizeof(packet));
+    packet[12] ^= 1;
+    check(!coordinator_receive(&coord, packet, sizeof(packet), 0x1003, 150, now_ms) &&
+          coord.stats.corrupt == 1 && coord.queued == 2, "a bad checksum is dropped");
+}
+
+static void aggregate(void) {
+    uint8_t sent[3][FRAME_PAYLOAD_MAX];
+    size_t lengths[3] = { 40, 13 + 20, 60 };
+
+    start();
+    for (int i = 0; i < 3; i++) {
+        telemetry(sent[i], (uint16_t)(10 + i), 1, 1, lengths[i]);
+        coordinator_receive(&coord, sent[i], lengths[i], (uint16_t)(0x1010 + i), 150, now_ms);
+        now_ms += 10;
+    }
+    now_ms += COORDINATOR_FLUSH_MS - 30;
+
+    size_t length = coordinator_poll(&coord, now_ms, out);
+    check(length > 0 && out[0] == PKT_TYPE_AGGREGATE && out[5] == 3 && crc_ok(length),
+          "three packets in one aggregate, checksum valid");
+
+    uint32_t clock;
+    memcpy(&clock, &out[1], 4);
+    const uint8_t *p = out + COORDINATOR_HEADER_SIZE;
+    bool same = clock == now_ms;
+    for (int i = 0; i < 3; i++) {
+        uint32_t age = get_varint(&p);
+        same = same && age == COORDINATOR_FLUSH_MS - 10u * i && *p == lengths[i] &&
+               memcmp(p + 1, sent[i], lengths[i]) == 0;
+        p += 1 + *p;
+    }
+    check(same && (size_t)(p - out) == length - 2, "ages and packets byte for byte");
+    check(coord.queued == 0 && coord.used == 0, "queue empty");
+}
+
+static void timing(void) {
+    start();
+    receive(1, 1, 1, 30, 150);
+    receive(2, 1, 1, 30, 150);
+    check(coordinator_timeout(&coord, now_ms) == COORDINATOR_FLUSH_MS &&
+          coordinator_poll(&coord, now_ms, out) == 0, "a part frame waits COORDINATOR_FLUSH_MS");
+
+    now_ms += COORDINATOR_FLUSH_MS;
+    size_t length = coordinator_poll(&coord, now_ms, out);
+    uint32_t busy = COORDINATOR_LINK_MS(FRAME_ENCODED_MAX(length));
+    check(length > 0 && out[5] == 2, "then goes");
+
+    // a frame's worth queued goes at once, but not before the link is free
+    for (uint16_t i = 0; i < 10; i++) {
+        receive((uint16_t)(20 + i), 4, 1, 40, 150);
+    }
+    check(coordinator_poll(&coord, now_ms, out) == 0 && coordinator_timeout(&coord, now_ms) == busy,
+          "nothing until the link has taken the last frame");
+    now_ms += busy;
+    length = coordinator_poll(&coord, now_ms, out);
+    check(length > 200 && out[0] == PKT_TYPE_AGGREGATE && out[5] < 10 && crc_ok(length),
+          "a full aggregate goes without waiting");
+    while (coord.queued > 0) {
+        now_ms += COORDINATOR_FLUSH_MS;
+        coordinator_poll(&coord, now_ms, out);
+    }
+    now_ms += COORDINATOR_FLUSH_MS;
+
+    // alone, or too big to share: as the node sent it
+    uint32_t unwrapped = coord.stats.unwrapped;
+    uint8_t big[200];
+    telemetry(big, 5, 30, 9, sizeof(big));
+    coordinator_receive(&coord, big, sizeof(big), 0x1005, 150, now_ms);
+    receive(6, 1, 1, 100, 150);
+    length = coordinator_poll(&coord, now_ms, out);
+    check(length == sizeof(big) && memcmp(out, big, sizeof(big)) == 0 && coord.stats.unwrapped == unwrapped + 1,
+          "a packet too big to share goes unwrapped");
+    now_ms += COORDINATOR_LINK_MS(FRAME_ENCODED_MAX(length)) + COORDINATOR_FLUSH_MS;
+    length = coordinator_poll(&coord, now_ms, out);
+    check(length == 100 && out[0] == PKT_TYPE_FEATURES && out[1] == 6 && coord.stats.unwrapped == unwrapped + 2,
+          "so does one on its own");
+}
+
+static void full_queue(void) {
+    int accepted = 0, dropped = 0;
+
+    start();
+    for (uint16_t i = 0; i < 100; i++) {
+        if (receive((uint16_t)(100 + i), 4, 1, 60, 150)) {
+            accepted++;
+        } else {
+            dropped++;
+        }
+    }
+    check(dropped > 0 && coord.stats.dropped == (uint32_t)dropped &&
+          coord.used <= COORDINATOR_QUEUE_BYTES && coord.stats.queue_max == coord.used,
+          "a full queue drops new packets");
+
+    int forwarded = 0;
+    size_t length;
+    while ((length = coordinator_poll(&coord, now_ms, out)) > 0) {
+        forwarded += out[0] == PKT_TYPE_AGGREGATE ? out[5] : 1;
+        now_ms += COORDINATOR_LINK_MS(FRAME_ENCODED_MAX(length)) + COORDINATOR_FLUSH_MS;
+    }
+    check(forwarded == accepted, "everything queued goes out");
+    printf("     %d of 100 packets queued, %u bytes\n", accepted, (unsigned)coord.stats.queue_max);
+}
+
+static void node_list(void) {
+    start();
+    uint32_t heard_ms = now_ms;
+    coord.status_ms = now_ms + COORDINATOR_STATUS_INTERVAL_MS;
+    for (uint16_t i = 0; i < 100; i++) {
+        receive((uint16_t)(500 + i), 0, 0, 13, (uint8_t)i);
+    }
+    check(coordinator_timeout(&coord, now_ms) == COORDINATOR_STATUS_INTERVAL_MS &&
+          coordinator_poll(&coord, now_ms, out) == 0, "nothing until COORDINATOR_STATUS_INTERVAL_MS");
+
+    now_ms += COORDINATOR_STATUS_INTERVAL_MS;
+    int frames = 0, listed = 0;
+    bool valid = true, ages = true;
+    size_t length;
+    while ((length = coordinator_poll(&coord, now_ms, out)) > 0) {
+        valid = valid && out[0] == PKT_TYPE_NODES && crc_ok(length);
+        const uint8_t *p = out + COORDINATOR_HEADER_SIZE;
+        for (uint8_t i = 0; i < out[5]; i++) {
+            p += 3;
+            ages = ages && get_varint(&p) == now_ms - heard_ms;
+        }
+        valid = valid && (size_t)(p - out) == length - 2;
+        frames++;
+        listed += out[5];
+        now_ms += COORDINATOR_LINK_MS(FRAME_ENCODED_MAX(length));
+    }
+    check(valid && listed == 100 && frames > 1 && ages, "every node heard, split over frames");
+
+    receive(500, 0, 0, 13, 10);
+    now_ms += COORDINATOR_STATUS_INTERVAL_MS;
+    length = coordinator_poll(&coord, now_ms, out);
+    check(length > 0 && out[5] == 1 && out[6] == (500 & 0xFF) && coordinator_poll(&coord, now_ms + 1000, out) == 0,
+          "the next list has only who was heard since");
+}
+
+int main(void) {
+    table();
+    heartbeats();
+    aggregate();
+    timing();
+    full_queue();
+    node_list();
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
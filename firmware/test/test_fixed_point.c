@@ -0,0 +1,215 @@
+/*
+ * Host test: integer analysis pipeline vs the float pipeline
+ *
+ * Builds vibration_analysis.c with ANALYSIS_FIXED_POINT=1 and checks the
+ * result against the float path (same magnitude/RMS/FFT steps on g's) for
+ * a handful of synthetic machine signals.
+ *
+ * Tolerances:
+ *   RMS            within 0.5% or 0.002 g, whichever is larger
+ *   dominant freq  within one FFT bin (SAMPLE_RATE_HZ / BUFFER_SIZE),
+ *                  skipped for the noise-only case where the peak is random
+ *   state          identical
+ *   band levels    within one 3 dB step for bands holding at least 1% of
+ *                  the energy (weaker ones are down in the Q15 noise)
+ *   centroid       within 0.5 Hz, skipped for noise only like the peak
+ *
+ * Run with: make test
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "fft.h"
+#include "vibration_analysis.h"
+
+#define RMS_TOL_REL 0.005f
+#define RMS_TOL_ABS 0.002f
+#define FREQ_TOL_HZ ((float)SAMPLE_RATE_HZ / BUFFER_SIZE)
+#define CENTROID_TOL_HZ 0.5f
+#define BAND_CHECK_LEVEL 6     // 3 dB steps: -18 dB and up, about 1.5%
+
+typedef struct {
+    const char *name;
+    float amplitude_g;   // vibration amplitude (z, half of it on x)
+    float freq_hz;       // vibration frequency
+    int noise_counts;    // +/- uniform noise added to every axis
+} test_case_t;
+
+static const test_case_t cases[] = {
+    {"idle",              0.00f, 0.0f,  3},
+    {"washing 3Hz",       0.50f, 3.0f,  2},
+    {"washing 2.3Hz",     0.60f, 2.3f,  6},
+    {"spinning 9Hz",      5.00f, 9.0f,  4},
+    {"spinning 11.7Hz",   4.50f, 11.7f, 10},
+    {"light 5Hz",         0.15f, 5.0f,  2},
+};
+
+static int16_t to_counts(float g) {
+    return (int16_t)lrintf(g / ADXL345_SCALE_G);
+}
+
+static void make_window(const test_case_t *tc, accel_data_t *window) {
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        float t = (float)i / SAMPLE_RATE_HZ;
+        float v = tc->amplitude_g * sinf(2.0f * (float)M_PI * tc->freq_hz * t);
+        int n = tc->noise_counts;
+
+        window[i].x = to_counts(0.5f * v) + (rand() % (2 * n + 1)) - n;
+        window[i].y = (rand() % (2 * n + 1)) - n;
+        window[i].z = to_counts(1.0f + v) + (rand() % (2 * n + 1)) - n;  // gravity + vibration
+    }
+}
+
+// Float pipeline, same steps as the ANALYSIS_FIXED_POINT=0 build
+static void reference_analysis(const accel_data_t *window, vibration_result_t *result) {
+    float magnitude[BUFFER_SIZE];
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        float x = window[i].x * ADXL345_SCALE_G;
+        float y = window[i].y * ADXL345_SCALE_G;
+        float z = window[i].z * ADXL345_SCALE_G;
+        magnitude[i] = sqrtf(x * x + y * y + z * z);
+    }
+
+    // RMS of the vibration, gravity/DC removed
+    float mean = 0.0f;
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        mean += magnitude[i];
+    }
+    mean /= BUFFER_SIZE;
+
+    float ac[BUFFER_SIZE];
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        ac[i] = magnitude[i] - mean;
+    }
+    result->rms_magnitude = vibration_compute_rms(ac, BUFFER_SIZE);
+
+    complex_t spectrum[BUFFER_SIZE / 2 + 1];
+    fft_real_forward(magnitude, spectrum, BUFFER_SIZE);
+
+    static const float edges_hz[VIBRATION_BANDS + 1] = FEATURE_BAND_EDGES_HZ;
+    float band_power[VIBRATION_BANDS] = {0};
+    float total = 0.0f;
+    float moment = 0.0f;
+    float max_power = 0.0f;
+    int max_index = 1;
+    for (int i = 1; i < BUFFER_SIZE / 2; i++) {
+        float power = spectrum[i].real * spectrum[i].real +
+                      spectrum[i].imag * spectrum[i].imag;
+        float freq = (float)i * SAMPLE_RATE_HZ / BUFFER_SIZE;
+        int band = VIBRATION_BANDS - 1;
+        while (band > 0 && freq < edges_hz[band]) {
+            band--;
+        }
+        band_power[band] += power;
+        total += power;
+        moment += power * freq;
+        if (power > max_power) {
+            max_power = power;
+            max_index = i;
+        }
+    }
+    result->dominant_freq = (float)max_index * SAMPLE_RATE_HZ / BUFFER_SIZE;
+
+    // straight from the definition, log and all
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        float level = band_power[b] > 0.0f ? -10.0f * log10f(band_power[b] / total) / 3.0f : 99.0f;
+        result->band_level[b] = (uint8_t)fminf(lrintf(level), VIBRATION_BAND_FLOOR);
+    }
+    result->centroid_hz = total > 0.0f ? moment / total : 0.0f;
+    result->state = vibration_classify_state(&vibration_config_thresholds, result->rms_magnitude,
+                                             result->dominant_freq);
+}
+
+int main(void) {
+    int failures = 0;
+    accel_data_t window[BUFFER_SIZE];
+
+    srand(1234);
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const test_case_t *tc = &cases[c];
+        vibration_result_t expected;
+        vibration_result_t actual;
+
+        make_window(tc, window);
+        reference_analysis(window, &expected);
+
+        vibration_analysis_init();
+        for (int i = 0; i < BUFFER_SIZE; i++) {
+            vibration_analysis_add_sample(&window[i]);
+        }
+        if (!vibration_analysis_compute(&actual)) {
+            printf("FAIL %-18s no result after a full window\n", tc->name);
+            failures++;
+            continue;
+        }
+
+        float rms_tol = fmaxf(RMS_TOL_ABS, RMS_TOL_REL * expected.rms_magnitude);
+        bool freq_ok = tc->amplitude_g == 0.0f ||
+                       fabsf(actual.dominant_freq - expected.dominant_freq) <= FREQ_TOL_HZ + 1e-3f;
+        bool bands_ok = true;
+        for (int b = 0; b < VIBRATION_BANDS; b++) {
+            if (expected.band_level[b] <= BAND_CHECK_LEVEL &&
+                abs(actual.band_level[b] - expected.band_level[b]) > 1) {
+                bands_ok = false;
+            }
+        }
+        bool centroid_ok = tc->amplitude_g == 0.0f ||
+                           fabsf(actual.centroid_hz - expected.centroid_hz) <= CENTROID_TOL_HZ;
+        bool ok = fabsf(actual.rms_magnitude - expected.rms_magnitude) <= rms_tol &&
+                  freq_ok && actual.state == expected.state && bands_ok && centroid_ok;
+
+        printf("%s %-18s rms %.4f/%.4f g  freq %.2f/%.2f Hz  centroid %.2f/%.2f Hz  state %d/%d  bands",
+               ok ? "ok  " : "FAIL", tc->name,
+               actual.rms_magnitude, expected.rms_magnitude,
+               actual.dominant_freq, expected.dominant_freq,
+               actual.centroid_hz, expected.centroid_hz,
+               actual.state, expected.state);
+        for (int b = 0; b < VIBRATION_BANDS; b++) {
+            printf(" %d/%d", actual.band_level[b], expected.band_level[b]);
+        }
+        printf("\n");
+        if (!ok) {
+            failures++;
+        }
+    }
+
+    // Contexts are independent: two fed interleaved match the firmware's one
+    for (size_t c = 0; c + 1 < sizeof(cases) / sizeof(cases[0]); c++) {
+        accel_data_t other[BUFFER_SIZE];
+        vibration_ctx_t ctx[2];
+        vibration_result_t single, side_by_side[2];
+
+        make_window(&cases[c], window);
+        make_window(&cases[c + 1], other);
+
+        vibration_analysis_init();
+        for (int i = 0; i < BUFFER_SIZE; i++) {
+            vibration_analysis_add_sample(&window[i]);
+        }
+        vibration_analysis_compute(&single);
+
+        vibration_ctx_init(&ctx[0], SAMPLE_RATE_HZ, NULL);
+        vibration_ctx_init(&ctx[1], SAMPLE_RATE_HZ, NULL);
+        for (int i = 0; i < BUFFER_SIZE; i++) {
+            vibration_ctx_add_sample(&ctx[0], &window[i]);
+            vibration_ctx_add_sample(&ctx[1], &other[i]);
+        }
+        bool ok = vibration_ctx_compute(&ctx[0], &side_by_side[0]) &&
+                  vibration_ctx_compute(&ctx[1], &side_by_side[1]) &&
+                  side_by_side[0].rms_magnitude == single.rms_magnitude &&
+                  side_by_side[0].dominant_freq == single.dominant_freq &&
+                  side_by_side[0].centroid_hz == single.centroid_hz &&
+                  side_by_side[0].state == single.state;
+
+        if (!ok) {
+            printf("FAIL %-18s context not independent of %s\n", cases[c].name, cases[c + 1].name);
+            failures++;
+        }
+    }
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
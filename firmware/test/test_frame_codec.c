@@ -0,0 +1,200 @@
+/*
+ * Host test: serial framing (frame_codec.c)
+ *
+ *   crc            CRC-16/CCITT-FALSE check value ("123456789" -> 0x29B1)
+ *   round trip     empty to FRAME_PAYLOAD_MAX packets, runs of 0x00/0xFF
+ *                  around the 254-byte COBS block edge, fed whole and one
+ *                  byte at a time
+ *   resync         a flipped, dropped or inserted byte, garbage before the
+ *                  first delimiter: the damaged frame is counted and
+ *                  dropped, the one after it decodes. A missing delimiter
+ *                  loses nothing.
+ *
+ * Run with: make test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "frame_codec.h"
+
+#define STREAM_MAX 4096
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void fill(uint8_t *p, size_t length, int pattern) {
+    for (size_t i = 0; i < length; i++) {
+        switch (pattern) {
+        case 0: p[i] = (uint8_t)(i * 37 + 11); break;  // no zeros... mostly
+        case 1: p[i] = 0x00; break;
+        case 2: p[i] = 0xFF; break;
+        default: p[i] = (i % 3) ? 0x00 : (uint8_t)i; break;
+        }
+    }
+}
+
+// Feed `length` bytes `chunk` at a time, collect the packets that come out
+static int decode_all(frame_decoder_t *d, const uint8_t *data, size_t length, size_t chunk,
+                      uint8_t out[][FRAME_PAYLOAD_MAX], size_t *lengths, int max) {
+    int n = 0;
+    size_t pos = 0;
+
+    while (pos < length) {
+        size_t avail = length - pos < chunk ? length - pos : chunk;
+        const uint8_t *packet;
+        size_t packet_length;
+        size_t used = frame_decoder_feed(d, data + pos, avail, &packet, &packet_length);
+
+        pos += used;
+        if (packet_length > 0 && n < max) {
+            memcpy(out[n], packet, packet_length);
+            lengths[n++] = packet_length;
+        }
+    }
+    return n;
+}
+
+static void round_trip(size_t length, int pattern, size_t chunk) {
+    uint8_t packet[FRAME_PAYLOAD_MAX];
+    uint8_t wire[FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX)];
+    uint8_t got[1][FRAME_PAYLOAD_MAX];
+    size_t got_length = 0;
+    frame_decoder_t d;
+    char what[80];
+
+    fill(packet, length, pattern);
+    size_t n = frame_encode(packet, length, wire);
+
+    bool clean = n > 0 && n <= FRAME_ENCODED_MAX(length) && wire[n - 1] == 0x00;
+    for (size_t i = 0; i + 1 < n; i++) {
+        clean = clean && wire[i] != 0x00;
+    }
+    snprintf(what, sizeof(what), "%zu bytes pattern %d: only the delimiter is 0x00", length, pattern);
+    check(clean, what);
+
+    frame_decoder_init(&d);
+    int frames = decode_all(&d, wire, n, chunk, got, &got_length, 1);
+    snprintf(what, sizeof(what), "%zu bytes pattern %d chunk %zu: round trip", length, pattern, chunk);
+    // an empty packet is a good frame too, it just has nothing to hand back
+    check(length == 0 ? d.stats.frames == 1 :
+          frames == 1 && got_length == length && memcmp(got[0], packet, length) == 0, what);
+}
+
+// Three frames back to back, the middle one damaged by `damage`; the first
+// and last must still come out
+typedef size_t (*damage_fn)(uint8_t *wire, size_t length);
+
+static size_t flip_byte(uint8_t *wire, size_t length) {
+    wire[length / 2] ^= 0x10;
+    return length;
+}
+
+static size_t drop_byte(uint8_t *wire, size_t length) {
+    memmove(&wire[3], &wire[4], length - 4);
+    return length - 1;
+}
+
+static size_t insert_zero(uint8_t *wire, size_t length) {
+    memmove(&wire[6], &wire[5], length - 5);
+    wire[5] = 0x00;
+    return length + 1;
+}
+
+static size_t lose_delimiter(uint8_t *wire, size_t length) {
+    (void)wire;
+    return length - 1;  // the length byte still says where it ends
+}
+
+static void resync(const char *name, damage_fn damage, int expect) {
+    uint8_t stream[STREAM_MAX];
+    uint8_t packet[40];
+    uint8_t got[4][FRAME_PAYLOAD_MAX];
+    size_t lengths[4];
+    size_t n = 0;
+    frame_decoder_t d;
+    char what[80];
+
+    for (int f = 0; f < 3; f++) {
+        for (size_t i = 0; i < sizeof(packet); i++) {
+            packet[i] = (uint8_t)(f * 50 + i);
+        }
+        size_t len = frame_encode(packet, sizeof(packet), &stream[n]);
+        if (f == 1) {
+            len = damage(&stream[n], len);
+        }
+        n += len;
+    }
+
+    frame_decoder_init(&d);
+    int frames = decode_all(&d, stream, n, 7, got, lengths, 4);
+    uint32_t errors = d.stats.crc_errors + d.stats.length_errors + d.stats.overruns;
+
+    snprintf(what, sizeof(what), "%s: good frames survive", name);
+    check(frames == expect && got[0][0] == 0 && got[frames - 1][0] == 100, what);
+    snprintf(what, sizeof(what), "%s: damage counted", name);
+    check(frames == 3 || errors >= 1, what);
+    printf("%-4s %-22s %d of 3 frames, %u crc / %u length / %u overrun\n",
+           frames == expect ? "ok" : "FAIL", name, frames, (unsigned)d.stats.crc_errors,
+           (unsigned)d.stats.length_errors, (unsigned)d.stats.overruns);
+}
+
+int main(void) {
+    static const uint8_t check_string[] = "123456789";
+    check(frame_crc16(check_string, 9) == 0x29B1, "crc16 check value");
+
+    static const size_t lengths[] = { 0, 1, 2, 40, 82, 250, 251, 252, 253, 254, FRAME_PAYLOAD_MAX };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            round_trip(lengths[i], pattern, STREAM_MAX);
+            round_trip(lengths[i], pattern, 1);
+        }
+    }
+
+    uint8_t big[FRAME_PAYLOAD_MAX + 1] = { 0 };
+    uint8_t wire[FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX + 1)];
+    check(frame_encode(big, sizeof(big), wire) == 0, "oversized packet refused");
+
+    resync("flipped byte", flip_byte, 2);
+    resync("dropped byte", drop_byte, 2);
+    resync("inserted 0x00", insert_zero, 2);
+    resync("lost delimiter", lose_delimiter, 3);
+
+    // joining mid-frame: the tail of some frame, then a good one
+    {
+        uint8_t stream[64];
+        uint8_t packet[20] = { 0 };
+        uint8_t got[1][FRAME_PAYLOAD_MAX];
+        size_t got_length;
+        frame_decoder_t d;
+
+        memset(stream, 0x5A, 9);
+        size_t n = 9 + frame_encode(packet, sizeof(packet), &stream[9]);
+        stream[8] = 0x00;
+        frame_decoder_init(&d);
+        check(decode_all(&d, stream, n, 64, got, &got_length, 1) == 1 && got_length == 20,
+              "joining mid-frame");
+    }
+
+    // no delimiter for longer than any frame can be
+    {
+        uint8_t stream[600];
+        uint8_t got[1][FRAME_PAYLOAD_MAX];
+        size_t got_length;
+        frame_decoder_t d;
+
+        memset(stream, 0x42, sizeof(stream) - 1);
+        stream[sizeof(stream) - 1] = 0x00;
+        frame_decoder_init(&d);
+        check(decode_all(&d, stream, sizeof(stream), 64, got, &got_length, 1) == 0 &&
+              d.stats.overruns == 1, "runaway frame counted as overrun");
+    }
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Host test: store-and-forward outbox
+ *
+ * Drives outbox.c the way the transmit task does, ACKing (or not) the
+ * frames it hands out, and checks:
+ *
+ *   seq            numbers count up from 1 and skip 0 when they wrap
+ *   retry          no ACK: the same frame again after OUTBOX_ACK_TIMEOUT_MS,
+ *                  the wait doubling up to OUTBOX_RETRY_MAX_MS (+ jitter)
+ *   ack            pops the reports, a stale or wrong number changes nothing
+ *   waiting        a part frame waits for HEARTBEAT_INTERVAL_MS or a flush
+ *   drain          a backlog goes out in full frames, back to back, and
+ *                  only the last carries the flush's flags
+ *   thinning       a full ring drops every other report but keeps state
+ *                  changes and the newest
+ *   sensors        queues take turns, the sub-id is in the flags
+ *
+ * Built twice, for one sensor (test_outbox) and two (test_outbox_pair).
+ * Run with: make test
+ */
+
+#include <stdio.h>
+#include "config.h"
+#include "outbox.h"
+#include "telemetry.h"
+
+static int failures = 0;
+static outbox_t box;
+static uint8_t frame[TELEMETRY_FRAME_MAX];
+static uint32_t now_ms;
+
+static void check(bool ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Header fields, telemetry.h
+static uint8_t frame_flags(void) { return frame[3]; }
+static uint8_t frame_count(void) { return frame[4]; }
+static uint16_t frame_seq(void) { return (uint16_t)(frame[9] | frame[10] << 8); }
+
+static void add(uint8_t sensor, machine_state_t state) {
+    vibration_result_t result = {0};
+
+    result.state = state;
+    result.rms_magnitude = 0.3f;
+    result.dominant_freq = 12.0f;
+    result.timestamp = now_ms;
+    outbox_add(&box, sensor, &result);
+    now_ms += TRANSMIT_INTERVAL_MS;
+}
+
+// Poll at `now_ms`; returns the frame's report count, -1 for nothing
+static int poll(void) {
+    size_t length = outbox_poll(&box, NODE_ID, now_ms, frame);
+    return length > 0 ? frame_count() : -1;
+}
+
+static void start(void) {
+    outbox_init(&box);
+    now_ms = 0xFFFF0000u;   // wraps during the test
+}
+
+static void seq_and_ack(void) {
+    start();
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        add(0, STATE_IDLE);
+    }
+    check(poll() == TELEMETRY_BATCH_MAX && frame_seq() == 1, "a full frame goes out at once, seq 1");
+    check(poll() == -1, "one frame in flight");
+    check(!outbox_ack(&box, 2) && outbox_unsent(&box, 0) == 0, "wrong seq ignored");
+    check(outbox_ack(&box, 1) && box.queues[0].count == 0, "ACK pops the reports");
+    check(!outbox_ack(&box, 1), "duplicate ACK ignored");
+
+    box.next_seq = UINT16_MAX;
+    for (int i = 0; i < 2 * TELEMETRY_BATCH_MAX; i++) {
+        add(0, STATE_IDLE);
+    }
+    poll();
+    uint16_t last = frame_seq();
+    outbox_ack(&box, last);
+    poll();
+    check(last == UINT16_MAX && frame_seq() == 1, "seq wraps past 0");
+}
+
+static void retry(void) {
+    start();
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        add(0, STATE_WASHING);
+    }
+    poll();
+    uint16_t seq = frame_seq();
+    uint32_t expect = OUTBOX_ACK_TIMEOUT_MS;
+    bool backoff = true, same = true;
+
+    for (int i = 0; i < 10; i++) {
+        uint32_t wait = outbox_timeout(&box, now_ms);
+        backoff = backoff && wait >= expect && wait <= expect + expect / 4;
+
+        now_ms += wait - 1;
+        same = same && poll() == -1;
+        now_ms += 1;
+        same = same && poll() == TELEMETRY_BATCH_MAX && frame_seq() == seq;
+
+        expect = expect * 2 > OUTBOX_RETRY_MAX_MS ? OUTBOX_RETRY_MAX_MS : expect * 2;
+    }
+    check(same, "retries resend the same frame, not before the timeout");
+    check(backoff, "retry wait doubles up to OUTBOX_RETRY_MAX_MS, at most 1/4 jitter");
+    check(box.retries == 10 && outbox_ack(&box, seq) && box.queues[0].count == 0,
+          "a retry's ACK pops it");
+    check(outbox_timeout(&box, now_ms) == UINT32_MAX, "nothing to do when empty");
+}
+
+static void waiting(void) {
+    start();
+    add(0, STATE_IDLE);
+    add(0, STATE_IDLE);
+    check(poll() == -1, "a part frame waits");
+    uint32_t wait = outbox_timeout(&box, now_ms);
+    check(wait == HEARTBEAT_INTERVAL_MS - 2 * TRANSMIT_INTERVAL_MS, "... until the oldest is HEARTBEAT_INTERVAL_MS old");
+    now_ms += wait;
+    check(poll() == 2 && frame_flags() == 0, "then goes out");
+    outbox_ack(&box, frame_seq());
+
+    add(0, STATE_IDLE);
+    outbox_flush(&box, 0, TELEMETRY_FLAG_STATE_CHANGE);
+    check(outbox_timeout(&box, now_ms) == 0 && poll() == 1 &&
+          frame_flags() == TELEMETRY_FLAG_STATE_CHANGE, "a flush sends it now, with its flags");
+}
+
+static void drain(void) {
+    start();
+    // an outage: nothing gets ACKed for a while
+    for (int i = 0; i < 100; i++) {
+        add(0, i < 50 ? STATE_WASHING : STATE_SPINNING);
+    }
+    poll();
+    for (int i = 0; i < 20; i++) {
+        now_ms += outbox_timeout(&box, now_ms);
+        poll();
+    }
+    outbox_flush(&box, 0, TELEMETRY_FLAG_SLEEPING);
+
+    int frames = 0, reports = 0, part = 0, flagged = 0, count = frame_count();
+    uint8_t last_flags;
+    bool back_to_back = true;
+    do {
+        frames++;
+        reports += count;
+        part += count < TELEMETRY_BATCH_MAX && box.queues[0].count > count;
+        last_flags = frame_flags();
+        flagged += (last_flags & TELEMETRY_FLAG_SLEEPING) != 0;
+
+        outbox_ack(&box, frame_seq());
+        back_to_back = back_to_back && (box.queues[0].count == 0 || outbox_timeout(&box, now_ms) == 0);
+    } while ((count = poll()) >= 0);
+
+    check(reports == 100 && box.queues[0].count == 0, "backlog drained, no reports lost");
+    check(back_to_back && part == 0, "in full frames, back to back");
+    check(flagged == 1 && (last_flags & TELEMETRY_FLAG_SLEEPING), "only the last frame has the flush's flags");
+    printf("     100 reports in %d frames after the outage\n", frames);
+}
+
+static void thinning(void) {
+    start();
+    for (int i = 0; i < OUTBOX_DEPTH; i++) {
+        // a state change every 100
+        add(0, (i / 100) % 2 ? STATE_SPINNING : STATE_WASHING);
+    }
+    add(0, STATE_DONE);
+
+    const outbox_queue_t *q = &box.queues[0];
+    int changes = 0;
+    for (int i = 1; i < q->count; i++) {
+        const telemetry_report_t *r = &q->reports[(q->head + i) % OUTBOX_DEPTH];
+        const telemetry_report_t *prev = &q->reports[(q->head + i - 1) % OUTBOX_DEPTH];
+        changes += r->state != prev->state;
+    }
+    const telemetry_report_t *newest = &q->reports[(q->head + q->count - 1) % OUTBOX_DEPTH];
+    check(q->count < OUTBOX_DEPTH / 2 + 8 && box.thinned == OUTBOX_DEPTH + 1u - q->count,
+          "a full ring is thinned to about half");
+    check(changes == 3 && newest->state == STATE_DONE, "state changes and the newest are kept");
+    check(q->reports[q->head].timestamp == 0xFFFF0000u, "the oldest is kept");
+}
+
+#if SENSOR_COUNT > 1
+static void sensors(void) {
+    start();
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        add(0, STATE_IDLE);
+        add(1, STATE_IDLE);
+    }
+    poll();
+    uint8_t first = frame_flags();
+    outbox_ack(&box, frame_seq());
+    poll();
+    check(first == TELEMETRY_FLAG_SENSOR(0) && frame_flags() == TELEMETRY_FLAG_SENSOR(1),
+          "sensors take turns, sub-id in the flags");
+}
+#endif
+
+int main(void) {
+    seq_and_ack();
+    retry();
+    waiting();
+    drain();
+    thinning();
+#if SENSOR_COUNT > 1
+    sensors();
+#endif
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Host test: stage profiling
+ *
+ * Records known cycle counts with profile.c, then checks:
+ *
+ *   buckets        log2 bucket edges, bucket 0 and the open-ended last one
+ *   stats          count, min, max, mean; snapshot with and without reset
+ *   report         PKT_TYPE_PROFILE decodes with the reference decoder
+ *                  below (same steps as backend/server.py), empty stages
+ *                  left out, shares add up, checksum valid
+ *   worst case     every stage in every bucket still fits PROFILE_PACKET_MAX
+ *   task report    PKT_TYPE_TASKS carries the numbers last set, checksum
+ *                  valid, none before the first profile_set_tasks
+ *
+ * profile.c only needs the interrupt lock and the counter rate from hal.h,
+ * stubbed here. Run with: make test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "frame_codec.h"
+#include "hal.h"
+#include "profile.h"
+#include "zigbee_handler.h"
+
+uintptr_t hal_irq_disable(void) {
+    return 0;
+}
+
+void hal_irq_restore(uintptr_t key) {
+    (void)key;
+}
+
+uint32_t hal_cycles_hz(void) {
+    return CPU_CLOCK_HZ;
+}
+
+typedef struct {
+    uint8_t stage;
+    uint32_t count, min, max, mean;
+    uint8_t first_bucket, buckets;
+    uint8_t shares[PROFILE_BUCKETS];
+} decoded_stage_t;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t get_varint(const uint8_t **p) {
+    uint32_t v = 0;
+    int shift = 0;
+
+    while (**p & 0x80) {
+        v |= (uint32_t)(**p & 0x7F) << shift;
+        shift += 7;
+        (*p)++;
+    }
+    v |= (uint32_t)(**p) << shift;
+    (*p)++;
+    return v;
+}
+
+// Returns the number of stages, -1 if the packet doesn't parse
+static int decode(const uint8_t *packet, size_t length, uint32_t *period_ms, decoded_stage_t *out) {
+    const uint8_t *p = packet;
+
+    if (length < PROFILE_HEADER_SIZE + 2 || p[0] != PKT_TYPE_PROFILE ||
+        (p[1] | p[2] << 8) != NODE_ID || get_u32(&p[7]) != CPU_CLOCK_HZ ||
+        p[15] != PROFILE_BUCKET_SHIFT) {
+        return -1;
+    }
+    *period_ms = get_u32(&p[11]);
+    int count = p[16];
+    p += PROFILE_HEADER_SIZE;
+
+    for (int i = 0; i < count; i++) {
+        decoded_stage_t *s = &out[i];
+        s->stage = *p++;
+        s->count = get_varint(&p);
+        s->min = get_varint(&p);
+        s->max = get_varint(&p);
+        s->mean = get_varint(&p);
+        s->first_bucket = *p++;
+        s->buckets = *p++;
+        if (s->buckets > PROFILE_BUCKETS) {
+            return -1;
+        }
+        memcpy(s->shares, p, s->buckets);
+        p += s->buckets;
+    }
+
+    uint16_t checksum = p[0] | p[1] << 8;
+    p += 2;
+    if ((size_t)(p - packet) != length || checksum != frame_crc16(packet, length - 2)) {
+        return -1;
+    }
+    return count;
+}
+
+int main(void) {
+    profile_stats_t stats[PROFILE_STAGE_COUNT];
+    decoded_stage_t decoded[PROFILE_STAGE_COUNT];
+    uint8_t packet[PROFILE_PACKET_MAX + 16];
+    uint32_t period_ms = 0;
+
+    check(profile_bucket(0) == 0 && profile_bucket(31) == 0, "bucket 0 below 32 cycles");
+    check(profile_bucket(32) == 1 && profile_bucket(63) == 1 && profile_bucket(64) == 2,
+          "log2 bucket edges");
+    check(profile_bucket(1u << 19) == PROFILE_BUCKETS - 1 &&
+          profile_bucket(UINT32_MAX) == PROFILE_BUCKETS - 1, "last bucket open ended");
+
+    profile_init(1000);
+    profile_record(PROFILE_ADD_SAMPLE, 100);
+    profile_record(PROFILE_ADD_SAMPLE, 120);
+    profile_record(PROFILE_ADD_SAMPLE, 3000);
+    profile_record(PROFILE_SPECTRUM, 40000);
+
+    profile_snapshot(stats, false);
+    const profile_stats_t *add = &stats[PROFILE_ADD_SAMPLE];
+    check(add->count == 3 && add->min == 100 && add->max == 3000 && add->total == 3220,
+          "count, min, max, total");
+    check(add->histogram[profile_bucket(100)] == 2 && add->histogram[profile_bucket(3000)] == 1,
+          "histogram");
+    check(stats[PROFILE_SEND].count == 0, "untouched stage empty");
+
+    size_t length = profile_encode(NODE_ID, 61000, packet);
+    int n = decode(packet, length, &period_ms, decoded);
+    check(n == 2 && period_ms == 60000, "report decodes, empty stages left out");
+    check(n == 2 && decoded[0].stage == PROFILE_ADD_SAMPLE && decoded[0].count == 3 &&
+          decoded[0].min == 100 && decoded[0].max == 3000 && decoded[0].mean == 1073,
+          "stage fields");
+
+    if (n == 2) {
+        unsigned total = 0;
+        for (int b = 0; b < decoded[0].buckets; b++) {
+            total += decoded[0].shares[b];
+        }
+        check(decoded[0].first_bucket == profile_bucket(100) &&
+              decoded[0].first_bucket + decoded[0].buckets - 1 == profile_bucket(3000) &&
+              total >= 254 && total <= 256, "histogram shares");
+    }
+
+    profile_snapshot(stats, false);
+    check(stats[PROFILE_ADD_SAMPLE].count == 0 && stats[PROFILE_SPECTRUM].count == 0,
+          "report starts a new period");
+
+    length = profile_encode(NODE_ID, 62000, packet);
+    check(decode(packet, length, &period_ms, decoded) == 0 && period_ms == 1000,
+          "nothing recorded, header only");
+
+    // every stage, every bucket, big counts
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            uint32_t cycles = b == 0 ? 1 : (1u << (b + PROFILE_BUCKET_SHIFT)) + 1;
+            for (int i = 0; i < 3; i++) {
+                profile_record((profile_stage_t)s, cycles);
+            }
+        }
+        profile_record((profile_stage_t)s, UINT32_MAX);
+    }
+    length = profile_encode(NODE_ID, 0x7FFFFFFF, packet);
+    check(length <= PROFILE_PACKET_MAX && decode(packet, length, &period_ms, decoded) == PROFILE_STAGE_COUNT,
+          "worst case fits PROFILE_PACKET_MAX");
+    printf("     worst case report %u bytes (max %u)\n", (unsigned)length, (unsigned)PROFILE_PACKET_MAX);
+
+    // task report
+    length = profile_encode_tasks(NODE_ID, 1000, packet);
+    check(length == PROFILE_TASKS_HEADER_SIZE + 2 && packet[0] == PKT_TYPE_TASKS && packet[12] == 0,
+          "task report before the first stats: no tasks");
+
+    profile_task_t tasks[] = {{412, 1024, 3}, {1660, 2048, 21}, {388, 1024, 1}};
+    profile_set_tasks(tasks, 3, 27, 5);
+    length = profile_encode_tasks(NODE_ID, 120000, packet);
+    const uint8_t *t = &packet[PROFILE_TASKS_HEADER_SIZE];
+    check(length == PROFILE_TASKS_HEADER_SIZE + 3 * 5 + 2 && length <= PROFILE_TASKS_PACKET_MAX &&
+          (packet[1] | packet[2] << 8) == NODE_ID && get_u32(&packet[3]) == 120000 &&
+          packet[7] == 27 && get_u32(&packet[8]) == 5 && packet[12] == 3,
+          "task report header");
+    check((t[5] | t[6] << 8) == 1660 && (t[7] | t[8] << 8) == 2048 && t[9] == 21 &&
+          (packet[length - 2] | packet[length - 1] << 8) == frame_crc16(packet, length - 2),
+          "task report entries, checksum");
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Host test: machine state tracker
+ *
+ * Feeds state_tracker.c windows as the analysis would produce them, one
+ * per hop, and checks:
+ *
+ *   glitches       single wash/spin windows while idle change nothing
+ *   cycle          IDLE -> WASHING -> SPINNING -> DONE, through pauses,
+ *                  a soak, UNKNOWN windows and a rinse between two spins
+ *   done           DONE only after TRACKER_DONE_AFTER_SPIN_MS of quiet,
+ *                  back to IDLE after TRACKER_DONE_HOLD_MS or on unloading
+ *   sleep          a deep sleep gap counts as quiet
+ *   baseline       a vibrating floor above IDLE_THRESHOLD is learned as
+ *                  quiet, washing never is
+ *
+ * Run with: make test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "state_tracker.h"
+
+#define HOP_MS (1000 * ANALYSIS_HOP_SIZE / SAMPLE_RATE_HZ)
+
+static int failures = 0;
+static state_tracker_t tracker;
+static uint32_t now_ms;
+static unsigned changes;
+
+static void check(bool ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static machine_state_t window(machine_state_t classified, float rms) {
+    vibration_result_t result = {0};
+    machine_state_t before = tracker.state;
+
+    result.state = classified;
+    result.rms_magnitude = rms;
+    result.timestamp = now_ms;
+    now_ms += HOP_MS;
+
+    machine_state_t state = state_tracker_update(&tracker, &result);
+    if (state != before) {
+        changes++;
+    }
+    return state;
+}
+
+// `ms` worth of windows; returns the state after the last
+static machine_state_t run(uint32_t ms, machine_state_t classified, float rms) {
+    machine_state_t state = tracker.state;
+    for (uint32_t t = 0; t < ms; t += HOP_MS) {
+        state = window(classified, rms);
+    }
+    return state;
+}
+
+#define QUIET() STATE_IDLE, 0.01f
+#define WASH() STATE_WASHING, 0.5f
+#define SPIN() STATE_SPINNING, 3.0f
+#define BETWEEN() STATE_UNKNOWN, 0.2f
+
+static void start(void) {
+    state_tracker_init(&tracker);
+    now_ms = 0xFFFF0000u;   // wraps during the test
+    changes = 0;
+}
+
+// Agitation with pauses and the odd unclassified window
+static void wash(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 16000) {
+        run(9000, WASH());
+        run(640, BETWEEN());
+        run(2400, WASH());
+        run(4000, QUIET());
+    }
+}
+
+int main(void) {
+    start();
+    run(60000, QUIET());
+    for (int i = 0; i < 20; i++) {
+        window(WASH());
+        run(5000, QUIET());
+        window(SPIN());
+        run(5000, BETWEEN());
+    }
+    check(tracker.state == STATE_IDLE && changes == 0, "single windows while idle change nothing");
+
+    run(2 * HOP_MS, WASH());
+    check(tracker.state == STATE_IDLE, "two washing windows aren't a cycle yet");
+    run(TRACKER_DONE_AFTER_SPIN_MS, QUIET());
+
+    start();
+    wash(60000);
+    check(tracker.state == STATE_WASHING && changes == 1, "washing with pauses and UNKNOWN windows");
+    run(180000, QUIET());
+    wash(60000);
+    check(tracker.state == STATE_WASHING && changes == 1, "a 3 min soak is still washing");
+
+    run(60000, SPIN());
+    check(tracker.state == STATE_SPINNING, "spinning");
+    run(60000, QUIET());
+    wash(60000);
+    check(tracker.state == STATE_WASHING, "rinse after the first spin");
+    run(120000, SPIN());
+    run(5000, BETWEEN());   // spinning down
+
+    run(TRACKER_DONE_AFTER_SPIN_MS - 10000, QUIET());
+    check(tracker.state == STATE_SPINNING, "not done before TRACKER_DONE_AFTER_SPIN_MS");
+    run(20000, QUIET());
+    check(tracker.state == STATE_DONE, "DONE after TRACKER_DONE_AFTER_SPIN_MS of quiet");
+    check(changes == 5, "IDLE -> WASHING -> SPINNING -> WASHING -> SPINNING -> DONE, no more");
+
+    // DONE since up to 10 s ago
+    run(TRACKER_DONE_HOLD_MS - 120000, QUIET());
+    check(tracker.state == STATE_DONE, "DONE held");
+    window(BETWEEN());
+    run(60000, QUIET());
+    check(tracker.state == STATE_DONE, "a bump doesn't end DONE");
+    run(80000, QUIET());
+    check(tracker.state == STATE_IDLE, "IDLE after TRACKER_DONE_HOLD_MS");
+
+    // unloading: a few seconds of handling
+    start();
+    wash(30000);
+    run(60000, SPIN());
+    run(TRACKER_DONE_AFTER_SPIN_MS + 5000, QUIET());
+    check(tracker.state == STATE_DONE, "done again");
+    run(5000, BETWEEN());
+    check(tracker.state == STATE_IDLE, "unloading ends DONE");
+
+    // deep sleep in DONE, woken up by the next wash
+    start();
+    run(60000, SPIN());
+    run(TRACKER_DONE_AFTER_SPIN_MS + 5000, QUIET());
+    now_ms += TRACKER_DONE_HOLD_MS;
+    window(QUIET());
+    check(tracker.state == STATE_IDLE, "sleeping through the hold counts as quiet");
+    run(2000, WASH());
+    check(tracker.state == STATE_WASHING, "next cycle");
+
+    // a neighbour's machine shaking the floor: 0.12 g +/- 0.02 at rest
+    start();
+    srand(7);
+    for (int i = 0; i < 2000; i++) {
+        window(STATE_UNKNOWN, 0.12f + 0.02f * ((float)rand() / RAND_MAX - 0.5f) * 2.0f);
+    }
+    float threshold = state_tracker_idle_threshold(&tracker);
+    vibration_result_t floor = { .state = STATE_UNKNOWN, .rms_magnitude = 0.13f };
+    check(threshold > 0.13f && state_tracker_observe(&tracker, &floor) == TRACKER_OBS_QUIET,
+          "vibrating floor learned as quiet");
+    printf("     idle threshold %.3f g after the floor (IDLE_THRESHOLD %.3f)\n",
+           threshold, (double)IDLE_THRESHOLD);
+    run(600000, WASH());
+    check(state_tracker_idle_threshold(&tracker) == threshold, "washing doesn't move the baseline");
+
+    start();
+    run(600000, QUIET());
+    check(state_tracker_idle_threshold(&tracker) < (float)IDLE_THRESHOLD, "still machine, lower threshold");
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
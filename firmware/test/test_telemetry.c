@@ -0,0 +1,290 @@
+/*
+ * Host test: batched telemetry frames
+ *
+ * Encodes report sequences with telemetry.c, decodes them with the
+ * reference decoder below (same steps as ZigbeeReader in backend/server.py)
+ * and checks:
+ *
+ *   round trip     states exact, RMS within 0.5 mg, freq within 0.05 Hz
+ *                  (PKT_TYPE_BATCH) or band levels exact and centroid
+ *                  within 0.1 Hz (PKT_TYPE_FEATURES), report timestamps exact
+ *   framing        length matches, checksum valid, sequence number, never over
+ *                  TELEMETRY_FRAME_MAX
+ *   size           a typical batch vs the same reports as zigbee_packet_t
+ *   full           feature frames stop taking reports before they could
+ *                  outgrow TELEMETRY_FRAME_MAX, batch frames only at
+ *                  TELEMETRY_BATCH_MAX
+ *   sensors        one batch per sensor, the sub-id survives in the flags
+ *
+ * Built twice, with TELEMETRY_FEATURES on (test_telemetry) and off
+ * (test_telemetry_batch). Run with: make test
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "telemetry.h"
+#include "zigbee_handler.h"
+#include "frame_codec.h"
+
+typedef struct {
+    uint8_t state;
+    float rms;
+    float freq;
+    uint8_t band_level[VIBRATION_BANDS];
+    float centroid;
+    uint32_t timestamp;
+} decoded_t;
+
+#if TELEMETRY_FEATURES
+#define FRAME_TYPE PKT_TYPE_FEATURES
+#else
+#define FRAME_TYPE PKT_TYPE_BATCH
+#endif
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static uint32_t get_varint(const uint8_t **p) {
+    uint32_t v = 0;
+    int shift = 0;
+
+    while (**p & 0x80) {
+        v |= (uint32_t)(**p & 0x7F) << shift;
+        shift += 7;
+        (*p)++;
+    }
+    v |= (uint32_t)(**p) << shift;
+    (*p)++;
+    return v;
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Returns the number of reports, -1 if the frame doesn't parse
+static int decode(const uint8_t *frame, size_t length, decoded_t *out, uint8_t *flags, uint16_t *seq) {
+    const uint8_t *p = frame;
+
+    if (length < TELEMETRY_HEADER_SIZE + 2 || p[0] != FRAME_TYPE) {
+        return -1;
+    }
+    if ((p[1] | p[2] << 8) != NODE_ID) {
+        return -1;
+    }
+    *flags = p[3];
+    int count = p[4];
+    uint32_t sent = (uint32_t)p[5] | (uint32_t)p[6] << 8 | (uint32_t)p[7] << 16 | (uint32_t)p[8] << 24;
+    *seq = (uint16_t)(p[9] | p[10] << 8);
+    p += TELEMETRY_HEADER_SIZE;
+
+    if (count > 0) {
+        uint8_t state = *p++;
+        int32_t rms = p[0] | p[1] << 8;
+        p += 2;
+#if TELEMETRY_FEATURES
+        uint8_t vector[TELEMETRY_VECTOR_SIZE];
+        memcpy(vector, p, TELEMETRY_VECTOR_SIZE);
+        p += TELEMETRY_VECTOR_SIZE;
+#else
+        int32_t freq = p[0] | p[1] << 8;
+        p += 2;
+#endif
+
+        const uint8_t *bitmap = p;
+        p += (count + 6) / 8;
+
+        uint8_t states[TELEMETRY_BATCH_MAX];
+        states[0] = state;
+        for (int i = 1; i < count; i++) {
+            if (bitmap[(i - 1) / 8] & (1 << ((i - 1) % 8))) {
+                state = *p++;
+            }
+            states[i] = state;
+        }
+
+        uint32_t timestamp = sent - get_varint(&p);
+        for (int i = 0; i < count; i++) {
+            if (i > 0) {
+                timestamp += get_varint(&p);
+                rms += unzigzag(get_varint(&p));
+#if TELEMETRY_FEATURES
+                uint8_t mask = *p++;
+                for (int j = 0; j < TELEMETRY_VECTOR_SIZE; j++) {
+                    if (mask & (1 << j)) {
+                        vector[j] = *p++;
+                    }
+                }
+#else
+                freq += unzigzag(get_varint(&p));
+#endif
+            }
+            out[i].state = states[i];
+            out[i].rms = rms / 1000.0f;
+#if TELEMETRY_FEATURES
+            for (int b = 0; b < VIBRATION_BANDS; b++) {
+                out[i].band_level[b] = (vector[b / 2] >> (4 * (b & 1))) & 0x0F;
+            }
+            out[i].centroid = vector[VIBRATION_BANDS / 2] / 5.0f;
+#else
+            out[i].freq = freq / 10.0f;
+#endif
+            out[i].timestamp = timestamp;
+        }
+    }
+
+    uint16_t checksum = p[0] | p[1] << 8;
+    p += 2;
+    if ((size_t)(p - frame) != length ||
+        checksum != frame_crc16(frame, length - 2)) {
+        return -1;
+    }
+    return count;
+}
+
+static telemetry_t batch;
+
+static bool report_matches(const decoded_t *decoded, const vibration_result_t *report) {
+    if (decoded->state != report->state || decoded->timestamp != report->timestamp ||
+        fabsf(decoded->rms - report->rms_magnitude) > 0.0005f) {
+        return false;
+    }
+#if TELEMETRY_FEATURES
+    return memcmp(decoded->band_level, report->band_level, VIBRATION_BANDS) == 0 &&
+           fabsf(decoded->centroid - fminf(report->centroid_hz, 51.0f)) <= 0.1f;
+#else
+    return fabsf(decoded->freq - report->dominant_freq) <= 0.05f;
+#endif
+}
+
+// Queues as many of `reports` as the batch takes, like tx_task flushing
+// once it is full, then checks the frame. Returns how many went in.
+static int round_trip(const char *name, const vibration_result_t *reports, int count,
+                      uint8_t flags, uint32_t now) {
+    uint8_t frame[TELEMETRY_FRAME_MAX + 16];
+    decoded_t decoded[TELEMETRY_BATCH_MAX];
+    uint8_t got_flags = 0;
+    uint16_t seq = (uint16_t)(0xFFF0u + (unsigned)count), got_seq = 0;
+    char what[96];
+    int queued = 0;
+
+    telemetry_init(&batch);
+    while (queued < count && telemetry_add(&batch, &reports[queued])) {
+        queued++;
+    }
+
+    size_t length = telemetry_encode(&batch, NODE_ID, flags, seq, now, frame);
+    int n = decode(frame, length, decoded, &got_flags, &got_seq);
+
+    snprintf(what, sizeof(what), "%s: decodes", name);
+    check(n == queued, what);
+    snprintf(what, sizeof(what), "%s: fits TELEMETRY_FRAME_MAX", name);
+    check(length <= TELEMETRY_FRAME_MAX, what);
+    snprintf(what, sizeof(what), "%s: flags", name);
+    check(got_flags == flags, what);
+    snprintf(what, sizeof(what), "%s: sequence number", name);
+    check(got_seq == seq, what);
+    snprintf(what, sizeof(what), "%s: batch emptied", name);
+    check(telemetry_count(&batch) == 0, what);
+
+    for (int i = 0; i < n && i < queued; i++) {
+        snprintf(what, sizeof(what), "%s: report %d", name, i);
+        check(report_matches(&decoded[i], &reports[i]), what);
+    }
+
+    printf("%-4s %-28s %d reports  %3u bytes (%3u as zigbee_packet_t)%s\n",
+           n == queued ? "ok" : "FAIL", name, queued, (unsigned)length,
+           (unsigned)(queued > 0 ? queued : 1) * (unsigned)sizeof(zigbee_packet_t),
+           queued < count ? ", batch full" : "");
+    return queued;
+}
+
+static void set_features(vibration_result_t *r, uint8_t peak_band, float centroid) {
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        int distance = b > peak_band ? b - peak_band : peak_band - b;
+        r->band_level[b] = (uint8_t)(distance * 4 < VIBRATION_BAND_FLOOR ? distance * 4 : VIBRATION_BAND_FLOOR);
+    }
+    r->centroid_hz = centroid;
+}
+
+int main(void) {
+    vibration_result_t reports[TELEMETRY_BATCH_MAX];
+    uint32_t t = 123456;
+
+    // steady washing, one report per TRANSMIT_INTERVAL_MS
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        reports[i].state = STATE_WASHING;
+        reports[i].rms_magnitude = 0.45f + 0.01f * (i % 3);
+        reports[i].dominant_freq = 3.125f - 0.78125f * (i & 1);
+        set_features(&reports[i], 2, 3.4f + 0.2f * (i == 4));
+        reports[i].timestamp = t + i * TRANSMIT_INTERVAL_MS + (i * 37) % 320;
+    }
+    check(round_trip("steady washing", reports, TELEMETRY_BATCH_MAX, 0,
+                     reports[TELEMETRY_BATCH_MAX - 1].timestamp + 12) == TELEMETRY_BATCH_MAX,
+          "steady batch takes TELEMETRY_BATCH_MAX reports");
+
+    // washing -> spinning: sent early with the change as the last report
+    reports[3].state = STATE_SPINNING;
+    reports[3].rms_magnitude = 3.2f;
+    reports[3].dominant_freq = 10.9f;
+    set_features(&reports[3], 5, 10.2f);
+    round_trip("state change", reports, 4, TELEMETRY_FLAG_STATE_CHANGE, reports[3].timestamp);
+
+    // state flips every report, large swings
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        reports[i].state = (i & 1) ? STATE_IDLE : STATE_SPINNING;
+        reports[i].rms_magnitude = (i & 1) ? 0.0f : 65.0f;
+        reports[i].dominant_freq = (i & 1) ? 0.0f : 49.2f;
+        set_features(&reports[i], (i & 1) ? 0 : 7, (i & 1) ? 0.0f : 49.2f);
+    }
+    int queued = round_trip("alternating extremes", reports, TELEMETRY_BATCH_MAX, 0, reports[5].timestamp + 40000);
+    check(TELEMETRY_FEATURES ? queued < TELEMETRY_BATCH_MAX : queued == TELEMETRY_BATCH_MAX,
+          "batch full when the worst case might not fit");
+
+    // gaps long enough for multi-byte varints, clock wrap in between
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        reports[i].state = STATE_UNKNOWN;
+        reports[i].rms_magnitude = 0.2f;
+        reports[i].dominant_freq = 5.5f;
+        set_features(&reports[i], 3, 60.0f);  // centroid saturates at 51 Hz
+        reports[i].timestamp = 0xFFFF0000u + (uint32_t)i * 3000000u;
+    }
+    round_trip("long gaps / clock wrap", reports, TELEMETRY_BATCH_MAX, TELEMETRY_FLAG_SLEEPING, reports[5].timestamp + 1000);
+
+    round_trip("single report", reports, 1, TELEMETRY_FLAG_SLEEPING, reports[0].timestamp + 5);
+    round_trip("heartbeat only", reports, 0, 0, t);
+
+    // full batch refuses more
+    telemetry_init(&batch);
+    for (int i = 0; i < TELEMETRY_BATCH_MAX; i++) {
+        telemetry_add(&batch, &reports[0]);
+    }
+    check(telemetry_full(&batch) && !telemetry_add(&batch, &reports[0]), "batch full rejects reports");
+
+    // a second sensor's batch is its own
+    telemetry_t other;
+    telemetry_init(&other);
+    telemetry_add(&other, &reports[1]);
+    check(telemetry_count(&other) == 1 && telemetry_oldest_ms(&other) == reports[1].timestamp &&
+          telemetry_count(&batch) == TELEMETRY_BATCH_MAX, "batches are independent");
+    round_trip("second sensor", reports, 3, TELEMETRY_FLAG_SENSOR(1) | TELEMETRY_FLAG_STATE_CHANGE,
+               reports[2].timestamp + 10);
+
+    // quantization saturates instead of wrapping
+    check(telemetry_quantize_rms(-1.0f) == 0 && telemetry_quantize_rms(100.0f) == 65535, "rms clamps");
+    check(telemetry_quantize_freq(7000.0f) == 65535, "freq clamps");
+    check(telemetry_quantize_centroid(-3.0f) == 0 && telemetry_quantize_centroid(80.0f) == 255 &&
+          telemetry_quantize_centroid(3.1f) == 16, "centroid quantization");
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
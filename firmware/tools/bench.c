@@ -0,0 +1,423 @@
+/*
+ * Micro-benchmarks for the analysis and protocol hot paths
+ *
+ * Times the real firmware functions on the host: the FFTs, RMS, the
+ * per-sample magnitude update, a whole analysis window, classification,
+ * the packet checksum and the profiling overhead, each at several sizes. Every case is calibrated to
+ * run for -t seconds, split into REPEATS runs; the best and the median
+ * ns/op are reported along with throughput and heap allocations per op
+ * (counted by wrapping malloc/calloc/realloc at link time, see Makefile).
+ *
+ * Window size, engine, arithmetic and zoom are compile time, build with e.g.
+ * BENCH_DEFS="-DBUFFER_SIZE=256 -DANALYSIS_FIXED_POINT=1" or
+ * BENCH_DEFS="-DZOOM_DECIMATION=4" to compare.
+ *
+ * Usage: bench [-m] [-t seconds] [-f filter] [-b baseline.csv [-x pct]]
+ *   -m  CSV for saving and comparing between commits
+ *   -f  only cases whose name contains `filter`
+ *   -b  show the change against a saved -m run
+ *   -x  with -b: exit 1 if any case got more than `pct` percent slower
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "fft.h"
+#include "hal.h"
+#include "profile.h"
+#include "vibration_analysis.h"
+#include "zigbee_handler.h"
+
+#define REPEATS 5
+#define MAX_SIZES 6
+#define MAX_SAMPLES 4096
+#define MAX_BASELINE 256
+
+typedef struct {
+    const char *name;
+    const char *unit;                       // what the throughput counts
+    // run `iterations` ops at `size`, return units per op
+    size_t (*run)(size_t size, unsigned long iterations);
+    size_t sizes[MAX_SIZES];                // 0 terminated
+} bench_t;
+
+typedef struct {
+    char name[48];
+    size_t size;
+    double ns_per_op;
+} baseline_t;
+
+static float samples_f[MAX_SAMPLES];
+static q15_t samples_q15[MAX_SAMPLES];
+static accel_data_t samples_accel[MAX_SAMPLES];
+static uint8_t bytes[MAX_SAMPLES];
+static complex_t spectrum_f[FFT_TABLE_SIZE / 2 + 1];
+static complex_q15_t spectrum_q15[FFT_TABLE_SIZE / 2 + 1];
+static float classify_rms[MAX_SAMPLES];
+static float classify_freq[MAX_SAMPLES];
+
+static volatile float sink_f;
+static volatile uint32_t sink_u;
+
+// Heap use by anything linked in (not libc's own)
+static unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    allocations++;
+    return __real_realloc(p, size);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Washing-like vibration: 0.5g at 3Hz on x and z, 1g gravity, +/-2 counts noise
+static void make_inputs(void) {
+    uint32_t seed = 42;
+
+    for (int i = 0; i < MAX_SAMPLES; i++) {
+        float t = (float)i / SAMPLE_RATE_HZ;
+        float v = 0.5f * sinf(2.0f * (float)M_PI * 3.0f * t);
+        int noise[3];
+        for (int a = 0; a < 3; a++) {
+            seed = seed * 1103515245u + 12345u;
+            noise[a] = (int)((seed >> 16) % 5) - 2;
+        }
+        samples_accel[i] = (accel_data_t){
+            (int16_t)(lrintf(0.5f * v / ADXL345_SCALE_G) + noise[0]),
+            (int16_t)noise[1],
+            (int16_t)(lrintf((1.0f + v) / ADXL345_SCALE_G) + noise[2]),
+        };
+        samples_f[i] = v + noise[0] * ADXL345_SCALE_G;
+        samples_q15[i] = (q15_t)(v * 16384.0f);
+        bytes[i] = (uint8_t)(seed >> 8);
+
+        // spread over all the states, so branches aren't free
+        classify_rms[i] = (float)((seed >> 4) % 2500) / 1000.0f;
+        classify_freq[i] = (float)((seed >> 12) % 1500) / 100.0f;
+    }
+}
+
+static size_t run_fft(size_t size, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++) {
+        fft_real_forward(samples_f, spectrum_f, (uint16_t)size);
+    }
+    sink_f = spectrum_f[1].real;
+    return size;
+}
+
+static size_t run_fft_q15(size_t size, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; i++) {
+        fft_real_forward_q15(samples_q15, spectrum_q15, (uint16_t)size);
+    }
+    sink_u = (uint16_t)spectrum_q15[1].real;
+    return size;
+}
+
+static size_t run_rms(size_t size, unsigned long iterations) {
+    float sum = 0.0f;
+    for (unsigned long i = 0; i < iterations; i++) {
+        sum += vibration_compute_rms(samples_f, size);
+    }
+    sink_f = sum;
+    return size;
+}
+
+// vibration_ctx_add_sample: magnitude, running sums (and SDFT bins)
+static size_t run_add_sample(size_t size, unsigned long iterations) {
+    static vibration_ctx_t ctx;
+    vibration_ctx_init(&ctx, SAMPLE_RATE_HZ, NULL);
+    for (unsigned long i = 0; i < iterations; i++) {
+        for (size_t s = 0; s < size; s++) {
+            vibration_ctx_add_sample(&ctx, &samples_accel[s]);
+        }
+    }
+    sink_u = ctx.sample_index;
+    return size;
+}
+
+// Up to the first window that can be measured; returns where it got to
+static size_t warm_up(vibration_ctx_t *ctx) {
+    size_t s = 0;
+    for (uint16_t i = 0; i < vibration_ctx_warmup_samples(ctx); i++) {
+        vibration_ctx_add_sample(ctx, &samples_accel[s]);
+        s = (s + 1) % MAX_SAMPLES;
+    }
+    return s;
+}
+
+// What the analysis task does per hop: the new samples, then the window
+static size_t run_window(size_t size, unsigned long iterations) {
+    static vibration_ctx_t ctx;
+    vibration_result_t result = {0};
+
+    (void)size;
+    vibration_ctx_init(&ctx, SAMPLE_RATE_HZ, NULL);
+    size_t s = warm_up(&ctx);
+    for (unsigned long i = 0; i < iterations; i++) {
+        for (int h = 0; h < ANALYSIS_HOP_SIZE; h++) {
+            vibration_ctx_add_sample(&ctx, &samples_accel[s]);
+            s = (s + 1) % MAX_SAMPLES;
+        }
+        vibration_ctx_compute(&ctx, &result);
+    }
+    sink_u = result.state;
+    return ANALYSIS_HOP_SIZE;
+}
+
+// vibration_ctx_compute alone: RMS, spectrum and classification
+static size_t run_compute(size_t size, unsigned long iterations) {
+    static vibration_ctx_t ctx;
+    vibration_result_t result = {0};
+
+    (void)size;
+    vibration_ctx_init(&ctx, SAMPLE_RATE_HZ, NULL);
+    warm_up(&ctx);
+    for (unsigned long i = 0; i < iterations; i++) {
+        ctx.samples_since_analysis = ANALYSIS_HOP_SIZE;
+        vibration_ctx_compute(&ctx, &result);
+    }
+    sink_u = result.state;
+    return 1;
+}
+
+// size = how many different inputs are cycled through (1 = perfectly predicted)
+static size_t run_classify(size_t size, unsigned long iterations) {
+    uint32_t states = 0;
+    size_t k = 0;
+    for (unsigned long i = 0; i < iterations; i++) {
+        states += vibration_classify_state(&vibration_config_thresholds, classify_rms[k],
+                                           classify_freq[k]);
+        k = k + 1 < size ? k + 1 : 0;
+    }
+    sink_u = states;
+    return 1;
+}
+
+static size_t run_checksum(size_t size, unsigned long iterations) {
+    uint32_t sum = 0;
+    for (unsigned long i = 0; i < iterations; i++) {
+        sum += zigbee_compute_checksum(bytes, size);
+    }
+    sink_u = sum;
+    return size;
+}
+
+// What PROFILE_START/PROFILE_END add around a stage (profiling itself is
+// compiled out of this build, so the other cases don't pay for it)
+static size_t run_profile(size_t size, unsigned long iterations) {
+    (void)size;
+    for (unsigned long i = 0; i < iterations; i++) {
+        uint32_t start = hal_cycles();
+        profile_record(PROFILE_CLASSIFY, hal_cycles() - start);
+    }
+    return 1;
+}
+
+static const bench_t benches[] = {
+    {"fft_real_forward", "samples", run_fft, {16, 64, 128, 256, 512}},
+    {"fft_real_forward_q15", "samples", run_fft_q15, {16, 64, 128, 256, 512}},
+    {"vibration_compute_rms", "samples", run_rms, {32, 128, 512, 4096}},
+    {"add_sample", "samples", run_add_sample, {32, 128, 1024}},
+    {"analysis_window", "samples", run_window, {BUFFER_SIZE}},
+    {"vibration_ctx_compute", "windows", run_compute, {BUFFER_SIZE}},
+    {"vibration_classify_state", "calls", run_classify, {1, 1024}},
+    {"zigbee_compute_checksum", "bytes", run_checksum, {8, 32, 82, 255}},
+    {"profile_record", "calls", run_profile, {1}},
+};
+
+typedef struct {
+    unsigned long iterations;
+    double best_ns;
+    double median_ns;
+    double units_per_s;
+    double allocs_per_op;
+} measurement_t;
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void measure(const bench_t *b, size_t size, double seconds, measurement_t *m) {
+    unsigned long iterations = 1;
+    double t;
+
+    // calibrate: double until a run takes a millisecond, then scale up
+    for (;;) {
+        double start = now_s();
+        b->run(size, iterations);
+        t = now_s() - start;
+        if (t >= 1e-3 || iterations >= (1ul << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    double per_run = seconds / REPEATS;
+    if (t < per_run) {
+        iterations = (unsigned long)(iterations * per_run / t) + 1;
+    }
+
+    double ns[REPEATS];
+    size_t units = 0;
+    unsigned long allocs_before = allocations;
+    for (int r = 0; r < REPEATS; r++) {
+        double start = now_s();
+        units = b->run(size, iterations);
+        ns[r] = (now_s() - start) * 1e9 / iterations;
+    }
+    qsort(ns, REPEATS, sizeof(ns[0]), compare_double);
+
+    m->iterations = iterations;
+    m->best_ns = ns[0];
+    m->median_ns = ns[REPEATS / 2];
+    m->units_per_s = units * 1e9 / m->best_ns;
+    m->allocs_per_op = (double)(allocations - allocs_before) / ((double)iterations * REPEATS);
+}
+
+static size_t load_baseline(const char *path, baseline_t *baseline) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t count = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    while (count < MAX_BASELINE && fgets(line, sizeof(line), f)) {
+        baseline_t *b = &baseline[count];
+        if (line[0] != '#' && sscanf(line, "%47[^,],%zu,%*[^,],%lf", b->name, &b->size, &b->ns_per_op) == 3) {
+            count++;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static const baseline_t *find_baseline(const baseline_t *baseline, size_t count, const char *name,
+                                       size_t size) {
+    for (size_t i = 0; i < count; i++) {
+        if (baseline[i].size == size && strcmp(baseline[i].name, name) == 0) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m] [-t seconds] [-f filter] [-b baseline.csv [-x pct]]\n", name);
+}
+
+int main(int argc, char **argv) {
+    static baseline_t baseline[MAX_BASELINE];
+    size_t baseline_count = 0;
+    const char *filter = NULL;
+    const char *baseline_path = NULL;
+    double seconds = 0.25;
+    double max_slowdown = 0.0;
+    bool csv = false;
+    int regressions = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "mt:f:b:x:")) != -1) {
+        switch (opt) {
+            case 'm':
+                csv = true;
+                break;
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'b':
+                baseline_path = optarg;
+                break;
+            case 'x':
+                max_slowdown = atof(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (seconds <= 0.0 || optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (baseline_path != NULL && (baseline_count = load_baseline(baseline_path, baseline)) == 0) {
+        return 1;
+    }
+
+    make_inputs();
+
+    printf("# window %d, hop %d, %s engine, %s, %d Hz", BUFFER_SIZE, ANALYSIS_HOP_SIZE,
+           SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT ? "sdft" : "fft",
+           ANALYSIS_FIXED_POINT ? "fixed point" : "float", SAMPLE_RATE_HZ);
+    if (ZOOM_DECIMATION > 1) {
+        printf(", zoom %d x %d", ZOOM_DECIMATION, ZOOM_FFT_SIZE);
+    }
+    printf("\n");
+    if (csv) {
+        printf("name,size,iterations,best_ns_per_op,median_ns_per_op,units_per_s,unit,allocs_per_op\n");
+    } else {
+        printf("%-26s %6s %12s %12s %14s %-8s %7s%s\n", "benchmark", "size", "best ns/op",
+               "median ns/op", "throughput/s", "", "allocs", baseline_count ? "   vs base" : "");
+    }
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const bench_t *b = &benches[i];
+        if (filter != NULL && strstr(b->name, filter) == NULL) {
+            continue;
+        }
+
+        for (int s = 0; s < MAX_SIZES && b->sizes[s] != 0; s++) {
+            measurement_t m;
+            measure(b, b->sizes[s], seconds, &m);
+
+            if (csv) {
+                printf("%s,%zu,%lu,%.3f,%.3f,%.0f,%s,%.3f\n", b->name, b->sizes[s], m.iterations,
+                       m.best_ns, m.median_ns, m.units_per_s, b->unit, m.allocs_per_op);
+                continue;
+            }
+
+            printf("%-26s %6zu %12.1f %12.1f %14.4g %-8s %7.2f", b->name, b->sizes[s], m.best_ns,
+                   m.median_ns, m.units_per_s, b->unit, m.allocs_per_op);
+            const baseline_t *base = find_baseline(baseline, baseline_count, b->name, b->sizes[s]);
+            if (base != NULL) {
+                double change = 100.0 * (m.best_ns / base->ns_per_op - 1.0);
+                bool regressed = max_slowdown > 0.0 && change > max_slowdown;
+                regressions += regressed;
+                printf("   %+7.1f%%%s", change, regressed ? "  SLOWER" : "");
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+
+    if (regressions > 0) {
+        printf("%d case(s) more than %.1f%% slower than %s\n", regressions, max_slowdown, baseline_path);
+    }
+    return regressions ? 1 : 0;
+}
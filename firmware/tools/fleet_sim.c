@@ -0,0 +1,626 @@
+/*
+ * The coordinator firmware on Linux, with a fleet of end devices around it
+ *
+ * coordinator_main.c (built with -Dmain=coordinator_main) on the host HAL,
+ * in virtual time. Hundreds of simulated nodes each run the real outbox
+ * (outbox.c) for a machine going through wash cycles and send its frames to
+ * the coordinator's radio callback. A model of backend/server.py reads the
+ * coordinator's UART at DEBUG_BAUD_RATE, stores and de-duplicates the
+ * frames, and writes ACKs back, which the coordinator routes to their node.
+ *
+ * At the end it reports the serial link's load next to what forwarding every
+ * packet on its own would have cost, packets lost at the coordinator, the
+ * nodes' retries, and frame latency (first send to stored). Radio airtime
+ * isn't modelled: packets reach the coordinator when sent, or are lost (-l, -O).
+ *
+ * Usage: wasche_coord_host [-n nodes] [-H hours] [-l loss%] [-O hour:minutes] [-o frames.bin]
+ *   -n  end devices (default 300)
+ *   -H  hours of virtual time (default 2)
+ *   -l  lose this percentage of the radio packets, each way
+ *   -O  the coordinator hears nothing for `minutes` from `hour` into the run
+ *   -o  also write what the coordinator sends to a file, for server.py
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "coordinator.h"
+#include "frame_codec.h"
+#include "hal_host.h"
+#include "outbox.h"
+#include "telemetry.h"
+#include "zigbee_handler.h"
+
+int coordinator_main(void);
+
+#define ADDRESS_BASE 0x1000       // node i is at network address ADDRESS_BASE + i
+#define BACKEND_ACK_US 5000       // server.py's commit before it ACKs
+#define LATENCY_BUCKETS 10000     // 1 ms each, the last one is "10 s or more"
+#define PHASES 6
+
+// One machine cycle, then idle for a random while
+static const struct {
+    machine_state_t state;
+    uint32_t minutes;
+} cycle[PHASES] = {
+    { STATE_IDLE, 0 },
+    { STATE_WASHING, 20 },
+    { STATE_SPINNING, 6 },
+    { STATE_WASHING, 12 },
+    { STATE_SPINNING, 8 },
+    { STATE_DONE, 3 },
+};
+
+typedef struct {
+    outbox_t box;
+    uint16_t node_id;
+    uint8_t lqi;
+    size_t heap_index;
+    uint64_t next_us;         // heap key: the earliest of the three below, or a retry
+    uint64_t report_us;
+    uint64_t heartbeat_us;
+    uint64_t last_frame_us;
+    uint64_t first_sent_us;   // the frame in flight, first attempt
+    uint8_t phase;
+    uint64_t phase_end_us;
+    bool have_state;
+    machine_state_t last_state;
+    uint64_t idle_since_us;
+    bool sleeping;            // POWER_SLEEP_AFTER_MS idle: heartbeats only
+    uint16_t stored_seq;      // backend side: last frame stored
+    unsigned long generated;  // reports
+} sim_node_t;
+
+typedef struct {
+    sim_node_t *nodes;
+    size_t count;
+    size_t *heap;             // node indices, min-heap on next_us
+    uint32_t rng;
+    double loss;
+    uint64_t outage_start_us, outage_end_us;
+
+    // serial link, coordinator -> backend
+    uint64_t line_free_us;
+    uint64_t backlog_max_us;
+    unsigned long line_bytes;
+    unsigned long second_bytes, second_max;
+    uint64_t second;
+    frame_decoder_t decoder;
+    FILE *out;
+
+    // ACKs, backend -> coordinator, in time order
+    uint8_t acks[64][FRAME_ENCODED_MAX(sizeof(zigbee_ack_t))];
+    size_t ack_lengths[64];
+    uint64_t ack_us[64];
+    size_t ack_head, ack_count;
+
+    // radio
+    unsigned long sent, delivered, heartbeats_delivered, lost, acks_lost, unbatched_bytes;
+
+    // backend
+    unsigned long aggregates, aggregated, unwrapped, statuses, listed, bad, frames,
+                  duplicates, reports, acks_sent, acks_dropped;
+    unsigned long latency[LATENCY_BUCKETS];
+    uint64_t latency_max_us;
+} fleet_t;
+
+static fleet_t fleet;
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n nodes] [-H hours] [-l loss%%] [-O hour:minutes] [-o frames.bin]\n", name);
+}
+
+// xorshift32, so runs repeat
+static uint32_t next_random(void) {
+    fleet.rng ^= fleet.rng << 13;
+    fleet.rng ^= fleet.rng >> 17;
+    fleet.rng ^= fleet.rng << 5;
+    return fleet.rng;
+}
+
+static bool lose(uint64_t now_us) {
+    if (now_us >= fleet.outage_start_us && now_us < fleet.outage_end_us) {
+        return true;
+    }
+    return fleet.loss > 0 && next_random() < fleet.loss * UINT32_MAX;
+}
+
+/* Event heap -------------------------------------------------------------- */
+
+static void heap_swap(size_t a, size_t b) {
+    size_t t = fleet.heap[a];
+    fleet.heap[a] = fleet.heap[b];
+    fleet.heap[b] = t;
+    fleet.nodes[fleet.heap[a]].heap_index = a;
+    fleet.nodes[fleet.heap[b]].heap_index = b;
+}
+
+static uint64_t heap_key(size_t i) {
+    return fleet.nodes[fleet.heap[i]].next_us;
+}
+
+static void heap_fix(size_t i) {
+    while (i > 0 && heap_key(i) < heap_key((i - 1) / 2)) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (true) {
+        size_t least = i, l = 2 * i + 1, r = l + 1;
+        if (l < fleet.count && heap_key(l) < heap_key(least)) {
+            least = l;
+        }
+        if (r < fleet.count && heap_key(r) < heap_key(least)) {
+            least = r;
+        }
+        if (least == i) {
+            break;
+        }
+        heap_swap(i, least);
+        i = least;
+    }
+}
+
+/* Nodes ------------------------------------------------------------------- */
+
+static void reschedule(sim_node_t *node, uint64_t now_us) {
+    uint32_t wait_ms = outbox_timeout(&node->box, (uint32_t)(now_us / 1000));
+    uint64_t next = node->report_us < node->heartbeat_us ? node->report_us : node->heartbeat_us;
+
+    if (wait_ms != UINT32_MAX) {
+        uint64_t due = now_us + (wait_ms > 0 ? wait_ms : 1) * 1000ull;
+        if (due < next) {
+            next = due;
+        }
+    }
+    node->next_us = next;
+    heap_fix(node->heap_index);
+}
+
+static void transmit(sim_node_t *node, const uint8_t *packet, size_t length, uint64_t now_us) {
+    fleet.sent++;
+    node->last_frame_us = now_us;
+    if (lose(now_us)) {
+        fleet.lost++;
+        return;
+    }
+
+    uint8_t frame[FRAME_ENCODED_MAX(TELEMETRY_FRAME_MAX)];
+    fleet.unbatched_bytes += frame_encode(packet, length, frame);
+    fleet.delivered++;
+    fleet.heartbeats_delivered += packet[4] == 0;
+    hal_host_radio_receive(packet, length, (uint16_t)(ADDRESS_BASE + (node - fleet.nodes)), node->lqi);
+}
+
+static void send_pending(sim_node_t *node, uint64_t now_us) {
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    size_t length = outbox_poll(&node->box, node->node_id, (uint32_t)(now_us / 1000), frame);
+
+    if (length > 0) {
+        if (node->box.tries == 1) {
+            node->first_sent_us = now_us;
+        }
+        transmit(node, frame, length, now_us);
+    }
+}
+
+static machine_state_t machine_state(sim_node_t *node, uint64_t now_us) {
+    while (now_us >= node->phase_end_us) {
+        node->phase = (uint8_t)((node->phase + 1) % PHASES);
+        uint32_t minutes = cycle[node->phase].state == STATE_IDLE ? 20 + next_random() % 160
+                                                                   : cycle[node->phase].minutes;
+        node->phase_end_us += minutes * 60000000ull;
+    }
+    return cycle[node->phase].state;
+}
+
+static void add_report(sim_node_t *node, uint64_t now_us) {
+    vibration_result_t result = {0};
+    machine_state_t state = machine_state(node, now_us);
+    float jitter = (next_random() % 100) / 1000.0f;
+
+    if (node->sleeping && state == STATE_IDLE) {
+        return;
+    }
+
+    result.state = state;
+    result.timestamp = (uint32_t)(now_us / 1000);
+    result.rms_magnitude = (state == STATE_SPINNING ? 2.0f : state == STATE_WASHING ? 0.4f : 0.02f) + jitter;
+    result.dominant_freq = state == STATE_SPINNING ? 14.0f : state == STATE_WASHING ? 0.8f : 0.0f;
+    result.centroid_hz = result.dominant_freq + jitter;
+    for (int i = 0; i < VIBRATION_BANDS; i++) {
+        result.band_level[i] = (uint8_t)(VIBRATION_BAND_FLOOR + (state == STATE_IDLE ? 0 : next_random() % 8));
+    }
+
+    // as main.c's on_result, with one result per TRANSMIT_INTERVAL_MS
+    bool changed = !node->have_state || state != node->last_state;
+    if (changed) {
+        node->idle_since_us = now_us;
+    }
+    node->have_state = true;
+    node->last_state = state;
+    node->sleeping = false;
+    outbox_add(&node->box, 0, &result);
+    node->generated++;
+    if (changed) {
+        outbox_flush(&node->box, 0, TELEMETRY_FLAG_STATE_CHANGE);
+    } else if (state == STATE_IDLE && now_us - node->idle_since_us >= POWER_SLEEP_AFTER_MS * 1000ull) {
+        // as main.c with POWER_MANAGEMENT_ENABLE: the last result goes now
+        outbox_flush(&node->box, 0, TELEMETRY_FLAG_SLEEPING);
+        node->sleeping = true;
+    }
+}
+
+static void node_run(sim_node_t *node, uint64_t now_us) {
+    if (now_us >= node->report_us) {
+        add_report(node, now_us);
+        node->report_us += TRANSMIT_INTERVAL_MS * 1000ull;
+    }
+    if (now_us >= node->heartbeat_us) {
+        // as main.c's TX_HEARTBEAT
+        if (outbox_unsent(&node->box, 0) > 0) {
+            outbox_flush(&node->box, 0, 0);
+        } else if (now_us - node->last_frame_us >= HEARTBEAT_INTERVAL_MS * 500ull) {
+            uint8_t frame[TELEMETRY_FRAME_MAX];
+            telemetry_t empty;
+            telemetry_init(&empty);
+            transmit(node, frame, telemetry_encode(&empty, node->node_id, 0, 0, (uint32_t)(now_us / 1000), frame),
+                     now_us);
+        }
+        node->heartbeat_us += HEARTBEAT_INTERVAL_MS * 1000ull;
+    }
+    send_pending(node, now_us);
+    reschedule(node, now_us);
+}
+
+// The coordinator's radio: ACKs for the nodes
+static bool radio_send(void *ctx, const uint8_t *packet, size_t length) {
+    uint64_t now_us = hal_time_us();
+    (void)ctx;
+
+    uint16_t node_id = length == sizeof(zigbee_ack_t) ? (uint16_t)(packet[1] | packet[2] << 8) : 0;
+    if (packet[0] != PKT_TYPE_ACK || node_id == 0 || node_id > fleet.count) {
+        return true;
+    }
+    if (lose(now_us)) {
+        fleet.acks_lost++;
+        return true;
+    }
+
+    sim_node_t *node = &fleet.nodes[node_id - 1];
+    outbox_ack(&node->box, (uint16_t)(packet[3] | packet[4] << 8));
+    send_pending(node, now_us);
+    reschedule(node, now_us);
+    return true;
+}
+
+/* Backend ----------------------------------------------------------------- */
+
+static void record_latency(uint64_t us) {
+    size_t bucket = us / 1000 < LATENCY_BUCKETS ? us / 1000 : LATENCY_BUCKETS - 1;
+    fleet.latency[bucket]++;
+    if (us > fleet.latency_max_us) {
+        fleet.latency_max_us = us;
+    }
+}
+
+static double latency_percentile(double p) {
+    unsigned long total = 0, seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        total += fleet.latency[i];
+    }
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += fleet.latency[i];
+        if (total > 0 && seen >= p * total) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void send_ack(uint16_t node_id, uint16_t seq, uint64_t at_us) {
+    if (fleet.ack_count == 64) {
+        fleet.acks_dropped++;
+        return;
+    }
+
+    zigbee_ack_t ack = { .packet_type = PKT_TYPE_ACK, .node_id = node_id, .seq = seq };
+    ack.checksum = zigbee_compute_checksum((uint8_t *)&ack, sizeof(ack) - sizeof(uint16_t));
+
+    size_t slot = (fleet.ack_head + fleet.ack_count) % 64;
+    fleet.ack_lengths[slot] = frame_encode((const uint8_t *)&ack, sizeof(ack), fleet.acks[slot]);
+    fleet.ack_us[slot] = at_us + COORDINATOR_LINK_MS(fleet.ack_lengths[slot]) * 1000ull;
+    fleet.ack_count++;
+    fleet.acks_sent++;
+}
+
+// A node's packet, as server.py stores it
+static void store(const uint8_t *packet, size_t length, uint64_t done_us) {
+    if ((packet[0] != PKT_TYPE_BATCH && packet[0] != PKT_TYPE_FEATURES) || length < TELEMETRY_HEADER_SIZE + 2) {
+        return;
+    }
+    uint16_t node_id = (uint16_t)(packet[1] | packet[2] << 8);
+    uint16_t seq = (uint16_t)(packet[9] | packet[10] << 8);
+    if (node_id == 0 || node_id > fleet.count || packet[4] == 0) {
+        return;
+    }
+
+    sim_node_t *node = &fleet.nodes[node_id - 1];
+    fleet.frames++;
+    if (seq == node->stored_seq) {
+        fleet.duplicates++;
+    } else {
+        node->stored_seq = seq;
+        fleet.reports += packet[4];
+        if (node->box.in_flight && node->box.seq == seq) {
+            record_latency(done_us - node->first_sent_us);
+        }
+    }
+    send_ack(node_id, seq, done_us + BACKEND_ACK_US);
+}
+
+static bool crc_ok(const uint8_t *packet, size_t length) {
+    return length >= COORDINATOR_HEADER_SIZE + 2 &&
+           frame_crc16(packet, length - 2) == (uint16_t)(packet[length - 2] | packet[length - 1] << 8);
+}
+
+static void backend_packet(const uint8_t *packet, size_t length, uint64_t done_us) {
+    if (packet[0] == PKT_TYPE_NODES) {
+        if (!crc_ok(packet, length)) {
+            fleet.bad++;
+            return;
+        }
+        fleet.statuses++;
+        fleet.listed += packet[5];
+        return;
+    }
+    if (packet[0] != PKT_TYPE_AGGREGATE) {
+        fleet.unwrapped++;
+        store(packet, length, done_us);
+        return;
+    }
+    if (!crc_ok(packet, length)) {
+        fleet.bad++;
+        return;
+    }
+
+    fleet.aggregates++;
+    const uint8_t *p = packet + COORDINATOR_HEADER_SIZE, *end = packet + length - 2;
+    for (uint8_t i = 0; i < packet[5] && p < end; i++) {
+        while (p < end && (*p & 0x80)) {
+            p++;                      // age: the node's send time is known here
+        }
+        p++;
+        if (p >= end || p + 1 + *p > end) {
+            fleet.bad++;
+            return;
+        }
+        fleet.aggregated++;
+        store(p + 1, *p, done_us);
+        p += 1 + *p;
+    }
+}
+
+// The coordinator's UART
+static bool uart_write(void *ctx, const uint8_t *data, size_t length) {
+    uint64_t now_us = hal_time_us();
+    (void)ctx;
+
+    if (fleet.line_free_us > now_us && fleet.line_free_us - now_us > fleet.backlog_max_us) {
+        fleet.backlog_max_us = fleet.line_free_us - now_us;
+    }
+    fleet.line_free_us = (fleet.line_free_us > now_us ? fleet.line_free_us : now_us) +
+                         (uint64_t)length * 10000000 / DEBUG_BAUD_RATE;
+    fleet.line_bytes += length;
+    if (fleet.out != NULL) {
+        fwrite(data, 1, length, fleet.out);
+    }
+    if (now_us / 1000000 != fleet.second) {
+        fleet.second = now_us / 1000000;
+        fleet.second_bytes = 0;
+    }
+    fleet.second_bytes += length;
+    if (fleet.second_bytes > fleet.second_max) {
+        fleet.second_max = fleet.second_bytes;
+    }
+
+    while (length > 0) {
+        const uint8_t *packet;
+        size_t packet_length = 0;
+        size_t used = frame_decoder_feed(&fleet.decoder, data, length, &packet, &packet_length);
+        data += used;
+        length -= used;
+        if (packet_length > 0) {
+            backend_packet(packet, packet_length, fleet.line_free_us);
+        }
+    }
+    return true;
+}
+
+/* The fleet as one host device -------------------------------------------- */
+
+static uint64_t fleet_next_event_us(void *ctx) {
+    uint64_t next = fleet.count > 0 ? heap_key(0) : UINT64_MAX;
+    (void)ctx;
+
+    if (fleet.ack_count > 0 && fleet.ack_us[fleet.ack_head] < next) {
+        next = fleet.ack_us[fleet.ack_head];
+    }
+    return next;
+}
+
+static void fleet_advance(void *ctx, uint64_t now_us) {
+    (void)ctx;
+
+    if (fleet.ack_count > 0 && fleet.ack_us[fleet.ack_head] <= now_us) {
+        size_t slot = fleet.ack_head;
+        fleet.ack_head = (fleet.ack_head + 1) % 64;
+        fleet.ack_count--;
+        hal_host_uart_receive(fleet.acks[slot], fleet.ack_lengths[slot]);
+        return;
+    }
+    if (fleet.count > 0 && heap_key(0) <= now_us) {
+        node_run(&fleet.nodes[fleet.heap[0]], now_us);
+    }
+}
+
+static bool fleet_init(size_t count) {
+    fleet.nodes = calloc(count, sizeof(sim_node_t));
+    fleet.heap = calloc(count, sizeof(size_t));
+    if (fleet.nodes == NULL || fleet.heap == NULL) {
+        return false;
+    }
+    fleet.rng = 1;
+    frame_decoder_init(&fleet.decoder);
+
+    for (size_t i = 0; i < count; i++) {
+        sim_node_t *node = &fleet.nodes[i];
+
+        outbox_init(&node->box);
+        node->node_id = (uint16_t)(i + 1);
+        node->lqi = (uint8_t)(100 + next_random() % 156);
+        // nodes come up spread over the first heartbeat interval, with
+        // their machines somewhere in the day
+        node->report_us = next_random() % (HEARTBEAT_INTERVAL_MS * 1000u);
+        node->heartbeat_us = node->report_us + HEARTBEAT_INTERVAL_MS * 1000ull;
+        node->next_us = node->report_us;
+        node->phase = (uint8_t)(next_random() % PHASES);
+        node->phase_end_us = (next_random() % 30 + 1) * 60000000ull;
+        node->heap_index = i;
+        fleet.heap[i] = i;
+        fleet.count = i + 1;
+        heap_fix(i);
+    }
+    return true;
+}
+
+static void report(double hours, double wall_s) {
+    hal_host_stats_t stats;
+    hal_host_task_info_t info;
+    double seconds = hours * 3600;
+    double line = DEBUG_BAUD_RATE / 10.0;
+    unsigned long frames = 0, retries = 0, thinned = 0, queued = 0, generated = 0;
+
+    hal_host_stats(&stats);
+    for (size_t i = 0; i < fleet.count; i++) {
+        frames += fleet.nodes[i].box.frames;
+        retries += fleet.nodes[i].box.retries;
+        thinned += fleet.nodes[i].box.thinned;
+        queued += fleet.nodes[i].box.queues[0].count;
+        generated += fleet.nodes[i].generated;
+    }
+    unsigned long forwarded = fleet.aggregated + fleet.unwrapped;
+    unsigned long to_forward = fleet.delivered - fleet.heartbeats_delivered;
+
+    printf("simulated %.2f h, %zu nodes, in %.2f s wall\n", hours, fleet.count, wall_s);
+    for (size_t i = 0; hal_host_task_info(i, &info); i++) {
+        printf("task:    %s %lu wakeups, %.2f us host CPU each\n", info.name, info.wakeups,
+               info.wakeups ? info.cpu_s * 1e6 / info.wakeups : 0.0);
+    }
+    printf("radio:   %lu packets sent by nodes, %lu lost, %lu reached the coordinator "
+           "(%lu heartbeats), %lu ACKs lost\n",
+           fleet.sent, fleet.lost, fleet.delivered, fleet.heartbeats_delivered, fleet.acks_lost);
+    printf("serial:  %lu bytes, %.0f B/s (%.1f%% of %u baud), busiest second %.1f%%, "
+           "UART backlog max %.1f ms\n",
+           fleet.line_bytes, fleet.line_bytes / seconds, 100 * fleet.line_bytes / seconds / line,
+           DEBUG_BAUD_RATE, 100 * fleet.second_max / line, fleet.backlog_max_us / 1e3);
+    printf("         forwarding every packet on its own: %.0f B/s (%.1f%%)\n",
+           fleet.unbatched_bytes / seconds, 100 * fleet.unbatched_bytes / seconds / line);
+    printf("coord:   %lu aggregates (%.1f packets each), %lu unwrapped, %lu node lists (%lu entries), "
+           "%lu packets lost (mailbox or queue full, or still queued)\n",
+           fleet.aggregates, fleet.aggregates ? (double)fleet.aggregated / fleet.aggregates : 0.0,
+           fleet.unwrapped, fleet.statuses, fleet.listed,
+           to_forward > forwarded ? to_forward - forwarded : 0);
+    printf("backend: %lu frames (%lu duplicates), %lu ACKs, %lu bad\n",
+           fleet.frames, fleet.duplicates, fleet.acks_sent, fleet.bad);
+    printf("nodes:   %lu frames, %lu retries; %lu reports: %lu stored, %lu thinned, %lu still queued\n",
+           frames, retries, generated, fleet.reports, thinned, queued);
+    printf("latency: first send to stored, p50 %.0f ms, p99 %.0f ms, max %.0f ms\n",
+           latency_percentile(0.5), latency_percentile(0.99), fleet.latency_max_us / 1e3);
+}
+
+int main(int argc, char **argv) {
+    hal_host_config_t config = { 0 };
+    double run_hours = 2, loss = 0, outage_hour = 0, outage_minutes = 0;
+    long count = 300;
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:H:l:O:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 'H':
+                run_hours = atof(optarg);
+                break;
+            case 'l':
+                loss = atof(optarg) / 100;
+                break;
+            case 'O':
+                if (sscanf(optarg, "%lf:%lf", &outage_hour, &outage_minutes) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (count < 1 || count > UINT16_MAX - 1 || run_hours <= 0 || loss < 0 || loss > 1 ||
+        outage_hour < 0 || outage_minutes < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (count > COORDINATOR_MAX_NODES) {
+        printf("%ld nodes, the coordinator tracks %d: ACKs for forgotten nodes are lost\n",
+               count, COORDINATOR_MAX_NODES);
+    }
+
+    if (!fleet_init((size_t)count)) {
+        perror("fleet");
+        return 1;
+    }
+    if (out_path != NULL && (fleet.out = fopen(out_path, "wb")) == NULL) {
+        perror(out_path);
+        return 1;
+    }
+    fleet.loss = loss;
+    fleet.outage_start_us = (uint64_t)(outage_hour * 3600e6);
+    fleet.outage_end_us = fleet.outage_start_us + (uint64_t)(outage_minutes * 60e6);
+
+    hal_host_device_t device = {
+        .irq_gpio = -1,
+        .next_event_us = fleet_next_event_us,
+        .advance = fleet_advance,
+    };
+    hal_host_attach(&device);
+    hal_host_set_radio(radio_send, NULL);
+    hal_host_set_uart(uart_write, NULL);
+
+    config.end_us = (uint64_t)(run_hours * 3600e6);
+    hal_host_configure(&config);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = coordinator_main();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (status != 0) {
+        fprintf(stderr, "coordinator main() failed\n");
+    }
+    report(run_hours, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+
+    if (fleet.out != NULL) {
+        fclose(fleet.out);
+    }
+    free(fleet.nodes);
+    free(fleet.heap);
+    return status;
+}
@@ -0,0 +1,113 @@
+/*
+ * Serial framing throughput
+ *
+ * Builds a stream of framed packets the size of real telemetry (11..82
+ * bytes, see telemetry.h) and times frame_codec.c over it on the host:
+ * CRC alone, encoding, and decoding a clean stream and one with a byte
+ * flipped every `corrupt` bytes. Decode speed is what the backend gets
+ * through libframe_codec.so, minus the ctypes call per packet; it's
+ * compared against what 115200 baud 8N1 can deliver (11520 bytes/s).
+ *
+ * Usage: frame_bench [corrupt_every]   (default 1000, 0 = clean only)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frame_codec.h"
+
+#define STREAM_PACKETS 20000
+#define REPEAT 50
+#define LINE_RATE_BPS (115200.0 / 10.0)  // 8N1: 10 bits per byte
+
+static uint8_t stream[STREAM_PACKETS * FRAME_ENCODED_MAX(82)];
+static uint8_t packets[STREAM_PACKETS][82];
+static size_t packet_lengths[STREAM_PACKETS];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double bytes, double seconds, double frames) {
+    printf("%-20s %8.1f MB/s  %10.0f frames/s  %8.0fx line rate\n",
+           name, bytes / seconds / 1e6, frames / seconds, bytes / seconds / LINE_RATE_BPS);
+}
+
+static void decode(const char *name, const uint8_t *data, size_t length) {
+    frame_decoder_t d;
+    unsigned long got = 0;
+    double start = now_s();
+
+    for (int r = 0; r < REPEAT; r++) {
+        frame_decoder_init(&d);
+        size_t pos = 0;
+        while (pos < length) {
+            const uint8_t *packet;
+            size_t packet_length;
+            pos += frame_decoder_feed(&d, data + pos, length - pos, &packet, &packet_length);
+            got += packet_length > 0;
+        }
+    }
+
+    double t = now_s() - start;
+    report(name, (double)length * REPEAT, t, (double)got);
+    printf("%-20s %u good, %u crc, %u length, %u overrun per pass\n", "",
+           (unsigned)d.stats.frames, (unsigned)d.stats.crc_errors,
+           (unsigned)d.stats.length_errors, (unsigned)d.stats.overruns);
+}
+
+int main(int argc, char **argv) {
+    long corrupt = argc > 1 ? atol(argv[1]) : 1000;
+    size_t length = 0;
+    size_t payload = 0;
+
+    if (corrupt < 0) {
+        fprintf(stderr, "usage: %s [corrupt_every]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    for (int i = 0; i < STREAM_PACKETS; i++) {
+        packet_lengths[i] = 11 + (size_t)(rand() % 72);
+        for (size_t j = 0; j < packet_lengths[i]; j++) {
+            // mostly small values, like quantized deltas and varints
+            packets[i][j] = (uint8_t)(rand() % 4 ? rand() % 16 : rand());
+        }
+        payload += packet_lengths[i];
+    }
+
+    double start = now_s();
+    for (int r = 0; r < REPEAT; r++) {
+        for (int i = 0; i < STREAM_PACKETS; i++) {
+            volatile uint16_t crc = frame_crc16(packets[i], packet_lengths[i]);
+            (void)crc;
+        }
+    }
+    report("crc16", (double)payload * REPEAT, now_s() - start, (double)STREAM_PACKETS * REPEAT);
+
+    start = now_s();
+    for (int r = 0; r < REPEAT; r++) {
+        length = 0;
+        for (int i = 0; i < STREAM_PACKETS; i++) {
+            length += frame_encode(packets[i], packet_lengths[i], &stream[length]);
+        }
+    }
+    report("encode", (double)payload * REPEAT, now_s() - start, (double)STREAM_PACKETS * REPEAT);
+    printf("%-20s %.1f%% framing overhead\n", "", 100.0 * (length - payload) / payload);
+
+    decode("decode clean", stream, length);
+
+    if (corrupt > 0) {
+        srand(2);
+        for (size_t i = (size_t)(rand() % corrupt); i < length; i += (size_t)corrupt) {
+            stream[i] ^= (uint8_t)(1 << (rand() % 8));
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "decode 1/%ld flipped", corrupt);
+        decode(name, stream, length);
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""
+Generates the precomputed lookup tables used by the firmware DSP code.
+
+Run from the firmware directory after changing FFT_TABLE_SIZE or the zoom
+filter design below:
+    python3 tools/gen_tables.py
+
+Writes fft_tables.h/.c and zoom_tables.h/.c. Don't edit those by hand.
+"""
+
+import math
+import os
+import sys
+
+# Largest real-input FFT length the tables support. Smaller power-of-2
+# lengths reuse the same tables with a stride, so this only needs to cover
+# the biggest window we ever run.
+FFT_TABLE_SIZE = 512
+
+# Zoom analysis decimating low-pass filters (vibration_analysis.c), one per
+# decimation factor the analysis may use: ZOOM_DECIMATION and the smaller
+# factors it drops to at lower sample rates. ZOOM_TAPS_PER_PHASE * D taps,
+# a Kaiser-windowed sinc with its -6 dB point at the decimated Nyquist.
+# Beta 5: flat to 0.8x that Nyquist, -50 dB and below from 1.2x (10 and
+# 15 Hz for 100 Hz in, 25 Hz out).
+ZOOM_DECIMATIONS = (2, 4, 8)
+ZOOM_TAPS_PER_PHASE = 16
+ZOOM_KAISER_BETA = 5.0
+
+HEADER = "// Generated by tools/gen_tables.py - do not edit\n"
+
+
+def log2(n):
+    bits = 0
+    while (1 << bits) < n:
+        bits += 1
+    return bits
+
+
+def reverse_bits(n, bits):
+    out = 0
+    for i in range(bits):
+        if n & (1 << i):
+            out |= 1 << (bits - 1 - i)
+    return out
+
+
+def format_rows(values, per_row, fmt):
+    rows = []
+    for i in range(0, len(values), per_row):
+        rows.append("    " + ", ".join(fmt(v) for v in values[i:i + per_row]) + ",")
+    return "\n".join(rows)
+
+
+def fmt_float(v):
+    # avoid "-0.0000000f"
+    if abs(v) < 5e-10:
+        v = 0.0
+    return f"{v: .9f}f"
+
+
+def to_q15(v):
+    # 1.0 isn't representable, saturate to 0x7FFF
+    return max(-32768, min(32767, int(round(v * 32768.0))))
+
+
+def gen_header():
+    half = FFT_TABLE_SIZE // 2
+    return f"""{HEADER}#ifndef FFT_TABLES_H
+#define FFT_TABLES_H
+
+#include <stdint.h>
+
+// Largest supported real-input FFT length
+#define FFT_TABLE_SIZE {FFT_TABLE_SIZE}
+#define FFT_TABLE_LOG2 {log2(FFT_TABLE_SIZE)}
+
+// Twiddles W^k = exp(-2*pi*i*k / FFT_TABLE_SIZE) for k < FFT_TABLE_SIZE/2
+extern const float fft_twiddle_cos[{half}];
+extern const float fft_twiddle_sin[{half}];
+
+// Same twiddles in Q15, interleaved (cos, -sin) so one 32-bit load gives
+// a packed complex value for the M4 dual 16-bit multiply instructions
+extern const int16_t fft_twiddle_q15[{2 * half}];
+
+// Bit reversal of i over log2(FFT_TABLE_SIZE/2) bits
+extern const uint8_t fft_bitrev[{half}];
+
+#endif // FFT_TABLES_H
+"""
+
+
+def gen_source():
+    half = FFT_TABLE_SIZE // 2
+    bits = log2(half)
+    cos_vals = [math.cos(2.0 * math.pi * k / FFT_TABLE_SIZE) for k in range(half)]
+    sin_vals = [-math.sin(2.0 * math.pi * k / FFT_TABLE_SIZE) for k in range(half)]
+    bitrev = [reverse_bits(i, bits) for i in range(half)]
+    twiddle_q15 = []
+    for c, si in zip(cos_vals, sin_vals):
+        twiddle_q15.append(to_q15(c))
+        twiddle_q15.append(to_q15(si))
+
+    return f"""{HEADER}#include "fft_tables.h"
+
+const float fft_twiddle_cos[{half}] = {{
+{format_rows(cos_vals, 4, fmt_float)}
+}};
+
+const float fft_twiddle_sin[{half}] = {{
+{format_rows(sin_vals, 4, fmt_float)}
+}};
+
+const int16_t fft_twiddle_q15[{2 * half}] = {{
+{format_rows(twiddle_q15, 8, lambda v: f"{v:6d}")}
+}};
+
+const uint8_t fft_bitrev[{half}] = {{
+{format_rows(bitrev, 16, lambda v: f"{v:3d}")}
+}};
+"""
+
+
+def bessel_i0(x):
+    total = term = 1.0
+    k = 0
+    while term > 1e-12 * total:
+        k += 1
+        term *= (x / (2 * k)) ** 2
+        total += term
+    return total
+
+
+def zoom_filter(decimation):
+    """Prototype low-pass h[0..taps-1], unity gain at DC"""
+    taps = ZOOM_TAPS_PER_PHASE * decimation
+    cutoff = 0.5 / decimation  # cycles per input sample
+    middle = (taps - 1) / 2.0
+    h = []
+    for m in range(taps):
+        t = m - middle
+        sinc = 2 * cutoff * (math.sin(2 * math.pi * cutoff * t) / (2 * math.pi * cutoff * t) if t else 1.0)
+        window = bessel_i0(ZOOM_KAISER_BETA * math.sqrt(1 - (t / (middle + 0.5)) ** 2))
+        h.append(sinc * window / bessel_i0(ZOOM_KAISER_BETA))
+    total = sum(h)
+    return [v / total for v in h]
+
+
+def zoom_phases(h, decimation):
+    """Polyphase order: row r (input phase), column j = h[j * D + D - 1 - r]"""
+    return [h[j * decimation + decimation - 1 - r]
+            for r in range(decimation) for j in range(ZOOM_TAPS_PER_PHASE)]
+
+
+def zoom_q15(coefs):
+    """Q15, the rounding error put on the largest tap so the DC gain stays
+    exactly 1"""
+    q = [to_q15(v) for v in coefs]
+    largest = max(range(len(q)), key=lambda i: abs(q[i]))
+    q[largest] += 32768 - sum(q)
+    return q
+
+
+def gen_zoom_header():
+    decls = []
+    for d in ZOOM_DECIMATIONS:
+        size = d * ZOOM_TAPS_PER_PHASE
+        decls.append(f"extern const float zoom_filter_{d}[{size}];\n"
+                     f"extern const int16_t zoom_filter_{d}_q15[{size}];")
+    decls = "\n".join(decls)
+    return f"""{HEADER}#ifndef ZOOM_TABLES_H
+#define ZOOM_TABLES_H
+
+#include <stdint.h>
+
+// Decimating low-pass filters for the zoom analysis, one per decimation D:
+// D * ZOOM_TAPS_PER_PHASE taps, unity gain at DC, cut off at the decimated
+// Nyquist. Polyphase order, [r * ZOOM_TAPS_PER_PHASE + j] = h[j * D + D - 1 - r]:
+// what input sample r of a block of D adds to the output j blocks on.
+#define ZOOM_TAPS_PER_PHASE {ZOOM_TAPS_PER_PHASE}
+#define ZOOM_DECIMATION_MAX {max(ZOOM_DECIMATIONS)}
+
+{decls}
+
+#endif // ZOOM_TABLES_H
+"""
+
+
+def gen_zoom_source():
+    tables = []
+    for d in ZOOM_DECIMATIONS:
+        size = d * ZOOM_TAPS_PER_PHASE
+        coefs = zoom_phases(zoom_filter(d), d)
+        tables.append(f"""const float zoom_filter_{d}[{size}] = {{
+{format_rows(coefs, 4, fmt_float)}
+}};
+
+const int16_t zoom_filter_{d}_q15[{size}] = {{
+{format_rows(zoom_q15(coefs), 8, lambda v: f"{v:6d}")}
+}};
+""")
+    return f"""{HEADER}#include "zoom_tables.h"
+
+""" + "\n".join(tables)
+
+
+def main():
+    if FFT_TABLE_SIZE > 512 or FFT_TABLE_SIZE & (FFT_TABLE_SIZE - 1):
+        # bit reversal table is uint8_t
+        sys.exit("FFT_TABLE_SIZE must be a power of 2 <= 512")
+
+    out_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+    with open(os.path.join(out_dir, "fft_tables.h"), "w") as f:
+        f.write(gen_header())
+    with open(os.path.join(out_dir, "fft_tables.c"), "w") as f:
+        f.write(gen_source())
+    with open(os.path.join(out_dir, "zoom_tables.h"), "w") as f:
+        f.write(gen_zoom_header())
+    with open(os.path.join(out_dir, "zoom_tables.c"), "w") as f:
+        f.write(gen_zoom_source())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,610 @@
+#define _GNU_SOURCE
+#include "hal.h"
+#include "hal_host.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+// Linux implementation of hal.h, see hal_host.h
+
+#define HOST_MAX_TASKS 8
+#define HOST_MAX_DEVICES 4   // the sensors (SENSOR_ADDRESSES) and the radio
+#define HOST_STACK_SIZE (256 * 1024)
+#define STACK_FILL 0xA5
+#define FOREVER UINT64_MAX
+
+static hal_host_config_t config = { .end_us = FOREVER };
+static uint64_t now_us = 0;
+
+static double clock_s(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Tasks ------------------------------------------------------------------- */
+
+typedef bool (*ready_fn_t)(void *obj);
+
+struct hal_task {
+    const char *name;
+    hal_task_fn_t fn;
+    int priority;
+    ucontext_t ctx;
+    uint8_t *stack;
+    bool started;
+    bool done;
+
+    // what it's blocked on, if anything
+    ready_fn_t ready;
+    void *obj;
+    uint64_t wake_us;
+    bool timed_out;
+
+    unsigned long wakeups;
+    double cpu_s;
+    double max_slice_s;
+    double stat_cpu_s;          // at the last hal_task_stat()
+    uint64_t stat_us;
+};
+
+static struct hal_task task_pool[HOST_MAX_TASKS];
+static struct hal_task *tasks[HOST_MAX_TASKS];  // by priority, highest first
+static size_t task_count = 0;
+static struct hal_task *current = NULL;
+static ucontext_t kernel_ctx;
+
+static double cpu_load_s = 0;
+static uint64_t cpu_load_us = 0;
+
+static void task_entry(void) {
+    current->fn();
+    current->done = true;
+    // returning switches to uc_link, the kernel
+}
+
+static void init_context(ucontext_t *ctx, uint8_t *stack) {
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = HOST_STACK_SIZE;
+    ctx->uc_link = &kernel_ctx;
+    makecontext(ctx, task_entry, 0);
+}
+
+hal_task_t hal_task_create(const char *name, hal_task_fn_t fn, int priority,
+                           uint8_t *stack, size_t stack_size) {
+    (void)stack;
+    (void)stack_size;
+
+    if (task_count >= HOST_MAX_TASKS) {
+        return NULL;
+    }
+
+    struct hal_task *t = &task_pool[task_count];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->fn = fn;
+    t->priority = priority;
+    t->wake_us = FOREVER;
+    t->stack = malloc(HOST_STACK_SIZE);
+    if (t->stack == NULL) {
+        return NULL;
+    }
+    memset(t->stack, STACK_FILL, HOST_STACK_SIZE);  // for the high water mark
+
+    init_context(&t->ctx, t->stack);
+
+    size_t i = task_count++;
+    while (i > 0 && tasks[i - 1]->priority < priority) {
+        tasks[i] = tasks[i - 1];
+        i--;
+    }
+    tasks[i] = t;
+    return t;
+}
+
+// Stacks grow down, so the untouched fill is at the bottom
+static size_t stack_used(const struct hal_task *t) {
+    size_t untouched = 0;
+    while (untouched < HOST_STACK_SIZE && t->stack[untouched] == STACK_FILL) {
+        untouched++;
+    }
+    return HOST_STACK_SIZE - untouched;
+}
+
+static uint32_t percent(double cpu_s, uint64_t elapsed_us) {
+    if (elapsed_us == 0) {
+        return 0;
+    }
+    double p = 100.0 * cpu_s * config.cpu_scale * 1e6 / (double)elapsed_us;
+    return p > 100.0 ? 100 : (uint32_t)p;
+}
+
+// CPU percentages are host CPU x cpu_scale over virtual time, so 0 unless
+// the run was configured with a scale
+bool hal_task_stat(hal_task_t task, hal_task_stat_t *stat) {
+    stat->stack_used = (uint32_t)stack_used(task);
+    stat->cpu_percent = percent(task->cpu_s - task->stat_cpu_s, now_us - task->stat_us);
+    task->stat_cpu_s = task->cpu_s;
+    task->stat_us = now_us;
+    return true;
+}
+
+uint32_t hal_cpu_load(void) {
+    double total = 0;
+    for (size_t i = 0; i < task_count; i++) {
+        total += tasks[i]->cpu_s;
+    }
+    uint32_t load = percent(total - cpu_load_s, now_us - cpu_load_us);
+    cpu_load_s = total;
+    cpu_load_us = now_us;
+    return load;
+}
+
+// Park the current task until ready(obj) or the timeout. Called from task
+// context only; true if it's ready, false on timeout.
+static bool wait_for(ready_fn_t ready, void *obj, uint32_t timeout_ms) {
+    struct hal_task *t = current;
+
+    if (ready != NULL && ready(obj)) {
+        return true;
+    }
+    if (timeout_ms == HAL_NO_WAIT || t == NULL) {
+        return false;
+    }
+
+    t->ready = ready;
+    t->obj = obj;
+    t->wake_us = timeout_ms == HAL_WAIT_FOREVER ? FOREVER : now_us + (uint64_t)timeout_ms * 1000;
+    t->timed_out = false;
+    swapcontext(&t->ctx, &kernel_ctx);
+    return !t->timed_out;
+}
+
+// Highest priority task that can run now. Clears its wait.
+static struct hal_task *pick(void) {
+    for (size_t i = 0; i < task_count; i++) {
+        struct hal_task *t = tasks[i];
+        if (t->done) {
+            continue;
+        }
+        if (!t->started) {
+            return t;
+        }
+
+        bool ready = t->ready != NULL && t->ready(t->obj);
+        if (ready || t->wake_us <= now_us) {
+            t->timed_out = !ready;
+            t->ready = NULL;
+            t->wake_us = FOREVER;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void run_slice(struct hal_task *t) {
+    double start = clock_s(CLOCK_THREAD_CPUTIME_ID);
+
+    t->started = true;
+    t->wakeups++;
+    current = t;
+    swapcontext(&kernel_ctx, &t->ctx);
+    current = NULL;
+
+    double slice = clock_s(CLOCK_THREAD_CPUTIME_ID) - start;
+    t->cpu_s += slice;
+    if (slice > t->max_slice_s) {
+        t->max_slice_s = slice;
+    }
+    if (config.cpu_scale > 0) {
+        now_us += (uint64_t)(slice * config.cpu_scale * 1e6);
+    }
+}
+
+/* Time -------------------------------------------------------------------- */
+
+bool hal_time_init(void) {
+    return true;
+}
+
+uint64_t hal_time_us(void) {
+    return now_us;
+}
+
+void hal_delay_ms(uint32_t ms) {
+    wait_for(NULL, NULL, ms);
+}
+
+// Host CPU time of the firmware (all tasks share the thread), so time this
+// process wasn't scheduled doesn't show up as a slow stage
+uint32_t hal_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+uint32_t hal_cycles_hz(void) {
+    return 1000000000u;
+}
+
+// One thread and interrupts only between slices: nothing to lock
+uintptr_t hal_irq_disable(void) {
+    return 0;
+}
+
+void hal_irq_restore(uintptr_t key) {
+    (void)key;
+}
+
+/* Semaphores and mailboxes ------------------------------------------------ */
+
+struct hal_sem {
+    unsigned count;
+    bool binary;
+};
+
+static bool sem_ready(void *obj) {
+    return ((struct hal_sem *)obj)->count > 0;
+}
+
+hal_sem_t hal_sem_create(bool binary) {
+    struct hal_sem *sem = calloc(1, sizeof(*sem));
+    if (sem != NULL) {
+        sem->binary = binary;
+    }
+    return sem;
+}
+
+void hal_sem_post(hal_sem_t sem) {
+    sem->count = sem->binary ? 1 : sem->count + 1;
+}
+
+bool hal_sem_pend(hal_sem_t sem, uint32_t timeout_ms) {
+    if (!wait_for(sem_ready, sem, timeout_ms)) {
+        return false;
+    }
+    sem->count--;
+    return true;
+}
+
+struct hal_mbox {
+    uint8_t *buf;
+    size_t msg_size;
+    unsigned depth;
+    unsigned head;
+    unsigned count;
+};
+
+static bool mbox_not_empty(void *obj) {
+    return ((struct hal_mbox *)obj)->count > 0;
+}
+
+static bool mbox_not_full(void *obj) {
+    struct hal_mbox *mbox = obj;
+    return mbox->count < mbox->depth;
+}
+
+hal_mbox_t hal_mbox_create(size_t msg_size, unsigned depth) {
+    struct hal_mbox *mbox = calloc(1, sizeof(*mbox));
+    if (mbox == NULL) {
+        return NULL;
+    }
+    mbox->buf = malloc(msg_size * depth);
+    if (mbox->buf == NULL) {
+        free(mbox);
+        return NULL;
+    }
+    mbox->msg_size = msg_size;
+    mbox->depth = depth;
+    return mbox;
+}
+
+bool hal_mbox_post(hal_mbox_t mbox, const void *msg, uint32_t timeout_ms) {
+    if (!wait_for(mbox_not_full, mbox, timeout_ms)) {
+        return false;
+    }
+    unsigned slot = (mbox->head + mbox->count) % mbox->depth;
+    memcpy(mbox->buf + slot * mbox->msg_size, msg, mbox->msg_size);
+    mbox->count++;
+    return true;
+}
+
+bool hal_mbox_pend(hal_mbox_t mbox, void *msg, uint32_t timeout_ms) {
+    if (!wait_for(mbox_not_empty, mbox, timeout_ms)) {
+        return false;
+    }
+    memcpy(msg, mbox->buf + mbox->head * mbox->msg_size, mbox->msg_size);
+    mbox->head = (mbox->head + 1) % mbox->depth;
+    mbox->count--;
+    return true;
+}
+
+/* Devices, I2C and GPIO ----------------------------------------------------
+ * A transaction occupies the bus for its bytes (9 clocks each, address
+ * included, plus start/stop) and completes when that's over; queued ones
+ * run back to back. The device sees the transfer at completion time.
+ */
+
+static hal_host_device_t devices[HOST_MAX_DEVICES];
+static bool irq_levels[HOST_MAX_DEVICES];
+static size_t device_count = 0;
+
+static uint32_t i2c_bit_rate = 0;
+static hal_i2c_transaction_t *i2c_ring[HAL_I2C_QUEUE_MAX];
+static uint64_t i2c_done_us[HAL_I2C_QUEUE_MAX];
+static size_t i2c_head = 0;
+static size_t i2c_count = 0;
+static uint64_t i2c_bus_free_us = 0;
+
+static hal_gpio_isr_t gpio_isrs[HAL_GPIO_MAX];
+
+static hal_host_stats_t stats;
+
+bool hal_host_attach(const hal_host_device_t *device) {
+    if (device_count >= HOST_MAX_DEVICES) {
+        return false;
+    }
+    devices[device_count++] = *device;
+    return true;
+}
+
+bool hal_i2c_open(uint32_t bit_rate) {
+    i2c_bit_rate = bit_rate;
+    return bit_rate > 0;
+}
+
+static uint64_t i2c_duration_us(const hal_i2c_transaction_t *t) {
+    size_t bytes = 1 + t->write_count + (t->read_count > 0 ? 1 + t->read_count : 0);
+    uint64_t clocks = bytes * 9 + 2 + (t->read_count > 0 && t->write_count > 0);
+    return (clocks * 1000000 + i2c_bit_rate - 1) / i2c_bit_rate;
+}
+
+bool hal_i2c_queue(hal_i2c_transaction_t *transaction) {
+    if (i2c_bit_rate == 0 || i2c_count >= HAL_I2C_QUEUE_MAX) {
+        return false;
+    }
+
+    uint64_t start = i2c_bus_free_us > now_us ? i2c_bus_free_us : now_us;
+    size_t slot = (i2c_head + i2c_count++) % HAL_I2C_QUEUE_MAX;
+    i2c_ring[slot] = transaction;
+    i2c_done_us[slot] = start + i2c_duration_us(transaction);
+    i2c_bus_free_us = i2c_done_us[slot];
+    return true;
+}
+
+static hal_i2c_transaction_t *i2c_pop(void) {
+    hal_i2c_transaction_t *t = i2c_ring[i2c_head];
+    i2c_head = (i2c_head + 1) % HAL_I2C_QUEUE_MAX;
+    i2c_count--;
+    return t;
+}
+
+void hal_i2c_cancel(void) {
+    // everything still queued fails, like I2C_cancel()
+    while (i2c_count > 0) {
+        hal_i2c_transaction_t *t = i2c_pop();
+        stats.i2c_failed++;
+        t->callback(t, false);
+    }
+    i2c_bus_free_us = now_us;
+}
+
+static void i2c_complete(uint64_t at_us) {
+    hal_i2c_transaction_t *t = i2c_pop();
+    bool ok = false;
+
+    for (size_t i = 0; i < device_count; i++) {
+        if (devices[i].transfer != NULL && devices[i].address == t->address) {
+            ok = devices[i].transfer(devices[i].ctx, at_us, t->write_buf, t->write_count,
+                                     t->read_buf, t->read_count);
+            break;
+        }
+    }
+
+    stats.i2c_transactions++;
+    if (!ok) {
+        stats.i2c_failed++;
+    }
+    t->callback(t, ok);
+}
+
+bool hal_gpio_enable_int(uint8_t index, hal_gpio_isr_t isr) {
+    if (index >= HAL_GPIO_MAX) {
+        return false;
+    }
+    gpio_isrs[index] = isr;
+    return true;
+}
+
+// Rising edges on the devices' interrupt lines
+static void check_irqs(void) {
+    for (size_t i = 0; i < device_count; i++) {
+        const hal_host_device_t *d = &devices[i];
+        if (d->irq_gpio < 0 || d->irq_level == NULL) {
+            continue;
+        }
+
+        bool level = d->irq_level(d->ctx);
+        if (level && !irq_levels[i] && d->irq_gpio < HAL_GPIO_MAX && gpio_isrs[d->irq_gpio]) {
+            stats.interrupts++;
+            gpio_isrs[d->irq_gpio]((uint8_t)d->irq_gpio);
+        }
+        irq_levels[i] = level;
+    }
+}
+
+// Everything due by now, oldest first
+static void deliver_events(void) {
+    while (true) {
+        uint64_t i2c_at = i2c_count > 0 ? i2c_done_us[i2c_head] : FOREVER;
+        uint64_t device_at = FOREVER;
+        size_t device = 0;
+
+        for (size_t i = 0; i < device_count; i++) {
+            uint64_t at = devices[i].next_event_us(devices[i].ctx);
+            if (at < device_at) {
+                device_at = at;
+                device = i;
+            }
+        }
+
+        if (device_at <= i2c_at && device_at <= now_us) {
+            devices[device].advance(devices[device].ctx, device_at);
+        } else if (i2c_at <= now_us) {
+            i2c_complete(i2c_at);
+        } else {
+            break;
+        }
+        check_irqs();
+    }
+}
+
+static uint64_t next_event_us(void) {
+    uint64_t next = i2c_count > 0 ? i2c_done_us[i2c_head] : FOREVER;
+
+    for (size_t i = 0; i < device_count; i++) {
+        uint64_t at = devices[i].next_event_us(devices[i].ctx);
+        if (at < next) {
+            next = at;
+        }
+    }
+    for (size_t i = 0; i < task_count; i++) {
+        if (!tasks[i]->done && tasks[i]->wake_us < next) {
+            next = tasks[i]->wake_us;
+        }
+    }
+    return next;
+}
+
+/* Radio and host UART ----------------------------------------------------- */
+
+static bool (*radio_send)(void *ctx, const uint8_t *packet, size_t length) = NULL;
+static void *radio_ctx = NULL;
+
+void hal_host_set_radio(bool (*send)(void *ctx, const uint8_t *packet, size_t length), void *ctx) {
+    radio_send = send;
+    radio_ctx = ctx;
+}
+
+bool hal_radio_send(const uint8_t *packet, size_t length) {
+    bool ok = radio_send == NULL || radio_send(radio_ctx, packet, length);
+    if (!ok) {
+        stats.radio_failed++;
+    }
+    return ok;
+}
+
+// One peer on the host, whatever the address
+bool hal_radio_send_to(uint16_t address, const uint8_t *packet, size_t length) {
+    (void)address;
+    return hal_radio_send(packet, length);
+}
+
+static hal_radio_receive_t radio_receive = NULL;
+
+void hal_radio_set_receive(hal_radio_receive_t callback) {
+    radio_receive = callback;
+}
+
+void hal_host_radio_receive(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi) {
+    if (radio_receive != NULL) {
+        radio_receive(packet, length, source, lqi);
+    }
+}
+
+// The host link: bytes are already framed
+static bool (*uart_sink)(void *ctx, const uint8_t *data, size_t length) = NULL;
+static void *uart_ctx = NULL;
+
+void hal_host_set_uart(bool (*write)(void *ctx, const uint8_t *data, size_t length), void *ctx) {
+    uart_sink = write;
+    uart_ctx = ctx;
+}
+
+bool hal_uart_open(uint32_t baud_rate) {
+    (void)baud_rate;
+    return true;
+}
+
+bool hal_uart_write(const uint8_t *data, size_t length) {
+    stats.uart_bytes += length;
+    return uart_sink == NULL || uart_sink(uart_ctx, data, length);
+}
+
+static hal_uart_receive_t uart_receive = NULL;
+
+void hal_uart_set_receive(hal_uart_receive_t callback) {
+    uart_receive = callback;
+}
+
+void hal_host_uart_receive(const uint8_t *data, size_t length) {
+    if (uart_receive != NULL) {
+        uart_receive(data, length);
+    }
+}
+
+/* Kernel ------------------------------------------------------------------ */
+
+void hal_host_configure(const hal_host_config_t *c) {
+    config = *c;
+}
+
+static void pace(uint64_t virtual_us, double wall_start) {
+    if (config.realtime <= 0) {
+        return;
+    }
+
+    double wait = wall_start + virtual_us * 1e-6 / config.realtime - clock_s(CLOCK_MONOTONIC);
+    if (wait > 0) {
+        struct timespec ts = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Runs until config.end_us, then returns (unlike the target)
+void hal_start(void) {
+    double wall_start = clock_s(CLOCK_MONOTONIC);
+
+    while (now_us < config.end_us) {
+        deliver_events();
+
+        struct hal_task *t = pick();
+        if (t != NULL) {
+            run_slice(t);
+            continue;
+        }
+
+        uint64_t next = next_event_us();
+        if (next > config.end_us) {
+            next = config.end_us;
+        }
+        pace(next, wall_start);
+        now_us = next;
+    }
+}
+
+size_t hal_host_task_count(void) {
+    return task_count;
+}
+
+bool hal_host_task_info(size_t index, hal_host_task_info_t *info) {
+    if (index >= task_count) {
+        return false;
+    }
+
+    const struct hal_task *t = tasks[index];
+    info->name = t->name;
+    info->priority = t->priority;
+    info->wakeups = t->wakeups;
+    info->cpu_s = t->cpu_s;
+    info->max_slice_s = t->max_slice_s;
+    info->stack_used = stack_used(t);
+    return true;
+}
+
+void hal_host_stats(hal_host_stats_t *out) {
+    *out = stats;
+    out->now_us = now_us;
+}
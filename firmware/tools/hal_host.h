@@ -0,0 +1,70 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Linux side of hal.h (tools/hal_host.c), for the host build
+//
+// The tasks are cooperative coroutines on one thread, in virtual time:
+// the highest priority task that can run runs until it blocks, then the
+// clock jumps to the next thing that happens (a timeout, a sensor sample,
+// an I2C transaction finishing). Interrupts are delivered between task
+// slices. So a simulated day takes however long the firmware's code takes
+// to run, and the order of events is deterministic.
+//
+// Devices on the I2C bus are callbacks, so simulated chips (sim_adxl345.c)
+// stay out of here. A device without `transfer` isn't on the bus and only
+// has events (sim_radio.c's coordinator sending ACKs back).
+
+typedef struct {
+    uint8_t address;
+    int irq_gpio;           // GPIO index its interrupt line is wired to, -1 none
+    void *ctx;
+    bool (*transfer)(void *ctx, uint64_t now_us, const uint8_t *write, size_t write_count,
+                     uint8_t *read, size_t read_count);
+    uint64_t (*next_event_us)(void *ctx);   // UINT64_MAX: nothing coming
+    void (*advance)(void *ctx, uint64_t now_us);
+    bool (*irq_level)(void *ctx);
+} hal_host_device_t;
+
+typedef struct {
+    uint64_t end_us;        // hal_start() returns when virtual time gets here
+    double cpu_scale;       // charge host CPU time x this to the virtual clock, 0 = free
+    double realtime;        // pace virtual time at this many times wall clock, 0 = flat out
+} hal_host_config_t;
+
+typedef struct {
+    const char *name;
+    int priority;
+    unsigned long wakeups;
+    double cpu_s;           // host CPU time, unscaled
+    double max_slice_s;     // longest single run between blocking calls
+    size_t stack_used;      // host stack high water, bytes (not what an M4 would use)
+} hal_host_task_info_t;
+
+typedef struct {
+    uint64_t now_us;
+    unsigned long i2c_transactions;
+    unsigned long i2c_failed;
+    unsigned long interrupts;
+    unsigned long uart_bytes;
+    unsigned long radio_failed;
+} hal_host_stats_t;
+
+void hal_host_configure(const hal_host_config_t *config);
+bool hal_host_attach(const hal_host_device_t *device);
+void hal_host_set_radio(bool (*send)(void *ctx, const uint8_t *packet, size_t length), void *ctx);
+void hal_host_set_uart(bool (*write)(void *ctx, const uint8_t *data, size_t length), void *ctx);
+// A packet for the node, to the firmware's hal_radio_set_receive callback,
+// and bytes from the host to its hal_uart_set_receive one. From a device's
+// advance(), i.e. between task slices like an interrupt.
+void hal_host_radio_receive(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi);
+void hal_host_uart_receive(const uint8_t *data, size_t length);
+
+size_t hal_host_task_count(void);
+bool hal_host_task_info(size_t index, hal_host_task_info_t *info);
+void hal_host_stats(hal_host_stats_t *stats);
+
+#endif // HAL_HOST_H
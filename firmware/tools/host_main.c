@@ -0,0 +1,269 @@
+/*
+ * The whole firmware on Linux
+ *
+ * main.c (built with -Dmain=firmware_main) on the host HAL: the three
+ * tasks run as coroutines in virtual time, the ADXL345 is a register model
+ * replaying accelerometer traces, and everything the radio sends comes out
+ * framed on a pty (-p) or into a file (-o) for backend/server.py. At the end
+ * it reports what each task cost in host CPU time, the analysis cost per
+ * window, and what went over the air. The simulated coordinator ACKs
+ * telemetry frames (outbox.h) unless server.py is on the pty to do it, and
+ * the link can lose packets (-l, -O) to see the backlog fill and drain.
+ *
+ * Traces are tools/trace.h text or binary files, played back to back; with none
+ * a synthetic 24h laundry room day is used.
+ *
+ * Usage: wasche_host [-H hours] [-p | -o frames.bin] [-r speed] [-c scale] [-l loss%]
+ *                    [-O hour:minutes] [trace.txt ...]
+ *   -H  stop after this many hours of virtual time (default: length of the traces)
+ *   -p  write frames to a new pty, its path is printed
+ *   -o  write frames to a file
+ *   -r  run at `speed` times real time instead of flat out (1 = real time)
+ *   -c  charge host CPU time x `scale` to the virtual clock, so tasks take
+ *       time and the CPU load numbers mean something (e.g. 20 for a fast
+ *       desktop standing in for a 48MHz M4)
+ *   -l  lose this percentage of the packets, each way
+ *   -O  lose everything for `minutes` from `hour` into the run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "hal_host.h"
+#include "profile.h"
+#include "sample_buffer.h"
+#include "sim_adxl345.h"
+#include "sim_radio.h"
+#include "trace.h"
+#include "zigbee_handler.h"
+
+int firmware_main(void);
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-H hours] [-p | -o frames.bin] [-r speed] [-c scale] [-l loss%%] "
+            "[-O hour:minutes] [trace.txt ...]\n", name);
+}
+
+// Traces back to back in one
+static bool load_traces(char **paths, int count, trace_t *trace) {
+    if (count == 0) {
+        return trace_synthetic_day(trace);
+    }
+
+    memset(trace, 0, sizeof(*trace));
+
+    for (int i = 0; i < count; i++) {
+        trace_t part;
+        if (!trace_load(paths[i], &part)) {
+            fprintf(stderr, "can't read trace %s\n", paths[i]);
+            trace_free(trace);
+            return false;
+        }
+        if (i > 0 && part.rate_hz != trace->rate_hz) {
+            fprintf(stderr, "%s: recorded at %u Hz, the first trace at %u Hz\n", paths[i],
+                    (unsigned)part.rate_hz, (unsigned)trace->rate_hz);
+            trace_free(&part);
+            trace_free(trace);
+            return false;
+        }
+        trace->rate_hz = part.rate_hz;
+
+        accel_data_t *samples = realloc(trace->samples, (trace->count + part.count) * sizeof(accel_data_t));
+        if (samples == NULL) {
+            trace_free(&part);
+            trace_free(trace);
+            return false;
+        }
+        memcpy(&samples[trace->count], part.samples, part.count * sizeof(accel_data_t));
+        trace->samples = samples;
+        trace->count += part.count;
+        trace_free(&part);
+    }
+    return trace->count > 0;
+}
+
+static void report(const sim_adxl345_t *sensors, const sim_radio_t *radio, double wall_s) {
+    hal_host_stats_t stats;
+    hal_host_task_info_t info;
+    double hours;
+
+    hal_host_stats(&stats);
+    hours = stats.now_us / 3600e6;
+
+    printf("simulated %.2f h in %.2f s wall (%.0fx)\n", hours, wall_s,
+           wall_s > 0 ? stats.now_us * 1e-6 / wall_s : 0.0);
+
+    printf("\n%-12s %4s %10s %10s %10s %10s %10s\n",
+           "task", "prio", "wakeups", "cpu ms", "us/wakeup", "max us", "stack");
+    for (size_t i = 0; hal_host_task_info(i, &info); i++) {
+        printf("%-12s %4d %10lu %10.1f %10.2f %10.1f %10zu\n", info.name, info.priority,
+               info.wakeups, info.cpu_s * 1e3,
+               info.wakeups ? info.cpu_s * 1e6 / info.wakeups : 0.0,
+               info.max_slice_s * 1e6, info.stack_used);
+
+        if (strcmp(info.name, "analysis") == 0 && info.wakeups > 0) {
+            // one wakeup per ANALYSIS_HOP_SIZE block, one window each
+            printf("%-12s %4s %10s analysis %.2f us host CPU per window\n", "", "", "",
+                   info.cpu_s * 1e6 / info.wakeups);
+        }
+    }
+
+    printf("\n");
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        const sim_adxl345_t *sensor = &sensors[i];
+        printf("sensor: 0x%02X %lu samples, %lu FIFO reads, %lu lost to FIFO overrun, %lu I2C transfers\n",
+               sensor->address, sensor->samples, sensor->fifo_reads, sensor->dropped, sensor->transfers);
+    }
+    printf("host:   %lu INT1 interrupts, %lu I2C failed, %u sample blocks overrun\n",
+           stats.interrupts, stats.i2c_failed, (unsigned)sample_buffer_overruns());
+    printf("radio:  %lu packets (%lu batch, %lu features, %lu data, %lu heartbeat), %lu bytes framed, "
+           "%.1f packets/h, %lu dropped\n",
+           radio->packets, radio->by_type[PKT_TYPE_BATCH], radio->by_type[PKT_TYPE_FEATURES],
+           radio->by_type[PKT_TYPE_DATA],
+           radio->by_type[PKT_TYPE_HEARTBEAT], radio->bytes,
+           hours > 0 ? radio->packets / hours : 0.0, radio->dropped + stats.radio_failed);
+    printf("link:   %lu lost, %lu report frames received (%lu duplicates), %lu reports stored, "
+           "%lu ACKs delivered\n",
+           radio->lost, radio->frames, radio->duplicates, radio->reports, radio->acks);
+    if (radio->uart_bytes > 0) {
+        printf("uart:   %lu bytes over the host link\n", radio->uart_bytes);
+    }
+
+#if PROFILE_ENABLE
+    profile_stats_t profile[PROFILE_STAGE_COUNT];
+    profile_snapshot(profile, false);
+
+    // what the node would put in its next PKT_TYPE_PROFILE report
+    printf("\n%-12s %10s %10s %10s %10s   host ns, since the last profile report (%lu sent)\n",
+           "stage", "count", "min", "mean", "max", radio->by_type[PKT_TYPE_PROFILE]);
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const profile_stats_t *p = &profile[i];
+        if (p->count > 0) {
+            printf("%-12s %10lu %10lu %10.0f %10lu\n", profile_stage_name((profile_stage_t)i),
+                   (unsigned long)p->count, (unsigned long)p->min, (double)p->total / p->count,
+                   (unsigned long)p->max);
+        }
+    }
+#endif
+}
+
+int main(int argc, char **argv) {
+    hal_host_config_t config = { 0 };
+    double run_hours = 0;
+    bool use_pty = false;
+    const char *out_path = NULL;
+    double loss = 0, outage_hour = 0, outage_minutes = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:po:r:c:l:O:")) != -1) {
+        switch (opt) {
+            case 'H':
+                run_hours = atof(optarg);
+                break;
+            case 'p':
+                use_pty = true;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'r':
+                config.realtime = atof(optarg);
+                break;
+            case 'c':
+                config.cpu_scale = atof(optarg);
+                break;
+            case 'l':
+                loss = atof(optarg) / 100;
+                break;
+            case 'O':
+                if (sscanf(optarg, "%lf:%lf", &outage_hour, &outage_minutes) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (run_hours < 0 || config.realtime < 0 || config.cpu_scale < 0 || (use_pty && out_path) ||
+        loss < 0 || loss > 1 || outage_hour < 0 || outage_minutes < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    trace_t trace;
+    if (!load_traces(&argv[optind], argc - optind, &trace)) {
+        return 1;
+    }
+
+    sim_radio_t radio;
+    sim_radio_init(&radio);
+    if (use_pty) {
+        const char *path = sim_radio_open_pty(&radio);
+        if (path == NULL) {
+            perror("pty");
+            return 1;
+        }
+        printf("radio frames on %s\n", path);
+        fflush(stdout);
+    } else if (out_path != NULL && !sim_radio_open_file(&radio, out_path)) {
+        perror(out_path);
+        return 1;
+    }
+
+    // one simulated chip per configured sensor, all playing the same trace;
+    // the others start part way into it so the machines don't run in step
+    static const uint8_t addresses[] = SENSOR_ADDRESSES;
+    static const uint8_t int_gpios[] = SENSOR_INT_GPIOS;
+    static sim_adxl345_t sensors[SENSOR_COUNT];
+    uint64_t trace_us = (uint64_t)trace.count * 1000000 / trace.rate_hz;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        sim_adxl345_init(&sensors[i], addresses[i], &trace);
+        sensors[i].offset_us = trace_us * i / SENSOR_COUNT;
+
+        hal_host_device_t device = {
+            .address = addresses[i],
+            .irq_gpio = int_gpios[i],
+            .ctx = &sensors[i],
+            .transfer = sim_adxl345_transfer,
+            .next_event_us = sim_adxl345_next_event_us,
+            .advance = sim_adxl345_advance,
+            .irq_level = sim_adxl345_int1,
+        };
+        hal_host_attach(&device);
+    }
+    sim_radio_set_link(&radio, loss, (uint64_t)(outage_hour * 3600e6), (uint64_t)(outage_minutes * 60e6));
+
+    // the coordinator's side, not on the I2C bus
+    hal_host_device_t coordinator = {
+        .irq_gpio = -1,
+        .ctx = &radio,
+        .next_event_us = sim_radio_next_event_us,
+        .advance = sim_radio_advance,
+    };
+    hal_host_attach(&coordinator);
+    hal_host_set_radio(sim_radio_send, &radio);
+    hal_host_set_uart(sim_radio_write_uart, &radio);
+
+    config.end_us = run_hours > 0 ? (uint64_t)(run_hours * 3600e6) : trace_us;
+    hal_host_configure(&config);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = firmware_main();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (status != 0) {
+        fprintf(stderr, "firmware main() failed\n");
+    }
+    report(sensors, &radio, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+
+    sim_radio_close(&radio);
+    trace_free(&trace);
+    return status;
+}
@@ -0,0 +1,234 @@
+/*
+ * Power simulation for the activity-driven sampling modes
+ *
+ * Replays accelerometer traces through the real vibration_analysis,
+ * state_tracker and power_manager code in virtual time, emulating what the ADXL345 would hand
+ * us in each power mode, and estimates MCU duty cycle and energy per hour.
+ *
+ * Traces are tools/trace.h text or binary files at SAMPLE_RATE_HZ. With no trace
+ * arguments a synthetic 24h laundry room day is used.
+ *
+ * Usage: power_sim [trace.txt ...]
+ *
+ * The energy numbers come from the constants below (datasheet typicals, not
+ * measurements), so treat them as relative rather than absolute.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "vibration_analysis.h"
+#include "power_manager.h"
+#include "state_tracker.h"
+#include "trace.h"
+
+// Energy model
+#define SUPPLY_V 3.0
+#define MCU_ACTIVE_MA 3.4       // CC2652 M4 @ 48MHz
+#define MCU_SLEEP_MA 0.005      // standby with RTC + RAM retention
+#define WAKE_OVERHEAD_MS 0.2    // standby -> active -> standby
+#define I2C_SAMPLE_MS 0.2       // one 6-byte ADXL345 read at 400kHz
+#define ANALYSIS_MS 1.0         // one vibration_analysis_compute() hop
+#define RADIO_TX_MA 7.3         // 0dBm
+#define RADIO_TX_MS 4.0         // per packet incl. CSMA and ack wait
+#define BATTERY_MAH 2000.0      // 3x AA
+
+// ADXL345 supply current (datasheet, uA) by mode
+#define ADXL_100HZ_UA 140.0
+#define ADXL_50HZ_LOW_POWER_UA 45.0
+#define ADXL_12HZ_LOW_POWER_UA 34.0
+
+typedef struct {
+    double seconds[3];          // time spent per power mode
+    double mcu_active_ms;
+    double charge_mc;           // millicoulombs (mA * s)
+    unsigned long wakeups;
+    unsigned long analyses;
+    unsigned long packets;
+} sim_stats_t;
+
+static double adxl_current_ma(power_mode_t mode) {
+    switch (mode) {
+        case POWER_MODE_FULL:
+            return ADXL_100HZ_UA / 1000.0;
+        case POWER_MODE_REDUCED:
+            return ADXL_50HZ_LOW_POWER_UA / 1000.0;
+        default:
+            return ADXL_12HZ_LOW_POWER_UA / 1000.0;
+    }
+}
+
+static void mcu_awake(sim_stats_t *stats, double ms) {
+    stats->mcu_active_ms += ms;
+    stats->charge_mc += (MCU_ACTIVE_MA - MCU_SLEEP_MA) * ms / 1000.0;
+}
+
+static void send_packet(sim_stats_t *stats) {
+    stats->packets++;
+    mcu_awake(stats, RADIO_TX_MS);
+    stats->charge_mc += RADIO_TX_MA * RADIO_TX_MS / 1000.0;
+}
+
+// ADXL345 ac-coupled activity: any axis moves more than the threshold away
+// from the reference taken when activity detection was enabled
+static bool activity_detected(const accel_data_t *ref, const accel_data_t *now) {
+    int threshold = (int)(POWER_WAKE_THRESHOLD * 62.5f / 4.0f);  // counts
+    return abs(now->x - ref->x) > threshold ||
+           abs(now->y - ref->y) > threshold ||
+           abs(now->z - ref->z) > threshold;
+}
+
+static void simulate(const trace_t *trace, bool power_management, sim_stats_t *stats) {
+    const double sample_ms = 1000.0 / SAMPLE_RATE_HZ;
+    vibration_result_t result;
+    state_tracker_t tracker;
+    power_manager_t pm;
+    power_mode_t mode = POWER_MODE_FULL;
+    accel_data_t activity_ref = {0, 0, 0};
+    double last_transmit_ms = 0.0;
+    double last_heartbeat_ms = 0.0;
+    unsigned int fifo_level = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    vibration_analysis_set_sample_rate(SAMPLE_RATE_HZ);
+    state_tracker_init(&tracker);
+    power_manager_init(&pm);
+
+    for (size_t i = 0; i < trace->count; i++) {
+        double now_ms = i * sample_ms;
+        const accel_data_t *sample = &trace->samples[i];
+
+        stats->seconds[mode] += sample_ms / 1000.0;
+        stats->charge_mc += (MCU_SLEEP_MA + adxl_current_ma(mode)) * sample_ms / 1000.0;
+
+        if (now_ms - last_heartbeat_ms >= HEARTBEAT_INTERVAL_MS) {
+            if (mode == POWER_MODE_SLEEP) {
+                stats->wakeups++;
+                mcu_awake(stats, WAKE_OVERHEAD_MS);
+            }
+            send_packet(stats);
+            last_heartbeat_ms = now_ms;
+        }
+
+        if (mode == POWER_MODE_SLEEP) {
+            // sensor runs at 12.5Hz, only every 8th sample exists for it
+            if (i % 8 == 0 && activity_detected(&activity_ref, sample)) {
+                stats->wakeups++;
+                mcu_awake(stats, WAKE_OVERHEAD_MS);
+                mode = power_manager_wake(&pm, (uint32_t)now_ms);
+                vibration_analysis_set_sample_rate(power_mode_sample_rate(mode));
+                fifo_level = 0;
+            }
+            continue;
+        }
+
+        // decimate to the sensor's output rate
+        uint16_t rate = power_mode_sample_rate(mode);
+        if (i % (SAMPLE_RATE_HZ / rate) != 0) {
+            continue;
+        }
+
+        // one wakeup per FIFO watermark, one I2C read per sample
+        mcu_awake(stats, I2C_SAMPLE_MS);
+        if (++fifo_level >= ADXL345_FIFO_WATERMARK) {
+            stats->wakeups++;
+            mcu_awake(stats, WAKE_OVERHEAD_MS);
+            fifo_level = 0;
+        }
+
+        vibration_analysis_add_sample((accel_data_t *)sample);
+        if (!vibration_analysis_compute(&result)) {
+            continue;
+        }
+
+        stats->analyses++;
+        mcu_awake(stats, ANALYSIS_MS);
+#if STATE_TRACKER_ENABLE
+        result.timestamp = (uint32_t)now_ms;
+        result.state = state_tracker_update(&tracker, &result);
+#endif
+
+        if (now_ms - last_transmit_ms >= TRANSMIT_INTERVAL_MS) {
+            send_packet(stats);
+            last_transmit_ms = now_ms;
+        }
+
+        if (!power_management) {
+            continue;
+        }
+
+        power_mode_t new_mode = power_manager_update(&pm, result.state, (uint32_t)now_ms);
+        if (new_mode == mode) {
+            continue;
+        }
+
+        mode = new_mode;
+        if (mode == POWER_MODE_SLEEP) {
+            activity_ref = *sample;
+            send_packet(stats);
+            last_transmit_ms = now_ms;
+        } else {
+            vibration_analysis_set_sample_rate(power_mode_sample_rate(mode));
+        }
+        fifo_level = 0;
+    }
+}
+
+static void report(const char *name, const char *label, const sim_stats_t *stats) {
+    double total_s = stats->seconds[0] + stats->seconds[1] + stats->seconds[2];
+    double hours = total_s / 3600.0;
+    double avg_ma = stats->charge_mc / total_s;
+
+    printf("%-24s %-10s %6.1fh  full %5.1f%%  reduced %5.1f%%  sleep %5.1f%%  "
+           "wakeups/h %8.0f  duty %6.3f%%  %7.4f mAh/h  %6.3f mWh/h  battery %6.1f days\n",
+           name, label, hours,
+           100.0 * stats->seconds[POWER_MODE_FULL] / total_s,
+           100.0 * stats->seconds[POWER_MODE_REDUCED] / total_s,
+           100.0 * stats->seconds[POWER_MODE_SLEEP] / total_s,
+           stats->wakeups / hours,
+           100.0 * stats->mcu_active_ms / 1000.0 / total_s,
+           avg_ma, avg_ma * SUPPLY_V,
+           BATTERY_MAH / avg_ma / 24.0);
+}
+
+static void run(const char *name, const trace_t *trace) {
+    sim_stats_t stats;
+
+    simulate(trace, false, &stats);
+    report(name, "fixed", &stats);
+
+    simulate(trace, true, &stats);
+    report(name, "adaptive", &stats);
+}
+
+int main(int argc, char **argv) {
+    trace_t trace;
+
+    if (argc < 2) {
+        if (!trace_synthetic_day(&trace)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        run("synthetic day", &trace);
+        trace_free(&trace);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (!trace_load(argv[i], &trace)) {
+            fprintf(stderr, "%s: no samples\n", argv[i]);
+            return 1;
+        }
+        if (trace.rate_hz != SAMPLE_RATE_HZ) {
+            fprintf(stderr, "%s: recorded at %u Hz, need %u Hz\n", argv[i],
+                    (unsigned)trace.rate_hz, (unsigned)SAMPLE_RATE_HZ);
+            trace_free(&trace);
+            return 1;
+        }
+        run(argv[i], &trace);
+        trace_free(&trace);
+    }
+
+    return 0;
+}
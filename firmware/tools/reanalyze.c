@@ -0,0 +1,363 @@
+/*
+ * Re-classify recorded traces against a grid of thresholds
+ *
+ * Memory-maps .wtr traces (tools/trace.h), cuts them into chunks and runs
+ * the firmware's vibration analysis over the chunks on every core. Each
+ * window's features are computed once and then classified against every
+ * point of the threshold grid, so a sweep costs little more than one pass.
+ * Per grid point it prints how the time splits between the states, how
+ * often the state flips, and how many windows come out different from
+ * today's config.h thresholds.
+ *
+ * Grid axes are lo:hi:step or a single value, config.h when not given.
+ * Only the amplitude thresholds are swept: the frequency bands decide
+ * which SDFT bins exist, so they shape the features themselves.
+ *
+ * Usage: reanalyze [-j threads] [-c] [-i idle] [-w washing_min] [-W washing_max]
+ *                  [-s spinning_min] trace.wtr ...
+ *   -c  CSV instead of a table
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "trace.h"
+#include "vibration_analysis.h"
+
+#define CHUNK_SAMPLES (1u << 18)   // ~45 min at 100Hz per job
+#define MAX_AXIS 64
+#define MAX_GRID 65536
+#define NO_STATE 0xFF
+#define NUM_STATES (STATE_UNKNOWN + 1)
+
+typedef struct {
+    float values[MAX_AXIS];
+    size_t count;
+} axis_t;
+
+typedef struct {
+    unsigned long windows[NUM_STATES];
+    unsigned long transitions;
+    unsigned long changed;       // classified differently than with config.h
+} point_stats_t;
+
+typedef struct {
+    size_t file;
+    size_t start;                // first sample this job reports windows for
+    size_t end;
+} job_t;
+
+static trace_t *traces;
+static size_t trace_count;
+static vibration_thresholds_t *grid;
+static size_t grid_size;
+static job_t *jobs;
+static size_t job_count;
+static uint8_t *edges;           // per job and grid point: first and last state
+static atomic_size_t next_job;
+
+typedef struct {
+    pthread_t thread;
+    point_stats_t *stats;        // grid_size, merged after the join
+    unsigned long windows;
+} worker_t;
+
+static void run_job(const job_t *job, uint8_t *edge, point_stats_t *stats, unsigned long *windows,
+                    uint8_t *last) {
+    const trace_t *trace = &traces[job->file];
+    vibration_ctx_t ctx;
+    vibration_features_t features;
+
+    // Warm up on the window before the chunk, starting on the same hop
+    // phase as a front-to-back run so the windows line up exactly (the
+    // hop is a multiple of the zoom decimation, so that lines up too)
+    vibration_ctx_init(&ctx, trace->rate_hz, NULL);
+    size_t warmup = vibration_ctx_warmup_samples(&ctx);
+    size_t from = 0;
+    if (job->start > warmup) {
+        from = job->start - warmup;
+        from -= from % ANALYSIS_HOP_SIZE;
+    }
+
+    memset(last, NO_STATE, grid_size);
+
+    for (size_t i = from; i < job->end; i++) {
+        vibration_ctx_add_sample(&ctx, &trace->samples[i]);
+        if (!vibration_ctx_features(&ctx, &features) || i < job->start) {
+            continue;
+        }
+
+        machine_state_t reference = vibration_classify(&vibration_config_thresholds, &features);
+        (*windows)++;
+
+        for (size_t g = 0; g < grid_size; g++) {
+            machine_state_t state = vibration_classify(&grid[g], &features);
+            stats[g].windows[state]++;
+            stats[g].changed += state != reference;
+            if (last[g] == NO_STATE) {
+                edge[2 * g] = (uint8_t)state;
+            } else if (last[g] != state) {
+                stats[g].transitions++;
+            }
+            last[g] = (uint8_t)state;
+        }
+    }
+
+    for (size_t g = 0; g < grid_size; g++) {
+        edge[2 * g + 1] = last[g];
+    }
+}
+
+static void *worker(void *arg) {
+    worker_t *w = arg;
+    uint8_t *last = malloc(grid_size);
+
+    if (last == NULL) {
+        return NULL;
+    }
+    for (;;) {
+        size_t j = atomic_fetch_add(&next_job, 1);
+        if (j >= job_count) {
+            break;
+        }
+        run_job(&jobs[j], &edges[j * 2 * grid_size], w->stats, &w->windows, last);
+    }
+    free(last);
+    return NULL;
+}
+
+static bool parse_axis(const char *arg, axis_t *axis) {
+    float lo, hi, step;
+    int n = sscanf(arg, "%f:%f:%f", &lo, &hi, &step);
+
+    if (n == 1) {
+        axis->values[0] = lo;
+        axis->count = 1;
+        return true;
+    }
+    if (n != 3 || step <= 0.0f || hi < lo) {
+        return false;
+    }
+    axis->count = 0;
+    for (int i = 0; lo + i * step <= hi + step * 1e-3f; i++) {
+        if (axis->count == MAX_AXIS) {
+            return false;
+        }
+        axis->values[axis->count++] = lo + i * step;
+    }
+    return true;
+}
+
+static bool build_grid(const axis_t *idle, const axis_t *wash_min, const axis_t *wash_max,
+                       const axis_t *spin_min) {
+    grid_size = idle->count * wash_min->count * wash_max->count * spin_min->count;
+    if (grid_size > MAX_GRID) {
+        fprintf(stderr, "grid of %zu points, at most %d\n", grid_size, MAX_GRID);
+        return false;
+    }
+    grid = malloc(grid_size * sizeof(*grid));
+    if (grid == NULL) {
+        return false;
+    }
+
+    size_t g = 0;
+    for (size_t a = 0; a < idle->count; a++)
+        for (size_t b = 0; b < wash_min->count; b++)
+            for (size_t c = 0; c < wash_max->count; c++)
+                for (size_t d = 0; d < spin_min->count; d++) {
+                    grid[g] = vibration_config_thresholds;
+                    grid[g].idle = idle->values[a];
+                    grid[g].washing_min = wash_min->values[b];
+                    grid[g].washing_max = wash_max->values[c];
+                    grid[g].spinning_min = spin_min->values[d];
+                    g++;
+                }
+    return true;
+}
+
+static bool build_jobs(void) {
+    job_count = 0;
+    for (size_t f = 0; f < trace_count; f++) {
+        job_count += (traces[f].count + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+    }
+    jobs = malloc(job_count * sizeof(*jobs));
+    edges = malloc(job_count * 2 * grid_size);
+    if (jobs == NULL || edges == NULL) {
+        return false;
+    }
+
+    size_t j = 0;
+    for (size_t f = 0; f < trace_count; f++) {
+        for (size_t start = 0; start < traces[f].count; start += CHUNK_SAMPLES) {
+            size_t end = start + CHUNK_SAMPLES;
+            jobs[j++] = (job_t){f, start, end < traces[f].count ? end : traces[f].count};
+        }
+    }
+    return true;
+}
+
+static void report(const point_stats_t *totals, double hours, bool csv) {
+    if (csv) {
+        printf("idle,washing_min,washing_max,spinning_min,idle_pct,washing_pct,spinning_pct,"
+               "unknown_pct,transitions_per_h,changed_pct\n");
+    } else {
+        printf("\n%6s %6s %6s %6s | %6s %6s %6s %6s | %8s %8s\n", "idle", "w_min", "w_max",
+               "s_min", "idle%", "wash%", "spin%", "unkn%", "flips/h", "changed%");
+    }
+
+    for (size_t g = 0; g < grid_size; g++) {
+        const point_stats_t *s = &totals[g];
+        unsigned long windows = 0;
+        for (int i = 0; i < NUM_STATES; i++) {
+            windows += s->windows[i];
+        }
+        double pct = windows ? 100.0 / windows : 0.0;
+        const char *format = csv ? "%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n"
+                                 : "%6.3f %6.3f %6.3f %6.3f | %6.2f %6.2f %6.2f %6.2f | %8.2f %8.2f\n";
+        printf(format, grid[g].idle, grid[g].washing_min, grid[g].washing_max, grid[g].spinning_min,
+               s->windows[STATE_IDLE] * pct, s->windows[STATE_WASHING] * pct,
+               s->windows[STATE_SPINNING] * pct, s->windows[STATE_UNKNOWN] * pct,
+               hours > 0 ? s->transitions / hours : 0.0, s->changed * pct);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-j threads] [-c] [-i idle] [-w washing_min] [-W washing_max] "
+            "[-s spinning_min] trace.wtr ...\n"
+            "       axes are lo:hi:step or a single value\n",
+            name);
+}
+
+int main(int argc, char **argv) {
+    axis_t idle = {{IDLE_THRESHOLD}, 1};
+    axis_t wash_min = {{WASHING_MIN}, 1};
+    axis_t wash_max = {{WASHING_MAX}, 1};
+    axis_t spin_min = {{SPINNING_MIN}, 1};
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool csv = false;
+    bool ok = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:ci:w:W:s:")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = atol(optarg);
+                break;
+            case 'c':
+                csv = true;
+                break;
+            case 'i':
+                ok = parse_axis(optarg, &idle) && ok;
+                break;
+            case 'w':
+                ok = parse_axis(optarg, &wash_min) && ok;
+                break;
+            case 'W':
+                ok = parse_axis(optarg, &wash_max) && ok;
+                break;
+            case 's':
+                ok = parse_axis(optarg, &spin_min) && ok;
+                break;
+            default:
+                ok = false;
+        }
+    }
+    if (!ok || optind == argc || threads < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    trace_count = (size_t)(argc - optind);
+    traces = calloc(trace_count, sizeof(*traces));
+    if (traces == NULL || !build_grid(&idle, &wash_min, &wash_max, &spin_min)) {
+        return 1;
+    }
+
+    double hours = 0.0;
+    size_t samples = 0;
+    for (size_t f = 0; f < trace_count; f++) {
+        if (!trace_map(argv[optind + f], &traces[f])) {
+            return 1;
+        }
+        hours += traces[f].count / (traces[f].rate_hz * 3600.0);
+        samples += traces[f].count;
+    }
+    if (!build_jobs()) {
+        return 1;
+    }
+    if ((size_t)threads > job_count) {
+        threads = (long)job_count;
+    }
+
+    worker_t *workers = calloc((size_t)threads, sizeof(*workers));
+    point_stats_t *totals = calloc(grid_size, sizeof(*totals));
+    if (workers == NULL || totals == NULL) {
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long t = 0; t < threads; t++) {
+        workers[t].stats = calloc(grid_size, sizeof(point_stats_t));
+        if (workers[t].stats == NULL ||
+            pthread_create(&workers[t].thread, NULL, worker, &workers[t]) != 0) {
+            return 1;
+        }
+    }
+
+    unsigned long windows = 0;
+    for (long t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        windows += workers[t].windows;
+        for (size_t g = 0; g < grid_size; g++) {
+            for (int i = 0; i < NUM_STATES; i++) {
+                totals[g].windows[i] += workers[t].stats[g].windows[i];
+            }
+            totals[g].transitions += workers[t].stats[g].transitions;
+            totals[g].changed += workers[t].stats[g].changed;
+        }
+        free(workers[t].stats);
+    }
+
+    // state changes that straddle two chunks of the same trace
+    for (size_t j = 1; j < job_count; j++) {
+        if (jobs[j].file != jobs[j - 1].file) {
+            continue;
+        }
+        const uint8_t *prev = &edges[(j - 1) * 2 * grid_size];
+        const uint8_t *next = &edges[j * 2 * grid_size];
+        for (size_t g = 0; g < grid_size; g++) {
+            uint8_t before = prev[2 * g + 1];
+            uint8_t after = next[2 * g];
+            totals[g].transitions += before != NO_STATE && after != NO_STATE && before != after;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    report(totals, hours, csv);
+    fprintf(csv ? stderr : stdout,
+            "\n%zu traces, %.1f node-hours, %lu windows x %zu grid points in %.2f s on %ld threads: "
+            "%.0f node-hours/s, %.1f M samples/s\n",
+            trace_count, hours, windows, grid_size, wall_s, threads,
+            wall_s > 0 ? hours / wall_s : 0.0, wall_s > 0 ? samples / wall_s * 1e-6 : 0.0);
+
+    for (size_t f = 0; f < trace_count; f++) {
+        trace_free(&traces[f]);
+    }
+    free(traces);
+    free(grid);
+    free(jobs);
+    free(edges);
+    free(workers);
+    free(totals);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Scheduler simulation on a virtual clock
+ *
+ * Runs the real scheduler.c with roughly the events main.c registers, but on
+ * tools/systime_virtual.c: handlers burn virtual CPU time according to the
+ * cost model below and the ADXL345 watermark interrupt is faked at the rate
+ * the sensor would raise it. Everything runs in one context here, the way it
+ * would without the separate analysis/transmit tasks, so the latencies are a
+ * worst case for the acquisition task. Reports per-event dispatch latency (how late a
+ * timer ran vs its due time, or an interrupt's handler vs the interrupt),
+ * whether the periodic timers drifted, and how much of the time the MCU
+ * could spend idle.
+ *
+ * Usage: sched_sim [hours]
+ *
+ * Handler costs are estimates (same numbers as tools/power_sim.c), not
+ * measurements.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "scheduler.h"
+#include "systime.h"
+#include "systime_virtual.h"
+
+// Handler cost model (us)
+#define I2C_SAMPLE_US 200       // one 6-byte ADXL345 read at 400kHz
+#define ANALYSIS_US 1000        // one vibration_analysis_compute() hop
+#define POWER_UPDATE_US 20      // analysis event: power manager bookkeeping
+#define RADIO_TX_US 4000        // per packet incl. CSMA and ack wait
+
+typedef struct {
+    unsigned long count;
+    uint64_t sum_us;
+    uint64_t max_us;
+} latency_t;
+
+static bool use_fifo;
+static unsigned int samples_since_hop;
+static uint64_t analysis_posted_us;
+
+static latency_t lat_sensor, lat_sample, lat_analysis, lat_transmit, lat_heartbeat;
+
+static void on_sensor(void);
+static void on_sample(void);
+static void on_analysis(void);
+static void on_transmit(void);
+static void on_heartbeat(void);
+
+static sched_event_t sensor_event = SCHED_EVENT("sensor", on_sensor);
+static sched_event_t sample_event = SCHED_EVENT("sample", on_sample);
+static sched_event_t analysis_event = SCHED_EVENT("analysis", on_analysis);
+static sched_event_t transmit_event = SCHED_EVENT("transmit", on_transmit);
+static sched_event_t heartbeat_event = SCHED_EVENT("heartbeat", on_heartbeat);
+
+static void record(latency_t *lat, uint64_t expected_us) {
+    uint64_t late = systime_virtual_now_us() - expected_us;
+
+    lat->count++;
+    lat->sum_us += late;
+    if (late > lat->max_us) {
+        lat->max_us = late;
+    }
+}
+
+// Periodic timers have already been re-armed when the handler runs
+static void record_timer(latency_t *lat, const sched_event_t *event) {
+    record(lat, (uint64_t)(event->due_ms - event->period_ms) * 1000);
+}
+
+static uint64_t watermark_period_us(void) {
+    return (uint64_t)ADXL345_FIFO_WATERMARK * 1000000 / SAMPLE_RATE_HZ;
+}
+
+static uint64_t next_watermark(uint64_t now_us) {
+    return (now_us / watermark_period_us() + 1) * watermark_period_us();
+}
+
+static void sensor_int1(void) {
+    scheduler_post(&sensor_event);
+}
+
+static void drain(unsigned int samples) {
+    for (unsigned int i = 0; i < samples; i++) {
+        systime_virtual_busy(I2C_SAMPLE_US);
+
+        if (++samples_since_hop >= ANALYSIS_HOP_SIZE) {
+            samples_since_hop = 0;
+            systime_virtual_busy(ANALYSIS_US);
+            analysis_posted_us = systime_virtual_now_us();
+            scheduler_post(&analysis_event);
+        }
+    }
+
+    if (use_fifo) {
+        uint32_t backstop = 2000 * ADXL345_FIFO_WATERMARK / SAMPLE_RATE_HZ;
+        scheduler_start(&sample_event, backstop, backstop);
+    }
+}
+
+static void on_sensor(void) {
+    record(&lat_sensor, systime_virtual_irq_us());
+    drain(ADXL345_FIFO_WATERMARK);
+}
+
+static void on_sample(void) {
+    record_timer(&lat_sample, &sample_event);
+    drain(use_fifo ? ADXL345_FIFO_WATERMARK : 1);
+}
+
+static void on_analysis(void) {
+    record(&lat_analysis, analysis_posted_us);
+    systime_virtual_busy(POWER_UPDATE_US);
+}
+
+static void on_transmit(void) {
+    record_timer(&lat_transmit, &transmit_event);
+    systime_virtual_busy(RADIO_TX_US);
+}
+
+static void on_heartbeat(void) {
+    record_timer(&lat_heartbeat, &heartbeat_event);
+    systime_virtual_busy(RADIO_TX_US);
+}
+
+static void print_latency(const char *name, const latency_t *lat, unsigned long expected_runs) {
+    if (lat->count == 0) {
+        printf("  %-10s %8lu\n", name, lat->count);
+        return;
+    }
+
+    printf("  %-10s %8lu", name, lat->count);
+    if (expected_runs > 0) {
+        printf(" (%lu due)", expected_runs);
+    } else {
+        printf("          ");
+    }
+    printf("  mean %7.1f us  max %7.1f us\n",
+           (double)lat->sum_us / lat->count, (double)lat->max_us);
+}
+
+static void simulate(bool fifo, double hours) {
+    uint64_t end_us = (uint64_t)(hours * 3600e6);
+    latency_t zero = {0, 0, 0};
+
+    use_fifo = fifo;
+    samples_since_hop = 0;
+    lat_sensor = lat_sample = lat_analysis = lat_transmit = lat_heartbeat = zero;
+
+    systime_virtual_set_irq(fifo ? next_watermark : NULL, fifo ? sensor_int1 : NULL);
+    systime_init();
+    scheduler_init();
+    scheduler_add(&sensor_event);
+    scheduler_add(&sample_event);
+    scheduler_add(&analysis_event);
+    scheduler_add(&transmit_event);
+    scheduler_add(&heartbeat_event);
+
+    if (fifo) {
+        drain(0);  // arms the backstop
+    } else {
+        scheduler_start(&sample_event, SAMPLE_PERIOD_MS, SAMPLE_PERIOD_MS);
+    }
+    scheduler_start(&transmit_event, TRANSMIT_INTERVAL_MS, TRANSMIT_INTERVAL_MS);
+    scheduler_start(&heartbeat_event, HEARTBEAT_INTERVAL_MS, HEARTBEAT_INTERVAL_MS);
+
+    while (systime_virtual_now_us() < end_us) {
+        scheduler_run_once();
+    }
+
+    double total_s = systime_virtual_now_us() / 1e6;
+    uint64_t total_ms = systime_virtual_now_us() / 1000;
+
+    printf("%s, %.1fh virtual\n",
+           fifo ? "FIFO watermark interrupt" : "polling every SAMPLE_PERIOD_MS", hours);
+    print_latency("sensor", &lat_sensor, 0);
+    print_latency("sample", &lat_sample, 0);
+    print_latency("analysis", &lat_analysis, 0);
+    print_latency("transmit", &lat_transmit, (unsigned long)((total_ms - 1) / TRANSMIT_INTERVAL_MS));
+    print_latency("heartbeat", &lat_heartbeat, (unsigned long)((total_ms - 1) / HEARTBEAT_INTERVAL_MS));
+    printf("  cpu idle %.3f%% (scheduler counted %.3f%%)  wakeups/s %.1f\n\n",
+           100.0 * systime_virtual_idle_us() / systime_virtual_now_us(),
+           100.0 * scheduler_idle_ms() / 1000.0 / total_s,
+           systime_virtual_wakeups() / total_s);
+}
+
+int main(int argc, char **argv) {
+    double hours = argc > 1 ? atof(argv[1]) : 1.0;
+
+    if (hours <= 0.0) {
+        fprintf(stderr, "usage: %s [hours]\n", argv[0]);
+        return 1;
+    }
+
+    simulate(true, hours);
+    simulate(false, hours);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "sim_adxl345.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FIFO_MODE_MASK 0xC0
+#define RATE_MASK 0x0F
+#define ACT_AXES_MASK 0x70      // ACT_INACT_CTL activity x/y/z enables
+#define THRESH_COUNTS 15.625f   // 62.5 mg/LSB in 4 mg/LSB counts
+
+void sim_adxl345_init(sim_adxl345_t *sim, uint8_t address, const trace_t *trace) {
+    memset(sim, 0, sizeof(*sim));
+    sim->address = address;
+    sim->trace = trace;
+    sim->regs[ADXL345_REG_DEVID] = ADXL345_DEVICE_ID;
+    sim->regs[ADXL345_REG_BW_RATE] = ADXL345_RATE_100HZ;  // reset value
+    sim->next_sample_us = UINT64_MAX;
+}
+
+static bool stream_mode(const sim_adxl345_t *sim) {
+    return (sim->regs[ADXL345_REG_FIFO_CTL] & FIFO_MODE_MASK) != ADXL345_FIFO_MODE_BYPASS;
+}
+
+// Output data rate from the BW_RATE code, 0x0A = 100 Hz, each step halves or doubles
+static uint64_t sample_period_us(const sim_adxl345_t *sim) {
+    int code = sim->regs[ADXL345_REG_BW_RATE] & RATE_MASK;
+    double rate = 100.0;
+    for (int c = code; c < ADXL345_RATE_100HZ; c++) {
+        rate /= 2;
+    }
+    for (int c = code; c > ADXL345_RATE_100HZ; c--) {
+        rate *= 2;
+    }
+    return (uint64_t)(1e6 / rate);
+}
+
+static uint8_t int_source(const sim_adxl345_t *sim) {
+    uint8_t source = 0;
+    uint8_t watermark = sim->regs[ADXL345_REG_FIFO_CTL] & ADXL345_FIFO_SAMPLES_MASK;
+
+    if (sim->fifo_count > 0) {
+        source |= ADXL345_INT_DATA_READY;
+    }
+    if (stream_mode(sim) && sim->fifo_count > 0 && sim->fifo_count >= watermark) {
+        source |= ADXL345_INT_WATERMARK;
+    }
+    if (sim->overrun) {
+        source |= ADXL345_INT_OVERRUN;
+    }
+    if (sim->activity) {
+        source |= ADXL345_INT_ACTIVITY;
+    }
+    return source;
+}
+
+bool sim_adxl345_int1(void *ctx) {
+    const sim_adxl345_t *sim = ctx;
+    uint8_t enabled = sim->regs[ADXL345_REG_INT_ENABLE] & ~sim->regs[ADXL345_REG_INT_MAP];
+    return (int_source(sim) & enabled) != 0;
+}
+
+// Trace sample at time t, wrapping around at the end
+static accel_data_t trace_at(const sim_adxl345_t *sim, uint64_t t_us) {
+    size_t i = (size_t)((t_us + sim->offset_us) * sim->trace->rate_hz / 1000000);
+    return sim->trace->samples[i % sim->trace->count];
+}
+
+static void push_sample(sim_adxl345_t *sim, accel_data_t s) {
+    sim->samples++;
+
+    if (!stream_mode(sim)) {
+        // bypass: the data registers only ever hold the latest sample
+        sim->latest = s;
+        sim->fifo_count = 1;
+    } else {
+        if (sim->fifo_count == ADXL345_FIFO_SIZE) {
+            sim->fifo_head = (sim->fifo_head + 1) % ADXL345_FIFO_SIZE;
+            sim->fifo_count--;
+            sim->overrun = true;
+            sim->dropped++;
+        }
+        sim->fifo[(sim->fifo_head + sim->fifo_count) % ADXL345_FIFO_SIZE] = s;
+        sim->fifo_count++;
+    }
+
+    if ((sim->regs[ADXL345_REG_INT_ENABLE] & ADXL345_INT_ACTIVITY) && !sim->activity) {
+        uint8_t axes = sim->regs[ADXL345_REG_ACT_INACT_CTL] & ACT_AXES_MASK;
+        float threshold = sim->regs[ADXL345_REG_THRESH_ACT] * THRESH_COUNTS;
+        const accel_data_t *ref = &sim->activity_ref;
+
+        if (((axes & 0x40) && abs(s.x - ref->x) > threshold) ||
+            ((axes & 0x20) && abs(s.y - ref->y) > threshold) ||
+            ((axes & 0x10) && abs(s.z - ref->z) > threshold)) {
+            sim->activity = true;
+        }
+    }
+}
+
+uint64_t sim_adxl345_next_event_us(void *ctx) {
+    return ((sim_adxl345_t *)ctx)->next_sample_us;
+}
+
+void sim_adxl345_advance(void *ctx, uint64_t now_us) {
+    sim_adxl345_t *sim = ctx;
+
+    while (sim->next_sample_us <= now_us) {
+        push_sample(sim, trace_at(sim, sim->next_sample_us));
+        sim->next_sample_us += sample_period_us(sim);
+    }
+}
+
+static void write_register(sim_adxl345_t *sim, uint8_t reg, uint8_t value, uint64_t now_us) {
+    if (reg == ADXL345_REG_DEVID || (reg >= ADXL345_REG_DATAX0 && reg != ADXL345_REG_FIFO_CTL) ||
+        reg == ADXL345_REG_INT_SOURCE) {
+        return;  // read only
+    }
+
+    uint8_t old = sim->regs[reg];
+    sim->regs[reg] = value;
+
+    switch (reg) {
+    case ADXL345_REG_POWER_CTL:
+        if ((value & ADXL345_MEASURE) && !(old & ADXL345_MEASURE)) {
+            sim->next_sample_us = now_us + sample_period_us(sim);
+        } else if (!(value & ADXL345_MEASURE)) {
+            sim->next_sample_us = UINT64_MAX;
+        }
+        break;
+    case ADXL345_REG_BW_RATE:
+        if (sim->next_sample_us != UINT64_MAX) {
+            sim->next_sample_us = now_us + sample_period_us(sim);
+        }
+        break;
+    case ADXL345_REG_FIFO_CTL:
+        if ((value & FIFO_MODE_MASK) == ADXL345_FIFO_MODE_BYPASS) {
+            // bypass clears the FIFO
+            sim->fifo_head = 0;
+            sim->fifo_count = 0;
+            sim->overrun = false;
+        }
+        break;
+    case ADXL345_REG_INT_ENABLE:
+        if ((value & ADXL345_INT_ACTIVITY) && !(old & ADXL345_INT_ACTIVITY)) {
+            // ac-coupled: activity is measured against the sample at enable time
+            sim->activity_ref = trace_at(sim, now_us);
+            sim->activity = false;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// DATAX0..DATAZ1, reading them pops the oldest FIFO entry
+static void read_data(sim_adxl345_t *sim, uint8_t *out) {
+    accel_data_t s = sim->latest;
+
+    if (stream_mode(sim)) {
+        if (sim->fifo_count > 0) {
+            s = sim->fifo[sim->fifo_head];
+            sim->fifo_head = (sim->fifo_head + 1) % ADXL345_FIFO_SIZE;
+            sim->fifo_count--;
+            sim->latest = s;
+        }
+        sim->overrun = false;
+    } else {
+        sim->fifo_count = 0;
+    }
+    sim->fifo_reads++;
+
+    out[0] = (uint8_t)s.x;
+    out[1] = (uint8_t)((uint16_t)s.x >> 8);
+    out[2] = (uint8_t)s.y;
+    out[3] = (uint8_t)((uint16_t)s.y >> 8);
+    out[4] = (uint8_t)s.z;
+    out[5] = (uint8_t)((uint16_t)s.z >> 8);
+}
+
+bool sim_adxl345_transfer(void *ctx, uint64_t now_us, const uint8_t *write, size_t write_count,
+                          uint8_t *read, size_t read_count) {
+    sim_adxl345_t *sim = ctx;
+
+    sim_adxl345_advance(sim, now_us);
+    sim->transfers++;
+    if (write_count == 0) {
+        return false;
+    }
+
+    uint8_t reg = write[0];
+    if (reg >= sizeof(sim->regs) || (reg > 0x00 && reg < 0x1D)) {
+        return false;  // reserved
+    }
+
+    for (size_t i = 1; i < write_count; i++, reg++) {
+        if (reg >= sizeof(sim->regs)) {
+            return false;
+        }
+        write_register(sim, reg, write[i], now_us);
+    }
+
+    for (size_t i = 0; i < read_count; ) {
+        if (reg >= sizeof(sim->regs)) {
+            return false;
+        }
+        if (reg == ADXL345_REG_DATAX0 && read_count - i >= 6) {
+            read_data(sim, &read[i]);
+            i += 6;
+            reg += 6;
+            continue;
+        }
+
+        switch (reg) {
+        case ADXL345_REG_INT_SOURCE:
+            read[i] = int_source(sim);
+            sim->activity = false;
+            break;
+        case ADXL345_REG_FIFO_STATUS:
+            read[i] = stream_mode(sim) ? sim->fifo_count : 0;
+            break;
+        default:
+            read[i] = sim->regs[reg];
+            break;
+        }
+        i++;
+        reg++;
+    }
+    return true;
+}
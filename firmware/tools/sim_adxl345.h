@@ -0,0 +1,55 @@
+#ifndef SIM_ADXL345_H
+#define SIM_ADXL345_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "trace.h"
+
+// ADXL345 register model for the host build
+//
+// Enough of the chip for adxl345.c: DEVID, BW_RATE (output data rate from
+// the rate code), POWER_CTL measure bit, the 32-entry FIFO in bypass and
+// stream mode with watermark and overrun, ac-coupled activity detection,
+// INT_ENABLE/INT_MAP/INT_SOURCE and the INT1 line. Samples come from a
+// trace (at its own recorded rate), decimated to whatever rate the driver
+// picks; the trace loops if the simulation runs longer.
+
+typedef struct {
+    uint8_t address;
+    const trace_t *trace;
+    uint64_t offset_us;       // where in the trace t = 0 is, so two sensors differ
+    uint8_t regs[64];
+
+    accel_data_t fifo[32];
+    uint8_t fifo_head;        // oldest entry
+    uint8_t fifo_count;
+    accel_data_t latest;      // DATAX0..DATAZ1 in bypass mode
+    bool overrun;
+    bool activity;            // latched until INT_SOURCE is read
+    accel_data_t activity_ref;
+
+    uint64_t next_sample_us;  // UINT64_MAX while not measuring
+
+    // stats
+    unsigned long samples;
+    unsigned long dropped;    // overwritten in the FIFO before being read
+    unsigned long fifo_reads;
+    unsigned long transfers;
+} sim_adxl345_t;
+
+void sim_adxl345_init(sim_adxl345_t *sim, uint8_t address, const trace_t *trace);
+
+// I2C write-then-read against the register file at now_us. False = NACK
+// (a register the chip doesn't have).
+bool sim_adxl345_transfer(void *sim, uint64_t now_us, const uint8_t *write, size_t write_count,
+                          uint8_t *read, size_t read_count);
+
+// Sample clock: when the next sample lands, and produce all samples due by now_us
+uint64_t sim_adxl345_next_event_us(void *sim);
+void sim_adxl345_advance(void *sim, uint64_t now_us);
+
+// INT1 level (all interrupts mapped to INT1 is all adxl345.c uses)
+bool sim_adxl345_int1(void *sim);
+
+#endif // SIM_ADXL345_H
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+#include "sim_radio.h"
+#include "hal.h"
+#include "hal_host.h"
+#include "zigbee_handler.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+void sim_radio_init(sim_radio_t *radio) {
+    memset(radio, 0, sizeof(*radio));
+    radio->fd = -1;
+    radio->backend = true;
+    radio->rng = 1;
+    radio->poll_us = UINT64_MAX;
+    frame_decoder_init(&radio->decoder);
+}
+
+void sim_radio_set_link(sim_radio_t *radio, double loss, uint64_t outage_start_us, uint64_t outage_us) {
+    radio->loss = loss;
+    radio->outage_start_us = outage_start_us;
+    radio->outage_end_us = outage_start_us + outage_us;
+}
+
+// xorshift32, so a run with loss is the same every time
+static bool lose(sim_radio_t *radio, uint64_t now_us) {
+    if (now_us >= radio->outage_start_us && now_us < radio->outage_end_us) {
+        radio->lost++;
+        return true;
+    }
+
+    radio->rng ^= radio->rng << 13;
+    radio->rng ^= radio->rng >> 17;
+    radio->rng ^= radio->rng << 5;
+    if (radio->loss > 0 && radio->rng < radio->loss * UINT32_MAX) {
+        radio->lost++;
+        return true;
+    }
+    return false;
+}
+
+const char *sim_radio_open_pty(sim_radio_t *radio) {
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    // raw, so frame bytes go through untouched
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    radio->fd = fd;
+    radio->backend = false;
+    return ptsname(fd);
+}
+
+bool sim_radio_open_file(sim_radio_t *radio, const char *path) {
+    radio->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return radio->fd >= 0;
+}
+
+static void write_out(sim_radio_t *radio, const uint8_t *data, size_t length) {
+    if (radio->fd >= 0) {
+        ssize_t n = write(radio->fd, data, length);
+        if (n != (ssize_t)length) {
+            // a short write would leave half a frame, the decoder drops it
+            radio->dropped++;
+        }
+    }
+}
+
+// A telemetry frame with reports got to the backend: store it unless it's
+// the one stored last, ACK it either way
+static void received(sim_radio_t *radio, const uint8_t *packet, size_t length, uint64_t now_us) {
+    if ((packet[0] != PKT_TYPE_BATCH && packet[0] != PKT_TYPE_FEATURES) || length < 11 ||
+        packet[4] == 0) {
+        return;
+    }
+
+    uint16_t seq = (uint16_t)(packet[9] | packet[10] << 8);
+    radio->frames++;
+    if (seq == radio->last_seq) {
+        radio->duplicates++;
+    } else {
+        radio->last_seq = seq;
+        radio->reports += packet[4];
+    }
+
+    if (!radio->backend) {
+        // server.py answers on the pty
+        radio->poll_us = now_us + SIM_RADIO_PTY_POLL_US;
+        radio->poll_until_us = now_us + SIM_RADIO_PTY_WAIT_US;
+    } else if (radio->ack_count < SIM_RADIO_ACKS) {
+        radio->ack_seq[radio->ack_count] = seq;
+        radio->ack_us[radio->ack_count] = now_us + SIM_RADIO_ACK_DELAY_US;
+        radio->ack_count++;
+    }
+}
+
+bool sim_radio_send(void *ctx, const uint8_t *packet, size_t length) {
+    sim_radio_t *radio = ctx;
+    uint8_t frame[FRAME_ENCODED_MAX(FRAME_PAYLOAD_MAX)];
+    size_t frame_length = frame_encode(packet, length, frame);
+    uint64_t now_us = hal_time_us();
+
+    if (frame_length == 0) {
+        return false;
+    }
+
+    radio->packets++;
+    radio->bytes += frame_length;
+    if (length > 0) {
+        radio->by_type[packet[0] & 0x0F]++;
+    }
+
+    // sent fine as far as the node can tell, lost on the way
+    if (lose(radio, now_us)) {
+        return true;
+    }
+    write_out(radio, frame, frame_length);
+    received(radio, packet, length, now_us);
+    return true;
+}
+
+static void deliver_ack(sim_radio_t *radio, uint16_t seq, uint64_t now_us) {
+    zigbee_ack_t ack = { PKT_TYPE_ACK, NODE_ID, seq, 0 };
+
+    if (lose(radio, now_us)) {
+        return;
+    }
+    ack.checksum = zigbee_compute_checksum((uint8_t *)&ack, sizeof(ack) - sizeof(uint16_t));
+    radio->acks++;
+    hal_host_radio_receive((const uint8_t *)&ack, sizeof(ack), COORDINATOR_ADDR, SIM_RADIO_LQI);
+}
+
+uint64_t sim_radio_next_event_us(void *ctx) {
+    sim_radio_t *radio = ctx;
+    uint64_t next = radio->poll_us;
+
+    if (radio->ack_count > 0 && radio->ack_us[0] < next) {
+        next = radio->ack_us[0];
+    }
+    return next;
+}
+
+// server.py's ACKs from the pty, whatever has come back by now. Keeps
+// looking for a while after each frame; an ACK later than that finds the
+// node retrying, which gets it ACKed again.
+static void read_acks(sim_radio_t *radio, uint64_t now_us) {
+    uint8_t data[256];
+    ssize_t n;
+
+    while ((n = read(radio->fd, data, sizeof(data))) > 0) {
+        size_t used = 0;
+
+        while (used < (size_t)n) {
+            const uint8_t *packet;
+            size_t length;
+
+            used += frame_decoder_feed(&radio->decoder, &data[used], (size_t)n - used, &packet, &length);
+            // the coordinator passes it on as it is
+            if (length == sizeof(zigbee_ack_t) && packet[0] == PKT_TYPE_ACK && !lose(radio, now_us)) {
+                radio->acks++;
+                hal_host_radio_receive(packet, length, COORDINATOR_ADDR, SIM_RADIO_LQI);
+            }
+        }
+    }
+
+    radio->poll_us = now_us + SIM_RADIO_PTY_POLL_US;
+    if (radio->poll_us > radio->poll_until_us) {
+        radio->poll_us = UINT64_MAX;
+    }
+}
+
+void sim_radio_advance(void *ctx, uint64_t now_us) {
+    sim_radio_t *radio = ctx;
+
+    if (radio->poll_us <= now_us) {
+        read_acks(radio, now_us);
+    }
+    if (radio->ack_count > 0 && radio->ack_us[0] <= now_us) {
+        uint16_t seq = radio->ack_seq[0];
+
+        radio->ack_count--;
+        memmove(radio->ack_seq, &radio->ack_seq[1], radio->ack_count * sizeof(radio->ack_seq[0]));
+        memmove(radio->ack_us, &radio->ack_us[1], radio->ack_count * sizeof(radio->ack_us[0]));
+        deliver_ack(radio, seq, now_us);
+    }
+}
+
+bool sim_radio_write_uart(void *ctx, const uint8_t *data, size_t length) {
+    sim_radio_t *radio = ctx;
+
+    radio->uart_bytes += length;
+    write_out(radio, data, length);
+    return true;
+}
+
+void sim_radio_close(sim_radio_t *radio) {
+    if (radio->fd >= 0) {
+        close(radio->fd);
+        radio->fd = -1;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef SIM_RADIO_H
+#define SIM_RADIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "frame_codec.h"
+
+// Radio for the host build: every packet the node sends comes out framed
+// (frame_codec.h) the way the coordinator forwards it over serial, so
+// backend/server.py can read a simulated node straight off a pty, or a file
+// of frames can be replayed later. With neither it only counts. The host
+// link UART (already framed) goes to the same place.
+//
+// It is also the other end of the link: telemetry frames get their
+// PKT_TYPE_ACK back (outbox.h), from server.py over the pty, otherwise
+// from a stand-in backend here that stores each sequence number once.
+// Packets either way can be lost at random or during an outage. As a host
+// device (sim_radio_next_event_us/advance, no I2C) it hands the ACKs to the
+// node when they arrive.
+
+#define SIM_RADIO_ACK_DELAY_US 30000    // coordinator, UART and the DB commit
+#define SIM_RADIO_PTY_POLL_US 20000     // looking for server.py's ACK
+#define SIM_RADIO_PTY_WAIT_US 1000000   // ... this long after each frame
+#define SIM_RADIO_ACKS 8
+#define SIM_RADIO_LQI 200
+
+typedef struct {
+    int fd;                         // -1: count only
+    unsigned long packets;
+    unsigned long bytes;            // framed
+    unsigned long dropped;          // pty full (nobody reading)
+    unsigned long uart_bytes;
+    unsigned long by_type[16];      // by packet type, zigbee_handler.h
+
+    // The link
+    double loss;                    // chance a packet is lost, each way
+    uint64_t outage_start_us;       // nothing gets through in between
+    uint64_t outage_end_us;
+    bool backend;                   // ACK here (no pty)
+    uint32_t rng;
+
+    // ACKs on their way to the node
+    uint16_t ack_seq[SIM_RADIO_ACKS];
+    uint64_t ack_us[SIM_RADIO_ACKS];
+    size_t ack_count;
+    uint64_t poll_us;               // pty: next look for ACKs, UINT64_MAX none expected
+    uint64_t poll_until_us;
+    frame_decoder_t decoder;
+
+    uint16_t last_seq;              // the stand-in backend's de-duplication
+    unsigned long lost;             // packets lost, either way
+    unsigned long frames;           // telemetry frames with reports that got through
+    unsigned long duplicates;       // ... of those, already stored
+    unsigned long reports;          // stored once
+    unsigned long acks;             // delivered to the node
+} sim_radio_t;
+
+void sim_radio_init(sim_radio_t *radio);
+
+// Open a pty and return the path to hand to server.py, NULL on failure
+const char *sim_radio_open_pty(sim_radio_t *radio);
+bool sim_radio_open_file(sim_radio_t *radio, const char *path);
+
+bool sim_radio_send(void *radio, const uint8_t *packet, size_t length);
+bool sim_radio_write_uart(void *radio, const uint8_t *data, size_t length);
+
+// Lose `loss` (0..1) of the packets, and all of them from `outage_start_us`
+// for `outage_us`
+void sim_radio_set_link(sim_radio_t *radio, double loss, uint64_t outage_start_us, uint64_t outage_us);
+
+uint64_t sim_radio_next_event_us(void *radio);
+void sim_radio_advance(void *radio, uint64_t now_us);
+
+void sim_radio_close(sim_radio_t *radio);
+
+#endif // SIM_RADIO_H
@@ -0,0 +1,91 @@
+/*
+ * Virtual clock implementation of systime.h for host simulations
+ */
+
+#include "systime.h"
+#include "systime_virtual.h"
+#include <stddef.h>
+
+static uint64_t now_us = 0;
+static uint64_t idle_us = 0;
+static uint64_t irq_us = 0;
+static uint64_t next_irq_us = UINT64_MAX;
+static systime_virtual_next_irq_t next_irq_fn = NULL;
+static void (*irq_fn)(void) = NULL;
+static bool woken = false;  // the wake semaphore
+static uint64_t wakeups = 0;
+
+bool systime_init(void) {
+    now_us = 0;
+    idle_us = 0;
+    irq_us = 0;
+    wakeups = 0;
+    woken = false;
+    next_irq_us = next_irq_fn ? next_irq_fn(0) : UINT64_MAX;
+    return true;
+}
+
+uint32_t systime_ms(void) {
+    return (uint32_t)(now_us / 1000);
+}
+
+static void fire_irq(void) {
+    if (next_irq_us > now_us) {
+        now_us = next_irq_us;
+    }
+    irq_us = now_us;
+    irq_fn();
+    next_irq_us = next_irq_fn(now_us);
+}
+
+void systime_idle(uint32_t timeout_ms) {
+    uint64_t until = now_us + (uint64_t)timeout_ms * 1000;
+    uint64_t start = now_us;
+
+    if (!woken && next_irq_us <= until) {
+        fire_irq();
+    } else if (!woken) {
+        now_us = until;
+    }
+
+    woken = false;
+    if (now_us != start) {
+        idle_us += now_us - start;
+        wakeups++;
+    }
+}
+
+void systime_wake(void) {
+    woken = true;
+}
+
+void systime_virtual_set_irq(systime_virtual_next_irq_t next_irq, void (*irq)(void)) {
+    next_irq_fn = next_irq;
+    irq_fn = irq;
+    next_irq_us = next_irq ? next_irq(now_us) : UINT64_MAX;
+}
+
+void systime_virtual_busy(uint32_t us) {
+    uint64_t until = now_us + us;
+
+    while (next_irq_us <= until) {
+        fire_irq();
+    }
+    now_us = until;
+}
+
+uint64_t systime_virtual_now_us(void) {
+    return now_us;
+}
+
+uint64_t systime_virtual_idle_us(void) {
+    return idle_us;
+}
+
+uint64_t systime_virtual_irq_us(void) {
+    return irq_us;
+}
+
+uint64_t systime_virtual_wakeups(void) {
+    return wakeups;
+}
@@ -0,0 +1,23 @@
+#ifndef SYSTIME_VIRTUAL_H
+#define SYSTIME_VIRTUAL_H
+
+#include <stdint.h>
+
+// Host-only extras for the virtual clock in systime_virtual.c. Time only
+// moves when the code under test idles or declares it is busy, and a fake
+// interrupt source fires in between at the times it asks for.
+
+// Returns the time (us) of the next interrupt after `now_us`
+typedef uint64_t (*systime_virtual_next_irq_t)(uint64_t now_us);
+
+void systime_virtual_set_irq(systime_virtual_next_irq_t next_irq, void (*irq)(void));
+
+// Pretend the CPU worked for `us`, firing any interrupts that come due
+void systime_virtual_busy(uint32_t us);
+
+uint64_t systime_virtual_now_us(void);
+uint64_t systime_virtual_idle_us(void);
+uint64_t systime_virtual_irq_us(void);  // when the last interrupt fired
+uint64_t systime_virtual_wakeups(void); // systime_idle() calls that actually slept
+
+#endif // SYSTIME_VIRTUAL_H
@@ -0,0 +1,217 @@
+#include "trace.h"
+#include "config.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(trace_header_t) == 32, "trace header layout");
+_Static_assert(sizeof(accel_data_t) == 6, "samples are read straight from the file");
+
+static void trace_reset(trace_t *trace) {
+    memset(trace, 0, sizeof(*trace));
+    trace->rate_hz = SAMPLE_RATE_HZ;
+}
+
+static bool trace_push(trace_t *trace, size_t *capacity, accel_data_t sample) {
+    if (trace->count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 4096;
+        accel_data_t *grown = realloc(trace->samples, new_capacity * sizeof(accel_data_t));
+        if (grown == NULL) {
+            return false;
+        }
+        trace->samples = grown;
+        *capacity = new_capacity;
+    }
+    trace->samples[trace->count++] = sample;
+    return true;
+}
+
+static bool header_ok(const trace_header_t *h, size_t file_size) {
+    return h->magic == TRACE_MAGIC && h->header_size >= sizeof(*h) && h->rate_hz > 0 &&
+           h->header_size <= file_size &&
+           h->sample_count <= (file_size - h->header_size) / sizeof(accel_data_t);
+}
+
+static bool load_binary(FILE *f, const char *path, trace_t *trace) {
+    trace_header_t h;
+    struct stat st;
+
+    if (fstat(fileno(f), &st) != 0 || fread(&h, sizeof(h), 1, f) != 1 ||
+        !header_ok(&h, (size_t)st.st_size)) {
+        fprintf(stderr, "%s: bad trace header\n", path);
+        return false;
+    }
+
+    trace->samples = malloc(h.sample_count * sizeof(accel_data_t) + 1);
+    if (trace->samples == NULL || fseek(f, h.header_size, SEEK_SET) != 0 ||
+        fread(trace->samples, sizeof(accel_data_t), h.sample_count, f) != h.sample_count) {
+        trace_free(trace);
+        return false;
+    }
+    trace->count = h.sample_count;
+    trace->node_id = h.node_id;
+    trace->rate_hz = h.rate_hz;
+    trace->start_ms = h.start_ms;
+    return trace->count > 0;
+}
+
+bool trace_load(const char *path, trace_t *trace) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    size_t capacity = 0;
+    char line[128];
+    uint32_t magic = 0;
+    trace_reset(trace);
+
+    if (fread(&magic, sizeof(magic), 1, f) == 1 && magic == TRACE_MAGIC) {
+        rewind(f);
+        bool ok = load_binary(f, path, trace);
+        fclose(f);
+        return ok;
+    }
+    rewind(f);
+
+    while (fgets(line, sizeof(line), f)) {
+        int x, y, z;
+        if (line[0] == '#' || sscanf(line, "%d %d %d", &x, &y, &z) != 3) {
+            continue;
+        }
+        accel_data_t sample = {(int16_t)x, (int16_t)y, (int16_t)z};
+        if (!trace_push(trace, &capacity, sample)) {
+            fclose(f);
+            return false;
+        }
+    }
+
+    fclose(f);
+    return trace->count > 0;
+}
+
+bool trace_synthetic_day(trace_t *trace) {
+    static const struct {
+        float minutes;
+        float amplitude_g;
+        float freq_hz;
+    } schedule[] = {
+        {420, 0.0f, 0.0f},   // night
+        {35, 0.5f, 3.0f},    // wash
+        {10, 5.0f, 9.0f},    // spin
+        {180, 0.0f, 0.0f},
+        {35, 0.5f, 3.0f},
+        {10, 5.0f, 10.0f},
+        {20, 0.0f, 0.0f},
+        {35, 0.5f, 2.5f},
+        {10, 5.0f, 9.0f},
+        {300, 0.0f, 0.0f},
+        {35, 0.5f, 3.0f},
+        {10, 5.0f, 11.0f},
+        {340, 0.0f, 0.0f},
+    };
+
+    size_t capacity = 0;
+    uint32_t seed = 42;
+    trace_reset(trace);
+
+    for (size_t s = 0; s < sizeof(schedule) / sizeof(schedule[0]); s++) {
+        size_t n = (size_t)(schedule[s].minutes * 60.0f * SAMPLE_RATE_HZ);
+        for (size_t i = 0; i < n; i++) {
+            float t = (float)i / SAMPLE_RATE_HZ;
+            float v = schedule[s].amplitude_g * sinf(2.0f * (float)M_PI * schedule[s].freq_hz * t);
+            int noise[3];
+            for (int a = 0; a < 3; a++) {
+                seed = seed * 1103515245u + 12345u;
+                noise[a] = (int)((seed >> 16) % 5) - 2;  // +/- 2 counts
+            }
+            accel_data_t sample = {
+                (int16_t)(lrintf(0.5f * v / ADXL345_SCALE_G) + noise[0]),
+                (int16_t)noise[1],
+                (int16_t)(lrintf((1.0f + v) / ADXL345_SCALE_G) + noise[2]),
+            };
+            if (!trace_push(trace, &capacity, sample)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool trace_map(const char *path, trace_t *trace) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    trace_reset(trace);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trace_header_t)) {
+        fprintf(stderr, "%s: not a binary trace\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+
+    const trace_header_t *h = map;
+    if (!header_ok(h, (size_t)st.st_size)) {
+        fprintf(stderr, "%s: bad trace header\n", path);
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+
+    // read front to back exactly once
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    trace->map = map;
+    trace->map_size = (size_t)st.st_size;
+    trace->samples = (accel_data_t *)((uint8_t *)map + h->header_size);
+    trace->count = h->sample_count;
+    trace->node_id = h->node_id;
+    trace->rate_hz = h->rate_hz;
+    trace->start_ms = h->start_ms;
+    return true;
+}
+
+bool trace_save(const char *path, const trace_t *trace, uint32_t gap_samples) {
+    trace_header_t h = {
+        .magic = TRACE_MAGIC,
+        .header_size = sizeof(trace_header_t),
+        .node_id = trace->node_id,
+        .rate_hz = trace->rate_hz,
+        .gap_samples = gap_samples,
+        .start_ms = trace->start_ms,
+        .sample_count = trace->count,
+    };
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(trace->samples, sizeof(accel_data_t), trace->count, f) == trace->count;
+    return fclose(f) == 0 && ok;
+}
+
+void trace_free(trace_t *trace) {
+    if (trace->map != NULL) {
+        munmap(trace->map, trace->map_size);
+    } else {
+        free(trace->samples);
+    }
+    trace_reset(trace);
+}
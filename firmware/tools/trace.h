@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "adxl345.h"
+
+// Accelerometer traces for the host tools
+//
+// Text format: one sample per line "x y z" in raw ADXL345 counts (full
+// resolution, 4 mg/LSB) at SAMPLE_RATE_HZ. Lines starting with # are
+// skipped.
+//
+// Binary format (.wtr, what trace_record writes from a capture): a
+// trace_header_t, then x, y, z as int16 per sample, all little-endian.
+// 6 bytes a sample, 2 MB per node-hour at 100 Hz, and it maps straight
+// onto accel_data_t, so tools mmap it instead of reading it.
+
+#define TRACE_MAGIC 0x31525457u  // "WTR1"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t header_size;     // samples start here
+    uint16_t node_id;
+    uint16_t rate_hz;
+    uint16_t reserved;
+    uint32_t gap_samples;     // filled in (repeating the last sample) where packets were lost
+    uint64_t start_ms;        // Unix time of the first sample
+    uint64_t sample_count;
+} trace_header_t;
+
+typedef struct {
+    accel_data_t *samples;
+    size_t count;
+    uint16_t node_id;         // 0 and SAMPLE_RATE_HZ for text traces
+    uint16_t rate_hz;
+    uint64_t start_ms;
+    void *map;                // trace_map(): the whole file
+    size_t map_size;
+} trace_t;
+
+// Text or binary, whichever the file is
+bool trace_load(const char *path, trace_t *trace);
+
+// Binary only, read-only and zero copy
+bool trace_map(const char *path, trace_t *trace);
+
+bool trace_save(const char *path, const trace_t *trace, uint32_t gap_samples);
+
+// A day in a laundry room: mostly idle, a few wash + spin cycles
+bool trace_synthetic_day(trace_t *trace);
+
+void trace_free(trace_t *trace);
+
+#endif // TRACE_H
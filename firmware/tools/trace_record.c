@@ -0,0 +1,285 @@
+/*
+ * Record raw sample captures into binary traces
+ *
+ * Reads the framed host link stream of nodes built with
+ * TRACE_CAPTURE_ENABLE (trace_capture.h) from a serial port, pty or file
+ * and writes one .wtr trace per node (tools/trace.h) when the input ends
+ * or on Ctrl-C. Lost packets show up as a jump in first_ms and are filled
+ * in by repeating the last sample, so the trace keeps real time; the
+ * header counts how many samples were made up.
+ *
+ * Also converts text traces, or writes the synthetic day, to .wtr.
+ *
+ * Usage: trace_record [-o prefix] [-n node_id] input   (serial port, pty, file, - for stdin)
+ *        trace_record -t trace.txt out.wtr [-n node_id]
+ *        trace_record -s out.wtr
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "frame_codec.h"
+#include "trace.h"
+#include "trace_capture.h"
+#include "zigbee_handler.h"
+
+#define MAX_NODES 64
+#define MAX_GAP_S 600   // longer than this and it's a new recording, not a gap
+
+typedef struct {
+    uint16_t node_id;
+    trace_t trace;
+    size_t capacity;
+    uint32_t next_ms;       // node clock of the next sample we expect
+    uint32_t gap_samples;
+    unsigned long packets;
+    unsigned long skipped;  // wrong rate, duplicates, too far out of line
+} recording_t;
+
+static recording_t recordings[MAX_NODES];
+static size_t recording_count = 0;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint64_t unix_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static bool push(recording_t *r, accel_data_t sample) {
+    trace_t *t = &r->trace;
+    if (t->count == r->capacity) {
+        size_t capacity = r->capacity ? r->capacity * 2 : 65536;
+        accel_data_t *grown = realloc(t->samples, capacity * sizeof(accel_data_t));
+        if (grown == NULL) {
+            return false;
+        }
+        t->samples = grown;
+        r->capacity = capacity;
+    }
+    t->samples[t->count++] = sample;
+    return true;
+}
+
+static recording_t *recording_for(uint16_t node_id) {
+    for (size_t i = 0; i < recording_count; i++) {
+        if (recordings[i].node_id == node_id) {
+            return &recordings[i];
+        }
+    }
+    if (recording_count == MAX_NODES) {
+        return NULL;
+    }
+    recording_t *r = &recordings[recording_count++];
+    memset(r, 0, sizeof(*r));
+    r->node_id = node_id;
+    r->trace.node_id = node_id;
+    return r;
+}
+
+static void add_packet(const uint8_t *packet, size_t length) {
+    if (length < 12 || packet[0] != PKT_TYPE_RAW) {
+        return;  // telemetry and heartbeats share the link
+    }
+
+    uint16_t node_id = get_u16(&packet[1]);
+    uint16_t rate_hz = get_u16(&packet[3]);
+    uint32_t first_ms = get_u32(&packet[5]);
+    size_t count = packet[9];
+
+    if (count > TRACE_CAPTURE_CHUNK || length != 10 + 6 * count + 2 || rate_hz == 0 ||
+        get_u16(&packet[length - 2]) != frame_crc16(packet, length - 2)) {
+        fprintf(stderr, "bad capture packet from node 0x%04X\n", node_id);
+        return;
+    }
+
+    recording_t *r = recording_for(node_id);
+    if (r == NULL) {
+        return;
+    }
+    r->packets++;
+
+    trace_t *t = &r->trace;
+    uint32_t period_ms = 1000 / rate_hz;
+    const uint8_t *p = &packet[10];
+    size_t skip = 0;
+
+    if (t->count == 0) {
+        t->rate_hz = rate_hz;
+        t->start_ms = unix_ms() - (uint64_t)(count - 1) * period_ms;
+        r->next_ms = first_ms;
+    }
+
+    int32_t ahead_ms = (int32_t)(first_ms - r->next_ms);
+    if (rate_hz != t->rate_hz || ahead_ms > MAX_GAP_S * 1000 ||
+        -ahead_ms >= (int32_t)(count * period_ms)) {
+        r->skipped += count;
+        return;
+    }
+
+    if (ahead_ms > 0) {
+        // lost packets: hold the last sample until this one starts
+        accel_data_t last = t->count ? t->samples[t->count - 1] : (accel_data_t){0, 0, 0};
+        for (uint32_t i = 0; i < (uint32_t)ahead_ms / period_ms; i++) {
+            push(r, last);
+            r->gap_samples++;
+        }
+    } else if (ahead_ms < 0) {
+        skip = (size_t)(-ahead_ms) / period_ms;  // overlaps what we have
+        r->skipped += skip;
+    }
+
+    for (size_t i = 0; i < count; i++, p += 6) {
+        if (i >= skip) {
+            accel_data_t s = {(int16_t)get_u16(p), (int16_t)get_u16(p + 2), (int16_t)get_u16(p + 4)};
+            push(r, s);
+        }
+    }
+    r->next_ms = first_ms + (uint32_t)count * period_ms;
+}
+
+static void set_raw(int fd) {
+    struct termios tio;
+    if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+static int record(const char *input, const char *prefix) {
+    int fd = strcmp(input, "-") == 0 ? STDIN_FILENO : open(input, O_RDONLY | O_NOCTTY);
+    frame_decoder_t decoder;
+    uint8_t buf[4096];
+    int status = 0;
+
+    if (fd < 0) {
+        perror(input);
+        return 1;
+    }
+    set_raw(fd);
+    frame_decoder_init(&decoder);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    while (!stop) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;  // end of file, or the pty's writer went away
+        }
+
+        size_t pos = 0;
+        while (pos < (size_t)n) {
+            const uint8_t *packet;
+            size_t length;
+            pos += frame_decoder_feed(&decoder, &buf[pos], (size_t)n - pos, &packet, &length);
+            if (length > 0) {
+                add_packet(packet, length);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < recording_count; i++) {
+        recording_t *r = &recordings[i];
+        char path[512];
+
+        snprintf(path, sizeof(path), "%snode%04X.wtr", prefix, r->node_id);
+        if (r->trace.count == 0 || !trace_save(path, &r->trace, r->gap_samples)) {
+            status = 1;
+            continue;
+        }
+        printf("%s: node 0x%04X, %zu samples at %u Hz (%.2f h), %lu packets, "
+               "%u filled in, %lu skipped\n",
+               path, r->node_id, r->trace.count, (unsigned)r->trace.rate_hz,
+               r->trace.count / (r->trace.rate_hz * 3600.0), r->packets,
+               (unsigned)r->gap_samples, r->skipped);
+        trace_free(&r->trace);
+    }
+    printf("frames: %u good, %u crc errors, %u length errors\n", (unsigned)decoder.stats.frames,
+           (unsigned)decoder.stats.crc_errors, (unsigned)decoder.stats.length_errors);
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return recording_count > 0 ? status : 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-o prefix] input        record (serial port, pty, file, - for stdin)\n"
+            "       %s -t trace.txt out.wtr    convert a text trace\n"
+            "       %s -s out.wtr              write the synthetic day\n"
+            "       -n node_id sets the node id of converted traces\n",
+            name, name, name);
+}
+
+int main(int argc, char **argv) {
+    const char *prefix = "";
+    const char *text = NULL;
+    bool synthetic = false;
+    long node_id = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:t:sn:")) != -1) {
+        switch (opt) {
+            case 'o':
+                prefix = optarg;
+                break;
+            case 't':
+                text = optarg;
+                break;
+            case 's':
+                synthetic = true;
+                break;
+            case 'n':
+                node_id = strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1 || (text != NULL && synthetic)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (text == NULL && !synthetic) {
+        return record(argv[optind], prefix);
+    }
+
+    trace_t trace;
+    if (synthetic ? !trace_synthetic_day(&trace) : !trace_load(text, &trace)) {
+        return 1;
+    }
+    trace.node_id = (uint16_t)node_id;
+    trace.start_ms = unix_ms();
+    bool ok = trace_save(argv[optind], &trace, 0);
+    printf("%s: %zu samples at %u Hz\n", argv[optind], trace.count, (unsigned)trace.rate_hz);
+    trace_free(&trace);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,379 @@
+/*
+ * Replay traces through the analysis and the state tracker
+ *
+ * Runs each trace (tools/trace.h) through vibration_analysis and
+ * state_tracker.c the way the firmware does and compares the per-window
+ * classification with the tracked state against ground truth:
+ *
+ *   changes     how often the reported state changes (every change is a
+ *               frame the node sends right away)
+ *   accuracy    share of windows whose state matches the labels
+ *   transitions labeled state changes found by a change to the same state
+ *               no earlier than 30 s before and no later than the tolerance
+ *               after it (recall), and the share of reported changes that
+ *               found one (precision), with the mean and worst delay
+ *   cost        ns per window for the analysis and for the tracker update
+ *
+ * Labels for trace.wtr are read from trace.wtr.labels, one line per labeled
+ * state change: "<seconds from the start> idle|washing|spinning|done", #
+ * comments. Without a labels file only changes and cost are reported.
+ * Without trace arguments a built-in labeled day is used: cycles with
+ * pauses, a soak and a rinse, finished machines that do and don't get
+ * unloaded, and a neighbour's machine shaking the floor.
+ *
+ * Usage: tracker_replay [-t tolerance_s] [trace ...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+#include "state_tracker.h"
+#include "trace.h"
+#include "vibration_analysis.h"
+
+#define MAX_LABELS 4096
+#define EARLY_MS 30000           // a change this much before the label still counts
+#define TRACKER_REPEAT 20        // the tracker is too quick to time in one pass
+
+static const char *const state_names[] = {"idle", "washing", "spinning", "done", "unknown"};
+
+typedef struct {
+    uint32_t ms;
+    machine_state_t state;
+} label_t;
+
+typedef struct {
+    label_t items[MAX_LABELS];
+    size_t count;
+} labels_t;
+
+typedef struct {
+    unsigned long changes;
+    unsigned long correct;
+    unsigned long matched;       // labeled changes found
+    double delay_s;
+    double worst_delay_s;
+} score_t;
+
+/* ---------------------------------------------------------------------------
+ * Built-in labeled day
+ * ------------------------------------------------------------------------- */
+
+typedef enum {
+    PATTERN_REST,
+    PATTERN_AGITATE,             // 12 s of drum movement, 4 s pause
+    PATTERN_SPIN,
+    PATTERN_NEIGHBOUR,           // someone else's spin through the floor
+    PATTERN_AGITATE_NEIGHBOUR,
+    PATTERN_UNLOAD,              // door, drum and laundry being handled
+} pattern_t;
+
+static const struct {
+    float minutes;
+    pattern_t pattern;
+    machine_state_t truth;
+} day[] = {
+    {300, PATTERN_REST, STATE_IDLE},
+    // full cycle, soak and rinse, unloaded after 20 min
+    {12, PATTERN_AGITATE, STATE_WASHING},
+    {3, PATTERN_REST, STATE_WASHING},
+    {10, PATTERN_AGITATE, STATE_WASHING},
+    {4, PATTERN_SPIN, STATE_SPINNING},
+    {1, PATTERN_REST, STATE_WASHING},
+    {8, PATTERN_AGITATE, STATE_WASHING},
+    {10, PATTERN_SPIN, STATE_SPINNING},
+    {20, PATTERN_REST, STATE_DONE},
+    {0.5f, PATTERN_UNLOAD, STATE_IDLE},
+    {120, PATTERN_REST, STATE_IDLE},
+    {60, PATTERN_NEIGHBOUR, STATE_IDLE},
+    // quick cycle, left in the machine
+    {30, PATTERN_AGITATE, STATE_WASHING},
+    {10, PATTERN_SPIN, STATE_SPINNING},
+    {TRACKER_DONE_HOLD_MS / 60000.0f, PATTERN_REST, STATE_DONE},
+    {200, PATTERN_REST, STATE_IDLE},
+    // a cycle while the neighbour's machine runs
+    {30, PATTERN_NEIGHBOUR, STATE_IDLE},
+    {25, PATTERN_AGITATE_NEIGHBOUR, STATE_WASHING},
+    {8, PATTERN_SPIN, STATE_SPINNING},
+    {15, PATTERN_NEIGHBOUR, STATE_DONE},
+    {0.5f, PATTERN_UNLOAD, STATE_IDLE},
+    {30, PATTERN_NEIGHBOUR, STATE_IDLE},
+    {545, PATTERN_REST, STATE_IDLE},
+};
+
+static uint32_t seed = 42;
+
+static float noise(float amplitude) {
+    seed = seed * 1103515245u + 12345u;
+    return amplitude * ((float)((seed >> 8) & 0xFFFF) / 32768.0f - 1.0f);
+}
+
+// vibration in g's on (x, z) at t seconds into the segment
+static void pattern_sample(pattern_t pattern, float t, float *x, float *z) {
+    const float two_pi = 2.0f * (float)M_PI;
+    float v;
+
+    *x = 0.0f;
+    *z = 0.0f;
+    switch (pattern) {
+        case PATTERN_AGITATE_NEIGHBOUR:
+            *z = 0.15f * sinf(two_pi * 17.0f * t);
+            // fall through
+        case PATTERN_AGITATE:
+            v = fmodf(t, 16.0f) < 12.0f ? 0.5f * sinf(two_pi * 3.0f * t) : 0.0f;
+            *x += 0.5f * v;
+            *z += v;
+            break;
+        case PATTERN_SPIN:
+            v = 5.0f * sinf(two_pi * 9.0f * t);
+            *x = 0.5f * v;
+            *z = v;
+            break;
+        case PATTERN_NEIGHBOUR:
+            *z = (0.15f + 0.03f * sinf(two_pi * 0.01f * t)) * sinf(two_pi * 17.0f * t);
+            break;
+        case PATTERN_UNLOAD:
+            *x = noise(0.4f);
+            *z = noise(0.4f);
+            break;
+        default:
+            break;
+    }
+}
+
+static bool synthetic_day(trace_t *trace, labels_t *labels) {
+    size_t count = 0;
+    for (size_t s = 0; s < sizeof(day) / sizeof(day[0]); s++) {
+        count += (size_t)(day[s].minutes * 60.0f * SAMPLE_RATE_HZ);
+    }
+
+    memset(trace, 0, sizeof(*trace));
+    trace->rate_hz = SAMPLE_RATE_HZ;
+    trace->samples = malloc(count * sizeof(accel_data_t));
+    if (trace->samples == NULL) {
+        return false;
+    }
+
+    labels->count = 0;
+    for (size_t s = 0; s < sizeof(day) / sizeof(day[0]); s++) {
+        size_t n = (size_t)(day[s].minutes * 60.0f * SAMPLE_RATE_HZ);
+        if (labels->count == 0 || labels->items[labels->count - 1].state != day[s].truth) {
+            labels->items[labels->count].ms = (uint32_t)(trace->count * 1000 / SAMPLE_RATE_HZ);
+            labels->items[labels->count].state = day[s].truth;
+            labels->count++;
+        }
+        for (size_t i = 0; i < n; i++) {
+            float x, z;
+            pattern_sample(day[s].pattern, (float)i / SAMPLE_RATE_HZ, &x, &z);
+            accel_data_t sample = {
+                (int16_t)lrintf((x + noise(0.008f)) / ADXL345_SCALE_G),
+                (int16_t)lrintf(noise(0.008f) / ADXL345_SCALE_G),
+                (int16_t)lrintf((1.0f + z + noise(0.008f)) / ADXL345_SCALE_G),
+            };
+            trace->samples[trace->count++] = sample;
+        }
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Labels
+ * ------------------------------------------------------------------------- */
+
+static bool load_labels(const char *trace_path, labels_t *labels) {
+    char path[4096];
+    char line[256];
+    char name[32];
+    double seconds;
+
+    labels->count = 0;
+    snprintf(path, sizeof(path), "%s.labels", trace_path);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL && labels->count < MAX_LABELS) {
+        if (line[0] == '#' || sscanf(line, "%lf %31s", &seconds, name) != 2) {
+            continue;
+        }
+        for (int s = STATE_IDLE; s <= STATE_DONE; s++) {
+            if (strcasecmp(name, state_names[s]) == 0) {
+                labels->items[labels->count].ms = (uint32_t)(seconds * 1000.0);
+                labels->items[labels->count].state = (machine_state_t)s;
+                labels->count++;
+                break;
+            }
+        }
+    }
+    fclose(f);
+    return labels->count > 0;
+}
+
+static machine_state_t label_at(const labels_t *labels, size_t *cursor, uint32_t ms) {
+    while (*cursor + 1 < labels->count && labels->items[*cursor + 1].ms <= ms) {
+        (*cursor)++;
+    }
+    return labels->items[*cursor].state;
+}
+
+/* ---------------------------------------------------------------------------
+ * Scoring
+ * ------------------------------------------------------------------------- */
+
+static void score(const vibration_result_t *results, const machine_state_t *states, size_t windows,
+                  const labels_t *labels, uint32_t tolerance_ms, score_t *out) {
+    size_t cursor = 0;
+
+    memset(out, 0, sizeof(*out));
+    for (size_t w = 0; w < windows; w++) {
+        if (w > 0 && states[w] != states[w - 1]) {
+            out->changes++;
+        }
+        if (labels->count > 0 && states[w] == label_at(labels, &cursor, results[w].timestamp)) {
+            out->correct++;
+        }
+    }
+
+    // each labeled change against the first matching reported change
+    size_t w = 1;
+    for (size_t l = 1; l < labels->count; l++) {
+        uint32_t from = labels->items[l].ms > EARLY_MS ? labels->items[l].ms - EARLY_MS : 0;
+        uint32_t until = labels->items[l].ms + tolerance_ms;
+
+        while (w < windows && results[w].timestamp < from) {
+            w++;
+        }
+        for (size_t c = w; c < windows && results[c].timestamp <= until; c++) {
+            if (states[c] != states[c - 1] && states[c] == labels->items[l].state) {
+                double delay = ((double)results[c].timestamp - labels->items[l].ms) / 1000.0;
+                out->matched++;
+                out->delay_s += delay;
+                if (delay > out->worst_delay_s) {
+                    out->worst_delay_s = delay;
+                }
+                w = c + 1;
+                break;
+            }
+        }
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_score(const char *label, const score_t *s, size_t windows, const labels_t *labels) {
+    printf("  %-9s changes %7lu", label, s->changes);
+    if (labels->count > 0) {
+        unsigned long labeled = (unsigned long)labels->count - 1;
+        printf("  accuracy %5.1f%%  transitions %3lu/%-3lu recall %5.1f%%  precision %5.1f%%",
+               100.0 * s->correct / windows, s->matched, labeled,
+               labeled ? 100.0 * s->matched / labeled : 100.0,
+               s->changes ? 100.0 * s->matched / s->changes : 100.0);
+        if (s->matched > 0) {
+            printf("  delay mean %5.1f s worst %5.1f s", s->delay_s / s->matched, s->worst_delay_s);
+        }
+    }
+    printf("\n");
+}
+
+static bool replay(const char *name, const trace_t *trace, const labels_t *labels, uint32_t tolerance_ms) {
+    size_t capacity = trace->count / ANALYSIS_HOP_SIZE + 1;
+    vibration_result_t *results = malloc(capacity * sizeof(*results));
+    machine_state_t *raw = malloc(capacity * sizeof(*raw));
+    machine_state_t *tracked = malloc(capacity * sizeof(*tracked));
+    vibration_ctx_t ctx;
+    state_tracker_t tracker;
+    size_t windows = 0;
+
+    if (results == NULL || raw == NULL || tracked == NULL) {
+        free(results);
+        free(raw);
+        free(tracked);
+        return false;
+    }
+
+    double start = now_s();
+    vibration_ctx_init(&ctx, trace->rate_hz, NULL);
+    for (size_t i = 0; i < trace->count && windows < capacity; i++) {
+        vibration_ctx_add_sample(&ctx, &trace->samples[i]);
+        if (vibration_ctx_compute(&ctx, &results[windows])) {
+            results[windows].timestamp = (uint32_t)(i * 1000 / trace->rate_hz);
+            raw[windows] = results[windows].state;
+            windows++;
+        }
+    }
+    double analysis_s = now_s() - start;
+
+    start = now_s();
+    for (int r = 0; r < TRACKER_REPEAT; r++) {
+        state_tracker_init(&tracker);
+        for (size_t w = 0; w < windows; w++) {
+            tracked[w] = state_tracker_update(&tracker, &results[w]);
+        }
+    }
+    double tracker_s = (now_s() - start) / TRACKER_REPEAT;
+
+    score_t raw_score, tracked_score;
+    score(results, raw, windows, labels, tolerance_ms, &raw_score);
+    score(results, tracked, windows, labels, tolerance_ms, &tracked_score);
+
+    printf("%s: %.1f h, %zu windows%s\n", name, trace->count / (trace->rate_hz * 3600.0), windows,
+           labels->count > 0 ? "" : " (no labels)");
+    print_score("raw", &raw_score, windows, labels);
+    print_score("tracked", &tracked_score, windows, labels);
+    printf("  cost      analysis %.0f ns/window  tracker %.1f ns/window, idle threshold now %.3f g\n",
+           windows ? analysis_s * 1e9 / windows : 0.0, windows ? tracker_s * 1e9 / windows : 0.0,
+           state_tracker_idle_threshold(&tracker));
+
+    free(results);
+    free(raw);
+    free(tracked);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static labels_t labels;
+    uint32_t tolerance_ms = TRACKER_DONE_AFTER_SPIN_MS + 60000;
+    trace_t trace;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        if (opt == 't') {
+            tolerance_ms = (uint32_t)(atof(optarg) * 1000.0);
+        } else {
+            fprintf(stderr, "usage: %s [-t tolerance_s] [trace ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        if (!synthetic_day(&trace, &labels)) {
+            return 1;
+        }
+        bool ok = replay("synthetic day", &trace, &labels, tolerance_ms);
+        trace_free(&trace);
+        return ok ? 0 : 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (!trace_load(argv[i], &trace)) {
+            return 1;
+        }
+        load_labels(argv[i], &labels);
+        bool ok = replay(argv[i], &trace, &labels, tolerance_ms);
+        trace_free(&trace);
+        if (!ok) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "trace_capture.h"
+#include "config.h"
+#include "frame_codec.h"
+#include "host_link.h"
+#include "zigbee_handler.h"
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+bool trace_capture_init(void) {
+    return host_link_init();
+}
+
+size_t trace_capture_encode(uint16_t node_id, uint16_t rate_hz, uint32_t first_ms,
+                            const accel_data_t *samples, size_t count, uint8_t *out) {
+    uint8_t *p = out;
+
+    if (count > TRACE_CAPTURE_CHUNK) {
+        count = TRACE_CAPTURE_CHUNK;
+    }
+
+    *p++ = PKT_TYPE_RAW;
+    p = put_u16(p, node_id);
+    p = put_u16(p, rate_hz);
+    p = put_u32(p, first_ms);
+    *p++ = (uint8_t)count;
+
+    for (size_t i = 0; i < count; i++) {
+        p = put_u16(p, (uint16_t)samples[i].x);
+        p = put_u16(p, (uint16_t)samples[i].y);
+        p = put_u16(p, (uint16_t)samples[i].z);
+    }
+
+    p = put_u16(p, frame_crc16(out, (size_t)(p - out)));
+    return (size_t)(p - out);
+}
+
+bool trace_capture_block(const accel_data_t *samples, size_t count, uint32_t last_ms,
+                         uint16_t rate_hz) {
+    uint8_t packet[TRACE_CAPTURE_PACKET_MAX];
+    uint32_t period_ms = 1000 / rate_hz;
+    uint32_t first_ms = last_ms - (uint32_t)(count - 1) * period_ms;
+    bool ok = true;
+
+    for (size_t i = 0; i < count; i += TRACE_CAPTURE_CHUNK) {
+        size_t n = count - i < TRACE_CAPTURE_CHUNK ? count - i : TRACE_CAPTURE_CHUNK;
+        size_t length = trace_capture_encode(NODE_ID, rate_hz, first_ms + (uint32_t)i * period_ms,
+                                             &samples[i], n, packet);
+        ok = host_link_send(packet, length) && ok;
+    }
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE_CAPTURE_H
+#define TRACE_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "adxl345.h"
+
+// Raw sample capture (TRACE_CAPTURE_ENABLE)
+//
+// Every sample block the analysis task takes also goes out over the host
+// link as PKT_TYPE_RAW packets, which tools/trace_record turns into .wtr
+// trace files (tools/trace.h) for re-analysis on a PC. 600 bytes/s at
+// 100 Hz, well inside 115200 baud.
+//
+//   off  size  field
+//   0    1     packet_type (PKT_TYPE_RAW)
+//   1    2     node_id
+//   3    2     rate_hz
+//   5    4     first_ms, systime_ms() of sample 0
+//   9    1     count
+//   10   6n    samples, x y z int16 each
+//   end  2     checksum, CRC-16/CCITT (frame_crc16) over everything before it
+//
+// All multi-byte fields little-endian. The recorder finds lost packets
+// from first_ms.
+
+#define TRACE_CAPTURE_CHUNK 40  // samples per packet, fits a 255-byte frame
+#define TRACE_CAPTURE_PACKET_MAX (10 + 6 * TRACE_CAPTURE_CHUNK + 2)
+
+// Function prototypes
+bool trace_capture_init(void);
+
+// Packet for up to TRACE_CAPTURE_CHUNK samples into `out`
+// (TRACE_CAPTURE_PACKET_MAX bytes). Returns its length.
+size_t trace_capture_encode(uint16_t node_id, uint16_t rate_hz, uint32_t first_ms,
+                            const accel_data_t *samples, size_t count, uint8_t *out);
+
+// Send a block, newest sample taken at last_ms, in as many packets as it takes
+bool trace_capture_block(const accel_data_t *samples, size_t count, uint32_t last_ms,
+                         uint16_t rate_hz);
+
+#endif // TRACE_CAPTURE_H
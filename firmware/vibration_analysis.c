@@ -1,100 +1,230 @@
 #include "vibration_analysis.h"
 #include "config.h"
+#include "fft.h"
+#include "dsp_fixed.h"
+#include "profile.h"
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
-// Circular buffer for storing samples
-static float sample_buffer_x[BUFFER_SIZE];
-static float sample_buffer_y[BUFFER_SIZE];
-static float sample_buffer_z[BUFFER_SIZE];
-static uint16_t sample_index = 0;
-static uint16_t samples_collected = 0;
-
-// Simple FFT implementation (Cooley-Tukey algorithm)
-// yeah I know I could use a library but wanted to understand it
-typedef struct {
-    float real;
-    float imag;
-} complex_t;
-
-// Bit reversal for FFT
-static uint16_t reverse_bits(uint16_t n, uint16_t bits) {
-    uint16_t reversed = 0;
-    for (int i = 0; i < bits; i++) {
-        if (n & (1 << i)) {
-            reversed |= 1 << (bits - 1 - i);
-        }
+typedef vibration_magnitude_t magnitude_t;
+typedef vibration_sq_sum_t mag_sq_sum_t;
+
+const vibration_thresholds_t vibration_config_thresholds = VIBRATION_THRESHOLDS_CONFIG;
+
+// Default context for single-sensor tools (bench, power_sim); the firmware
+// keeps one vibration_ctx_t per sensor
+static vibration_ctx_t analysis = {
+    .rate_hz = SAMPLE_RATE_HZ,
+    .thresholds = VIBRATION_THRESHOLDS_CONFIG,
+};
+
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+static void sdft_init(vibration_ctx_t *ctx);
+static void sdft_update(sdft_state_t *sdft, magnitude_t newest, magnitude_t oldest);
+#else
+static void bands_init(vibration_ctx_t *ctx);
+#endif
+
+#if ZOOM_DECIMATION > 1
+
+// Decimation at rate_hz: as much as keeps the decimated rate at
+// SAMPLE_RATE_HZ / ZOOM_DECIMATION or above (half as much at 50Hz)
+static uint16_t zoom_decimation(uint16_t rate_hz) {
+    uint16_t decimation = ZOOM_DECIMATION;
+    while (decimation > 1 && (uint32_t)rate_hz * ZOOM_DECIMATION < (uint32_t)SAMPLE_RATE_HZ * decimation) {
+        decimation /= 2;
     }
-    return reversed;
+    return decimation;
 }
 
-// In-place FFT (recursive approach was too memory intensive)
-static void compute_fft(complex_t *data, uint16_t n) {
-    // bit reversal permutation
-    uint16_t bits = 0;
-    uint16_t temp = n;
-    while (temp > 1) {
-        bits++;
-        temp >>= 1;
+static const zoom_coef_t *zoom_filter(uint16_t decimation) {
+    switch (decimation) {
+#if ANALYSIS_FIXED_POINT
+        case 2: return zoom_filter_2_q15;
+        case 4: return zoom_filter_4_q15;
+        case 8: return zoom_filter_8_q15;
+#else
+        case 2: return zoom_filter_2;
+        case 4: return zoom_filter_4;
+        case 8: return zoom_filter_8;
+#endif
+        default: return NULL;   // 1: every sample goes straight in
     }
+}
+
+// Filter for the context's rate, starting empty; the window is left alone
+static void zoom_restart_filter(vibration_ctx_t *ctx) {
+    zoom_state_t *zoom = &ctx->zoom;
+    zoom->decimation = zoom_decimation(ctx->rate_hz);
+    zoom->filter = zoom_filter(zoom->decimation);
+    memset(zoom->acc, 0, sizeof(zoom->acc));
+    zoom->phase = 0;
+    // the first outputs are missing the older half of their taps
+    zoom->skip = zoom->filter != NULL ? ZOOM_TAPS_PER_PHASE - 1 : 0;
+}
+
+static void zoom_reset(vibration_ctx_t *ctx) {
+    memset(ctx->zoom.window, 0, sizeof(ctx->zoom.window));
+    ctx->zoom.index = 0;
+    ctx->zoom.collected = 0;
+    zoom_restart_filter(ctx);
+}
+
+// ZOOM_TAPS_PER_PHASE multiply-adds per sample, whatever the decimation
+static void zoom_add_sample(zoom_state_t *zoom, magnitude_t magnitude) {
+    magnitude_t decimated = magnitude;
     
-    for (uint16_t i = 0; i < n; i++) {
-        uint16_t j = reverse_bits(i, bits);
-        if (j > i) {
-            complex_t tmp = data[i];
-            data[i] = data[j];
-            data[j] = tmp;
+    if (zoom->filter != NULL) {
+        const zoom_coef_t *coef = &zoom->filter[zoom->phase * ZOOM_TAPS_PER_PHASE];
+        for (int j = 0; j < ZOOM_TAPS_PER_PHASE; j++) {
+            zoom->acc[j] += (zoom_acc_t)coef[j] * magnitude;
         }
-    }
-    
-    // FFT computation
-    for (uint16_t size = 2; size <= n; size *= 2) {
-        float angle = -2.0f * M_PI / size;
-        complex_t wlen = {cosf(angle), sinf(angle)};
+        if (++zoom->phase < zoom->decimation) {
+            return;
+        }
+        zoom->phase = 0;
         
-        for (uint16_t i = 0; i < n; i += size) {
-            complex_t w = {1.0f, 0.0f};
-            
-            for (uint16_t j = 0; j < size / 2; j++) {
-                complex_t u = data[i + j];
-                complex_t v = {
-                    w.real * data[i + j + size/2].real - w.imag * data[i + j + size/2].imag,
-                    w.real * data[i + j + size/2].imag + w.imag * data[i + j + size/2].real
-                };
-                
-                data[i + j].real = u.real + v.real;
-                data[i + j].imag = u.imag + v.imag;
-                data[i + j + size/2].real = u.real - v.real;
-                data[i + j + size/2].imag = u.imag - v.imag;
-                
-                // multiply w by wlen
-                float tmp_real = w.real * wlen.real - w.imag * wlen.imag;
-                w.imag = w.real * wlen.imag + w.imag * wlen.real;
-                w.real = tmp_real;
-            }
+#if ANALYSIS_FIXED_POINT
+        // saturated: the filter overshoots a little on a hard step
+        int32_t out = (zoom->acc[0] + (1 << 14)) >> 15;
+        decimated = (magnitude_t)(out > INT16_MAX ? INT16_MAX : out);
+#else
+        decimated = zoom->acc[0];
+#endif
+        memmove(zoom->acc, &zoom->acc[1], (ZOOM_TAPS_PER_PHASE - 1) * sizeof(zoom_acc_t));
+        zoom->acc[ZOOM_TAPS_PER_PHASE - 1] = 0;
+        
+        if (zoom->skip > 0) {
+            zoom->skip--;
+            return;
         }
     }
+    
+    zoom->window[zoom->index] = decimated;
+    zoom->index = (zoom->index + 1) % ZOOM_FFT_SIZE;
+    if (zoom->collected < ZOOM_FFT_SIZE) {
+        zoom->collected++;
+    }
 }
 
-void vibration_analysis_init(void) {
-    memset(sample_buffer_x, 0, sizeof(sample_buffer_x));
-    memset(sample_buffer_y, 0, sizeof(sample_buffer_y));
-    memset(sample_buffer_z, 0, sizeof(sample_buffer_z));
-    sample_index = 0;
-    samples_collected = 0;
+#endif // ZOOM_DECIMATION
+
+// The full-rate window, and the spectrum's bins at the current rate
+static void window_reset(vibration_ctx_t *ctx) {
+    memset(ctx->magnitude_buffer, 0, sizeof(ctx->magnitude_buffer));
+    ctx->magnitude_sum = 0;
+    ctx->magnitude_sq_sum = 0;
+    ctx->sample_index = 0;
+    ctx->samples_collected = 0;
+    ctx->samples_since_analysis = 0;
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+    sdft_init(ctx);
+#else
+    bands_init(ctx);
+#endif
 }
 
-void vibration_analysis_add_sample(accel_data_t *data) {
-    // Convert to g's and store in circular buffer
-    sample_buffer_x[sample_index] = adxl345_convert_to_g(data->x);
-    sample_buffer_y[sample_index] = adxl345_convert_to_g(data->y);
-    sample_buffer_z[sample_index] = adxl345_convert_to_g(data->z);
+void vibration_ctx_reset(vibration_ctx_t *ctx) {
+#if ZOOM_DECIMATION > 1
+    zoom_reset(ctx);
+#endif
+    window_reset(ctx);
+}
+
+void vibration_ctx_init(vibration_ctx_t *ctx, uint16_t rate_hz, const vibration_thresholds_t *thresholds) {
+    ctx->rate_hz = rate_hz;
+    ctx->thresholds = thresholds != NULL ? *thresholds : vibration_config_thresholds;
+    vibration_ctx_reset(ctx);
+}
+
+void vibration_ctx_set_sample_rate(vibration_ctx_t *ctx, uint16_t rate_hz) {
+#if ZOOM_DECIMATION > 1
+    // Switching to or from the reduced power rate changes the decimation,
+    // not the decimated rate: the zoom window carries on (with a gap of
+    // ZOOM_TAPS_PER_PHASE - 1 samples while the new filter fills)
+    if ((uint32_t)rate_hz * ctx->zoom.decimation == (uint32_t)ctx->rate_hz * zoom_decimation(rate_hz)) {
+        ctx->rate_hz = rate_hz;
+        zoom_restart_filter(ctx);
+        window_reset(ctx);
+        return;
+    }
+#endif
+    // samples at different rates can't share a window, start over
+    ctx->rate_hz = rate_hz;
+    vibration_ctx_reset(ctx);
+}
+
+uint16_t vibration_ctx_warmup_samples(const vibration_ctx_t *ctx) {
+#if ZOOM_DECIMATION > 1
+    uint16_t outputs = ZOOM_FFT_SIZE + (ctx->zoom.filter != NULL ? ZOOM_TAPS_PER_PHASE - 1 : 0);
+    uint16_t samples = outputs * ctx->zoom.decimation;
+    return samples > BUFFER_SIZE ? samples : BUFFER_SIZE;
+#else
+    (void)ctx;
+    return BUFFER_SIZE;
+#endif
+}
+
+#if !ANALYSIS_FIXED_POINT
+// Float running sums pick up rounding error with every add/subtract, so they
+// are rebuilt from the buffer once per lap (amortised: one add per sample)
+static void resync_sums(vibration_ctx_t *ctx) {
+    ctx->magnitude_sum = 0.0f;
+    ctx->magnitude_sq_sum = 0.0f;
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        ctx->magnitude_sum += ctx->magnitude_buffer[i];
+        ctx->magnitude_sq_sum += ctx->magnitude_buffer[i] * ctx->magnitude_buffer[i];
+    }
+}
+#endif
+
+void vibration_ctx_add_sample(vibration_ctx_t *ctx, const accel_data_t *data) {
+    // x^2 + y^2 in one dual multiply, then z^2. Assumes full resolution mode,
+    // where counts stay within +/-4096 (13 bits) so this fits in 32 bits.
+    uint32_t xy = dsp_pack16(data->x, data->y);
+    uint32_t mag_sq = (uint32_t)dsp_smuad(xy, xy) + (uint32_t)((int32_t)data->z * data->z);
+    
+#if ANALYSIS_FIXED_POINT
+    // quarter counts to keep some fraction bits, rounded to nearest so the
+    // mean isn't biased (matters once it's subtracted for the RMS)
+    uint32_t scaled = mag_sq << 4;
+    uint32_t root = dsp_isqrt32(scaled);
+    if (scaled - root * root > root) {
+        root++;
+    }
+    magnitude_t magnitude = (q15_t)root;
+#else
+    magnitude_t magnitude = sqrtf((float)mag_sq) * ADXL345_SCALE_G;
+#endif
+    
+    magnitude_t oldest = ctx->magnitude_buffer[ctx->sample_index];
+    
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+    sdft_update(&ctx->sdft, magnitude, oldest);
+#endif
+#if ZOOM_DECIMATION > 1
+    zoom_add_sample(&ctx->zoom, magnitude);
+#endif
     
-    sample_index = (sample_index + 1) % BUFFER_SIZE;
+    // replace the oldest sample (zeros until the window fills up)
+    ctx->magnitude_sum += magnitude - oldest;
+    ctx->magnitude_sq_sum += (mag_sq_sum_t)magnitude * magnitude - (mag_sq_sum_t)oldest * oldest;
+    ctx->magnitude_buffer[ctx->sample_index] = magnitude;
     
-    if (samples_collected < BUFFER_SIZE) {
-        samples_collected++;
+    ctx->sample_index = (ctx->sample_index + 1) % BUFFER_SIZE;
+    
+#if !ANALYSIS_FIXED_POINT
+    if (ctx->sample_index == 0) {
+        resync_sums(ctx);
+    }
+#endif
+    
+    if (ctx->samples_collected < BUFFER_SIZE) {
+        ctx->samples_collected++;
+    }
+    if (ctx->samples_since_analysis < ANALYSIS_HOP_SIZE) {
+        ctx->samples_since_analysis++;
     }
 }
 
@@ -106,81 +236,459 @@ float vibration_compute_rms(float *buffer, size_t length) {
     return sqrtf(sum / length);
 }
 
-bool vibration_analysis_compute(vibration_result_t *result) {
-    // Need full buffer to do analysis
-    if (samples_collected < BUFFER_SIZE) {
-        return false;
+// The RMS is taken over the vibration only: the window mean (the static 1g
+// of gravity plus sensor offset) is removed, otherwise a machine at rest
+// reads ~1g and could never drop below IDLE_THRESHOLD.
+//     N^2 * variance = N * sum(m^2) - sum(m)^2
+#if ANALYSIS_FIXED_POINT
+
+static float window_rms(const vibration_ctx_t *ctx) {
+    int64_t var_n2 = (int64_t)BUFFER_SIZE * ctx->magnitude_sq_sum -
+                     (int64_t)ctx->magnitude_sum * ctx->magnitude_sum;
+    if (var_n2 < 0) {
+        var_n2 = 0;
     }
     
-    // Compute magnitude for each sample (sqrt(x^2 + y^2 + z^2))
-    float magnitude[BUFFER_SIZE];
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-        magnitude[i] = sqrtf(
-            sample_buffer_x[i] * sample_buffer_x[i] +
-            sample_buffer_y[i] * sample_buffer_y[i] +
-            sample_buffer_z[i] * sample_buffer_z[i]
-        );
+    // sqrt(var_n2 << 8) = 16 * N * rms, rms in quarter counts
+    uint32_t rms_scaled = dsp_isqrt64((uint64_t)var_n2 << 8);
+    return rms_scaled * (ADXL345_SCALE_G / (16.0f * 4.0f * BUFFER_SIZE));
+}
+
+#else
+
+static float window_rms(const vibration_ctx_t *ctx) {
+    float mean = ctx->magnitude_sum / BUFFER_SIZE;
+    float variance = ctx->magnitude_sq_sum / BUFFER_SIZE - mean * mean;
+    return variance > 0.0f ? sqrtf(variance) : 0.0f;
+}
+
+#endif // ANALYSIS_FIXED_POINT
+
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_FFT
+
+static const float band_edges_hz[VIBRATION_BANDS + 1] = FEATURE_BAND_EDGES_HZ;
+
+// A band is at level q when it holds at least 10^(-0.3 * (q + 0.5)) of the
+// energy: 3 dB steps, rounded to the nearest, no log on the node
+static const float band_level_min[VIBRATION_BAND_FLOOR] = {
+    7.0795e-01f, 3.5481e-01f, 1.7783e-01f, 8.9125e-02f, 4.4668e-02f,
+    2.2387e-02f, 1.1220e-02f, 5.6234e-03f, 2.8184e-03f, 1.4125e-03f,
+    7.0795e-04f, 3.5481e-04f, 1.7783e-04f, 8.9125e-05f, 4.4668e-05f,
+};
+
+// Rate of the samples the FFT sees: the decimated rate in zoom mode
+static float spectrum_rate_hz(const vibration_ctx_t *ctx) {
+#if ZOOM_DECIMATION > 1
+    return (float)ctx->rate_hz / ctx->zoom.decimation;
+#else
+    return (float)ctx->rate_hz;
+#endif
+}
+
+// Band edges as FFT bins at the current rate; bands above Nyquist end up empty
+static void bands_init(vibration_ctx_t *ctx) {
+    float rate_hz = spectrum_rate_hz(ctx);
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        float bin = ceilf(band_edges_hz[b] * VIBRATION_FFT_SIZE / rate_hz);
+        if (bin < 1.0f) {
+            bin = 1.0f;
+        }
+        ctx->band_first_bin[b] = bin < VIBRATION_FFT_SIZE / 2 ? (uint16_t)bin : VIBRATION_FFT_SIZE / 2;
     }
+    ctx->band_first_bin[VIBRATION_BANDS] = VIBRATION_FFT_SIZE / 2;
+}
+
+static uint8_t band_level(float power, float total) {
+    uint8_t level = 0;
+    while (level < VIBRATION_BAND_FLOOR && power < total * band_level_min[level]) {
+        level++;
+    }
+    return level;
+}
+
+// Peak frequency, band levels and centroid from the power of bins
+// 1..N/2-1 (DC and Nyquist left out, as for the peak)
+static void spectrum_features(const vibration_ctx_t *ctx, const float *power,
+                              vibration_features_t *features) {
+    float band_power[VIBRATION_BANDS];
+    float total = 0.0f;
+    float moment = 0.0f;
+    float max_power = 0.0f;
+    uint16_t max_index = 1;
     
-    // Compute RMS
-    result->rms_magnitude = vibration_compute_rms(magnitude, BUFFER_SIZE);
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        band_power[b] = 0.0f;
+        for (uint16_t i = ctx->band_first_bin[b]; i < ctx->band_first_bin[b + 1]; i++) {
+            band_power[b] += power[i];
+            moment += power[i] * i;
+            if (power[i] > max_power) {
+                max_power = power[i];
+                max_index = i;
+            }
+        }
+        total += band_power[b];
+    }
     
-    // Prepare data for FFT
-    complex_t fft_data[BUFFER_SIZE];
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-        fft_data[i].real = magnitude[i];
-        fft_data[i].imag = 0.0f;
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        features->band_level[b] = total > 0.0f ? band_level(band_power[b], total) : VIBRATION_BAND_FLOOR;
     }
+    float rate_hz = spectrum_rate_hz(ctx);
+    features->centroid_hz = total > 0.0f ? moment / total * rate_hz / VIBRATION_FFT_SIZE : 0.0f;
     
-    // Perform FFT
-    compute_fft(fft_data, BUFFER_SIZE);
+    // Convert bin index to frequency
+    features->dominant_freq = (float)max_index * rate_hz / VIBRATION_FFT_SIZE;
+}
+
+// Copy the window out oldest-first, so the analysis sees it in time order
+// (the decimated one in zoom mode)
+static void copy_window(const vibration_ctx_t *ctx, magnitude_t *window) {
+#if ZOOM_DECIMATION > 1
+    const magnitude_t *ring = ctx->zoom.window;
+    uint16_t oldest = ctx->zoom.index;
+#else
+    const magnitude_t *ring = ctx->magnitude_buffer;
+    uint16_t oldest = ctx->sample_index;
+#endif
+    uint16_t tail = VIBRATION_FFT_SIZE - oldest;
+    memcpy(window, &ring[oldest], tail * sizeof(magnitude_t));
+    memcpy(&window[tail], ring, oldest * sizeof(magnitude_t));
+}
+
+#if ANALYSIS_FIXED_POINT
+
+static void fft_analyze(const vibration_ctx_t *ctx, vibration_features_t *features) {
+    // the samples are done with after the FFT, the bin powers reuse the space
+    union {
+        q15_t samples[VIBRATION_FFT_SIZE];
+        float power[VIBRATION_FFT_SIZE / 2];
+    } window;
+    copy_window(ctx, window.samples);
     
-    // Find dominant frequency (skip DC component at index 0)
-    float max_magnitude = 0.0f;
-    uint16_t max_index = 1;
+    // Remove DC (mostly gravity) and scale the window up to use the Q15 range.
+    // Peak, band shares and centroid are all relative, so the gain doesn't
+    // need undoing.
+#if ZOOM_DECIMATION > 1
+    int32_t sum = 0;
+    for (int i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        sum += window.samples[i];
+    }
+    int16_t mean = (int16_t)(sum / VIBRATION_FFT_SIZE);
+#else
+    int16_t mean = (int16_t)(ctx->magnitude_sum / BUFFER_SIZE);
+#endif
+    int32_t max_abs = 0;
+    for (int i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        window.samples[i] -= mean;
+        int32_t a = window.samples[i] < 0 ? -window.samples[i] : window.samples[i];
+        if (a > max_abs) {
+            max_abs = a;
+        }
+    }
+    
+    uint16_t gain_shift = 0;
+    while (max_abs != 0 && (max_abs << (gain_shift + 1)) < 16384) {
+        gain_shift++;
+    }
+    for (int i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        window.samples[i] = (q15_t)(window.samples[i] << gain_shift);
+    }
     
-    for (int i = 1; i < BUFFER_SIZE / 2; i++) {  // only need first half
-        float mag = sqrtf(fft_data[i].real * fft_data[i].real + 
-                         fft_data[i].imag * fft_data[i].imag);
-        if (mag > max_magnitude) {
-            max_magnitude = mag;
-            max_index = i;
+    complex_q15_t spectrum[VIBRATION_FFT_SIZE / 2 + 1];
+    fft_real_forward_q15(window.samples, spectrum, VIBRATION_FFT_SIZE);
+    
+    for (int i = 1; i < VIBRATION_FFT_SIZE / 2; i++) {
+        uint32_t bin = dsp_load_pair(&spectrum[i]);
+        window.power[i] = (float)(uint32_t)dsp_smuad(bin, bin);
+    }
+    
+    spectrum_features(ctx, window.power, features);
+}
+
+#else
+
+static void fft_analyze(const vibration_ctx_t *ctx, vibration_features_t *features) {
+    float window[VIBRATION_FFT_SIZE];
+    copy_window(ctx, window);
+    
+    // Real-input FFT, only bins 0..N/2 come back
+    complex_t spectrum[VIBRATION_FFT_SIZE / 2 + 1];
+    fft_real_forward(window, spectrum, VIBRATION_FFT_SIZE);
+    
+    // squared magnitudes, into the window which is done with
+    // (same argmax as the magnitudes, without the sqrt)
+    float *power = window;
+    for (int i = 1; i < VIBRATION_FFT_SIZE / 2; i++) {  // only need first half
+        power[i] = spectrum[i].real * spectrum[i].real +
+                   spectrum[i].imag * spectrum[i].imag;
+    }
+    
+    spectrum_features(ctx, power, features);
+}
+
+#endif // ANALYSIS_FIXED_POINT
+
+#endif // SPECTRAL_ENGINE_FFT
+
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+
+// Sliding DFT of just the bins inside the washing and spinning bands.
+// Each new sample updates every tracked bin in O(1):
+//     X_k(n) = r * e^(j*2*pi*k/N) * (X_k(n-1) + x(n) - r^N * x(n-N))
+// r slightly below 1 keeps rounding errors from building up forever.
+#define SDFT_DAMPING 0.99976f   // 1 - 2^-12
+
+static void sdft_add_band(sdft_state_t *sdft, sdft_band_t *band, uint16_t rate_hz,
+                          float freq_min, float freq_max) {
+    uint16_t first = (uint16_t)ceilf(freq_min * BUFFER_SIZE / rate_hz);
+    uint16_t last = (uint16_t)floorf(freq_max * BUFFER_SIZE / rate_hz);
+    
+    if (first < 1) {
+        first = 1;
+    }
+    if (last > BUFFER_SIZE / 2 - 1) {
+        last = BUFFER_SIZE / 2 - 1;
+    }
+    
+    band->first_bin = sdft->num_bins;
+    band->num_bins = 0;
+    
+    for (uint16_t k = first; k <= last && sdft->num_bins < SDFT_MAX_BINS; k++) {
+        float angle = 2.0f * (float)M_PI * k / BUFFER_SIZE;
+        sdft_bin_t *w = &sdft->twiddle[sdft->num_bins];
+#if ANALYSIS_FIXED_POINT
+        w->real = (int32_t)lrintf(SDFT_DAMPING * cosf(angle) * 32768.0f);
+        w->imag = (int32_t)lrintf(SDFT_DAMPING * sinf(angle) * 32768.0f);
+#else
+        w->real = SDFT_DAMPING * cosf(angle);
+        w->imag = SDFT_DAMPING * sinf(angle);
+#endif
+        sdft->bin_index[sdft->num_bins] = k;
+        sdft->num_bins++;
+        band->num_bins++;
+    }
+}
+
+static void sdft_init(vibration_ctx_t *ctx) {
+    // twiddles are computed once here, the per-sample path has no trig
+    sdft_state_t *sdft = &ctx->sdft;
+    const vibration_thresholds_t *t = &ctx->thresholds;
+    
+    sdft->num_bins = 0;
+    sdft_add_band(sdft, &sdft->washing_band, ctx->rate_hz, t->washing_freq_min, t->washing_freq_max);
+    sdft_add_band(sdft, &sdft->spinning_band, ctx->rate_hz, t->spinning_freq_min, t->spinning_freq_max);
+    memset(sdft->bins, 0, sizeof(sdft->bins));
+    
+#if ANALYSIS_FIXED_POINT
+    sdft->damping_n = (int32_t)lrintf(powf(SDFT_DAMPING, BUFFER_SIZE) * 32768.0f);
+#else
+    sdft->damping_n = powf(SDFT_DAMPING, BUFFER_SIZE);
+#endif
+}
+
+static void sdft_update(sdft_state_t *sdft, magnitude_t newest, magnitude_t oldest) {
+#if ANALYSIS_FIXED_POINT
+    int32_t delta = newest - (int32_t)(((int64_t)oldest * sdft->damping_n + (1 << 14)) >> 15);
+    
+    for (uint16_t b = 0; b < sdft->num_bins; b++) {
+        int64_t tr = sdft->bins[b].real + delta;
+        int64_t ti = sdft->bins[b].imag;
+        int64_t wr = sdft->twiddle[b].real;
+        int64_t wi = sdft->twiddle[b].imag;
+        
+        // rounded, so the error doesn't drift one way
+        sdft->bins[b].real = (int32_t)((tr * wr - ti * wi + (1 << 14)) >> 15);
+        sdft->bins[b].imag = (int32_t)((tr * wi + ti * wr + (1 << 14)) >> 15);
+    }
+#else
+    float delta = newest - sdft->damping_n * oldest;
+    
+    for (uint16_t b = 0; b < sdft->num_bins; b++) {
+        float tr = sdft->bins[b].real + delta;
+        float ti = sdft->bins[b].imag;
+        
+        sdft->bins[b].real = tr * sdft->twiddle[b].real - ti * sdft->twiddle[b].imag;
+        sdft->bins[b].imag = tr * sdft->twiddle[b].imag + ti * sdft->twiddle[b].real;
+    }
+#endif
+}
+
+static float sdft_bin_power(const sdft_state_t *sdft, uint16_t b) {
+    float re = (float)sdft->bins[b].real;
+    float im = (float)sdft->bins[b].imag;
+    return re * re + im * im;
+}
+
+static float sdft_band_power(const sdft_state_t *sdft, const sdft_band_t *band) {
+    float power = 0.0f;
+    for (uint16_t b = band->first_bin; b < band->first_bin + band->num_bins; b++) {
+        power += sdft_bin_power(sdft, b);
+    }
+    return power;
+}
+
+// Total vibration (non-DC) energy of the window, in the same units as the
+// bins: by Parseval, sum over k=1..N-1 of |X_k|^2 = N*sum(x^2) - sum(x)^2
+static float window_ac_power(const vibration_ctx_t *ctx) {
+#if ANALYSIS_FIXED_POINT
+    return (float)((int64_t)BUFFER_SIZE * ctx->magnitude_sq_sum -
+                   (int64_t)ctx->magnitude_sum * ctx->magnitude_sum);
+#else
+    return BUFFER_SIZE * ctx->magnitude_sq_sum - ctx->magnitude_sum * ctx->magnitude_sum;
+#endif
+}
+
+static void sdft_analyze(const vibration_ctx_t *ctx, vibration_features_t *features) {
+    const sdft_state_t *sdft = &ctx->sdft;
+    float ac_power = window_ac_power(ctx);
+    
+    // a real signal splits its energy between bin k and N-k, hence the 2
+    features->washing_fraction = 0.0f;
+    features->spinning_fraction = 0.0f;
+    if (ac_power > 0.0f) {
+        features->washing_fraction = 2.0f * sdft_band_power(sdft, &sdft->washing_band) / ac_power;
+        features->spinning_fraction = 2.0f * sdft_band_power(sdft, &sdft->spinning_band) / ac_power;
+    }
+    
+    // still report a peak frequency, from the tracked bins only
+    float max_power = 0.0f;
+    uint16_t max_index = sdft->num_bins ? sdft->bin_index[0] : 1;
+    for (uint16_t b = 0; b < sdft->num_bins; b++) {
+        float power = sdft_bin_power(sdft, b);
+        if (power > max_power) {
+            max_power = power;
+            max_index = sdft->bin_index[b];
         }
     }
+    features->dominant_freq = (float)max_index * ctx->rate_hz / BUFFER_SIZE;
+}
+
+#endif // SPECTRAL_ENGINE_SDFT
+
+bool vibration_ctx_features(vibration_ctx_t *ctx, vibration_features_t *features) {
+    // Need a full window, then one analysis per hop
+    if (ctx->samples_collected < BUFFER_SIZE || ctx->samples_since_analysis < ANALYSIS_HOP_SIZE) {
+        return false;
+    }
+#if ZOOM_DECIMATION > 1
+    if (ctx->zoom.collected < ZOOM_FFT_SIZE) {
+        return false;
+    }
+#endif
+    ctx->samples_since_analysis = 0;
     
-    // Convert bin index to frequency
-    result->dominant_freq = (float)max_index * SAMPLE_RATE_HZ / BUFFER_SIZE;
+    PROFILE_START(rms_start);
+    features->rms = window_rms(ctx);
+    PROFILE_END(PROFILE_RMS, rms_start);
+    
+    PROFILE_START(spectrum_start);
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+    sdft_analyze(ctx, features);
+    memset(features->band_level, VIBRATION_BAND_FLOOR, sizeof(features->band_level));
+    features->centroid_hz = 0.0f;
+#else
+    fft_analyze(ctx, features);
+    features->washing_fraction = 0.0f;
+    features->spinning_fraction = 0.0f;
+#endif
+    PROFILE_END(PROFILE_SPECTRUM, spectrum_start);
+    return true;
+}
+
+machine_state_t vibration_classify(const vibration_thresholds_t *t, const vibration_features_t *features) {
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+    return vibration_classify_bands(t, features->rms,
+                                    features->washing_fraction, features->spinning_fraction);
+#else
+    return vibration_classify_state(t, features->rms, features->dominant_freq);
+#endif
+}
+
+bool vibration_ctx_compute(vibration_ctx_t *ctx, vibration_result_t *result) {
+    vibration_features_t features;
+    
+    if (!vibration_ctx_features(ctx, &features)) {
+        return false;
+    }
+    
+    result->rms_magnitude = features.rms;
+    result->dominant_freq = features.dominant_freq;
+    memcpy(result->band_level, features.band_level, sizeof(result->band_level));
+    result->centroid_hz = features.centroid_hz;
     
-    // Classify machine state
-    result->state = vibration_classify_state(result->rms_magnitude, result->dominant_freq);
+    PROFILE_START(classify_start);
+    result->state = vibration_classify(&ctx->thresholds, &features);
+    PROFILE_END(PROFILE_CLASSIFY, classify_start);
     
-    // TODO: add actual timestamp
+    // main.c stamps it, it knows when the samples were taken
     result->timestamp = 0;
     
     return true;
 }
 
-machine_state_t vibration_classify_state(float rms, float freq) {
+void vibration_analysis_init(void) {
+    vibration_ctx_reset(&analysis);
+}
+
+void vibration_analysis_set_sample_rate(uint16_t rate_hz) {
+    vibration_ctx_set_sample_rate(&analysis, rate_hz);
+}
+
+uint16_t vibration_analysis_get_sample_rate(void) {
+    return analysis.rate_hz;
+}
+
+void vibration_analysis_add_sample(accel_data_t *data) {
+    vibration_ctx_add_sample(&analysis, data);
+}
+
+bool vibration_analysis_compute(vibration_result_t *result) {
+    return vibration_ctx_compute(&analysis, result);
+}
+
+machine_state_t vibration_classify_state(const vibration_thresholds_t *t, float rms, float freq) {
     // Based on empirical testing (will need to tune these)
     
-    if (rms < IDLE_THRESHOLD) {
+    if (rms < t->idle) {
         return STATE_IDLE;
     }
     
-    if (rms >= SPINNING_MIN) {
+    if (rms >= t->spinning_min) {
         // High vibration = spinning cycle
         return STATE_SPINNING;
     }
     
-    if (rms >= WASHING_MIN && rms <= WASHING_MAX) {
+    if (rms >= t->washing_min && rms <= t->washing_max) {
         // Medium vibration with lower frequency = washing
-        if (freq >= 2.0f && freq <= 4.0f) {
+        if (freq >= t->washing_freq_min && freq <= t->washing_freq_max) {
             return STATE_WASHING;
         }
     }
     
-    // If we had high vibration before and now it's low, machine is done
-    // TODO: implement state tracking to detect done state properly
+    // Stateless on purpose: state_tracker_update() (state_tracker.h) turns
+    // these per-window states into WASHING -> SPINNING -> DONE
+    
+    return STATE_UNKNOWN;
+}
+
+machine_state_t vibration_classify_bands(const vibration_thresholds_t *t, float rms,
+                                         float washing_fraction, float spinning_fraction) {
+    // Same rules as vibration_classify_state, but "frequency in the washing
+    // band" means the band holds a real share of the vibration energy and
+    // more of it than the spin band
+    
+    if (rms < t->idle) {
+        return STATE_IDLE;
+    }
+    
+    if (rms >= t->spinning_min) {
+        return STATE_SPINNING;
+    }
+    
+    if (rms >= t->washing_min && rms <= t->washing_max) {
+        if (washing_fraction >= t->band_dominance && washing_fraction >= spinning_fraction) {
+            return STATE_WASHING;
+        }
+    }
     
     return STATE_UNKNOWN;
 }
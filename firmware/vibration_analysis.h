@@ -2,6 +2,9 @@
 #define VIBRATION_ANALYSIS_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
 #include "adxl345.h"
 
 // Machine states
@@ -13,19 +16,186 @@ typedef enum {
     STATE_UNKNOWN
 } machine_state_t;
 
+// Spectral feature vector (FFT engine, FEATURE_BAND_EDGES_HZ): per band its
+// share of the window's vibration energy in 3 dB steps, 0 = all of it,
+// VIBRATION_BAND_FLOOR = -43.5 dB or less (or no energy at all)
+#define VIBRATION_BANDS 8
+#define VIBRATION_BAND_FLOOR 15
+
 // Vibration analysis result
 typedef struct {
-    float rms_magnitude;      // Root Mean Square of vibration
+    float rms_magnitude;      // RMS of vibration (gravity/DC removed), in g's
     float dominant_freq;      // Dominant frequency in Hz
     machine_state_t state;    // Detected machine state
-    uint32_t timestamp;       // Timestamp of analysis
+    uint32_t timestamp;       // systime_ms() of the newest sample in the window
+    uint8_t band_level[VIBRATION_BANDS];
+    float centroid_hz;        // spectral centroid
 } vibration_result_t;
 
-// Function prototypes
+// What a window measured, before classification
+typedef struct {
+    float rms;                // g's, gravity/DC removed
+    float dominant_freq;      // Hz
+    float washing_fraction;   // SDFT engine: share of the vibration energy per band
+    float spinning_fraction;
+    uint8_t band_level[VIBRATION_BANDS];  // FFT engine, all VIBRATION_BAND_FLOOR with SDFT
+    float centroid_hz;
+} vibration_features_t;
+
+// Classification thresholds, config.h values unless a tool sweeps them
+typedef struct {
+    float idle;               // IDLE_THRESHOLD
+    float washing_min;        // WASHING_MIN .. WASHING_MAX
+    float washing_max;
+    float spinning_min;       // SPINNING_MIN
+    float washing_freq_min;   // WASHING_FREQ_MIN .. WASHING_FREQ_MAX
+    float washing_freq_max;
+    float spinning_freq_min;  // SPINNING_FREQ_MIN .. SPINNING_FREQ_MAX
+    float spinning_freq_max;
+    float band_dominance;     // BAND_DOMINANCE
+} vibration_thresholds_t;
+
+#define VIBRATION_THRESHOLDS_CONFIG { \
+    IDLE_THRESHOLD, WASHING_MIN, WASHING_MAX, SPINNING_MIN, \
+    WASHING_FREQ_MIN, WASHING_FREQ_MAX, SPINNING_FREQ_MIN, SPINNING_FREQ_MAX, \
+    BAND_DOMINANCE }
+
+extern const vibration_thresholds_t vibration_config_thresholds;
+
+// Sliding window over the magnitude signal, updated one sample at a time.
+// Magnitude is computed once when a sample arrives; running sums of the
+// magnitude and its square give the RMS without a pass over the window.
+#if ANALYSIS_FIXED_POINT
+typedef int16_t vibration_magnitude_t;   // quarter counts (Q2)
+typedef int32_t vibration_sum_t;         // integer sums are exact, never drift
+typedef int64_t vibration_sq_sum_t;
+#else
+typedef float vibration_magnitude_t;     // g's
+typedef float vibration_sum_t;
+typedef float vibration_sq_sum_t;
+#endif
+
+#if ZOOM_DECIMATION > 1
+#include "fft_tables.h"
+#include "zoom_tables.h"
+
+#if SPECTRAL_ENGINE != SPECTRAL_ENGINE_FFT
+#error "ZOOM_DECIMATION needs the FFT spectral engine"
+#endif
+#if ZOOM_DECIMATION > ZOOM_DECIMATION_MAX || (ZOOM_DECIMATION & (ZOOM_DECIMATION - 1))
+#error "ZOOM_DECIMATION must be 1, 2, 4 or 8"
+#endif
+#if ZOOM_FFT_SIZE < 16 || ZOOM_FFT_SIZE > FFT_TABLE_SIZE || (ZOOM_FFT_SIZE & (ZOOM_FFT_SIZE - 1))
+#error "ZOOM_FFT_SIZE must be a power of 2 from 16 to FFT_TABLE_SIZE"
+#endif
+
+#define VIBRATION_FFT_SIZE ZOOM_FFT_SIZE
+
+// Decimating low-pass in polyphase form: each input sample is multiplied
+// into the ZOOM_TAPS_PER_PHASE outputs it contributes to, and every
+// decimation-th sample completes acc[0]. No input history is kept.
+#if ANALYSIS_FIXED_POINT
+typedef int16_t zoom_coef_t;    // Q15
+typedef int32_t zoom_acc_t;     // Q2 counts << 15
+#else
+typedef float zoom_coef_t;
+typedef float zoom_acc_t;
+#endif
+
+typedef struct {
+    vibration_magnitude_t window[ZOOM_FFT_SIZE];  // decimated magnitude, ring
+    zoom_acc_t acc[ZOOM_TAPS_PER_PHASE];          // outputs in the making, acc[0] next
+    const zoom_coef_t *filter;      // zoom_tables.h order, NULL at decimation 1
+    uint16_t decimation;            // at the context's rate_hz
+    uint16_t phase;                 // input sample within the block of decimation
+    uint16_t skip;                  // outputs to drop while the filter fills
+    uint16_t index;                 // oldest sample once the window is full
+    uint16_t collected;
+} zoom_state_t;
+#else
+#define VIBRATION_FFT_SIZE BUFFER_SIZE
+#endif
+
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+#define SDFT_MAX_BINS 16
+
+typedef struct {
+    uint16_t first_bin;
+    uint16_t num_bins;
+} sdft_band_t;
+
+// Fixed point: bins in Q2 counts like the magnitude, twiddles and r^N in Q15
+typedef struct {
+#if ANALYSIS_FIXED_POINT
+    int32_t real;
+    int32_t imag;
+#else
+    float real;
+    float imag;
+#endif
+} sdft_bin_t;
+
+typedef struct {
+    sdft_band_t washing_band;
+    sdft_band_t spinning_band;
+    uint16_t num_bins;
+    uint16_t bin_index[SDFT_MAX_BINS];
+    sdft_bin_t bins[SDFT_MAX_BINS];
+    sdft_bin_t twiddle[SDFT_MAX_BINS];
+#if ANALYSIS_FIXED_POINT
+    int32_t damping_n;
+#else
+    float damping_n;
+#endif
+} sdft_state_t;
+#endif
+
+// All the analysis state for one sensor. The firmware uses one through the
+// vibration_analysis_* calls; host tools run as many as they like side by
+// side (nothing in here is shared).
+typedef struct {
+    vibration_magnitude_t magnitude_buffer[BUFFER_SIZE];
+    vibration_sum_t magnitude_sum;          // running sums over the window
+    vibration_sq_sum_t magnitude_sq_sum;
+    uint16_t sample_index;                  // oldest sample once the window is full
+    uint16_t samples_collected;
+    uint16_t samples_since_analysis;
+    uint16_t rate_hz;
+    vibration_thresholds_t thresholds;
+#if SPECTRAL_ENGINE == SPECTRAL_ENGINE_SDFT
+    sdft_state_t sdft;
+#else
+    uint16_t band_first_bin[VIBRATION_BANDS + 1];  // at rate_hz, last entry VIBRATION_FFT_SIZE / 2
+#endif
+#if ZOOM_DECIMATION > 1
+    zoom_state_t zoom;
+#endif
+} vibration_ctx_t;
+
+// thresholds NULL = config.h
+void vibration_ctx_init(vibration_ctx_t *ctx, uint16_t rate_hz, const vibration_thresholds_t *thresholds);
+void vibration_ctx_reset(vibration_ctx_t *ctx);      // empty window, same rate and thresholds
+void vibration_ctx_set_sample_rate(vibration_ctx_t *ctx, uint16_t rate_hz);
+void vibration_ctx_add_sample(vibration_ctx_t *ctx, const accel_data_t *data);
+// Samples from a reset to the first window that can be measured (BUFFER_SIZE
+// unless the zoom analysis needs more)
+uint16_t vibration_ctx_warmup_samples(const vibration_ctx_t *ctx);
+// Once per ANALYSIS_HOP_SIZE samples with a full window: measure it
+bool vibration_ctx_features(vibration_ctx_t *ctx, vibration_features_t *features);
+machine_state_t vibration_classify(const vibration_thresholds_t *t, const vibration_features_t *features);
+// features + classify with the context's thresholds
+bool vibration_ctx_compute(vibration_ctx_t *ctx, vibration_result_t *result);
+
+// A default context, for tools that only ever analyse one sensor
 void vibration_analysis_init(void);
+void vibration_analysis_set_sample_rate(uint16_t rate_hz);
+uint16_t vibration_analysis_get_sample_rate(void);
 void vibration_analysis_add_sample(accel_data_t *data);
 bool vibration_analysis_compute(vibration_result_t *result);
-machine_state_t vibration_classify_state(float rms, float freq);
+
+machine_state_t vibration_classify_state(const vibration_thresholds_t *t, float rms, float freq);
+machine_state_t vibration_classify_bands(const vibration_thresholds_t *t, float rms,
+                                         float washing_fraction, float spinning_fraction);
 float vibration_compute_rms(float *buffer, size_t length);
 
 #endif // VIBRATION_ANALYSIS_H
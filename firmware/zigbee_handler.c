@@ -1,20 +1,25 @@
 #include "zigbee_handler.h"
 #include "config.h"
+#include "systime.h"
+#include "frame_codec.h"
+#include "host_link.h"
+#include "hal.h"
 #include <string.h>
 
 // NOTE: This is a simplified Zigbee implementation
 // In production, you'd use TI's Z-Stack or similar
 
 static bool zigbee_connected = false;
+#ifndef DEVICE_TYPE_COORDINATOR
 static uint32_t last_ack_time = 0;
+#endif
+static zigbee_ack_handler_t ack_handler = NULL;
+static zigbee_packet_handler_t packet_handler = NULL;
 
-// Compute simple checksum (CRC would be better but this works)
+// CRC-16/CCITT, same table as the serial framing. The additive sum this
+// used to be missed swapped and paired bit errors.
 uint16_t zigbee_compute_checksum(uint8_t *data, size_t length) {
-    uint16_t checksum = 0;
-    for (size_t i = 0; i < length; i++) {
-        checksum += data[i];
-    }
-    return checksum;
+    return frame_crc16(data, length);
 }
 
 bool zigbee_init(void) {
@@ -24,6 +29,14 @@ bool zigbee_init(void) {
     // 2. Join the Zigbee network
     // 3. Set up routing tables
     
+    hal_radio_set_receive(zigbee_receive);
+    
+#if DEBUG_UART_ENABLE || defined(DEVICE_TYPE_COORDINATOR)
+    if (!host_link_init()) {
+        return false;
+    }
+#endif
+    
     // For now, just simulate successful init
     zigbee_connected = true;
     
@@ -54,18 +67,11 @@ bool zigbee_send_data(vibration_result_t *result) {
     );
     
     // Send packet to coordinator
-    // In real implementation, would use Zigbee AF (Application Framework) to send
-    // af_DataRequest(&packet, sizeof(packet), COORDINATOR_ADDR, ...);
-    
-    // For now, just log it
     #if DEBUG_UART_ENABLE
-    // Would output via UART here
+    host_link_send((const uint8_t *)&packet, sizeof(packet));
     #endif
     
-    // TODO: implement actual transmission
-    // Wait for ACK with timeout
-    
-    return true;
+    return hal_radio_send((const uint8_t *)&packet, sizeof(packet));
 }
 
 bool zigbee_send_heartbeat(void) {
@@ -79,7 +85,7 @@ bool zigbee_send_heartbeat(void) {
     packet.machine_state = 0;
     packet.rms_magnitude = 0.0f;
     packet.dominant_freq = 0.0f;
-    packet.timestamp = 0;  // TODO: use actual timestamp
+    packet.timestamp = systime_ms();
     
     packet.checksum = zigbee_compute_checksum(
         (uint8_t*)&packet,
@@ -87,9 +93,69 @@ bool zigbee_send_heartbeat(void) {
     );
     
     // Send heartbeat
-    // af_DataRequest(&packet, sizeof(packet), COORDINATOR_ADDR, ...);
+    #if DEBUG_UART_ENABLE
+    host_link_send((const uint8_t *)&packet, sizeof(packet));
+    #endif
     
-    return true;
+    return hal_radio_send((const uint8_t *)&packet, sizeof(packet));
+}
+
+bool zigbee_send_frame(const uint8_t *frame, size_t length) {
+    if (!zigbee_connected || length == 0) {
+        return false;
+    }
+    
+    // Frame is already complete (type, node id, checksum), send as is
+    #if DEBUG_UART_ENABLE
+    host_link_send(frame, length);
+    #endif
+    
+    return hal_radio_send(frame, length);
+}
+
+void zigbee_set_ack_handler(zigbee_ack_handler_t handler) {
+    ack_handler = handler;
+}
+
+void zigbee_set_packet_handler(zigbee_packet_handler_t handler) {
+    packet_handler = handler;
+}
+
+bool zigbee_send_to(uint16_t address, const uint8_t *packet, size_t length) {
+    if (!zigbee_connected || length == 0) {
+        return false;
+    }
+    return hal_radio_send_to(address, packet, length);
+}
+
+void zigbee_receive(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi) {
+    // Coordinator: called from the AF incoming message callback, packets go
+    // to coordinator_main.c's queue
+#ifdef DEVICE_TYPE_COORDINATOR
+    if (packet_handler != NULL) {
+        packet_handler(packet, length, source, lqi);
+    }
+#else
+    (void)source;
+    (void)lqi;
+
+    // Node: the backend's ACKs for our telemetry frames
+    zigbee_ack_t ack;
+
+    if (length != sizeof(ack) || packet[0] != PKT_TYPE_ACK) {
+        return;
+    }
+    memcpy(&ack, packet, sizeof(ack));
+    if (ack.node_id != NODE_ID ||
+        ack.checksum != zigbee_compute_checksum((uint8_t *)&ack, sizeof(ack) - sizeof(uint16_t))) {
+        return;
+    }
+
+    last_ack_time = systime_ms();
+    if (ack_handler != NULL) {
+        ack_handler(ack.seq);
+    }
+#endif
 }
 
 bool zigbee_is_connected(void) {
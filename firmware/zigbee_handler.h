@@ -3,12 +3,20 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "vibration_analysis.h"
 
 // Zigbee packet types
 #define PKT_TYPE_DATA 0x01
 #define PKT_TYPE_HEARTBEAT 0x02
 #define PKT_TYPE_ACK 0x03
+#define PKT_TYPE_BATCH 0x04  // batched reports + heartbeat, see telemetry.h
+#define PKT_TYPE_RAW 0x05    // raw samples, host link only, see trace_capture.h
+#define PKT_TYPE_PROFILE 0x06  // stage timings, extended heartbeat, see profile.h
+#define PKT_TYPE_FEATURES 0x07  // PKT_TYPE_BATCH with spectral feature vectors, see telemetry.h
+#define PKT_TYPE_AGGREGATE 0x08  // coordinator -> host, several node packets, see coordinator.h
+#define PKT_TYPE_NODES 0x09      // coordinator -> host, nodes heard lately, see coordinator.h
+#define PKT_TYPE_TASKS 0x0A      // task stack/CPU usage, extended heartbeat, see profile.h
 
 // Packet structure for sending vibration data
 typedef struct __attribute__((packed)) {
@@ -21,10 +29,29 @@ typedef struct __attribute__((packed)) {
     uint16_t checksum;
 } zigbee_packet_t;
 
+// PKT_TYPE_ACK, backend -> node: telemetry frame `seq` is stored (outbox.h)
+typedef struct __attribute__((packed)) {
+    uint8_t packet_type;
+    uint16_t node_id;
+    uint16_t seq;
+    uint16_t checksum;
+} zigbee_ack_t;
+
+// Interrupt context, once per ACK addressed to this node
+typedef void (*zigbee_ack_handler_t)(uint16_t seq);
+
+// Coordinator: interrupt context, once per packet from a node (hal.h)
+typedef void (*zigbee_packet_handler_t)(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi);
+
 // Function prototypes
 bool zigbee_init(void);
+void zigbee_set_ack_handler(zigbee_ack_handler_t handler);
+void zigbee_set_packet_handler(zigbee_packet_handler_t handler);
 bool zigbee_send_data(vibration_result_t *result);
 bool zigbee_send_heartbeat(void);
+bool zigbee_send_frame(const uint8_t *frame, size_t length);
+bool zigbee_send_to(uint16_t address, const uint8_t *packet, size_t length);  // coordinator -> node
+void zigbee_receive(const uint8_t *packet, size_t length, uint16_t source, uint8_t lqi);  // coordinator: to the packet handler, node: ACKs
 bool zigbee_is_connected(void);
 uint16_t zigbee_compute_checksum(uint8_t *data, size_t length);
 
@@ -0,0 +1,104 @@
+// Generated by tools/gen_tables.py - do not edit
+#include "zoom_tables.h"
+
+const float zoom_filter_2[32] = {
+    -0.001409004f,  0.003563889f, -0.007323126f,  0.013496811f,
+    -0.023632701f,  0.041823029f, -0.085305196f,  0.449579315f,
+     0.147262086f, -0.057775936f,  0.031234335f, -0.017914637f,
+     0.010038536f, -0.005201592f,  0.002323509f, -0.000759318f,
+    -0.000759318f,  0.002323509f, -0.005201592f,  0.010038536f,
+    -0.017914637f,  0.031234335f, -0.057775936f,  0.147262086f,
+     0.449579315f, -0.085305196f,  0.041823029f, -0.023632701f,
+     0.013496811f, -0.007323126f,  0.003563889f, -0.001409004f,
+};
+
+const int16_t zoom_filter_2_q15[32] = {
+       -46,    117,   -240,    442,   -774,   1370,  -2795,  14732,
+      4825,  -1893,   1023,   -587,    329,   -170,     76,    -25,
+       -25,     76,   -170,    329,   -587,   1023,  -1893,   4825,
+     14732,  -2795,   1370,   -774,    442,   -240,    117,    -46,
+};
+
+const float zoom_filter_4[64] = {
+    -0.000435784f,  0.001064180f, -0.002148741f,  0.003923574f,
+    -0.006852531f,  0.012220913f, -0.025916022f,  0.243690714f,
+     0.033911239f, -0.014356522f,  0.007876570f, -0.004519866f,
+     0.002515488f, -0.001285381f,  0.000559249f, -0.000170975f,
+    -0.000799527f,  0.002103113f, -0.004404014f,  0.008199567f,
+    -0.014407218f,  0.025345586f, -0.050074664f,  0.195253090f,
+     0.116132380f, -0.041259226f,  0.021909260f, -0.012545289f,
+     0.007072192f, -0.003712194f,  0.001698709f, -0.000587871f,
+    -0.000587871f,  0.001698709f, -0.003712194f,  0.007072192f,
+    -0.012545289f,  0.021909260f, -0.041259226f,  0.116132380f,
+     0.195253090f, -0.050074664f,  0.025345586f, -0.014407218f,
+     0.008199567f, -0.004404014f,  0.002103113f, -0.000799527f,
+    -0.000170975f,  0.000559249f, -0.001285381f,  0.002515488f,
+    -0.004519866f,  0.007876570f, -0.014356522f,  0.033911239f,
+     0.243690714f, -0.025916022f,  0.012220913f, -0.006852531f,
+     0.003923574f, -0.002148741f,  0.001064180f, -0.000435784f,
+};
+
+const int16_t zoom_filter_4_q15[64] = {
+       -14,     35,    -70,    129,   -225,    400,   -849,   7983,
+      1111,   -470,    258,   -148,     82,    -42,     18,     -6,
+       -26,     69,   -144,    269,   -472,    831,  -1641,   6398,
+      3805,  -1352,    718,   -411,    232,   -122,     56,    -19,
+       -19,     56,   -122,    232,   -411,    718,  -1352,   3805,
+      6398,  -1641,    831,   -472,    269,   -144,     69,    -26,
+        -6,     18,    -42,     82,   -148,    258,   -470,   1111,
+      7985,   -849,    400,   -225,    129,    -70,     35,    -14,
+};
+
+const float zoom_filter_8[128] = {
+    -0.000118475f,  0.000284647f, -0.000570015f,  0.001036339f,
+    -0.001808291f,  0.003239793f, -0.007028122f,  0.124281011f,
+     0.008035484f, -0.003511259f,  0.001938663f, -0.001112290f,
+     0.000616736f, -0.000312827f,  0.000134202f, -0.000039511f,
+    -0.000296114f,  0.000735591f, -0.001498078f,  0.002747925f,
+    -0.004804854f,  0.008534050f, -0.017731193f,  0.117845521f,
+     0.026607008f, -0.010869526f,  0.005921819f, -0.003397804f,
+     0.001897676f, -0.000976602f,  0.000430661f, -0.000136306f,
+    -0.000386377f,  0.000996079f, -0.002065823f,  0.003826348f,
+    -0.006710764f,  0.011838415f, -0.023746093f,  0.105590312f,
+     0.047370380f, -0.017747035f,  0.009512807f, -0.005452423f,
+     0.003064799f, -0.001598554f,  0.000722915f, -0.000243363f,
+    -0.000394351f,  0.001059700f, -0.002241426f,  0.004195784f,
+    -0.007387518f,  0.012965592f, -0.025265790f,  0.088675027f,
+     0.068668742f, -0.022937604f,  0.012055065f, -0.006893749f,
+     0.003896728f, -0.002057894f,  0.000952422f, -0.000338214f,
+    -0.000338214f,  0.000952422f, -0.002057894f,  0.003896728f,
+    -0.006893749f,  0.012055065f, -0.022937604f,  0.068668742f,
+     0.088675027f, -0.025265790f,  0.012965592f, -0.007387518f,
+     0.004195784f, -0.002241426f,  0.001059700f, -0.000394351f,
+    -0.000243363f,  0.000722915f, -0.001598554f,  0.003064799f,
+    -0.005452423f,  0.009512807f, -0.017747035f,  0.047370380f,
+     0.105590312f, -0.023746093f,  0.011838415f, -0.006710764f,
+     0.003826348f, -0.002065823f,  0.000996079f, -0.000386377f,
+    -0.000136306f,  0.000430661f, -0.000976602f,  0.001897676f,
+    -0.003397804f,  0.005921819f, -0.010869526f,  0.026607008f,
+     0.117845521f, -0.017731193f,  0.008534050f, -0.004804854f,
+     0.002747925f, -0.001498078f,  0.000735591f, -0.000296114f,
+    -0.000039511f,  0.000134202f, -0.000312827f,  0.000616736f,
+    -0.001112290f,  0.001938663f, -0.003511259f,  0.008035484f,
+     0.124281011f, -0.007028122f,  0.003239793f, -0.001808291f,
+     0.001036339f, -0.000570015f,  0.000284647f, -0.000118475f,
+};
+
+const int16_t zoom_filter_8_q15[128] = {
+        -4,      9,    -19,     34,    -59,    106,   -230,   4070,
+       263,   -115,     64,    -36,     20,    -10,      4,     -1,
+       -10,     24,    -49,     90,   -157,    280,   -581,   3862,
+       872,   -356,    194,   -111,     62,    -32,     14,     -4,
+       -13,     33,    -68,    125,   -220,    388,   -778,   3460,
+      1552,   -582,    312,   -179,    100,    -52,     24,     -8,
+       -13,     35,    -73,    137,   -242,    425,   -828,   2906,
+      2250,   -752,    395,   -226,    128,    -67,     31,    -11,
+       -11,     31,    -67,    128,   -226,    395,   -752,   2250,
+      2906,   -828,    425,   -242,    137,    -73,     35,    -13,
+        -8,     24,    -52,    100,   -179,    312,   -582,   1552,
+      3460,   -778,    388,   -220,    125,    -68,     33,    -13,
+        -4,     14,    -32,     62,   -111,    194,   -356,    872,
+      3862,   -581,    280,   -157,     90,    -49,     24,    -10,
+        -1,      4,    -10,     20,    -36,     64,   -115,    263,
+      4072,   -230,    106,    -59,     34,    -19,      9,     -4,
+};
@@ -0,0 +1,21 @@
+// Generated by tools/gen_tables.py - do not edit
+#ifndef ZOOM_TABLES_H
+#define ZOOM_TABLES_H
+
+#include <stdint.h>
+
+// Decimating low-pass filters for the zoom analysis, one per decimation D:
+// D * ZOOM_TAPS_PER_PHASE taps, unity gain at DC, cut off at the decimated
+// Nyquist. Polyphase order, [r * ZOOM_TAPS_PER_PHASE + j] = h[j * D + D - 1 - r]:
+// what input sample r of a block of D adds to the output j blocks on.
+#define ZOOM_TAPS_PER_PHASE 16
+#define ZOOM_DECIMATION_MAX 8
+
+extern const float zoom_filter_2[32];
+extern const int16_t zoom_filter_2_q15[32];
+extern const float zoom_filter_4[64];
+extern const int16_t zoom_filter_4_q15[64];
+extern const float zoom_filter_8[128];
+extern const int16_t zoom_filter_8_q15[128];
+
+#endif // ZOOM_TABLES_H